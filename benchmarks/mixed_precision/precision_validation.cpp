@@ -0,0 +1,247 @@
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+
+#include "../../include/lbm.h"
+
+/*****************************************************
+ *
+ * Accuracy of the mixed precision mode compared
+ *	with the double precision steps
+ *
+ * - Laminar flow in x direction in a channel with
+ *		walls in y, compared with the double precision
+ *		and the analytical velocity profiles
+ * - Laplace law - droplets of several sizes in a
+ *		periodic domain, pressure difference and
+ *		surface tension compared with double precision
+ * - Each case runs with double precision storage,
+ *		single precision storage, and single precision
+ *		deviations from the rest state
+ *
+ *****************************************************/
+
+// Storage of the distributions in one run
+struct Storage {
+	std::string name;
+	LBM::Precision precision;
+	bool deviation;
+};
+
+// Result of one Laplace law run
+struct DropletResult {
+	double radius;
+	double dp;
+};
+
+// Steady velocity profile in the channel, ux at each row of one column
+std::vector<double> channel_flow(const Storage& storage, double& time);
+// Equilibrated droplet initialized as a square with half side half_side
+DropletResult droplet_equilibration(const Storage& storage, const int half_side, double& time);
+// Slope of the least squares line through (x, y) points
+double fit_slope(const std::vector<double>& x, const std::vector<double>& y);
+// Largest absolute difference between two profiles
+double max_difference(const std::vector<double>& a, const std::vector<double>& b);
+
+// All storage types
+const std::vector<Storage> storages = {{"double", LBM::double_precision, false},
+										{"float", LBM::mixed_precision, false},
+										{"float deviation", LBM::mixed_precision, true}};
+
+// Channel flow settings
+const size_t channel_Nx = 10, channel_Ny = 50;
+const double channel_rho = 2.0, dPdL = 1e-4;
+const int channel_steps = 30000;
+
+// Laplace law settings
+const size_t drop_Nx = 160, drop_Ny = 160;
+const std::vector<int> half_sides = {30, 24, 18, 12};
+const double G_repulsive = 0.9;
+const int drop_steps = 10000;
+
+int main()
+{
+	std::cout << std::scientific << std::setprecision(4);
+
+	//
+	// Laminar flow in a channel
+	//
+
+	// Analytical profile, walls at the first and last row
+	const double mu = 1.0/6.0*channel_rho;
+	const double channel_hw = (channel_Ny - 2.0)/2.0;
+	const double u_max = dPdL*channel_hw*channel_hw/(2.0*mu);
+	std::vector<double> u_an(channel_Ny, 0.0);
+	for (size_t j = 1; j < channel_Ny - 1; ++j) {
+		const double y = j - 1.0 - channel_hw + 0.5;
+		u_an.at(j) = u_max*(1.0 - (y/channel_hw)*(y/channel_hw));
+	}
+
+	std::cout << "Laminar channel flow, " << channel_Nx << "x" << channel_Ny
+			  << ", " << channel_steps << " steps" << std::endl;
+	std::cout << std::setw(16) << "storage" << std::setw(14) << "max |u-u_dbl|"
+			  << std::setw(14) << "rel. to u_max" << std::setw(14) << "max |u-u_an|"
+			  << std::setw(10) << "time (s)" << std::endl;
+	std::vector<double> u_double;
+	for (const Storage& storage : storages) {
+		double time = 0.0;
+		const std::vector<double> u = channel_flow(storage, time);
+		if (storage.precision == LBM::double_precision) {
+			u_double = u;
+		}
+		const double diff = max_difference(u, u_double);
+		std::cout << std::setw(16) << storage.name << std::setw(14) << diff
+				  << std::setw(14) << diff/u_max << std::setw(14) << max_difference(u, u_an)
+				  << std::setw(10) << std::fixed << std::setprecision(2) << time
+				  << std::scientific << std::setprecision(4) << std::endl;
+	}
+
+	//
+	// Laplace law
+	//
+
+	std::cout << std::endl << "Laplace law, " << drop_Nx << "x" << drop_Ny
+			  << ", " << drop_steps << " steps" << std::endl;
+	std::cout << std::setw(16) << "storage" << std::setw(10) << "half side"
+			  << std::setw(12) << "radius" << std::setw(14) << "dp"
+			  << std::setw(14) << "|dp-dp_dbl|" << std::setw(10) << "time (s)" << std::endl;
+	std::vector<double> dp_double, sigmas;
+	for (const Storage& storage : storages) {
+		std::vector<double> inv_radius, dp;
+		for (size_t k = 0; k < half_sides.size(); ++k) {
+			double time = 0.0;
+			const DropletResult res = droplet_equilibration(storage, half_sides.at(k), time);
+			if (storage.precision == LBM::double_precision) {
+				dp_double.push_back(res.dp);
+			}
+			inv_radius.push_back(1.0/res.radius);
+			dp.push_back(res.dp);
+			std::cout << std::setw(16) << storage.name << std::setw(10) << half_sides.at(k)
+					  << std::setw(12) << std::fixed << std::setprecision(3) << res.radius
+					  << std::scientific << std::setprecision(4) << std::setw(14) << res.dp
+					  << std::setw(14) << std::abs(res.dp - dp_double.at(k))
+					  << std::setw(10) << std::fixed << std::setprecision(2) << time
+					  << std::scientific << std::setprecision(4) << std::endl;
+		}
+		sigmas.push_back(fit_slope(inv_radius, dp));
+	}
+
+	std::cout << std::endl << "Surface tension from the Laplace law" << std::endl;
+	std::cout << std::setw(16) << "storage" << std::setw(14) << "sigma"
+			  << std::setw(14) << "rel. diff." << std::endl;
+	for (size_t k = 0; k < storages.size(); ++k) {
+		std::cout << std::setw(16) << storages.at(k).name << std::setw(14) << sigmas.at(k)
+				  << std::setw(14) << std::abs(sigmas.at(k) - sigmas.at(0))/std::abs(sigmas.at(0)) << std::endl;
+	}
+}
+
+// Steady velocity profile in the channel, ux at each row of one column
+std::vector<double> channel_flow(const Storage& storage, double& time)
+{
+	const double beta = 1.0/6.0;
+	std::vector<double> vol_force{0, 1, 0, -1, 0, 1, -1, -1, 1};
+	std::for_each(vol_force.begin(), vol_force.end(), [&beta](double& el) { el *= dPdL*beta; });
+
+	Geometry geom(channel_Nx, channel_Ny);
+	geom.add_walls(1, "x");
+	Fluid fluid;
+	fluid.simple_ini(geom, channel_rho);
+	LBM lbm(geom, LBM::two_lattice, storage.precision);
+	if (storage.precision == LBM::mixed_precision) {
+		lbm.compress(geom, fluid, storage.deviation);
+	}
+
+	std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+	for (int iter = 0; iter<channel_steps; ++iter) {
+		lbm.step(geom, fluid, vol_force);
+	}
+	std::chrono::steady_clock::time_point t_end = std::chrono::steady_clock::now();
+	time = std::chrono::duration<double>(t_end - t0).count();
+
+	if (storage.precision == LBM::mixed_precision) {
+		lbm.expand(geom, fluid);
+	}
+	fluid.compute_macroscopic(geom);
+	std::vector<double> u(channel_Ny, 0.0);
+	for (size_t j = 0; j < channel_Ny; ++j) {
+		u.at(j) = fluid.get_ux().at(j*channel_Nx);
+	}
+	return u;
+}
+
+// Equilibrated droplet initialized as a square with half side half_side
+DropletResult droplet_equilibration(const Storage& storage, const int half_side, double& time)
+{
+	Geometry geom(drop_Nx, drop_Ny);
+	LBM lbm(geom, LBM::two_lattice, storage.precision);
+
+	Fluid bulk("water"), droplet("oil");
+	bulk.zero_density_ini(geom);
+	droplet.zero_density_ini(geom);
+	// No solids, only repulsive fluid-fluid interactions
+	bulk.initialize_interactions(0.0, G_repulsive);
+	droplet.initialize_interactions(0.0, G_repulsive);
+	lbm.initialize_fluid_rectangle(geom, bulk, droplet, 2.0, 2.0, 0.06, 0.06,
+									drop_Nx/2, drop_Ny/2, half_side, half_side);
+	lbm.compute_solid_surface_force(geom, bulk, droplet);
+	if (storage.precision == LBM::mixed_precision) {
+		lbm.compress(geom, bulk, storage.deviation);
+		lbm.compress(geom, droplet, storage.deviation);
+	}
+
+	std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+	for (int iter = 0; iter<drop_steps; ++iter) {
+		lbm.step(geom, bulk, droplet);
+	}
+	std::chrono::steady_clock::time_point t_end = std::chrono::steady_clock::now();
+	time = std::chrono::duration<double>(t_end - t0).count();
+
+	if (storage.precision == LBM::mixed_precision) {
+		lbm.expand(geom, bulk);
+		lbm.expand(geom, droplet);
+	}
+	bulk.compute_density();
+	droplet.compute_density();
+	const LatticeVector<double>& rho_b = bulk.get_rho();
+	const LatticeVector<double>& rho_d = droplet.get_rho();
+
+	// Pressure difference between the center and a point far from the droplet
+	auto pressure = [&](const size_t ai)
+		{ return 1.0/3.0*(rho_b.at(ai) + rho_d.at(ai)) + G_repulsive/3.0*rho_b.at(ai)*rho_d.at(ai); };
+	const size_t center = drop_Ny/2*drop_Nx + drop_Nx/2;
+	const size_t outside = (drop_Ny - 10)*drop_Nx + drop_Nx - 10;
+
+	// Radius from the area of the droplet
+	size_t Ninside = 0;
+	for (size_t ai = 0; ai < drop_Nx*drop_Ny; ++ai) {
+		if (rho_d.at(ai) > rho_b.at(ai)) {
+			++Ninside;
+		}
+	}
+	const double pi = std::acos(-1.0);
+	return {std::sqrt(Ninside/pi), pressure(center) - pressure(outside)};
+}
+
+// Slope of the least squares line through (x, y) points
+double fit_slope(const std::vector<double>& x, const std::vector<double>& y)
+{
+	const double N = static_cast<double>(x.size());
+	double sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0;
+	for (size_t k = 0; k < x.size(); ++k) {
+		sx += x.at(k);
+		sy += y.at(k);
+		sxx += x.at(k)*x.at(k);
+		sxy += x.at(k)*y.at(k);
+	}
+	return (N*sxy - sx*sy)/(N*sxx - sx*sx);
+}
+
+// Largest absolute difference between two profiles
+double max_difference(const std::vector<double>& a, const std::vector<double>& b)
+{
+	double diff = 0.0;
+	for (size_t k = 0; k < a.size(); ++k) {
+		diff = std::max(diff, std::abs(a.at(k) - b.at(k)));
+	}
+	return diff;
+}
@@ -0,0 +1,33 @@
+import subprocess
+
+import sys
+py_path = '../../scripts/'
+sys.path.insert(0, py_path)
+
+import utils as ut
+from colors import *
+
+py_version = 'python3'
+
+# Directory with executables
+path_exe = '../../executables/'
+
+#
+# Accuracy of the single precision storage compared 
+#	with the double precision steps - laminar channel 
+#	flow and Laplace law; the report is written to 
+#	report_file
+#
+
+# Output
+report_file = 'precision_report.txt'
+
+# Compile
+subprocess.call([py_version + ' compilation.py'], shell=True)
+
+ut.msg('Mixed precision validation', CYAN)
+out = subprocess.check_output([path_exe + 'precision_validation'], shell=True, universal_newlines=True)
+print(out)
+
+with open(report_file, 'w') as fout:
+	fout.write(out)
@@ -0,0 +1,80 @@
+import subprocess
+
+import sys
+py_path = '../../scripts/'
+sys.path.insert(0, py_path)
+
+import utils as ut
+from colors import *
+
+py_version = 'python3'
+
+# Directory with executables
+path_exe = '../../executables/'
+
+#
+# Weak and strong scaling of the MPI domain decomposition
+#	Run on the target machine with one OpenMP thread
+#	per rank (OMP_NUM_THREADS=1) and the ranks bound
+#	to cores; the report is written to report_file
+#
+
+# Numbers of MPI processes
+nprocs = [1, 2, 4, 8]
+# Number of time steps
+steps = 500
+# Strong scaling - whole domain
+strong_Nx, strong_Ny = 400, 800
+# Weak scaling - domain per rank
+weak_Nx, weak_Ny = 400, 200
+# Single phase (1) and two phase (2) flows
+phases = [1, 2]
+# Output
+report_file = 'scaling_report.txt'
+
+# Run one case, returns [np, Nx, Ny, time, MLUPS]
+def run_case(mode, phase, nproc, Nx, Ny):
+	command = ' '.join(['mpirun -np', str(nproc), '--bind-to core', path_exe + 'mpi_scaling',
+							mode, str(phase), str(Nx), str(Ny), str(steps)])
+	out = subprocess.check_output([command], shell=True, universal_newlines=True)
+	res = out.split()
+	return [int(res[0]), int(res[1]), int(res[2]), float(res[3]), float(res[4])]
+
+# Table with speedup and efficiency relative to the first number of processes
+def report(mode, phase, results):
+	lines = ['', mode.capitalize() + ' scaling, ' + ('single' if phase == 1 else 'two') + ' phase flow']
+	lines.append('{:>6} {:>12} {:>12} {:>10} {:>10} {:>11}'.format('np', 'domain', 'time (s)', 
+					'MLUPS', 'speedup', 'efficiency'))
+	np_ref, t_ref = results[0][0], results[0][3]
+	for res in results:
+		nproc, Nx, Ny, time, mlups = res
+		if mode == 'strong':
+			speedup = t_ref/time
+			efficiency = speedup*np_ref/nproc
+		else:
+			# Work grows with the number of processes
+			speedup = t_ref/time*nproc/np_ref
+			efficiency = t_ref/time
+		lines.append('{:>6} {:>12} {:>12.4f} {:>10.2f} {:>10.2f} {:>11.2f}'.format(nproc, 
+						str(Nx) + 'x' + str(Ny), time, mlups, speedup, efficiency))
+	return lines
+
+# Compile
+subprocess.call([py_version + ' compilation.py'], shell=True)
+
+ut.msg('MPI scaling', CYAN)
+all_lines = []
+for phase in phases:
+	for mode in ['strong', 'weak']:
+		results = []
+		for nproc in nprocs:
+			if mode == 'strong':
+				results.append(run_case(mode, phase, nproc, strong_Nx, strong_Ny))
+			else:
+				results.append(run_case(mode, phase, nproc, weak_Nx, weak_Ny))
+		lines = report(mode, phase, results)
+		print('\n'.join(lines))
+		all_lines += lines
+
+with open(report_file, 'w') as fout:
+	fout.write('\n'.join(all_lines) + '\n')
@@ -0,0 +1,103 @@
+#include <string>
+#include <iostream>
+#include <iomanip>
+
+#include "../../include/mpi/distributed_lbm.h"
+
+/***************************************************** 
+ *
+ * Parallel scaling of the MPI domain decomposition
+ *
+ * Usage: mpirun -np N scaling <strong|weak> <1|2> Nx Ny steps
+ *
+ * - strong - fixed Nx by Ny domain for all N
+ * - weak - Nx by Ny nodes per rank, domain Nx by N*Ny
+ * - 1 - single fluid driven by a volume force in a
+ * 		channel with a cylinder, 2 - droplet in a channel
+ * - Prints one line: N, Nx, Ny of the whole domain,
+ * 		wall time of the slowest rank, and MLUPS
+ *
+ *****************************************************/
+
+// Time steps of a single phase flow, returns the wall time of this rank
+double single_phase_run(DistributedLBM& dlbm, const int steps);
+// Time steps of a two phase flow, returns the wall time of this rank
+double two_phase_run(DistributedLBM& dlbm, const size_t Nx, const size_t Ny, const int steps);
+
+int main(int argc, char** argv)
+{
+	MPI_Init(&argc, &argv);
+	int rank = 0, nranks = 1;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &nranks);
+
+	if (argc != 6) {
+		if (rank == 0) {
+			std::cerr << "Usage: scaling <strong|weak> <1|2> Nx Ny steps" << std::endl;
+		}
+		MPI_Finalize();
+		return 1;
+	}
+	const std::string mode(argv[1]);
+	const int phases = std::stoi(argv[2]);
+	const size_t Nx = std::stoul(argv[3]);
+	const size_t Ny = (mode == "weak") ? std::stoul(argv[4])*nranks : std::stoul(argv[4]);
+	const int steps = std::stoi(argv[5]);
+
+	// Channel with walls at x = 0 and x = Nx - 1, periodic in y (decomposed direction)
+	Geometry geom(Nx, Ny);
+	geom.add_walls(1, "y");
+	if (phases == 1) {
+		// Odd diameter, about a quarter of the channel width
+		geom.add_circle(2*(Nx/8) + 1, Nx/2, Ny/2);
+	}
+
+	DistributedLBM dlbm(geom);
+	const double local_time = (phases == 1) ? single_phase_run(dlbm, steps) 
+											: two_phase_run(dlbm, Nx, Ny, steps);
+	double time = 0.0;
+	MPI_Reduce(&local_time, &time, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+	if (rank == 0) {
+		const double mlups = static_cast<double>(Nx*Ny)*steps/time/1e6;
+		std::cout << nranks << " " << Nx << " " << Ny << " " 
+				  << std::setprecision(6) << time << " " << mlups << std::endl;
+	}
+
+	MPI_Finalize();
+}
+
+double single_phase_run(DistributedLBM& dlbm, const int steps)
+{
+	Fluid fluid("water");
+	fluid.simple_ini(dlbm.get_local_geometry(), 1.0);
+	const std::vector<double> force = {0.0, 0.0, 1e-5, 0.0, -1e-5, 1e-5, 1e-5, -1e-5, -1e-5};
+
+	MPI_Barrier(MPI_COMM_WORLD);
+	const double start = MPI_Wtime();
+	for (int it = 0; it < steps; ++it) {
+		dlbm.step(fluid, force);
+	}
+	return MPI_Wtime() - start;
+}
+
+double two_phase_run(DistributedLBM& dlbm, const size_t Nx, const size_t Ny, const int steps)
+{
+	const Geometry& local_geom = dlbm.get_local_geometry();
+	Fluid bulk("water"), droplet("oil");
+	bulk.zero_density_ini(local_geom);
+	droplet.zero_density_ini(local_geom);
+	bulk.initialize_interactions(0.1, 0.9);
+	droplet.initialize_interactions(-0.1, 0.9);
+	dlbm.initialize_droplet(bulk, droplet, 2.0, 2.0, 0.06, 0.06, 
+							Nx/2, Ny/2, std::min(Nx, Ny)/4.0);
+	dlbm.compute_solid_surface_force(bulk, droplet);
+	const std::vector<double> force = {0.0, 0.0, 1e-6, 0.0, -1e-6, 1e-6, 1e-6, -1e-6, -1e-6};
+
+	MPI_Barrier(MPI_COMM_WORLD);
+	const double start = MPI_Wtime();
+	for (int it = 0; it < steps; ++it) {
+		dlbm.step(bulk, droplet, force);
+	}
+	return MPI_Wtime() - start;
+}
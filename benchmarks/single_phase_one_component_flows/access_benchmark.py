@@ -0,0 +1,46 @@
+import subprocess
+
+import sys
+py_path = '../../scripts/'
+sys.path.insert(0, py_path)
+
+import utils as ut
+from colors import *
+
+py_version = 'python3'
+
+# Directory with executables
+path_exe = '../../executables/'
+
+#
+# Performance of the release build (unchecked, __restrict
+#	qualified array access in the kernels) compared with 
+#	the debug configuration with bounds checks (LBM_CHECKED); 
+#	flow past a cylinder, results are written to report_file
+#
+
+# Settings
+dPdL = '5e-5'
+fname = 'access_benchmark'
+num_steps = 3000
+# Output
+report_file = 'access_report.txt'
+
+# Compile
+subprocess.call([py_version + ' compilation.py'], shell=True)
+
+ut.msg('Array access in the kernels - flow past a cylinder', CYAN)
+report = ['{:>12}{:>12}'.format('build', 'MLUPS')]
+mlups = {}
+for exe in ['fpc', 'fpc_checked']:
+	out = subprocess.check_output([path_exe + exe + ' ' + dPdL + ' ' + fname + ' ' + str(num_steps)], 
+						shell=True, universal_newlines=True)
+	for line in out.splitlines():
+		if line.startswith('Performance:'):
+			mlups[exe] = float(line.split()[1])
+	report.append('{:>12}{:>12.2f}'.format(exe, mlups[exe]))
+report.append('Speedup of the release build: {:.2f}'.format(mlups['fpc']/mlups['fpc_checked']))
+
+print('\n'.join(report))
+with open(report_file, 'w') as fout:
+	fout.write('\n'.join(report) + '\n')
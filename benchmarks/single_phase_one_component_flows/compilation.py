@@ -11,12 +11,13 @@ path_exe = '../../executables/'
 cx = 'g++'
 std = '-std=c++11'
 opt = '-O3'
-other = '-Wall'
+other = '-Wall -fopenmp'
 
 # Common source files
 src_files = path + 'geometry.cpp' + ' ' + path + 'misc_checks.cpp '
 src_files += path + 'geom_object/rectangle.cpp' + ' ' + path + 'geom_object/ellipse.cpp'
 src_files += ' ' + path + 'fluid.cpp'
+src_files += ' ' + path + 'simd_kernels.cpp'
 src_files += ' ' + path + 'lbm.cpp'
 src_files += ' ' + path + 'io_operations/FileHandler.cpp'
 src_files += ' ' + path + 'arrays/regular_array.cpp'
@@ -58,6 +59,16 @@ compile_com = ' '.join([cx, std, opt, other, '-o', exe_name, spec_files, src_fil
 subprocess.call([compile_com], shell=True)
 subprocess.call(['mv ' + exe_name + ' ' + path_exe], shell=True)
 
+## Flow past a cylinder, debug configuration with bounds-checked
+## array access - for comparing performance with fpc
+# Name of the executable
+exe_name = 'fpc_checked'
+# Files needed only for this build
+spec_files = 'flow_past_cylinder.cpp '
+compile_com = ' '.join([cx, std, opt, other, '-DLBM_CHECKED', '-o', exe_name, spec_files, src_files])
+subprocess.call([compile_com], shell=True)
+subprocess.call(['mv ' + exe_name + ' ' + path_exe], shell=True)
+
 ## Flow past an array of ellipses in x direction
 # Name of the executable
 exe_name = 'xarre'
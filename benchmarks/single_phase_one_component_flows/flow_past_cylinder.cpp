@@ -1,5 +1,5 @@
 #include <chrono>
-#include "../include/lbm.h"
+#include "../../include/lbm.h"
 
 /***************************************************** 
  *
@@ -15,7 +15,7 @@ int main(int argc, char *argv[])
 	//
 
 	if (argc < 3) {
-		std::cout << "Usage: fpc <pressure drop> <output files name template>";
+		std::cout << "Usage: fpc <pressure drop> <output files name template> [number of steps]";
 		throw std::invalid_argument("Not enough input arguments - see examples");
 	}
 
@@ -27,6 +27,9 @@ int main(int argc, char *argv[])
 	// All simulation results 
 	const std::string fname_out(argv[2]);
 
+	// Number of steps to simulate, optional
+	const int max_iter = (argc > 3) ? std::atoi(argv[3]) : 30000;
+
 	//
 	// Simulation settings
 	//
@@ -37,8 +40,6 @@ int main(int argc, char *argv[])
 	std::vector<double> vol_force{0, 1, 0, -1, 0, 1, -1, -1, 1};
 	std::for_each(vol_force.begin(), vol_force.end(), [&dPdL](double& el) { el *= dPdL; });
 
-	// Number of steps to simulate
-	int max_iter = 30000;
 	// When to print an update status
 	int disp_every = 10000;
 
@@ -80,9 +81,7 @@ int main(int argc, char *argv[])
 	std::chrono::steady_clock::time_point sim_t0 = std::chrono::steady_clock::now();
 	
 	for (int iter = 0; iter<max_iter; ++iter) {
-		lbm.collide(geom, working_fluid);	
-		lbm.add_volume_force(geom, working_fluid, vol_force);		
-		lbm.stream(geom, working_fluid);
+		lbm.step(geom, working_fluid, vol_force);
 
 		if (iter+1 == disp_every) {
 			std::cout << "Simulation step  " << iter+1 << std::endl;
@@ -93,6 +92,9 @@ int main(int argc, char *argv[])
 	std::chrono::steady_clock::time_point sim_t_end = std::chrono::steady_clock::now();
 	std::cout << "Simulation time: " << std::chrono::duration_cast<std::chrono::milliseconds> (sim_t_end - sim_t0).count() << "[ms]" << std::endl;
 	std::cout << "Simulation time: " << std::chrono::duration_cast<std::chrono::seconds> (sim_t_end - sim_t0).count() << "[s]" << std::endl;
+	// Million lattice node updates per second
+	const double sim_time = std::chrono::duration<double>(sim_t_end - sim_t0).count();
+	std::cout << "Performance: " << static_cast<double>(Nx*Ny)*max_iter/sim_time/1e6 << " [MLUPS]" << std::endl;
 
 	// 
 	// Post-processing
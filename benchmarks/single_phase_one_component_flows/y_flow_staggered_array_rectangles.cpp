@@ -1,5 +1,5 @@
 #include <chrono>
-#include "../include/lbm.h"
+#include "../../include/lbm.h"
 
 /***************************************************** 
  *
@@ -82,9 +82,7 @@ int main()
 	std::chrono::steady_clock::time_point sim_t0 = std::chrono::steady_clock::now();
 	
 	for (int iter = 0; iter<max_iter; ++iter) {
-		lbm.collide(geom, working_fluid);	
-		lbm.add_volume_force(geom, working_fluid, vol_force);		
-		lbm.stream(geom, working_fluid);
+		lbm.step(geom, working_fluid, vol_force);
 	}
 	
 	// Print time needed
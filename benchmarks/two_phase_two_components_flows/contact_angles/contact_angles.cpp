@@ -117,14 +117,8 @@ void droplet_on_a_solid(const double Gs_droplet)
 
 	for (int step_i = 0; step_i < max_steps; ++step_i) {
 		
-		bulk_fluid.compute_density();
-		droplet_fluid.compute_density();
-
 		// Note - adding a (zero) volume force is omitted
-		lbm.compute_fluid_repulsive_interactions(geom, bulk_fluid, droplet_fluid);
-		lbm.compute_equilibrium_velocities(geom, bulk_fluid, droplet_fluid);
-		lbm.collide(bulk_fluid, droplet_fluid);
-		lbm.stream(geom, bulk_fluid, droplet_fluid);
+		lbm.step(geom, bulk_fluid, droplet_fluid);
 
 	}
 
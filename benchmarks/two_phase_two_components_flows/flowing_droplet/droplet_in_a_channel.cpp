@@ -144,14 +144,7 @@ void flowing_droplet(const double dPdL_in, const double G_solids_bulk,
 
 	for (int step_i = 0; step_i < max_steps; ++step_i) {
 		
-		bulk_fluid.compute_density();
-		droplet_fluid.compute_density();
-
-		lbm.compute_fluid_repulsive_interactions(geom, bulk_fluid, droplet_fluid);
-		lbm.compute_equilibrium_velocities(geom, bulk_fluid, droplet_fluid);
-		lbm.collide(bulk_fluid, droplet_fluid);
-		lbm.add_volume_force(geom, bulk_fluid, droplet_fluid, vol_force);
-		lbm.stream(geom, bulk_fluid, droplet_fluid);
+		lbm.step(geom, bulk_fluid, droplet_fluid, vol_force);
 
 	}
 
@@ -11,12 +11,13 @@ path_exe = '../../../executables/'
 cx = 'g++'
 std = '-std=c++11'
 opt = '-O3'
-other = '-Wall'
+other = '-Wall -fopenmp'
 
 # Common source files
 src_files = path + 'geometry.cpp' + ' ' + path + 'misc_checks.cpp '
 src_files += path + 'geom_object/rectangle.cpp' + ' ' + path + 'geom_object/ellipse.cpp'
 src_files += ' ' + path + 'fluid.cpp'
+src_files += ' ' + path + 'simd_kernels.cpp'
 src_files += ' ' + path + 'lbm.cpp'
 src_files += ' ' + path + 'io_operations/FileHandler.cpp'
 src_files += ' ' + path + 'arrays/regular_array.cpp'
@@ -52,6 +52,8 @@ void droplet_equilibration(const int droplet_side, const std::string& fname,
 
 	const std::string path("output/");
 	const int save_every = 1000;
+	// Snapshots are written on a background thread
+	SnapshotWriter writer;
 
 	//
 	// Simulation settings
@@ -122,20 +124,14 @@ void droplet_equilibration(const int droplet_side, const std::string& fname,
 
 	for (int step_i = 0; step_i < max_steps; ++step_i) {
 		
-		bulk_fluid.compute_density();
-		droplet_fluid.compute_density();
-
 		// Note - adding a (zero) volume force is omitted
-		lbm.compute_fluid_repulsive_interactions(geom, bulk_fluid, droplet_fluid);
-		lbm.compute_equilibrium_velocities(geom, bulk_fluid, droplet_fluid);
-		lbm.collide(bulk_fluid, droplet_fluid);
-		lbm.stream(geom, bulk_fluid, droplet_fluid);
+		lbm.step(geom, bulk_fluid, droplet_fluid);
 
 		// Update and save
 		if ((save_intermediate) && !(step_i % save_every)) {
 			std::cout << "Reached simulation step " << step_i << " --- saving " << std::endl;
-			bulk_fluid.write_density(path + fname + "_bulk_fluid_" + std::to_string(step_i) + ".txt");	
-			droplet_fluid.write_density(path + fname + "_droplet_fluid_" + std::to_string(step_i) + ".txt");
+			bulk_fluid.write_density(writer, path + fname + "_bulk_fluid_" + std::to_string(step_i) + ".txt");
+			droplet_fluid.write_density(writer, path + fname + "_droplet_fluid_" + std::to_string(step_i) + ".txt");
 		 }
 	}
 
@@ -144,6 +140,7 @@ void droplet_equilibration(const int droplet_side, const std::string& fname,
     std::cout << "Simulation time (main loop only) = " << std::chrono::duration_cast<std::chrono::seconds> (t_end - t_begin).count() << "[s]" << std::endl;
 
 	// Save end results
-	bulk_fluid.write_density(path + fname + "_bulk_fluid_final.txt");	
-	droplet_fluid.write_density(path + fname + "_droplet_fluid_final.txt");
+	bulk_fluid.write_density(writer, path + fname + "_bulk_fluid_final.txt");
+	droplet_fluid.write_density(writer, path + fname + "_droplet_fluid_final.txt");
+	writer.flush();
 }
@@ -98,14 +98,8 @@ void phase_separation(const double mass_frac_fluid_1, const std::string fname, R
 
 	for (int step_i = 0; step_i < max_steps; ++step_i) {
 		
-		fluid_1.compute_density();
-		fluid_2.compute_density();
-
 		// Note - adding a (zero) volume force is omitted
-		lbm.compute_fluid_repulsive_interactions(geom, fluid_1, fluid_2);
-		lbm.compute_equilibrium_velocities(geom, fluid_1, fluid_2);
-		lbm.collide(fluid_1, fluid_2);
-		lbm.stream(geom, fluid_1, fluid_2);
+		lbm.step(geom, fluid_1, fluid_2);
 
 		// Update and save
 		if (dcol_steps.find(step_i) != dcol_steps.end()) {
@@ -0,0 +1,89 @@
+#ifndef ARRAY_ACCESS_H
+#define ARRAY_ACCESS_H
+
+#include <cstddef>
+#include <stdexcept>
+
+/*****************************************************
+ * Element access in the node kernels
+ *
+ * By default kernels access the lattice arrays through
+ *	raw pointers without bounds checks, __restrict
+ *	qualified where no other pointer in the kernel
+ *	reaches the same array.
+ *
+ * Compiling with -DLBM_CHECKED (debug configuration,
+ *	used by the test suites) replaces the pointers with
+ *	views that check every index and throw
+ *	std::out_of_range, same as std::vector::at().
+ *
+ ******************************************************/
+
+#ifdef LBM_CHECKED
+
+/// Bounds-checked view of a contiguous array
+template <typename T>
+class CheckedPtr {
+public:
+	CheckedPtr(T* data, const std::size_t size) : ptr(data), len(size) { }
+	/// Conversion to a view of constant elements
+	operator CheckedPtr<const T>() const { return CheckedPtr<const T>(ptr, len); }
+	T& operator[](const std::size_t i) const
+	{
+		if (i >= len) {
+			throw std::out_of_range("Lattice array index out of range");
+		}
+		return ptr[i];
+	}
+private:
+	T* ptr = nullptr;
+	std::size_t len = 0;
+};
+
+/// Array pointer that may alias another one in the same kernel
+template <typename T>
+using ArrayPtr = CheckedPtr<T>;
+
+/// Array pointer that is the only access to its array in a kernel
+template <typename T>
+using RestrictPtr = CheckedPtr<T>;
+
+/// Kernel view of an array (std::vector or LatticeVector)
+template <typename Vec>
+CheckedPtr<typename Vec::value_type> array_ptr(Vec& vec)
+	{ return CheckedPtr<typename Vec::value_type>(vec.data(), vec.size()); }
+
+template <typename Vec>
+CheckedPtr<const typename Vec::value_type> array_ptr(const Vec& vec)
+	{ return CheckedPtr<const typename Vec::value_type>(vec.data(), vec.size()); }
+
+/// Element i of an array, bounds-checked
+template <typename Vec>
+auto element(Vec& vec, const std::size_t i) -> decltype(vec[i])
+	{ return vec.at(i); }
+
+#else
+
+/// Array pointer that may alias another one in the same kernel
+template <typename T>
+using ArrayPtr = T*;
+
+/// Array pointer that is the only access to its array in a kernel
+template <typename T>
+using RestrictPtr = T* __restrict;
+
+/// Kernel view of an array (std::vector or LatticeVector)
+template <typename Vec>
+typename Vec::value_type* array_ptr(Vec& vec) { return vec.data(); }
+
+template <typename Vec>
+const typename Vec::value_type* array_ptr(const Vec& vec) { return vec.data(); }
+
+/// Element i of an array, unchecked
+template <typename Vec>
+auto element(Vec& vec, const std::size_t i) -> decltype(vec[i])
+	{ return vec[i]; }
+
+#endif
+
+#endif
@@ -7,12 +7,18 @@
 #include <random>
 
 #include "geometry.h"
+#include "lattice.h"
 #include "lbm.h"
 #include "logger.h"
 #include "common.h"
 #include "utils.h"
 #include "rng.h"
+#include "parallel.h"
+#include "simd_kernels.h"
+#include "moment_kernels.h"
+#include "scratch_pool.h"
 #include "./io_operations/lbm_io.h"
+#include "./io_operations/snapshot_writer.h"
 
 /***************************************************** 
  * class: Fluid 
@@ -23,7 +29,8 @@
  *
  * The arrays are flat STL vectors of dimensions
  * Nx*Ny (for macroscopic) and Nx*Ny*9 for the 
- * distribution.
+ * distribution. They are first touched in parallel 
+ * by row slabs (check parallel.h).
  * 
  * First direction (0) is the center, last (8th) is 
  * North-West.
@@ -47,6 +54,14 @@
  * First index is the position within a row, second indicates
  * which row the user asks for.
  *
+ * Density and velocities are computed lazily - they are
+ * recomputed only if the distribution changed since the
+ * last computation. The non-const getters of the distribution
+ * mark them out of date, so writes through them are always
+ * noticed; a reference kept across a computation of the moments
+ * needs invalidate_moments() after the writes, as the LBM
+ * classes do. Read through the const getters to keep them.
+ *
  ******************************************************/
 
 class Fluid {
@@ -69,6 +84,14 @@ public:
 	Fluid() : Fluid("fluid", 1./3, 1.0)
 		{ }
 
+	Fluid(const Fluid&) = default;
+	Fluid(Fluid&&) = default;
+	Fluid& operator=(const Fluid&) = default;
+	Fluid& operator=(Fluid&&) = default;
+
+	/// Gives the lattice arrays back to the shared pool (check scratch_pool.h)
+	~Fluid();
+
 	// 
 	// Initialization
 	//
@@ -114,7 +137,7 @@ public:
 	}
 
 	/// Compute and store the force components stemming from interactions with solids
-	void add_surface_forces(const std::vector<double>, const std::vector<double>);
+	void add_surface_forces(const LatticeVector<double>& Fxs, const LatticeVector<double>& Fys);
 
 	/// Initialize vectors and parameters for repulsive interactions
 	void initialize_fluid_repulsion(const double Gf);
@@ -124,50 +147,98 @@ public:
 	// 
 	
 	/// Compute macroscopic density
+	/// @details Does nothing if the density is up to date with the distribution;
+	///		the momentum is computed in the same pass once compute_momentum() allocated it
 	void compute_density();
 
 	/// Compute macroscopic velocities
+	/// @details Does nothing if the velocities are up to date with the distribution,
+	///		divides the momentum by the density if these are, and computes all of them 
+	///		in one pass otherwise
 	void compute_velocities(const Geometry& geom);
 
 	/// Compute density and x and y velocity components
 	void compute_macroscopic(const Geometry& geom);
 
+	/// Compute the momentum (density times velocity)
+	/// @details Does nothing if it is up to date with the distribution; 
+	///		its arrays are allocated by the first call and kept
+	void compute_momentum();
+
+	/// Compute the momentum of two fluids, in one pass over both distributions 
+	///	if neither is up to date
+	static void compute_momentum(Fluid& fluid_1, Fluid& fluid_2);
+
+	/// Mark the density, velocities, and momentum out of date
+	/// @details Needed only after writing through a reference to the distribution
+	///		taken before the moments were last computed
+	void invalidate_moments() { rho_current = false; velocities_current = false; momentum_current = false; }
+
+	/// True if the density is up to date with the distribution
+	bool is_density_current() const { return rho_current; }
+	/// True if the velocities are up to date with the distribution
+	bool are_velocities_current() const { return velocities_current; }
+	/// True if the momentum is up to date with the distribution
+	bool is_momentum_current() const { return momentum_current; }
+
 	//
 	// Other properties
 	//
 
 	/// Compute the equilibrium distribution function
+	/// @details Vectorized, check simd_kernels.h
 	void compute_f_equilibrium(const Geometry& geom);
 
 	/// Compute the equilibrium distribution function in a multicomponent - multiphase system
 	void compute_f_equilibrium();
 
+	/** 
+	 * Equilibrium distribution at a single node
+	 * @details Shared by the full-lattice functions above and the fused LBM kernels
+	 *
+	 * @param rho_i - density at the node
+	 * @param ux_i - x velocity component used in the equilibrium
+	 * @param uy_i - y velocity component used in the equilibrium
+	 * @param feq - output, Ndir values of the equilibrium distribution
+	 */
+	void node_f_equilibrium(const double rho_i, const double ux_i, 
+								const double uy_i, double* feq) const;
+
 	//
 	// Getters 
 	//
 
 	/// Reference to density distribution, flat array of size Nx*Ny*9 
-	std::vector<double>& get_f_dist() { return f_dist; } 
+	/// @details Marks the density, velocities, and momentum out of date
+	LatticeVector<double>& get_f_dist() { invalidate_moments(); return f_dist; } 
+	/// Reference to single precision density distribution (LBM mixed_precision mode), 
+	///	flat array of size Nx*Ny*9 - deviation from the weight times the reference density, 
+	///	marks the moments out of date
+	LatticeVector<float>& get_f_dist_float() { invalidate_moments(); return f_dist_float; } 
 	/// Reference to equilibrium density distribution, flat array of size Nx*Ny*9 
-    std::vector<double>& get_f_eq_dist() { return f_eq_dist; }
+    LatticeVector<double>& get_f_eq_dist() { return f_eq_dist; }
 	/// Reference to x component of the fluid-solid interaction force 
-	std::vector<double>& get_fluid_solid_force_x() { return F_solid_x; }
+	LatticeVector<double>& get_fluid_solid_force_x() { return F_solid_x; }
 	/// Reference to y component of the fluid-solid interaction force 
-	std::vector<double>& get_fluid_solid_force_y() { return F_solid_y; }
+	LatticeVector<double>& get_fluid_solid_force_y() { return F_solid_y; }
 	/// Reference to x component of the repulsive fluid-fluid force 
-	std::vector<double>& get_repulsive_force_x() { return F_repulsive_x; }
+	LatticeVector<double>& get_repulsive_force_x() { return F_repulsive_x; }
 	/// Reference to y component of the repulsive fluid-fluid force 
-	std::vector<double>& get_repulsive_force_y() { return F_repulsive_y; }
+	LatticeVector<double>& get_repulsive_force_y() { return F_repulsive_y; }
 	/// Reference to macroscopic density Nx*Ny
-	std::vector<double>& get_rho() { return rho; }
+	LatticeVector<double>& get_rho() { return rho; }
 	/// Reference to macroscopic x velocity component
-	std::vector<double>& get_ux() { return ux; }
+	LatticeVector<double>& get_ux() { return ux; }
 	/// Reference to macroscopic y velocity component
-	std::vector<double>& get_uy() { return uy; }
+	LatticeVector<double>& get_uy() { return uy; }
+	/// Reference to x momentum
+	LatticeVector<double>& get_momentum_x() { return jx; }
+	/// Reference to y momentum
+	LatticeVector<double>& get_momentum_y() { return jy; }
 	/// Reference to equlibrium x velocity component
-	std::vector<double>& get_u_eq_x() { return u_eq_x; }
+	LatticeVector<double>& get_u_eq_x() { return u_eq_x; }
 	/// Reference to equilibrium y velocity component
-	std::vector<double>& get_u_eq_y() { return u_eq_y; }
+	LatticeVector<double>& get_u_eq_y() { return u_eq_y; }
 
 	/// x dimension
 	size_t get_Nx() const { return Nx; }
@@ -177,33 +248,60 @@ public:
 	double get_omega() const { return omega; }
 	/// Repulsive fluid-fluid interaction potential
 	double get_repulsive_g_fluid() const { return Gfluid_repulsion; }
+	/// Reference density of the single precision distribution
+	double get_reference_density() const { return rho_ref; }
+	/// True if only the arrays of the fused steps are stored
+	bool is_lean() const { return lean; }
 	
 	/// Const reference to density distribution, flat array of size Nx*Ny*9 
-    const std::vector<double>& get_f_dist() const { return f_dist; } 
+    const LatticeVector<double>& get_f_dist() const { return f_dist; } 
+	/// Const reference to single precision density distribution, flat array of size Nx*Ny*9 
+	const LatticeVector<float>& get_f_dist_float() const { return f_dist_float; } 
 	/// Const reference to equilibrium density distribution, flat array of size Nx*Ny*9 
-    const std::vector<double>& get_f_eq_dist() const { return f_eq_dist; }
+    const LatticeVector<double>& get_f_eq_dist() const { return f_eq_dist; }
 	/// Const reference to x component of the fluid-solid interaction force 
-	const std::vector<double>& get_fluid_solid_force_x() const { return F_solid_x; }
+	const LatticeVector<double>& get_fluid_solid_force_x() const { return F_solid_x; }
 	/// Const reference to y component of the fluid-solid interaction force 
-	const std::vector<double>& get_fluid_solid_force_y() const { return F_solid_y; }
+	const LatticeVector<double>& get_fluid_solid_force_y() const { return F_solid_y; }
 	/// Const reference to macroscopic density Nx*Ny
-	const std::vector<double>& get_rho() const { return rho; }
+	const LatticeVector<double>& get_rho() const { return rho; }
 	/// Const reference to macroscopic x velocity component
-	const std::vector<double>& get_ux() const { return ux; }
+	const LatticeVector<double>& get_ux() const { return ux; }
 	/// Const reference to macroscopic y velocity component
-	const std::vector<double>& get_uy() const { return uy; }
+	const LatticeVector<double>& get_uy() const { return uy; }
+	/// Const reference to x momentum, empty until compute_momentum()
+	const LatticeVector<double>& get_momentum_x() const { return jx; }
+	/// Const reference to y momentum, empty until compute_momentum()
+	const LatticeVector<double>& get_momentum_y() const { return jy; }
 	/// Const reference to equlibrium x velocity component
-	const std::vector<double>& get_u_eq_x() const { return u_eq_x; }
+	const LatticeVector<double>& get_u_eq_x() const { return u_eq_x; }
 	/// Const reference to equilibrium y velocity component
-	const std::vector<double>& get_u_eq_y() const { return u_eq_y; }
+	const LatticeVector<double>& get_u_eq_y() const { return u_eq_y; }
 
-	/// Density weights for computing the equilibrium distribution
-	std::vector<double> get_wrts() const { return {wrt0, wrt1, wrt2}; }  
+	/// Density weights for computing the equilibrium distribution, one per lattice direction
+	std::vector<double> get_wrts() const { return std::vector<double>(Lattice::w, Lattice::w + Lattice::Q); }
 
 	//
 	// Setters
 	//
 
+	/// Reference density of the single precision distribution
+	/// @details Set by LBM::compress, values are stored as the deviation from w_i*rho_r
+	void set_reference_density(const double rho_r) { rho_ref = rho_r; }
+
+	/** 
+	 * Lean storage - keep only the arrays used by the fused LBM steps
+	 *
+	 * @details The distribution, density, and fluid-solid forces are kept, about 
+	 *	12 doubles per node; the equilibrium distribution, equilibrium velocities, 
+	 *	and repulsive forces are not stored (the fused steps compute them at each node)
+	 * @details Velocities are allocated when computed and released after they are 
+	 *	written, separate LBM operations throw for lean fluids
+	 * @details Set before initialization the arrays are never allocated, set after 
+	 *	they are released; false allocates them again
+	 */
+	void set_lean_storage(const bool lean_storage);
+
 	/// Restore state from file (restart) 
 	/// @details Reads and restores the density distribution function from a file
 	/// @details WARNING: this assumes that user executes fitting initialization function
@@ -220,10 +318,20 @@ public:
 			{ compute_density(); write_var(rho, fname); }
 	/// Save macroscopic x velocity component to file
 	void write_ux(const std::string& fname, const Geometry& geom)
-			{ compute_velocities(geom); write_var(ux, fname); }
+			{ compute_velocities(geom); write_var(ux, fname); release_velocities(); }
 	/// Save macroscopic y velocity component to file
 	void write_uy(const std::string& fname, const Geometry& geom)
-			{ compute_velocities(geom); write_var(uy, fname); }
+			{ compute_velocities(geom); write_var(uy, fname); release_velocities(); }
+	/// Queue macroscopic density for writing on the I/O thread of writer
+	/// @details Returns after copying the density, same file as write_density(fname)
+	void write_density(SnapshotWriter& writer, const std::string& fname)
+			{ compute_density(); writer.write(rho, Nx, Ny, fname); }
+	/// Queue macroscopic x velocity component for writing on the I/O thread of writer
+	void write_ux(SnapshotWriter& writer, const std::string& fname, const Geometry& geom)
+			{ compute_velocities(geom); writer.write(ux, Nx, Ny, fname); release_velocities(); }
+	/// Queue macroscopic y velocity component for writing on the I/O thread of writer
+	void write_uy(SnapshotWriter& writer, const std::string& fname, const Geometry& geom)
+			{ compute_velocities(geom); writer.write(uy, Nx, Ny, fname); release_velocities(); }
 	/// Save repulsive force - x component to file
 	void write_F_repulsive_x(const std::string& fname)
 			{ write_var(F_repulsive_x, fname); }
@@ -262,7 +370,7 @@ private:
 	// Name of the fluid
 	std::string name;
 	// Number of directions
-	const size_t Ndir = 9;
+	static constexpr size_t Ndir = Lattice::Q;
 	// Squared lattice speed
 	double cs2 = 0.0;
 	// Relaxation time 
@@ -275,16 +383,10 @@ private:
 	double Gsolid = 0.0;
 	// Fluid-fluid potential for repulsive interactions
 	double Gfluid_repulsion = 0.0;
-	// Discrete lattice velocities
-	const std::vector<double> Cx = {0.0, 1.0, 0.0, -1.0, 0.0, 1.0, -1.0, -1.0, 1.0};
-    const std::vector<double> Cy = {0.0, 0.0, 1.0, 0.0, -1.0, 1.0, 1.0, -1.0, -1.0};	
-	// Weights for the equilibrium distribution
-	double wrt0 = 4.0/9.0, wrt1 = 1.0/9.0, wrt2 = 1.0/36.0;
-	double feq1 = 3.0, feq2 = 4.5, feq3 = 1.5;
 
 	// Fluid-solid interaction force terms (constant for stationary solids)
-	std::vector<double> F_solid_x;
-	std::vector<double> F_solid_y;
+	LatticeVector<double> F_solid_x;
+	LatticeVector<double> F_solid_y;
 
 	//
 	// Variables
@@ -293,30 +395,85 @@ private:
 	// Horizontal and vertical dimensions (number of nodes)
 	size_t Nx = 0, Ny = 0, Ntot = 0;
 	// Density distribution function, flat array of size Nx*Ny*9 
-	std::vector<double> f_dist; 
+	LatticeVector<double> f_dist; 
+	// Density distribution function in single precision, empty unless 
+	// used with the LBM mixed_precision mode
+	LatticeVector<float> f_dist_float;
+	// Reference density of the single precision distribution
+	double rho_ref = 0.0;
+	// True if the intermediate arrays are not stored
+	bool lean = false;
+	// True if the density, the velocities, or the momentum were computed 
+	// from the current distribution
+	bool rho_current = false;
+	bool velocities_current = false;
+	bool momentum_current = false;
 	// Equilibrium density distribution function, flat array of size Nx*Ny*9 
-	std::vector<double> f_eq_dist;
+	LatticeVector<double> f_eq_dist;
 	// Forces stemming from repulsive interactions between fluids
-	std::vector<double> F_repulsive_x;
-	std::vector<double> F_repulsive_y;
+	LatticeVector<double> F_repulsive_x;
+	LatticeVector<double> F_repulsive_y;
 	// Macroscopic density Nx*Ny
-	std::vector<double> rho;
+	LatticeVector<double> rho;
 	// Macroscopic velocity components
-	std::vector<double> ux;
-	std::vector<double> uy;
+	LatticeVector<double> ux;
+	LatticeVector<double> uy;
+	// Momentum components, empty until the first compute_momentum()
+	LatticeVector<double> jx;
+	LatticeVector<double> jy;
 	// Equilibrium velocity components
-	std::vector<double> u_eq_x;
-	std::vector<double> u_eq_y;
+	LatticeVector<double> u_eq_x;
+	LatticeVector<double> u_eq_y;
 
 	//
 	// Private methods
 	//
 
+	/// Allocate the arrays that lean fluids don't store, no-op for lean fluids
+	/// @param mcmp - also the arrays used only in multicomponent - multiphase systems
+	void allocate_intermediate(const bool mcmp);
+
+	/// Release the velocities of a lean fluid after output
+	void release_velocities();
+
+	/// Allocate the velocity arrays if they are not (lean fluids)
+	void allocate_velocities();
+
+	/// Allocate the momentum arrays if they are not
+	void allocate_momentum();
+
+	/// True if the momentum arrays are allocated
+	bool has_momentum_arrays() const { return (jx.size() == Ntot) && (jy.size() == Ntot); }
+
+	/// Distribution and requested outputs for the moment kernels
+	/// @details Throws if the distribution is not stored
+	MomentArrays moment_arrays(const bool with_density, const bool with_momentum);
+
+	/// Throws if the arrays used by the equilibrium kernels are not allocated 
+	void check_equilibrium_arrays(const LatticeVector<double>& u_x, const LatticeVector<double>& u_y) const;
+
 	/// Write a 2D variable to file fname
-	void write_var(const std::vector<double>& variable, const std::string& fname) const;
+	void write_var(const LatticeVector<double>& variable, const std::string& fname) const;
 
 	/// Write a 3D variable to file fname
-	void write_var(const std::vector<double>& variable, const std::string& fname, const bool is_3D) const;
+	void write_var(const LatticeVector<double>& variable, const std::string& fname, const bool is_3D) const;
 };
 
+//
+// Implementation - inline
+//
+
+// Equilibrium distribution at a single node
+inline void Fluid::node_f_equilibrium(const double rho_i, const double ux_i, 
+										const double uy_i, double* feq) const
+{
+	// Lattice constants fold into the expressions once the loop is unrolled
+	const double feq1 = Lattice::feq1, feq2 = Lattice::feq2, feq3 = Lattice::feq3;
+	const double usq = ux_i*ux_i + uy_i*uy_i;
+	for (size_t dj = 0; dj < Lattice::Q; ++dj) {
+		const double cu = Lattice::cx[dj]*ux_i + Lattice::cy[dj]*uy_i;
+		feq[dj] = Lattice::w[dj]*rho_i*(1.0 + feq1*cu + feq2*cu*cu - feq3*usq);
+	}
+}
+
 #endif
@@ -2,9 +2,11 @@
 #define GEOMETRY_H
 
 #include <limits>
+#include <cstdint>
 #include "common.h"
 #include "utils.h"
 #include "geom_include.h"
+#include "array_access.h"
 #include "./io_operations/lbm_io.h"
 
 /*************************************************************** 
@@ -32,11 +34,22 @@
  * First index is the position within a row, second indicates
  * which row the user asks for.
  *
+ * Kernels read a compact copy of the geometry, one byte
+ * per node with the node type (node_types()), or one bit
+ * per node (fluid_bitmask()).
+ *
  ***************************************************************/
 
 class Geometry{
 public:
 
+	/// Node types of the compact geometry, bit flags
+	/// @details Solid nodes are 0, fluid nodes have the fluid flag and
+	///		wall_adjacent if at least one neighbor is solid (periodic 
+	///		boundaries included), periodic_edge if in the first or last 
+	///		row or column; fluid nodes with no other flag are bulk nodes
+	enum NodeType : std::uint8_t { solid = 0, fluid = 1, wall_adjacent = 2, periodic_edge = 4 };
+
 	//
 	// Constructors 	
 	// 
@@ -234,21 +247,36 @@ public:
 	/** 
 	* \brief Returns geometry value at a node (xi,yi)
 	* \details Indexing from 0 to _Nx or _Ny -1 
+    * \details Bounds-checked only with LBM_CHECKED (check array_access.h)
     * 
 	* @param xi [in] - x coordinate 
 	* @param yi [in] - y coordinate
 	*/
 	const int operator()(const size_t xi, const size_t yi) const 
-		{ return geom.at(yi*_Nx + xi); }
+		{ return element(geom, yi*_Nx + xi); }
  
 	/** 
 	 * \brief Returns geometry value at a node specified with a flat index 
      * \details Indexing from 0 to _Nx*_Ny-1
+     * \details Bounds-checked only with LBM_CHECKED (check array_access.h)
 	 *
 	 * @param ind [in] - position in the geometry array
 	 */
 	const int operator()(const size_t ind) const 
-		{ return geom.at(ind); }
+		{ return element(geom, ind); }
+
+	/** 
+	 * \brief Compact geometry - NodeType flags of each node
+	 * \details One byte per node, same order as the geometry array;
+	 *		neighbors are found with the D2Q9 lattice, periodic in x and y
+	 */
+	std::vector<std::uint8_t> node_types() const;
+
+	/** 
+	 * \brief Packed geometry - one bit per node, set for fluid nodes 
+	 * \details Node ind is bit ind%64 of word ind/64
+	 */
+	std::vector<std::uint64_t> fluid_bitmask() const;
 	
 	//	
 	// Getters
@@ -63,6 +63,15 @@ public:
 	template<typename T>
 	void write_vector(const std::vector<std::vector<T>>& data) const;
 
+	/**
+	 * \brief Write a flat row-major array as dims[0] rows of dims[1] values
+	 * \details Same file as write_vector() of the nested rows, without copying
+	 *	the data into them. Truncates if the file exists.
+	 * @param data - array with at least dims[0] x dims[1] elements
+	 */
+	template<typename Array>
+	void write_flat(const Array& data) const;
+
 	//
 	// Destructor
 	//
@@ -115,4 +124,21 @@ void LbmIO::write_vector(const std::vector<std::vector<T>>& data) const
 	}	
 }		
 
+template<typename Array>
+void LbmIO::write_flat(const Array& data) const
+{
+	const size_t nrows = dimensions.at(0), ncols = dimensions.at(1);
+	if (data.size() < nrows*ncols) {
+		throw std::invalid_argument("Flat array is smaller than the number of rows times columns");
+	}
+	FileHandler file(fname, std::ios_base::out | std::ios_base::trunc);
+	std::fstream &out = file.get_stream();
+
+	typedef typename Array::value_type T;
+	for (size_t i = 0; i<nrows; i++) {
+		std::copy(data.begin() + i*ncols, data.begin() + (i+1)*ncols, std::ostream_iterator<T>(out, delim.c_str()));
+		out << '\n';
+	}
+}
+
 #endif
@@ -0,0 +1,208 @@
+#ifndef SNAPSHOT_WRITER_H
+#define SNAPSHOT_WRITER_H
+
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include "lbm_io.h"
+
+/***************************************************************
+ * class: SnapshotWriter
+ *
+ * Writes 2D fields to files on a background thread
+ *
+ * write() copies the field into a buffer and queues it, the
+ * I/O thread formats and writes it with LbmIO while the
+ * simulation continues. Buffers of written snapshots are
+ * reused, so after the first snapshots a write costs one
+ * copy of the field. When the queue is full, write() waits
+ * for the I/O thread. Files are the same as from
+ * Fluid::write_density() and the like.
+ *
+ * An error in the I/O thread is rethrown by the next call to
+ * write() or flush(). The destructor writes the remaining
+ * snapshots.
+***************************************************************/
+
+class SnapshotWriter
+{
+public:
+
+	//
+	// Constructors
+	//
+
+	/**
+	 * \brief Starts the I/O thread
+	 * @param max_queued - number of snapshots that can wait for writing
+	 */
+	explicit SnapshotWriter(const size_t max_queued = 2) : capacity(max_queued)
+	{
+		if (capacity < 1) {
+			throw std::invalid_argument("Snapshot queue needs to hold at least one snapshot");
+		}
+		io_thread = std::thread(&SnapshotWriter::write_loop, this);
+	}
+
+	SnapshotWriter(const SnapshotWriter&) = delete;
+	SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+	//
+	// Writing functionality
+	//
+
+	/**
+	 * \brief Queue a 2D field for writing to file fname
+	 * \details Waits if the queue is full; the field can be modified
+	 *	as soon as this returns
+	 * @param field - flat row-major array of Nx*Ny values
+	 * @param Nx - number of columns (nodes in x direction)
+	 * @param Ny - number of rows (nodes in y direction)
+	 * @param fname - name of the file, truncated if exists
+	 */
+	template<typename Field>
+	void write(const Field& field, const size_t Nx, const size_t Ny, const std::string& fname)
+	{
+		if (field.size() < Nx*Ny) {
+			throw std::invalid_argument("Snapshot field is smaller than Nx*Ny");
+		}
+		std::unique_lock<std::mutex> lock(queue_mutex);
+		space.wait(lock, [this]() { return (queue.size() < capacity) || error; });
+		rethrow_error();
+		Snapshot snapshot;
+		if (!free_buffers.empty()) {
+			snapshot.data.swap(free_buffers.back());
+			free_buffers.pop_back();
+		}
+		// Copy outside of the lock, the I/O thread can keep going
+		lock.unlock();
+		snapshot.data.assign(field.begin(), field.begin() + Nx*Ny);
+		snapshot.fname = fname;
+		snapshot.Nx = Nx;
+		snapshot.Ny = Ny;
+		lock.lock();
+		queue.push_back(std::move(snapshot));
+		lock.unlock();
+		pending.notify_one();
+	}
+
+	/**
+	 * \brief Wait until all queued snapshots are written
+	 */
+	void flush()
+	{
+		std::unique_lock<std::mutex> lock(queue_mutex);
+		space.wait(lock, [this]() { return (queue.empty() && !writing) || error; });
+		rethrow_error();
+	}
+
+	/// Number of snapshots waiting for writing
+	size_t queued() const
+	{
+		std::lock_guard<std::mutex> lock(queue_mutex);
+		return queue.size();
+	}
+
+	//
+	// Destructor
+	//
+
+	/// Writes the remaining snapshots and stops the I/O thread
+	/// \details Errors are only reported to std::cerr
+	~SnapshotWriter()
+	{
+		{
+			std::lock_guard<std::mutex> lock(queue_mutex);
+			stopping = true;
+		}
+		pending.notify_one();
+		io_thread.join();
+		if (error) {
+			try {
+				std::rethrow_exception(error);
+			} catch (const std::exception& e) {
+				std::cerr << "Error writing snapshots: " << e.what() << std::endl;
+			} catch (...) {
+				std::cerr << "Error writing snapshots" << std::endl;
+			}
+		}
+	}
+
+private:
+	struct Snapshot {
+		std::string fname;
+		size_t Nx = 0, Ny = 0;
+		std::vector<double> data;
+	};
+
+	size_t capacity = 2;
+	std::deque<Snapshot> queue;
+	// Buffers of written snapshots, reused by write()
+	std::vector<std::vector<double>> free_buffers;
+	// True while the I/O thread writes a snapshot
+	bool writing = false;
+	bool stopping = false;
+	// First error of the I/O thread
+	std::exception_ptr error = nullptr;
+	mutable std::mutex queue_mutex;
+	// Signals new snapshots, and space in the queue or finished writes
+	std::condition_variable pending, space;
+	std::thread io_thread;
+
+	/// Throw the error of the I/O thread, queue_mutex needs to be locked
+	void rethrow_error()
+	{
+		if (error) {
+			std::exception_ptr thrown = nullptr;
+			std::swap(thrown, error);
+			queue.clear();
+			std::rethrow_exception(thrown);
+		}
+	}
+
+	/// Write queued snapshots until stopped and the queue is empty
+	/// \details After an error the remaining snapshots are dropped
+	void write_loop()
+	{
+		std::unique_lock<std::mutex> lock(queue_mutex);
+		while (true) {
+			pending.wait(lock, [this]() { return !queue.empty() || stopping; });
+			if (queue.empty()) {
+				return;
+			}
+			Snapshot snapshot = std::move(queue.front());
+			queue.pop_front();
+			writing = true;
+			lock.unlock();
+			space.notify_one();
+			std::exception_ptr failed = nullptr;
+			try {
+				write_snapshot(snapshot);
+			} catch (...) {
+				failed = std::current_exception();
+			}
+			lock.lock();
+			writing = false;
+			if (failed && !error) {
+				error = failed;
+			}
+			if (error) {
+				queue.clear();
+			}
+			free_buffers.push_back(std::move(snapshot.data));
+			space.notify_all();
+		}
+	}
+
+	/// Format a snapshot as Ny rows of Nx values and write it
+	static void write_snapshot(const Snapshot& snapshot)
+	{
+		std::vector<size_t> dims = {snapshot.Ny, snapshot.Nx, 0};
+		LbmIO lbm_io(snapshot.fname, " ", true, dims);
+		lbm_io.write_flat(snapshot.data);
+	}
+};
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef LATTICE_H
+#define LATTICE_H
+
+#include <cstddef>
+
+/*****************************************************
+ * Lattice descriptors
+ *
+ * Compile-time constants of the discrete velocity
+ *	sets - directions, opposite directions, weights,
+ *	and equilibrium coefficients. Kernels take them
+ *	from a descriptor so that the direction loops have
+ *	constant bounds and the constants fold into the
+ *	generated code, with no per-object tables.
+ *
+ * Descriptors are class templates (on the floating
+ *	point type of the weights) only so that their
+ *	constant arrays can be defined in this header.
+ *
+ * Fluid, LBM, and the other interface classes use the
+ *	velocity set named Lattice. Their node kernels loop
+ *	over its directions, so any descriptor with the
+ *	second order equilibrium coefficients can be used;
+ *	only the vectorized full-lattice equilibrium
+ *	(simd_kernels.h) is written out for D2Q9.
+ *
+ ******************************************************/
+
+/// D2Q9 - two dimensional flows
+/// @details Order of directions: rest, +x, +y, -x, -y, then diagonals
+///		(+x,+y), (-x,+y), (-x,-y), (+x,-y)
+template <typename Real = double>
+struct D2Q9 {
+	/// Number of dimensions
+	static constexpr std::size_t dim = 2;
+	/// Number of discrete velocities
+	static constexpr std::size_t Q = 9;
+	/// Discrete velocities - x components
+	static constexpr int cx[Q] = {0, 1, 0, -1, 0, 1, -1, -1, 1};
+	/// Discrete velocities - y components
+	static constexpr int cy[Q] = {0, 0, 1, 0, -1, 1, 1, -1, -1};
+	/// Opposite of each direction, bounce-back
+	static constexpr std::size_t opposite[Q] = {0, 3, 4, 1, 2, 7, 8, 5, 6};
+	/// Lattice weights, also the weights of the Shan-Chen interaction forces
+	static constexpr Real w[Q] = {4.0/9.0, 1.0/9.0, 1.0/9.0, 1.0/9.0, 1.0/9.0,
+									1.0/36.0, 1.0/36.0, 1.0/36.0, 1.0/36.0};
+	/// Equilibrium coefficients 1/cs^2, 1/(2 cs^4), 1/(2 cs^2), cs^2 = 1/3
+	static constexpr Real feq1 = 3.0, feq2 = 4.5, feq3 = 1.5;
+};
+
+template <typename Real> constexpr std::size_t D2Q9<Real>::dim;
+template <typename Real> constexpr std::size_t D2Q9<Real>::Q;
+template <typename Real> constexpr int D2Q9<Real>::cx[];
+template <typename Real> constexpr int D2Q9<Real>::cy[];
+template <typename Real> constexpr std::size_t D2Q9<Real>::opposite[];
+template <typename Real> constexpr Real D2Q9<Real>::w[];
+template <typename Real> constexpr Real D2Q9<Real>::feq1;
+template <typename Real> constexpr Real D2Q9<Real>::feq2;
+template <typename Real> constexpr Real D2Q9<Real>::feq3;
+
+/// D2Q5 - scalar transport (advection-diffusion) in two dimensions
+/// @details Order of directions: rest, +x, +y, -x, -y
+template <typename Real = double>
+struct D2Q5 {
+	/// Number of dimensions
+	static constexpr std::size_t dim = 2;
+	/// Number of discrete velocities
+	static constexpr std::size_t Q = 5;
+	/// Discrete velocities - x components
+	static constexpr int cx[Q] = {0, 1, 0, -1, 0};
+	/// Discrete velocities - y components
+	static constexpr int cy[Q] = {0, 0, 1, 0, -1};
+	/// Opposite of each direction, bounce-back
+	static constexpr std::size_t opposite[Q] = {0, 3, 4, 1, 2};
+	/// Lattice weights
+	static constexpr Real w[Q] = {1.0/3.0, 1.0/6.0, 1.0/6.0, 1.0/6.0, 1.0/6.0};
+	/// Equilibrium coefficient 1/cs^2, cs^2 = 1/3 (linear equilibrium)
+	static constexpr Real feq1 = 3.0;
+};
+
+template <typename Real> constexpr std::size_t D2Q5<Real>::dim;
+template <typename Real> constexpr std::size_t D2Q5<Real>::Q;
+template <typename Real> constexpr int D2Q5<Real>::cx[];
+template <typename Real> constexpr int D2Q5<Real>::cy[];
+template <typename Real> constexpr std::size_t D2Q5<Real>::opposite[];
+template <typename Real> constexpr Real D2Q5<Real>::w[];
+template <typename Real> constexpr Real D2Q5<Real>::feq1;
+
+/// Velocity set of the fluid flow classes
+using Lattice = D2Q9<double>;
+
+#endif
@@ -4,11 +4,23 @@
 #include <iostream>
 #include <algorithm>
 #include <vector>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <chrono>
 #include "geometry.h"
+#include "lattice.h"
+#include "array_access.h"
 #include "fluid.h"
 #include "logger.h"
 #include "common.h"
 #include "utils.h"
+#include "parallel.h"
+#include "thread_pool.h"
+#include "tile_scheduler.h"
+#include "scratch_pool.h"
 #include "./io_operations/lbm_io.h"
 
 /***************************************************** 
@@ -16,6 +28,18 @@
  * 
  * Interface class that provides all the LBM operations
  *
+ * Node loops run in parallel with OpenMP over static
+ * row slabs, same as in the Fluid class (check parallel.h);
+ * the fused steps run on a persistent thread pool owned
+ * by the object, each worker always on the same slab
+ *
+ * Fluid nodes away from the lattice edges with only fluid
+ * neighbors (bulk nodes) are updated in runs with fixed
+ * neighbor offsets, the remaining boundary nodes through
+ * the neighbor and streaming tables; in the padded layout
+ * edge nodes are also updated with fixed offsets, through
+ * a frame of ghost cells around the lattice
+ *
  ******************************************************/
 
 class Fluid;
@@ -23,19 +47,120 @@ class Fluid;
 class LBM {
 public:
 
+	/// Streaming schemes
+	/// @details two_lattice - streaming into a temporary lattice swapped with the fluid's,
+	///		aa_pattern - in-place streaming alternating even and odd steps, 
+	///		no temporary lattices, only available through step()
+	enum Streaming { two_lattice, aa_pattern };
+
+	/// Storage precision of the density distributions
+	/// @details double_precision - distributions stored and computed in double,
+	///		mixed_precision - distributions stored in float (check compress), 
+	///		moments and collisions computed in double, only available through step()
+	enum Precision { double_precision, mixed_precision };
+
+	/// Storage layout of the density distributions in step()
+	/// @details dense - Nx*Ny values per direction, row after row,
+	///		padded - rows with a ghost cell on each side and a ghost row above
+	///		and below, row pitch a multiple of 64 bytes with the first column
+	///		aligned; all fluid nodes without solid neighbors are then updated 
+	///		with fixed neighbor offsets, lattice edges included, and the ghost
+	///		cells are folded onto the opposite edges once per step (check pad);
+	///		single fluid steps in the two_lattice mode and double precision only
+	enum Layout { dense, padded };
+
+	/// Distribution of the nodes among the workers in step()
+	/// @details static_slabs - each worker updates a fixed slab of rows,
+	///		work_stealing - rows are grouped into tiles with about the same
+	///		number of fluid nodes, each worker starts with its own share of tiles
+	///		and takes tiles from the others when it runs out (check tile_scheduler.h);
+	///		for geometries where the fraction of solid nodes differs among rows
+	enum Schedule { static_slabs, work_stealing };
+
+	/** 
+	 * Communication hooks of a time step that overlaps halo exchanges with 
+	 *	the update of the interior rows (check the step overloads that take one)
+	 * @details Boundary strips are the first and the last active row; all hooks
+	 *	are called by the thread that called step(), the other workers keep 
+	 *	updating the interior meanwhile; default hooks do nothing
+	 */
+	class HaloExchange {
+	public:
+		virtual ~HaloExchange() = default;
+		/// Densities of the boundary strips are computed, start sending them
+		virtual void start_density_exchange(Fluid& /*fluid_1*/, Fluid& /*fluid_2*/) { }
+		/// Store the densities of the rows next to the active ones before returning
+		virtual void finish_density_exchange(Fluid& /*fluid_1*/, Fluid& /*fluid_2*/) { }
+		/// Boundary strips are updated, f_new holds the values they streamed out of 
+		/// the active rows; it becomes the fluid's distribution when the step returns
+		virtual void start_stream_exchange(LatticeVector<double>& /*f_new*/) { }
+		/// Same for both fluids of a two fluid step
+		virtual void start_stream_exchange(LatticeVector<double>& /*f_new_1*/, LatticeVector<double>& /*f_new_2*/) { }
+	};
+
 	/// Need to assign the right size to temporary arrays
 	LBM() = delete;
 	
-	/// Constructor: stores dimensions and initializes temporary arrays
-	LBM(const Geometry& geom) 
+	/// Constructor: stores dimensions, initializes temporary arrays, and 
+	/// builds the node types, neighbor and streaming tables for this geometry
+	/// @details The geometry is assumed static - all operations need to be
+	///		called with the same geometry as this constructor
+	/// @details Temporary streaming lattices are not allocated in the aa_pattern mode,
+	///		and they are single precision in the mixed_precision mode
+	/// @details Temporary arrays are taken from the shared pool (check scratch_pool.h),
+	///		except for the padded temporary lattice, which has its own size
+	LBM(const Geometry& geom, const Streaming mode = two_lattice, 
+			const Precision prec = double_precision, const Layout lay = dense) 
+				: streaming(mode), precision(prec), layout(lay)
 	{	
 		Nx = geom.Nx(); Ny = geom.Ny(); Ntot = Nx*Ny; 
-		temp_f_dist.resize(Ntot*Ndir, 0.0); 
-		temp_f_dist_spare.resize(Ntot*Ndir, 0.0);
-		temp_uc_x.resize(Ntot, 0.0); 
-		temp_uc_y.resize(Ntot, 0.0); 
+		if ((layout == padded) && ((streaming != two_lattice) || (precision != double_precision))) {
+			throw std::invalid_argument("The padded layout needs the two_lattice mode and double precision");
+		}
+		// Lead, Nx nodes, and the ghost column after them, rounded up to whole lines
+		row_pitch = ((Nx + 2*pad_lead)/pad_lead)*pad_lead;
+		padded_plane = (Ny + 2)*row_pitch;
+		if (layout == padded) {
+			first_touch_resize(temp_f_dist, row_pitch, Ny + 2, Ndir);
+		} else if (streaming == two_lattice && precision == double_precision) {
+			pooled_resize(temp_f_dist, Nx, Ny, Ndir); 
+			pooled_resize(temp_f_dist_spare, Nx, Ny, Ndir);
+		} else if (streaming == two_lattice) {
+			pooled_resize(temp_f_float, Nx, Ny, Ndir); 
+			pooled_resize(temp_f_float_spare, Nx, Ny, Ndir);
+		}
+		pooled_resize(temp_uc_x, Nx, Ny, 1); 
+		pooled_resize(temp_uc_y, Nx, Ny, 1); 
+		row_end = Ny;
+		build_lattice_tables(geom);
 	}  
 
+	/// Gives the temporary arrays back to the shared pool
+	~LBM();
+
+	/** 
+	 * Restrict the collision and streaming operations to a range of rows
+	 * @details Rows outside of the range are a halo - they are not updated
+	 *		but they still receive values streamed from the active rows, and 
+	 *		their densities are used as neighbor potentials in the two fluid step;
+	 *		used for domain decomposition, by default all rows are active
+	 *
+	 * @param first_row - first active row
+	 * @param end_row - one past the last active row
+	 */
+	void set_active_rows(const size_t first_row, const size_t end_row);
+
+	/// Choose how the nodes are distributed among the workers in step(), 
+	/// static_slabs by default; results don't depend on it
+	void set_schedule(const Schedule sched) { schedule = sched; }
+
+	/// Time each worker spent updating nodes in step() since the last reset, 
+	///	in seconds, waiting at barriers excluded
+	const std::vector<double>& get_busy_times() const { return busy_times; }
+
+	/// Zero the busy times of all workers
+	void reset_busy_times() { std::fill(busy_times.begin(), busy_times.end(), 0.0); }
+
 	/** 
 	 * Initializes a droplet of one fluid in the other fluid
 	 * @details This initialization will not put fluid nodes inside a solid
@@ -82,56 +207,560 @@ public:
 	void compute_solid_surface_force(const Geometry&, Fluid&, Fluid&);
 
 	/// Computes the force from fluid-fluid interactions for both fluids
-	/// @details Stores it in the fluid objects 
+	/// @details Stores it in the fluid objects, not available for lean fluids
 	void compute_fluid_repulsive_interactions(const Geometry&, Fluid&, Fluid&);
 
 	/// Calculate the macroscopic, composite, and equilibrium velocity
+	/// @details Uses the momentum computed together with the density by 
+	///		Fluid::compute_density, and computes it only if the distributions
+	///		changed since; not available for lean fluids
 	void compute_equilibrium_velocities(Geometry& geom, Fluid&, Fluid&);
 
 	/// Collision step for a single fluid
+	/// @details Vectorized, check simd_kernels.h
+	/// @details Not available in the mixed_precision mode
 	void collide(const Geometry& geom, Fluid&);
 
 	/// Collision step for a two fluids
+	/// @details Vectorized, check simd_kernels.h
+	/// @details Not available in the mixed_precision mode
 	void collide(Fluid&, Fluid&);
 
 	/// Add an external volume force to a single fluid (gravity, pressure drop)	
 	/// @details The force is specified for each lattice direction (check manual)
+	/// @details Not available in the mixed_precision mode
 	void add_volume_force(const Geometry&, Fluid&, const std::vector<double>&);
 
 	/// Add an external volume force to a two species - two fluid system (gravity, pressure drop)	
 	/// @details The force is specified for each lattice direction (check manual)
+	/// @details Not available in the mixed_precision mode
 	void add_volume_force(const Geometry&, Fluid&, Fluid&, const std::vector<double>&);
  
 	/// Streaming step for a single fluid
+	/// @details Shift of the whole lattice followed by bounce-back on the fluid-solid links
+	/// @details Not available in the aa_pattern and mixed_precision modes
 	void stream(const Geometry&, Fluid&);
 
 	/// Streaming step for a two fluid species and two phases
+	/// @details Shift of the whole lattice followed by bounce-back on the fluid-solid links
+	/// @details Not available in the aa_pattern and mixed_precision modes
 	void stream(const Geometry&, Fluid&, Fluid&);
 
+	/** 
+	 * Complete time step for a single fluid in one pass over the lattice
+	 * @details Same result as collide, add_volume_force, and stream called in that order
+	 * @details Each node's distribution is read once - moments, collision, the volume force,
+	 *		and streaming with bounce-back are all done per node; the equilibrium 
+	 *		distribution and macroscopic properties are not stored in the fluid
+	 *
+	 * @param geom - geometry object
+	 * @param fluid_1 - fluid to advance by one step
+	 * @param force - volume force for each lattice direction (check manual)
+	 */
+	void step(const Geometry& geom, Fluid& fluid_1, const std::vector<double>& force);
+
+	/** 
+	 * Complete time step for a two fluid species - two phase system in two passes
+	 * @details Same result as compute_density for both fluids, compute_fluid_repulsive_interactions,
+	 *		compute_equilibrium_velocities, collide, add_volume_force, and stream called in that order
+	 * @details First pass computes densities of both fluids, second pass computes the repulsive
+	 *		forces, composite and equilibrium velocities, collision, volume force, and streaming
+	 *		node by node; repulsive forces, equilibrium velocities, and equilibrium 
+	 *		distributions are not stored in the fluids  
+	 * @details Fluid-solid forces need to be computed beforehand (compute_solid_surface_force)
+	 *
+	 * @param geom - geometry object
+	 * @param fluid_1 - first fluid
+	 * @param fluid_2 - second fluid
+	 * @param force - volume force for each lattice direction (check manual)
+	 */
+	void step(const Geometry& geom, Fluid& fluid_1, Fluid& fluid_2, const std::vector<double>& force);
+
+	/// Complete time step for a two fluid species - two phase system without a volume force
+	void step(const Geometry& geom, Fluid& fluid_1, Fluid& fluid_2)
+		{ step(geom, fluid_1, fluid_2, no_force); }
+
+	/** 
+	 * Single fluid step that overlaps a halo exchange with the interior update
+	 * @details Same result as step(); the boundary strips are updated first, then 
+	 *	halo.start_stream_exchange is called and the remaining active rows are updated
+	 *	while the exchange is in flight; the caller finishes it after the step returns
+	 * @details Boundary strips are split among the workers by columns, the remaining 
+	 *	rows follow the schedule (check set_schedule); both count in the busy times
+	 * @details Needs the two_lattice mode and double precision
+	 *
+	 * @param geom - geometry object
+	 * @param fluid_1 - fluid to advance by one step
+	 * @param force - volume force for each lattice direction (check manual)
+	 * @param halo - communication hooks
+	 */
+	void step(const Geometry& geom, Fluid& fluid_1, const std::vector<double>& force, HaloExchange& halo);
+
+	/** 
+	 * Two fluid step that overlaps the density and the streaming halo exchanges 
+	 *	with the interior update
+	 * @details Same result as step() if halo.finish_density_exchange stores the 
+	 *	densities of the rows next to the active ones, which this step does not compute;
+	 *	densities of the boundary strips are computed and passed on first, those of the 
+	 *	remaining rows while they are in flight; the update then proceeds as in the 
+	 *	single fluid version
+	 * @details Same requirements as the single fluid version, fluid-solid 
+	 *	forces need to be computed beforehand
+	 */
+	void step(const Geometry& geom, Fluid& fluid_1, Fluid& fluid_2, const std::vector<double>& force, 
+					HaloExchange& halo);
+
+	/** 
+	 * Several time steps for a single fluid with temporal blocking
+	 * @details Same result as nsteps calls of step(); up to depth steps advance 
+	 *	together in a wavefront over the rows - each row is updated by all of
+	 *	them while its neighborhood is still in cache, instead of streaming the 
+	 *	whole lattice from memory every step
+	 * @details Needs the two_lattice mode and all rows active; the lattice
+	 *	needs at least 3 rows, smaller ones run step() 
+	 *
+	 * @param geom - geometry object
+	 * @param fluid_1 - fluid to advance
+	 * @param force - volume force for each lattice direction (check manual)
+	 * @param nsteps - number of time steps
+	 * @param depth - number of time steps in one wavefront
+	 */
+	void advance(const Geometry& geom, Fluid& fluid_1, const std::vector<double>& force, 
+					const size_t nsteps, const size_t depth = 4);
+
+	/** 
+	 * Several time steps for a two fluid species - two phase system with temporal blocking
+	 * @details Same result as nsteps calls of step(); the rows of each step lag 
+	 *	more behind the previous step than for a single fluid, since the repulsive 
+	 *	forces need the densities of the neighbors
+	 * @details Same requirements as the single fluid version, fluid-solid 
+	 *	forces need to be computed beforehand
+	 */
+	void advance(const Geometry& geom, Fluid& fluid_1, Fluid& fluid_2, const std::vector<double>& force, 
+					const size_t nsteps, const size_t depth = 4);
+
+	/** 
+	 * Brings the distributions to their regular layout after an odd number of 
+	 *	aa_pattern steps - finishes the streaming of the last step in place
+	 * @details Needs to be called before any operation other than step() and 
+	 *	before reading the distributions; the next step continues normally
+	 * @details Does nothing in the two_lattice mode or if already synchronized
+	 *
+	 * @param geom - geometry object
+	 * @param fluid_1 - fluid advanced with step()
+	 */
+	void synchronize(const Geometry& geom, Fluid& fluid_1);
+
+	/// Synchronize both fluids of a two fluid species - two phase system
+	/// @details Both fluids need to be synchronized together, they share the step parity
+	void synchronize(const Geometry& geom, Fluid& fluid_1, Fluid& fluid_2);
+
+	/// True if the distributions are in their regular layout
+	bool is_synchronized() const { return !aa_odd; }
+
+	/** 
+	 * Converts the distribution of an initialized fluid to single precision 
+	 *	storage for steps in the mixed_precision mode
+	 * @details Values are stored as float, optionally as the deviation from the rest
+	 *	state w_i*rho_ref with rho_ref the mean density of the fluid nodes - the deviation 
+	 *	is small so its rounding error is small compared to the distribution itself; only
+	 *	for nearly uniform densities, in two fluid systems each density varies between its 
+	 *	bulk and dissolved values and the plain values are more accurate 
+	 *	(check benchmarks/mixed_precision)
+	 * @details The double precision distribution and equilibrium distribution are
+	 *	released, the macroscopic properties and forces stay in double precision
+	 *
+	 * @param geom - geometry object
+	 * @param fluid_1 - initialized fluid
+	 * @param deviation - store the deviation from the rest state if true, the values otherwise
+	 */
+	void compress(const Geometry& geom, Fluid& fluid_1, const bool deviation = true);
+
+	/// Restores the double precision distribution of a compressed fluid
+	/// @details Needed before reading the distribution or saving the fluid
+	void expand(const Geometry& geom, Fluid& fluid_1);
+
+	/** 
+	 * Converts the distribution of an initialized fluid to the padded layout 
+	 *	for steps with an LBM constructed with it
+	 * @details Each row of each direction is copied to its place in the padded array,
+	 *	ghost cells are zero; the equilibrium distribution is released
+	 * @details Only step() works on padded fluids, the macroscopic properties
+	 *	and output need unpad first
+	 *
+	 * @param geom - geometry object
+	 * @param fluid_1 - initialized fluid
+	 */
+	void pad(const Geometry& geom, Fluid& fluid_1);
+
+	/// Restores the dense distribution of a padded fluid
+	/// @details Needed before reading the distribution or saving the fluid
+	void unpad(const Geometry& geom, Fluid& fluid_1);
+
 private:
-	// Number of directions (Ntot is Nx*Ny)
-	size_t Nx = 0, Ny = 0, Ntot = 0, Ndir = 9;
+	// Lattice dimensions (Ntot is Nx*Ny) and number of directions
+	size_t Nx = 0, Ny = 0, Ntot = 0;
+	static constexpr size_t Ndir = Lattice::Q;
 	// Boundary conditions (default periodic in all directions)
 	bool xperiodic = true;
 	bool yperiodic = true;
-	// Weights for computing fluid-solid interactions
-	const std::vector<double> solid_weights = {0.0, 1.0/9, 1.0/9, 1.0/9, 1.0/9,
-							1.0/36, 1.0/36, 1.0/36, 1.0/36};
-	// Weights for computing repulsive fluid-fluid interactions
-	const std::vector<double> repulsion_weights = {0.0, 1.0/9, 1.0/9, 1.0/9, 1.0/9,
-							1.0/36, 1.0/36, 1.0/36, 1.0/36};
-	// Bounce-back direction conversions
-	const std::vector<int> bb_rules = {3, 4, 1, 2, 7, 8, 5, 6};
-	// Discerete velocities - x components
-	const std::vector<int> Cx = {0, 1, 0, -1, 0, 1, -1, -1, 1};
-	// Discerete velocities - y components
-	const std::vector<int> Cy = {0, 0, 1, 0, -1, 1, 1, -1, -1};
-	// Temporary containers for streaming operations
-	std::vector<double> temp_f_dist;
- 	std::vector<double> temp_f_dist_spare;
+	// Zero volume force for steps without external forcing
+	const std::vector<double> no_force = std::vector<double>(Ndir, 0.0);
+	// Compact geometry - Geometry::NodeType flags of each node (check 
+	// Geometry::node_types), read by the kernels instead of the geometry
+	LatticeVector<std::uint8_t> node_type;
+	// Marks a solid neighbor in the fluid neighbor table
+	const std::uint32_t no_neighbor = std::numeric_limits<std::uint32_t>::max();
+	// Linear index of the neighbor of each node in each direction, periodic
+	// boundaries included; no_neighbor if the neighbor is a solid node, 
+	// flat array of size Nx*Ny*9 ordered like the density distribution
+	LatticeVector<std::uint32_t> fluid_neighbors;
+	// Final position in the density distribution array of the value streamed 
+	// from each node in each direction, with bounce-back already resolved,
+	// flat array of size Nx*Ny*9 ordered like the density distribution
+	LatticeVector<std::uint32_t> stream_targets;
+	// Fluid-solid link - value leaving a fluid node towards a solid neighbor,
+	// each entry is a position in the density distribution array
+	struct BounceBackLink {
+		// Value leaving fluid node ai in direction dj, ai + dj*Ntot
+		std::uint32_t source;
+		// Where it bounces back to, ai + opposite(dj)*Ntot
+		std::uint32_t target;
+		// Where a plain shift moves it - solid node ij in the same direction, ij + dj*Ntot
+		std::uint32_t solid;
+	};
+	// All fluid-solid links of a static geometry ordered by node, links of
+	// row yj are from bb_link_rows[yj] to bb_link_rows[yj+1] - 1
+	std::vector<BounceBackLink> bb_links;
+	std::vector<size_t> bb_link_rows;
+	// Runs of consecutive bulk nodes - fluid nodes not on the lattice edges 
+	// with all neighbors fluid; each run is within one row, sorted by position
+	std::vector<NodeRange> bulk_runs;
+	// Linear index offset of the neighbor in each direction, cx + cy*Nx
+	std::ptrdiff_t neighbor_offset[Ndir] = {};
+	// Padded layout - values before the first column of a row, a 64 byte line 
+	// of doubles, so that the ghost column before it is in the same row
+	static constexpr size_t pad_lead = 8;
+	// Padded layout - values per row, multiple of pad_lead, and per direction
+	size_t row_pitch = 0, padded_plane = 0;
+	// Padded layout - final position of the value streamed from each fluid node
+	// in each direction, like stream_targets; values crossing a periodic edge 
+	// go to the ghost cell past it, including those that bounce back from a solid
+	// node on the other side, so that the fold sets every edge slot it covers
+	LatticeVector<std::uint32_t> padded_targets;
+	// Padded layout - runs of fluid nodes with all neighbors fluid, lattice
+	// edges included; each run is within one row, sorted by position
+	std::vector<NodeRange> padded_runs;
+	// Rows updated by the collision and streaming operations, [row_begin, row_end)
+	size_t row_begin = 0, row_end = 0;
+	// Streaming scheme
+	Streaming streaming = two_lattice;
+	// Storage precision of the distributions
+	Precision precision = double_precision;
+	// Storage layout of the distributions in step()
+	Layout layout = dense;
+	// In the aa_pattern mode, true after an odd number of steps - the last
+	// post-collision values are stored in the opposite slots of each node 
+	bool aa_odd = false;
+	// Temporary containers for streaming operations (two_lattice mode only)
+	LatticeVector<double> temp_f_dist;
+ 	LatticeVector<double> temp_f_dist_spare;
+	// Single precision temporary containers (two_lattice and mixed_precision modes)
+	LatticeVector<float> temp_f_float;
+	LatticeVector<float> temp_f_float_spare;
 	// Temporary containers for composite velocities
-	std::vector<double> temp_uc_x;
-	std::vector<double> temp_uc_y;
+	LatticeVector<double> temp_uc_x;
+	LatticeVector<double> temp_uc_y;
+	// Workers of the fused steps, started by the first step and 
+	// restarted when the number of threads changes
+	std::unique_ptr<ThreadPool> pool;
+	// Distribution of the nodes among the workers in step()
+	Schedule schedule = static_slabs;
+	// Tiles of the active rows, and of the rows with densities in the two fluid step,
+	// for the work_stealing schedule; built for tiles_key - number of workers, row_begin, row_end
+	TileScheduler update_tiles, density_tiles;
+	// Tiles of the active rows other than the boundary strips, for the steps 
+	// with halo exchanges - update, and densities in the two fluid step
+	TileScheduler interior_tiles, interior_density_tiles;
+	std::array<size_t, 3> tiles_key = {{0, 0, 0}};
+	// Tiles per worker in the work_stealing schedule
+	static constexpr size_t tiles_per_worker = 8;
+	// Time each worker spent in the node loops of step(), seconds
+	std::vector<double> busy_times;
+
+	/// Compute the node types, neighbor and streaming tables for a static geometry
+	void build_lattice_tables(const Geometry& geom);
+
+	/// Streaming targets and fixed offset runs of the padded layout, from the other tables
+	void build_padded_tables();
+
+	/// Nodes of the active rows in the row slab of the calling thread
+	NodeRange active_slab() const { return thread_slab(Nx, row_begin, row_end); }
+
+	/// Workers for the current number of threads (check get_num_threads)
+	ThreadPool& workers()
+	{
+		const size_t nthreads = static_cast<size_t>(get_num_threads());
+		if (!pool || (pool->size() != nthreads)) {
+			pool.reset();
+			pool.reset(new ThreadPool(nthreads));
+			busy_times.assign(nthreads, 0.0);
+		}
+		return *pool;
+	}
+
+	/// Build the tiles for the current workers and active rows if needed, 
+	///	and deal them for the next step
+	void prepare_tiles();
+
+	/** 
+	 * Run kernel(range) for the nodes of worker tid in one pass of step() and 
+	 *	add the time to its busy time
+	 * @details Nodes are the slab with the static_slabs schedule, tiles 
+	 *	taken from tiles with the work_stealing schedule
+	 */
+	template <typename NodeKernel>
+	void scheduled_pass(const size_t tid, TileScheduler& tiles, const NodeRange slab, NodeKernel kernel)
+	{
+		timed_pass(tid, [&]()
+			{
+				if (schedule == work_stealing) {
+					tiles.run(tid, kernel);
+				} else {
+					kernel(slab);
+				}
+			});
+	}
+
+	/// Run work() for worker tid and add the time to its busy time
+	template <typename Work>
+	void timed_pass(const size_t tid, Work work)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		work();
+		busy_times[tid] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	/// Nodes of the active rows in the row slab of worker tid
+	NodeRange active_slab(const size_t tid) const 
+		{ return thread_slab(Nx, row_begin, row_end, tid, pool->size()); }
+
+	/// Nodes of the active rows other than the boundary strips in the row slab of worker tid
+	NodeRange interior_slab(const size_t tid) const
+	{
+		const size_t first = row_begin + 1;
+		return thread_slab(Nx, first, std::max(first, row_end - 1), tid, pool->size());
+	}
+
+	/// Nodes of row yj in a range of columns
+	NodeRange row_part(const size_t yj, const NodeRange columns) const
+	{
+		NodeRange part;
+		part.begin = yj*Nx + columns.begin;
+		part.end = yj*Nx + columns.end;
+		return part;
+	}
+
+	/// Bounce-back links of the fluid nodes in a range of whole rows
+	NodeRange links_of(const NodeRange range) const 
+	{ 
+		NodeRange links;
+		links.begin = bb_link_rows[range.begin/Nx];
+		links.end = bb_link_rows[range.end/Nx];
+		return links;
+	}
+
+	/// Move plane dj of the rows in range by one link to temp, periodic, 
+	/// regardless of the node types
+	void shift_plane(const LatticeVector<double>& f_dist, LatticeVector<double>& temp, 
+						const size_t dj, const NodeRange range) const;
+
+	/// Position of the distribution value of node ai in direction dj at the beginning of a step
+	size_t read_index(const size_t ai, const size_t dj) const
+	{ 
+		return aa_odd ? element(stream_targets, ai + Lattice::opposite[dj]*Ntot) : ai + dj*Ntot; 
+	}
+
+	/// Position where a step stores the value leaving node ai in direction dj 
+	/// @details In the two_lattice mode the position is in the temporary lattice 
+	size_t write_index(const size_t ai, const size_t dj) const
+	{ 
+		return (streaming == aa_pattern && !aa_odd) ? ai + Lattice::opposite[dj]*Ntot : element(stream_targets, ai + dj*Ntot); 
+	}
+
+	/// Position of node (xi, yj) in a direction of the padded layout, -1 and Nx,
+	///	-1 and Ny are the ghost cells
+	size_t padded_index(const std::ptrdiff_t xi, const std::ptrdiff_t yj) const
+	{
+		return static_cast<size_t>((yj + 1)*static_cast<std::ptrdiff_t>(row_pitch) 
+						+ static_cast<std::ptrdiff_t>(pad_lead) + xi);
+	}
+
+	/// Shift from node ai of row yj to its position in the padded layout
+	size_t padded_shift(const size_t yj) const { return padded_index(0, yj) - yj*Nx; }
+
+	/// Shift from a bulk node ai to read_index(ai, dj)
+	std::ptrdiff_t bulk_read_shift(const size_t dj) const
+	{
+		const size_t opp = Lattice::opposite[dj];
+		return aa_odd ? static_cast<std::ptrdiff_t>(opp*Ntot) + neighbor_offset[opp] : static_cast<std::ptrdiff_t>(dj*Ntot);
+	}
+
+	/// Shift from a bulk node ai to write_index(ai, dj)
+	std::ptrdiff_t bulk_write_shift(const size_t dj) const
+	{
+		return (streaming == aa_pattern && !aa_odd) ? static_cast<std::ptrdiff_t>(Lattice::opposite[dj]*Ntot) 
+							: static_cast<std::ptrdiff_t>(dj*Ntot) + neighbor_offset[dj];
+	}
+
+	/** 
+	 * Visit the nodes of a range in order
+	 * @details Runs of bulk nodes, or their parts within the range, go to 
+	 *	bulk_kernel(begin, end), every other node (solid nodes included) 
+	 *	to boundary_kernel(ai)
+	 */
+	template <typename BulkKernel, typename BoundaryKernel>
+	void for_each_node(const NodeRange range, BulkKernel bulk_kernel, BoundaryKernel boundary_kernel) const
+	{
+		for_each_node(bulk_runs, range, bulk_kernel, boundary_kernel);
+	}
+
+	/// Same with other runs of nodes updated with fixed offsets (padded_runs)
+	template <typename BulkKernel, typename BoundaryKernel>
+	void for_each_node(const std::vector<NodeRange>& runs, const NodeRange range, 
+							BulkKernel bulk_kernel, BoundaryKernel boundary_kernel) const
+	{
+		// First run that ends in the range
+		auto run = std::lower_bound(runs.cbegin(), runs.cend(), range.begin,
+							[](const NodeRange& r, const size_t ai) { return r.end <= ai; });
+		size_t ai = range.begin;
+		for (; (run != runs.cend()) && (run->begin < range.end); ++run) {
+			for (; ai < run->begin; ++ai) {
+				boundary_kernel(ai);
+			}
+			bulk_kernel(ai, std::min(run->end, range.end));
+			ai = std::min(run->end, range.end);
+		}
+		for (; ai < range.end; ++ai) {
+			boundary_kernel(ai);
+		}
+	}
+
+	/** 
+	 * Row wavefront for temporal blocking - level k visits every row once, periodic, 
+	 *	starting from row a*k, (a+d)*k waves after level 0; in each wave all levels 
+	 *	visit their rows, each thread takes the same part of every row
+	 * @details Each phase calls row_kernel(phase, k, p, columns) for level k at position 
+	 *	p of its order, columns is the part of the row of the calling worker; phases and 
+	 *	waves are separated by barriers; levels of a wave must be independent, a and d 
+	 *	are chosen for that from the dependency radius of the step (check advance())
+	 */
+	template <typename RowKernel>
+	void wavefront(const size_t levels, const size_t a, const size_t d, const size_t phases, 
+						RowKernel row_kernel)
+	{
+		const size_t b = a + d;
+		const size_t waves = Ny + b*(levels - 1);
+		ThreadPool& team = workers();
+		auto sweep = [&](const size_t tid)
+		{
+			const NodeRange columns = thread_slab(1, 0, Nx, tid, team.size());
+			for (size_t wave = 0; wave < waves; ++wave) {
+				for (size_t phase = 0; phase < phases; ++phase) {
+					for (size_t k = 0; k < levels; ++k) {
+						if ((wave >= b*k) && (wave - b*k < Ny)) {
+							row_kernel(phase, k, wave - b*k, columns);
+						}
+					}
+					team.barrier();
+				}
+			}
+		};
+		team.run(sweep);
+	}
+
+	/// Collision, volume force, and streaming of the fluid nodes in a range, single fluid
+	template <typename Real>
+	void update_fluid_nodes(const Fluid& fluid_1, LatticeVector<Real>& f_dist, LatticeVector<Real>& f_out, 
+								const std::vector<double>& force, const NodeRange range) const;
+
+	/// Collision, volume force, and streaming of the fluid nodes in a range, 
+	/// single fluid in the padded layout
+	void update_padded_nodes(const Fluid& fluid_1, const LatticeVector<double>& f_dist, 
+								LatticeVector<double>& f_out, const std::vector<double>& force, 
+								const NodeRange range) const;
+
+	/// Copy the ghost cells of direction dj that received streamed values
+	/// to their periodic images on the opposite edges
+	void fold_ghosts(LatticeVector<double>& f_out, const size_t dj) const;
+
+	/// Densities of both fluids at the fluid nodes in a range
+	/// @details Called by the workers, so the density arrays are taken beforehand
+	template <typename Real>
+	void fluid_densities(const Fluid& fluid_1, const Fluid& fluid_2, const LatticeVector<Real>& f_dist_1, 
+							const LatticeVector<Real>& f_dist_2, LatticeVector<double>& rho_out_1, 
+							LatticeVector<double>& rho_out_2, const NodeRange range) const;
+
+	/// Repulsive forces, collision, volume force, and streaming of the fluid nodes 
+	/// in a range, two fluids; densities of the range and its neighbors need to be computed
+	template <typename Real>
+	void update_fluids_nodes(const Fluid& fluid_1, const Fluid& fluid_2, 
+								LatticeVector<Real>& f_dist_1, LatticeVector<Real>& f_dist_2, 
+								LatticeVector<Real>& f_out_1, LatticeVector<Real>& f_out_2, 
+								const std::vector<double>& force, const NodeRange range) const;
+
+	/// Temporally blocked single fluid steps on distributions stored as Real
+	template <typename Real>
+	void advance_fluid(Fluid& fluid_1, LatticeVector<Real>& f_dist, LatticeVector<Real>& temp, 
+							const std::vector<double>& force, const size_t levels);
+
+	/// Temporally blocked two fluid steps on distributions stored as Real
+	template <typename Real>
+	void advance_fluids(Fluid& fluid_1, Fluid& fluid_2, LatticeVector<Real>& f_dist_1, 
+							LatticeVector<Real>& f_dist_2, LatticeVector<Real>& temp_1, 
+							LatticeVector<Real>& temp_2, const std::vector<double>& force, 
+							const size_t levels);
+
+	/// Swap the values on each fluid-fluid link to finish in-place streaming
+	template <typename Real>
+	void swap_links(LatticeVector<Real>& f_dist);
+
+	/// Single fluid step on distributions stored as Real, temp is the 
+	/// temporary lattice of the same precision
+	template <typename Real>
+	void step_fluid(Fluid& fluid_1, LatticeVector<Real>& f_dist, 
+						LatticeVector<Real>& temp, const std::vector<double>& force);
+
+	/// Single fluid step in the padded layout
+	void step_padded(Fluid& fluid_1, LatticeVector<double>& f_dist, const std::vector<double>& force);
+
+	/// Two fluid step on distributions stored as Real
+	template <typename Real>
+	void step_fluids(Fluid& fluid_1, Fluid& fluid_2, 
+						LatticeVector<Real>& f_dist_1, LatticeVector<Real>& f_dist_2, 
+						LatticeVector<Real>& temp_1, LatticeVector<Real>& temp_2, 
+						const std::vector<double>& force);
+
+	/// Throws if the overlapped halo exchange is not available in this configuration
+	void check_overlap() const;
+
+	/// Throws if temporal blocking is not available in this configuration
+	void check_blocking(const size_t depth) const;
+
+	/// Throws if the separate operations are not available in this mode
+	void check_double_precision() const;
+
+	/// Throws if a fluid was not compressed for the mixed_precision steps
+	void check_single_precision(const Fluid& fluid_1) const;
+
+	/// Throws if a fluid doesn't store the arrays of the separate operations
+	void check_full_storage(const Fluid& fluid_1) const;
+
+	/// Throws if an operation other than the single fluid step is used in the padded layout
+	void check_dense_layout() const;
+
+	/// Throws if a fluid was not padded for the padded layout steps
+	void check_padded(const Fluid& fluid_1) const;
 };
 
 #endif
@@ -0,0 +1,109 @@
+#ifndef MOMENT_KERNELS_H
+#define MOMENT_KERNELS_H
+
+#include <cstddef>
+#include "lattice.h"
+
+/*****************************************************
+ * Moment kernels
+ *
+ * Density and momentum (density times velocity) of
+ *	ranges of nodes of the direction-major distributions,
+ *	all computed from one read of the distribution.
+ *	The two fluid version reads both distributions in
+ *	the same loop.
+ *
+ * Used by the Fluid class for the macroscopic properties
+ *	and by the separate LBM operations of two fluid
+ *	systems for the composite velocity. Sums run over
+ *	the directions in order, so results are the same as
+ *	those of separate loops for each moment.
+ *
+ ******************************************************/
+
+/// Distribution and outputs of the moment kernels
+/// @details Outputs that are not needed are nullptr
+struct MomentArrays {
+	const double* f = nullptr;
+	double* rho = nullptr;
+	double* jx = nullptr;
+	double* jy = nullptr;
+};
+
+/**
+ * Density and momentum at a single node
+ *
+ * @param f - distribution, Ntot*9 values
+ * @param Ntot - number of nodes in the lattice (size of one direction)
+ * @param ai - node
+ * @param rho - output, density
+ * @param jx - output, x momentum
+ * @param jy - output, y momentum
+ */
+inline void node_moments(const double* f, const size_t Ntot, const size_t ai,
+							double& rho, double& jx, double& jy)
+{
+	rho = 0.0;
+	jx = 0.0;
+	jy = 0.0;
+	for (size_t dj = 0; dj < Lattice::Q; ++dj) {
+		const double f_dj = f[dj*Ntot + ai];
+		rho += f_dj;
+		jx += f_dj*Lattice::cx[dj];
+		jy += f_dj*Lattice::cy[dj];
+	}
+}
+
+/// Store the requested moments of node ai
+inline void store_moments(const MomentArrays& fluid, const size_t ai,
+							const double rho, const double jx, const double jy)
+{
+	if (fluid.rho) {
+		fluid.rho[ai] = rho;
+	}
+	if (fluid.jx) {
+		fluid.jx[ai] = jx;
+		fluid.jy[ai] = jy;
+	}
+}
+
+/**
+ * Requested moments of nodes begin to end - 1 of one distribution
+ *
+ * @param fluid - distribution and outputs, each output Ntot values
+ * @param Ntot - number of nodes in the lattice (size of one direction)
+ * @param begin - first node
+ * @param end - one past the last node
+ */
+inline void compute_moments(const MomentArrays& fluid, const size_t Ntot,
+								const size_t begin, const size_t end)
+{
+	double rho = 0.0, jx = 0.0, jy = 0.0;
+	for (size_t ai = begin; ai < end; ++ai) {
+		node_moments(fluid.f, Ntot, ai, rho, jx, jy);
+		store_moments(fluid, ai, rho, jx, jy);
+	}
+}
+
+/**
+ * Requested moments of nodes begin to end - 1 of two distributions in one loop
+ *
+ * @param fluid_1 - first distribution and outputs
+ * @param fluid_2 - second distribution and outputs
+ * @param Ntot - number of nodes in the lattice (size of one direction)
+ * @param begin - first node
+ * @param end - one past the last node
+ */
+inline void compute_moments(const MomentArrays& fluid_1, const MomentArrays& fluid_2,
+								const size_t Ntot, const size_t begin, const size_t end)
+{
+	double rho = 0.0, jx = 0.0, jy = 0.0;
+	for (size_t ai = begin; ai < end; ++ai) {
+		node_moments(fluid_1.f, Ntot, ai, rho, jx, jy);
+		store_moments(fluid_1, ai, rho, jx, jy);
+		node_moments(fluid_2.f, Ntot, ai, rho, jx, jy);
+		store_moments(fluid_2, ai, rho, jx, jy);
+	}
+}
+
+#endif
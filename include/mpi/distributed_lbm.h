@@ -0,0 +1,201 @@
+#ifndef DISTRIBUTED_LBM_H
+#define DISTRIBUTED_LBM_H
+
+#include <mpi.h>
+#include <vector>
+#include "../geometry.h"
+#include "../fluid.h"
+#include "../lbm.h"
+
+/*****************************************************
+ * class: DistributedLBM
+ *
+ * LBM operations on a domain decomposed among MPI
+ *	ranks into slabs of whole rows
+ *
+ * Each rank stores its own rows and one halo row
+ *	below and above them - local rows 0 and Ny_local-1.
+ *	Halo rows mirror the boundary rows of the
+ *	neighboring ranks, with periodic wrap in y between
+ *	the last and the first rank; x is periodic within
+ *	each rank.
+ *
+ * Fluids are initialized with the local geometry.
+ *	After streaming, values that were streamed into
+ *	the halo rows are sent to the ranks that own them.
+ *	In two fluid systems the halo rows also receive
+ *	the neighbor densities (or distributions) needed
+ *	for the repulsive interactions.
+ *
+ * The fused steps update the first and the last own
+ *	row first and exchange their values while the
+ *	other own rows are updated (LBM::HaloExchange);
+ *	MPI is only called from the thread that calls
+ *	step(), so MPI_THREAD_FUNNELED is enough.
+ *
+ * Only the two_lattice streaming mode is supported.
+ *
+ ******************************************************/
+
+class DistributedLBM {
+public:
+
+	/// Needs the global geometry
+	DistributedLBM() = delete;
+
+	/// Constructor: splits the rows of the global geometry among all ranks
+	///	of the communicator, creates the local geometry and the local LBM
+	/// @details All ranks need to pass the same global geometry
+	DistributedLBM(const Geometry& global_geom, MPI_Comm comm = MPI_COMM_WORLD);
+
+	//
+	// Initialization
+	//
+
+	/// Initializes a droplet of one fluid in the other fluid
+	/// @details Same as LBM::initialize_droplet, center in global coordinates
+	void initialize_droplet(Fluid& bulk, Fluid& droplet,
+								const double rho_bulk, const double rho_droplet,
+								const double rho_b_in_d, const double rho_d_in_b,
+								const double xc, const double yc, const double radius);
+
+	/// Computes the force from fluid-solid interactions
+	void compute_solid_surface_force(Fluid& fluid_1, Fluid& fluid_2)
+		{ lbm.compute_solid_surface_force(local_geom, fluid_1, fluid_2); }
+
+	//
+	// Time steps
+	//
+
+	/// Complete time step for a single fluid, same as LBM::step followed by the halo exchange
+	/// @details Values streamed into the halo rows are sent while the interior rows are updated
+	void step(Fluid& fluid_1, const std::vector<double>& force);
+
+	/// Complete time step for a two fluid species - two phase system
+	/// @details Densities of the first and last own rows are sent to the halo rows
+	///		of the neighbors while the other densities are computed, then the 
+	///		streamed values are exchanged while the interior rows are updated
+	void step(Fluid& fluid_1, Fluid& fluid_2, const std::vector<double>& force);
+
+	/// Complete time step for a two fluid species - two phase system without a volume force
+	void step(Fluid& fluid_1, Fluid& fluid_2)
+		{ step(fluid_1, fluid_2, no_force); }
+
+	//
+	// Halo exchanges for the separate LBM operations
+	//
+
+	/// Send values streamed into the halo rows to the ranks that own them (after LBM::stream)
+	void exchange_streamed(Fluid& fluid_1);
+
+	/// Send values streamed into the halo rows to the ranks that own them, both fluids
+	void exchange_streamed(Fluid& fluid_1, Fluid& fluid_2);
+
+	/// Copy neighbor densities into the halo rows (after compute_density,
+	///	before LBM::compute_fluid_repulsive_interactions)
+	void exchange_density(Fluid& fluid_1, Fluid& fluid_2);
+
+	/// Copy neighbor distributions into the halo rows
+	void exchange_distributions(Fluid& fluid_1, Fluid& fluid_2);
+
+	//
+	// Output
+	//
+
+	/// Gather the own rows of a macroscopic field of size Nx*Ny_local
+	/// @return global Nx*Ny field on rank 0, empty on other ranks
+	std::vector<double> gather(const LatticeVector<double>& local_field) const;
+
+	/// Gather the own rows of a density distribution of size Nx*Ny_local*9
+	/// @return global Nx*Ny*9 distribution on rank 0, empty on other ranks
+	std::vector<double> gather_distribution(const LatticeVector<double>& local_dist) const;
+
+	//
+	// Getters
+	//
+
+	/// Local geometry - own rows with halo rows, used to initialize the fluids
+	const Geometry& get_local_geometry() const { return local_geom; }
+	/// Local LBM object, active only in the own rows
+	LBM& get_lbm() { return lbm; }
+	/// Global index of the first own row
+	size_t get_first_row() const { return first_row; }
+	/// Number of own rows
+	size_t get_Ny_own() const { return Ny_own; }
+	/// Rank in the communicator
+	int get_rank() const { return rank; }
+	/// Number of ranks
+	int get_size() const { return nranks; }
+
+private:
+	// Communicator and ranks
+	MPI_Comm comm;
+	int rank = 0, nranks = 1;
+	// Neighbor ranks, periodic
+	int rank_up = 0, rank_down = 0;
+	// Global dimensions
+	size_t Nx = 0, Ny = 0;
+	// Own rows - global index of the first one and their number
+	size_t first_row = 0, Ny_own = 0;
+	// Local dimensions with the halo rows (Ny_local = Ny_own + 2)
+	size_t Ny_local = 0, Ntot_local = 0;
+	// Number of directions
+	static constexpr size_t Ndir = Lattice::Q;
+	// Directions streamed into the upper and the lower halo rows
+	const std::vector<size_t> up_dirs = {2, 5, 6};
+	const std::vector<size_t> down_dirs = {4, 7, 8};
+	// Zero volume force for steps without external forcing
+	const std::vector<double> no_force = std::vector<double>(Ndir, 0.0);
+	// Own rows and halo rows
+	Geometry local_geom;
+	// Operations restricted to the own rows
+	LBM lbm;
+	// Communication buffers
+	std::vector<double> send_up, send_down, recv_up, recv_down;
+	// Pending receives and sends of the current exchange
+	MPI_Request requests[4];
+
+	/// Exchanges of the fused steps, started and finished by LBM::step
+	class OverlappedExchange : public LBM::HaloExchange {
+	public:
+		explicit OverlappedExchange(DistributedLBM& dlbm) : parent(dlbm) { }
+		void start_density_exchange(Fluid& fluid_1, Fluid& fluid_2) override
+			{ parent.post_rows({&fluid_1.get_rho(), &fluid_2.get_rho()}, 1); }
+		void finish_density_exchange(Fluid& fluid_1, Fluid& fluid_2) override
+			{ parent.finish_rows({&fluid_1.get_rho(), &fluid_2.get_rho()}, 1); }
+		void start_stream_exchange(LatticeVector<double>& f_new) override
+			{ parent.post_streamed({&f_new}); }
+		void start_stream_exchange(LatticeVector<double>& f_new_1, LatticeVector<double>& f_new_2) override
+			{ parent.post_streamed({&f_new_1, &f_new_2}); }
+	private:
+		DistributedLBM& parent;
+	};
+
+	/// First global row owned by a rank
+	size_t rank_first_row(const int r) const { return static_cast<size_t>(r)*Ny/nranks; }
+
+	/// Geometry of the own rows of this rank with one halo row on each side
+	Geometry make_local_geometry(const Geometry& global_geom) const;
+
+	/// Send own boundary rows of all arrays to the halo rows of the neighbors
+	void exchange_rows(const std::vector<LatticeVector<double>*>& arrays, const size_t Nplanes)
+		{ post_rows(arrays, Nplanes); finish_rows(arrays, Nplanes); }
+
+	/// Start sending own boundary rows, nonblocking
+	void post_rows(const std::vector<LatticeVector<double>*>& arrays, const size_t Nplanes);
+
+	/// Wait for the rows from the neighbors and store them in the halo rows
+	void finish_rows(const std::vector<LatticeVector<double>*>& arrays, const size_t Nplanes);
+
+	/// Send values streamed into the halo rows to the ranks that own them
+	void exchange_streamed(const std::vector<LatticeVector<double>*>& f_dists)
+		{ post_streamed(f_dists); finish_streamed(f_dists); }
+
+	/// Start sending values streamed into the halo rows, nonblocking
+	void post_streamed(const std::vector<LatticeVector<double>*>& f_dists);
+
+	/// Wait for the values streamed into the own rows by the neighbors and store them
+	void finish_streamed(const std::vector<LatticeVector<double>*>& f_dists);
+};
+
+#endif
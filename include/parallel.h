@@ -0,0 +1,250 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <cstdint>
+#include <new>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+/*****************************************************
+ * Shared memory parallelization support
+ *
+ * Node loops of the Fluid and LBM classes run with
+ *	OpenMP when compiled with -fopenmp, serially
+ *	otherwise.
+ *
+ * All loops use the same static partition of the
+ *	lattice - each thread owns one slab of whole rows.
+ *	Lattice arrays are allocated without initialization
+ *	and first written slab by slab, so that the memory
+ *	pages of each slab are placed on the NUMA node of
+ *	the thread that later updates them.
+ *
+ * The fused LBM time steps run on persistent workers
+ *	instead (thread_pool.h), with the same partition.
+ *
+ * Node loops write only to their own nodes (or to
+ *	distinct streaming targets), so the results do
+ *	not depend on the number of threads.
+ *
+ ******************************************************/
+
+//
+// Thread count
+//
+
+/// Set the number of threads used by the node loops
+/// @details Same as omp_set_num_threads or the OMP_NUM_THREADS
+///		environment variable; no effect in a serial build
+inline void set_num_threads(const int nthreads)
+{
+	if (nthreads < 1) {
+		throw std::invalid_argument("Number of threads needs to be at least 1");
+	}
+#ifdef _OPENMP
+	omp_set_num_threads(nthreads);
+#endif
+}
+
+/// Number of threads used by the node loops
+inline int get_num_threads()
+{
+#ifdef _OPENMP
+	return omp_get_max_threads();
+#else
+	return 1;
+#endif
+}
+
+//
+// Static row-slab partition
+//
+
+/// Range of linear node indices [begin, end)
+struct NodeRange {
+	size_t begin = 0;
+	size_t end = 0;
+};
+
+/// Nodes in the row slab of thread tid out of nthreads, rows from first_row to end_row - 1
+/// @details Same partition as below, for threads that are not OpenMP threads (check thread_pool.h)
+inline NodeRange thread_slab(const size_t Nx, const size_t first_row, const size_t end_row,
+								const size_t tid, const size_t nthreads)
+{
+	const size_t Nrows = end_row - first_row;
+	NodeRange slab;
+	slab.begin = (first_row + tid*Nrows/nthreads)*Nx;
+	slab.end = (first_row + (tid + 1)*Nrows/nthreads)*Nx;
+	return slab;
+}
+
+/**
+ * Nodes in the row slab of the calling thread, rows from first_row to end_row - 1
+ * @details The R rows are split into T slabs, thread t owns rows 
+ *		first_row + t*R/T to first_row + (t+1)*R/T - 1; outside of 
+ *		a parallel region this is the whole range
+ *
+ * @param Nx - number of nodes in x direction (row length)
+ * @param first_row - first row of the partitioned range
+ * @param end_row - one past the last row of the partitioned range
+ * @return range of linear indices of the slab nodes
+ */
+inline NodeRange thread_slab(const size_t Nx, const size_t first_row, const size_t end_row)
+{
+#ifdef _OPENMP
+	const size_t nthreads = static_cast<size_t>(omp_get_num_threads());
+	const size_t tid = static_cast<size_t>(omp_get_thread_num());
+#else
+	const size_t nthreads = 1, tid = 0;
+#endif
+	return thread_slab(Nx, first_row, end_row, tid, nthreads);
+}
+
+/// Nodes in the row slab of the calling thread in a lattice of Nx by Ny nodes
+inline NodeRange thread_slab(const size_t Nx, const size_t Ny)
+{
+	return thread_slab(Nx, 0, Ny);
+}
+
+/// Block of the calling thread in a compact array of Nnodes nodes
+/// @details Same partition as a lattice with one node per row, so arrays
+///		allocated with first_touch_resize(vec, 1, Nnodes, Nplanes) are
+///		first touched by the threads that own the blocks
+inline NodeRange thread_block(const size_t Nnodes)
+{
+	return thread_slab(1, 0, Nnodes);
+}
+
+//
+// First-touch lattice arrays
+//
+
+/**
+ * Allocator that leaves new elements default-initialized
+ * @details For arithmetic types this means not written at all,
+ *		so the memory is not touched until the parallel
+ *		initialization; construction with a value is unchanged
+ * @details Arrays of at least a page are page-aligned, and arrays
+ *		of at least a huge page are aligned to huge pages and backed
+ *		by them where the system allows (transparent huge pages on Linux);
+ *		all memory comes from the global operator new
+ */
+template <typename T>
+class FirstTouchAllocator : public std::allocator<T> {
+public:
+	template <typename U>
+	struct rebind { using other = FirstTouchAllocator<U>; };
+
+	FirstTouchAllocator() = default;
+	template <typename U>
+	FirstTouchAllocator(const FirstTouchAllocator<U>&) { }
+
+	static constexpr size_t page_size = 4096;
+	static constexpr size_t huge_page_size = 2*1024*1024;
+
+	/// Memory for n elements, not touched
+	T* allocate(const size_t n)
+	{
+		const size_t bytes = n*sizeof(T);
+		if (bytes < page_size) {
+			return std::allocator<T>::allocate(n);
+		}
+		size_t alignment = page_size;
+		if (bytes >= huge_page_size) {
+			alignment = huge_page_size;
+		}
+		// The block starts at least one pointer after the allocated memory,
+		// which is stored right before the block for deallocate
+		char* raw = static_cast<char*>(::operator new(bytes + alignment));
+		const std::uintptr_t address = reinterpret_cast<std::uintptr_t>(raw) + alignment;
+		char* block = reinterpret_cast<char*>(address - address%alignment);
+		reinterpret_cast<void**>(block)[-1] = raw;
+#ifdef MADV_HUGEPAGE
+		if (alignment == huge_page_size) {
+			// Only a hint - fails harmlessly without transparent huge pages
+			madvise(block, bytes, MADV_HUGEPAGE);
+		}
+#endif
+		return reinterpret_cast<T*>(block);
+	}
+
+	/// Release memory from allocate(n)
+	void deallocate(T* ptr, const size_t n)
+	{
+		if (n*sizeof(T) < page_size) {
+			std::allocator<T>::deallocate(ptr, n);
+			return;
+		}
+		::operator delete(reinterpret_cast<void**>(ptr)[-1]);
+	}
+
+	/// Default construction - no initialization
+	template <typename U>
+	void construct(U* ptr) { ::new(static_cast<void*>(ptr)) U; }
+
+	/// Construction with arguments - same as std::allocator
+	template <typename U, typename... Args>
+	void construct(U* ptr, Args&&... args)
+		{ ::new(static_cast<void*>(ptr)) U(std::forward<Args>(args)...); }
+};
+
+/// Lattice array - flat vector of Nx*Ny or Nx*Ny*9 values
+template <typename T>
+using LatticeVector = std::vector<T, FirstTouchAllocator<T>>;
+
+/**
+ * Fill a lattice array slab by slab in parallel
+ *
+ * @param vec - array of Nplanes planes of Nx*Ny values each
+ * @param Nx - number of nodes in x direction
+ * @param Ny - number of rows
+ * @param Nplanes - number of planes (1 for macroscopic, 9 for distributions)
+ * @param value - value to assign
+ */
+template <typename T>
+void slab_fill(LatticeVector<T>& vec, const size_t Nx, const size_t Ny,
+					const size_t Nplanes, const T value)
+{
+	const size_t Ntot = Nx*Ny;
+	#pragma omp parallel
+	{
+		const NodeRange slab = thread_slab(Nx, Ny);
+		for (size_t k = 0; k < Nplanes; ++k) {
+			std::fill(vec.begin() + k*Ntot + slab.begin, vec.begin() + k*Ntot + slab.end, value);
+		}
+	}
+}
+
+/**
+ * Allocate a lattice array and zero it slab by slab in parallel (first touch)
+ * @details Does nothing if the array already has the right size
+ *
+ * @param vec - array to allocate, Nplanes planes of Nx*Ny values each
+ * @param Nx - number of nodes in x direction
+ * @param Ny - number of rows
+ * @param Nplanes - number of planes (1 for macroscopic, 9 for distributions)
+ */
+template <typename T>
+void first_touch_resize(LatticeVector<T>& vec, const size_t Nx, const size_t Ny,
+							const size_t Nplanes)
+{
+	if (vec.size() == Nx*Ny*Nplanes) {
+		return;
+	}
+	vec.clear();
+	vec.resize(Nx*Ny*Nplanes);
+	slab_fill(vec, Nx, Ny, Nplanes, T());
+}
+
+#endif
@@ -0,0 +1,145 @@
+#ifndef SCRATCH_POOL_H
+#define SCRATCH_POOL_H
+
+#include <cstddef>
+#include <vector>
+#include <mutex>
+#include "parallel.h"
+
+/*****************************************************
+ * class: ScratchPool
+ *
+ * Lattice arrays kept for reuse between simulations
+ *
+ * LBM and Fluid objects take their lattice arrays from
+ *	the pool and give them back when destroyed, so the
+ *	next simulation on a domain of the same size gets
+ *	memory that is already allocated and mapped, with no
+ *	page faults. The arrays are page-aligned and, when
+ *	large, backed by huge pages (check parallel.h).
+ *
+ * The pool holds arrays for one domain size - an array
+ *	requested for a domain with a different number of
+ *	nodes frees the kept arrays first, so a new domain
+ *	size doesn't add to the peak memory.
+ *
+ * All objects use the process-wide pool, shared(); it
+ *	is thread safe.
+ *
+ ******************************************************/
+
+class ScratchPool {
+public:
+
+	ScratchPool() = default;
+	ScratchPool(const ScratchPool&) = delete;
+	ScratchPool& operator=(const ScratchPool&) = delete;
+
+	/// Pool used by the LBM and Fluid objects
+	static ScratchPool& shared()
+	{
+		static ScratchPool pool;
+		return pool;
+	}
+
+	/**
+	 * Give vec Nplanes zero planes of Nx*Ny values each
+	 * @details Same as first_touch_resize, does nothing if the array already
+	 *	has the right size; otherwise its current memory goes back to the pool
+	 *	and a kept array is reused if there is one of this size
+	 *
+	 * @param vec - array to allocate
+	 * @param Nx - number of nodes in x direction
+	 * @param Ny - number of rows
+	 * @param Nplanes - number of planes (1 for macroscopic, 9 for distributions)
+	 */
+	template <typename T>
+	void acquire(LatticeVector<T>& vec, const size_t Nx, const size_t Ny, const size_t Nplanes)
+	{
+		const size_t n = Nx*Ny*Nplanes;
+		if (vec.size() == n) {
+			return;
+		}
+		release(vec);
+		{
+			std::lock_guard<std::mutex> lock(pool_mutex);
+			if (Nx*Ny != domain_nodes) {
+				double_arrays.clear();
+				float_arrays.clear();
+				domain_nodes = Nx*Ny;
+			}
+			std::vector<LatticeVector<T>>& kept = arrays(static_cast<T*>(nullptr));
+			for (auto it = kept.begin(); it != kept.end(); ++it) {
+				if (it->size() == n) {
+					vec.swap(*it);
+					kept.erase(it);
+					break;
+				}
+			}
+		}
+		if (vec.empty()) {
+			first_touch_resize(vec, Nx, Ny, Nplanes);
+		} else {
+			slab_fill(vec, Nx, Ny, Nplanes, T());
+		}
+	}
+
+	/// Give the memory of vec to the pool, vec becomes empty
+	/// @details Arrays that don't fit the domain of the pool are freed
+	template <typename T>
+	void release(LatticeVector<T>& vec)
+	{
+		if (vec.empty()) {
+			return;
+		}
+		std::lock_guard<std::mutex> lock(pool_mutex);
+		// Not an array of this domain (e.g. compacted), freed
+		if ((domain_nodes == 0) || (vec.size()%domain_nodes != 0)) {
+			LatticeVector<T>().swap(vec);
+			return;
+		}
+		arrays(static_cast<T*>(nullptr)).emplace_back();
+		arrays(static_cast<T*>(nullptr)).back().swap(vec);
+	}
+
+	/// Free all kept arrays
+	void clear()
+	{
+		std::lock_guard<std::mutex> lock(pool_mutex);
+		double_arrays.clear();
+		float_arrays.clear();
+	}
+
+	/// Memory of the kept arrays in bytes
+	size_t kept_bytes() const
+	{
+		std::lock_guard<std::mutex> lock(pool_mutex);
+		size_t bytes = 0;
+		for (const auto& vec : double_arrays) {
+			bytes += vec.size()*sizeof(double);
+		}
+		for (const auto& vec : float_arrays) {
+			bytes += vec.size()*sizeof(float);
+		}
+		return bytes;
+	}
+
+private:
+	// Number of nodes of the domain of the kept arrays
+	size_t domain_nodes = 0;
+	std::vector<LatticeVector<double>> double_arrays;
+	std::vector<LatticeVector<float>> float_arrays;
+	mutable std::mutex pool_mutex;
+
+	std::vector<LatticeVector<double>>& arrays(double*) { return double_arrays; }
+	std::vector<LatticeVector<float>>& arrays(float*) { return float_arrays; }
+};
+
+/// Same as first_touch_resize, with memory from the shared pool
+template <typename T>
+void pooled_resize(LatticeVector<T>& vec, const size_t Nx, const size_t Ny, const size_t Nplanes)
+{
+	ScratchPool::shared().acquire(vec, Nx, Ny, Nplanes);
+}
+
+#endif
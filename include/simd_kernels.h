@@ -0,0 +1,76 @@
+#ifndef SIMD_KERNELS_H
+#define SIMD_KERNELS_H
+
+#include <string>
+#include <stdexcept>
+#include "lattice.h"
+
+/*****************************************************
+ * Vectorized node kernels
+ *
+ * Kernels over contiguous ranges of nodes of the
+ *	direction-major lattice arrays, with explicit
+ *	AVX-512 (8 nodes per instruction) and AVX2 (4 nodes)
+ *	versions and a portable scalar fallback.
+ *
+ * The version is selected at runtime from the features
+ *	of the CPU, the best one by default. All versions
+ *	perform the same floating point operations in the
+ *	same order, without fused multiply-adds, so the
+ *	results do not depend on the version.
+ *
+ ******************************************************/
+
+/// Instruction sets of the kernels
+enum class SimdLevel { scalar, avx2, avx512 };
+
+/// Best instruction set supported by this CPU (and compiler)
+SimdLevel detect_simd_level();
+
+/// Instruction set currently used by the kernels
+SimdLevel get_simd_level();
+
+/// Select the instruction set used by the kernels
+/// @details Throws std::invalid_argument if not supported by this CPU
+void set_simd_level(const SimdLevel level);
+
+/// Name of an instruction set, for output
+std::string simd_level_name(const SimdLevel level);
+
+/// Weights and coefficients of the D2Q9 equilibrium distribution
+struct EquilibriumCoefficients {
+	double wrt0 = D2Q9<>::w[0], wrt1 = D2Q9<>::w[1], wrt2 = D2Q9<>::w[5];
+	double feq1 = D2Q9<>::feq1, feq2 = D2Q9<>::feq2, feq3 = D2Q9<>::feq3;
+};
+
+/**
+ * Equilibrium distribution of nodes begin to end - 1
+ * @details Same result as Fluid::node_f_equilibrium at each node
+ *
+ * @param coeffs - weights and coefficients of the equilibrium
+ * @param rho - density, Ntot values
+ * @param ux - x velocity component used in the equilibrium, Ntot values
+ * @param uy - y velocity component used in the equilibrium, Ntot values
+ * @param f_eq - output, equilibrium distribution, Ntot*9 values
+ * @param Ntot - number of nodes in the lattice (size of one direction)
+ * @param begin - first node
+ * @param end - one past the last node
+ */
+void simd_f_equilibrium(const EquilibriumCoefficients& coeffs, const double* rho,
+							const double* ux, const double* uy, double* f_eq,
+							const size_t Ntot, const size_t begin, const size_t end);
+
+/**
+ * BGK relaxation of values begin to end - 1 of one array,
+ *	f = (1 - omega)*f + omega*f_eq
+ *
+ * @param f - distribution, updated
+ * @param f_eq - equilibrium distribution at the same positions
+ * @param omega - inverse of the relaxation time
+ * @param begin - first value
+ * @param end - one past the last value
+ */
+void simd_relax(double* f, const double* f_eq, const double omega,
+					const size_t begin, const size_t end);
+
+#endif
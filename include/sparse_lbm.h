@@ -0,0 +1,145 @@
+#ifndef SPARSE_LBM_H
+#define SPARSE_LBM_H
+
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <cstdint>
+#include <limits>
+#include "geometry.h"
+#include "lattice.h"
+#include "array_access.h"
+#include "fluid.h"
+#include "utils.h"
+#include "parallel.h"
+
+/*****************************************************
+ * class: SparseLBM
+ *
+ * LBM time steps on fluid nodes only, for geometries
+ *	with a large fraction of solid nodes (porous media,
+ *	arrays of objects)
+ *
+ * Fluid nodes are numbered in the row-major order of
+ *	the lattice and their values are stored in compact
+ *	arrays - Nfluid values for macroscopic properties,
+ *	Nfluid*9 values, direction by direction, for the
+ *	density distribution. Neighbors and streaming targets
+ *	are precomputed indices into these arrays, so memory
+ *	and time scale with the number of fluid nodes.
+ *
+ * Fluids are initialized as usual and then converted
+ *	with compact(); dense arrays, for output or for
+ *	the LBM class, are restored with expand(). Results
+ *	are identical to the fused LBM::step.
+ *
+ * Loops run in parallel with OpenMP over static blocks
+ *	of fluid nodes (check parallel.h).
+ *
+ ******************************************************/
+
+class Fluid;
+
+class SparseLBM {
+public:
+
+	/// Needs the geometry to number the fluid nodes
+	SparseLBM() = delete;
+
+	/// Constructor: numbers the fluid nodes, builds the compact neighbor
+	///	and streaming tables, and allocates the temporary arrays
+	/// @details The geometry is assumed static
+	SparseLBM(const Geometry& geom);
+
+	//
+	// Storage conversions
+	//
+
+	/**
+	 * Convert an initialized fluid to the compact storage
+	 * @details Keeps the density distribution and, if present, the density
+	 *		and the fluid-solid forces of the fluid nodes; all other arrays
+	 *		are released - until expand(), the fluid can only be used
+	 *		with this object
+	 *
+	 * @param fluid - fluid initialized with the geometry of this object
+	 */
+	void compact(Fluid& fluid) const;
+
+	/// Restore the dense arrays of a compacted fluid - distribution, density,
+	///	and fluid-solid forces; all other arrays are zero initialized
+	/// @details Values in solid nodes are zero, the fluid can be used
+	///		with the Fluid and LBM classes (e.g. compute_macroscopic for output)
+	void expand(Fluid& fluid) const;
+
+	/// Dense Nx*Ny copy of a compact macroscopic property, zero in solid nodes
+	LatticeVector<double> dense_field(const LatticeVector<double>& compact_field) const;
+
+	//
+	// Time steps
+	//
+
+	/// Computes the force from fluid-solid interactions for compacted fluids
+	/// @details Stores it in the fluid objects, compact
+	void compute_solid_surface_force(Fluid&, Fluid&);
+
+	/// Complete time step for a single compacted fluid
+	/// @details Same as LBM::step - collision, volume force, and streaming in one pass
+	void step(Fluid& fluid_1, const std::vector<double>& force);
+
+	/// Complete time step for a two fluid species - two phase system, both compacted
+	/// @details Same as LBM::step - densities in the first pass, everything else in the second;
+	///		compacted densities are stored in the fluids
+	/// @details Fluid-solid forces need to be computed beforehand (compute_solid_surface_force)
+	void step(Fluid& fluid_1, Fluid& fluid_2, const std::vector<double>& force);
+
+	/// Complete time step for a two fluid species - two phase system without a volume force
+	void step(Fluid& fluid_1, Fluid& fluid_2)
+		{ step(fluid_1, fluid_2, no_force); }
+
+	//
+	// Getters
+	//
+
+	/// Number of fluid nodes
+	size_t get_Nfluid() const { return Nfluid; }
+	/// Lattice index of each fluid node, in the order of the compact arrays
+	const std::vector<std::uint32_t>& get_fluid_nodes() const { return fluid_nodes; }
+
+private:
+	// Lattice dimensions and number of fluid nodes
+	size_t Nx = 0, Ny = 0, Ntot = 0, Nfluid = 0;
+	// Number of directions
+	static constexpr size_t Ndir = Lattice::Q;
+	// Zero volume force for steps without external forcing
+	const std::vector<double> no_force = std::vector<double>(Ndir, 0.0);
+	// Marks a solid neighbor in the fluid neighbor table
+	const std::uint32_t no_neighbor = std::numeric_limits<std::uint32_t>::max();
+	// Lattice index of each fluid node
+	std::vector<std::uint32_t> fluid_nodes;
+	// Compact index of the neighbor of each fluid node in each direction,
+	// periodic boundaries included; no_neighbor if the neighbor is solid,
+	// flat array of size Nfluid*9 ordered like the compact distribution
+	LatticeVector<std::uint32_t> fluid_neighbors;
+	// Final position in the compact distribution of the value streamed
+	// from each fluid node in each direction, with bounce-back resolved,
+	// flat array of size Nfluid*9 ordered like the compact distribution
+	LatticeVector<std::uint32_t> stream_targets;
+	// Temporary containers for streaming
+	LatticeVector<double> temp_f_dist;
+ 	LatticeVector<double> temp_f_dist_spare;
+
+	/// Compute the fluid node numbering and the compact tables
+	void build_lattice_tables(const Geometry& geom);
+
+	/// Compact copy of a dense array of Nplanes planes
+	LatticeVector<double> compact_array(const LatticeVector<double>& dense, const size_t Nplanes) const;
+
+	/// Dense copy of a compact array of Nplanes planes, zero in solid nodes
+	LatticeVector<double> dense_array(const LatticeVector<double>& compact, const size_t Nplanes) const;
+
+	/// Throws if the distribution of the fluid is not in the compact storage
+	void check_compact(const Fluid& fluid) const;
+};
+
+#endif
@@ -0,0 +1,230 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <cstddef>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <stdexcept>
+#include "parallel.h"
+
+#if defined(_OPENMP) && defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/*****************************************************
+ * class: ThreadPool
+ *
+ * Persistent workers for the LBM time steps
+ *
+ * Workers are started once and run one task per
+ *	time step, so a step costs no thread startup or
+ *	OpenMP parallel region; barriers inside a task
+ *	are spin barriers.
+ *
+ * Worker 0 is the calling thread. Worker t takes the
+ *	same row slab as OpenMP thread t in the node loops
+ *	of parallel.h, and when OpenMP binds its threads
+ *	(OMP_PROC_BIND, OMP_PLACES) it also gets the CPUs
+ *	of that thread, so it updates the memory pages that
+ *	thread first touched.
+ *
+ * Between tasks workers spin for a short while, then
+ *	sleep until the next task.
+ *
+ ******************************************************/
+
+class ThreadPool {
+public:
+
+	/// Starts nthreads - 1 workers, the calling thread is worker 0
+	explicit ThreadPool(const size_t nthreads) : Nthreads(nthreads)
+	{
+		if (Nthreads < 1) {
+			throw std::invalid_argument("Number of threads needs to be at least 1");
+		}
+		workers.reserve(Nthreads - 1);
+		for (size_t tid = 1; tid < Nthreads; ++tid) {
+			workers.emplace_back(&ThreadPool::worker_loop, this, tid);
+		}
+		bind_to_openmp_places();
+	}
+
+	/// Stops and joins the workers
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(wake_mutex);
+			stopping.store(true, std::memory_order_relaxed);
+			epoch.fetch_add(1, std::memory_order_release);
+		}
+		wake.notify_all();
+		for (auto& worker : workers) {
+			worker.join();
+		}
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	/// Number of workers, the calling thread included
+	size_t size() const { return Nthreads; }
+
+	/**
+	 * Run task(tid) on every worker, tid from 0 to size() - 1
+	 * @details Returns when all workers finished; an exception thrown
+	 *	by any worker is rethrown here, after the others stopped too
+	 *	(at their next barrier or at the end of the task)
+	 * @details Not reentrant - tasks can't call run()
+	 */
+	template <typename Task>
+	void run(Task& task)
+	{
+		if (Nthreads == 1) {
+			task(0);
+			return;
+		}
+		context = &task;
+		invoke = [](void* ctx, const size_t tid) { (*static_cast<Task*>(ctx))(tid); };
+		finished.store(0, std::memory_order_relaxed);
+		{
+			std::lock_guard<std::mutex> lock(wake_mutex);
+			epoch.fetch_add(1, std::memory_order_release);
+		}
+		wake.notify_all();
+		execute(0);
+		for (size_t spin = 0; finished.load(std::memory_order_acquire) < Nthreads - 1; ++spin) {
+			pause(spin);
+		}
+		if (aborted.load(std::memory_order_relaxed)) {
+			// Barrier arrivals of the stopped task
+			barrier_count.store(0, std::memory_order_relaxed);
+			aborted.store(false, std::memory_order_relaxed);
+			std::exception_ptr thrown = nullptr;
+			std::swap(thrown, error);
+			std::rethrow_exception(thrown);
+		}
+	}
+
+	/// Wait until all workers reach this barrier, only inside a task
+	void barrier()
+	{
+		if (Nthreads == 1) {
+			return;
+		}
+		const size_t generation = barrier_generation.load(std::memory_order_acquire);
+		if (barrier_count.fetch_add(1, std::memory_order_acq_rel) + 1 == Nthreads) {
+			barrier_count.store(0, std::memory_order_relaxed);
+			barrier_generation.store(generation + 1, std::memory_order_release);
+			return;
+		}
+		for (size_t spin = 0; barrier_generation.load(std::memory_order_acquire) == generation; ++spin) {
+			if (aborted.load(std::memory_order_relaxed)) {
+				throw Aborted();
+			}
+			pause(spin);
+		}
+	}
+
+private:
+	// Thrown at the barriers of the other workers when one worker throws
+	struct Aborted { };
+	// Busy polls before yielding and before a waiting worker sleeps
+	static constexpr size_t busy_spins = 64;
+	static constexpr size_t idle_spins = 4096;
+
+	size_t Nthreads = 1;
+	std::vector<std::thread> workers;
+	// Current task - type-erased without allocation
+	void* context = nullptr;
+	void (*invoke)(void*, const size_t) = nullptr;
+	// Task count, each new value starts a task (or stops the workers)
+	std::atomic<size_t> epoch{0};
+	std::atomic<size_t> finished{0};
+	std::atomic<bool> stopping{false};
+	std::mutex wake_mutex;
+	std::condition_variable wake;
+	// Spin barrier
+	std::atomic<size_t> barrier_count{0};
+	std::atomic<size_t> barrier_generation{0};
+	// First exception of the current task
+	std::atomic<bool> aborted{false};
+	std::exception_ptr error = nullptr;
+	std::mutex error_mutex;
+
+	/// Polling step - spins first, then yields to the other threads
+	static void pause(const size_t spin)
+	{
+		if (spin >= busy_spins) {
+			std::this_thread::yield();
+		}
+	}
+
+	/// Task of one worker, records the first exception and stops the others
+	void execute(const size_t tid)
+	{
+		try {
+			invoke(context, tid);
+		} catch (const Aborted&) {
+		} catch (...) {
+			std::lock_guard<std::mutex> lock(error_mutex);
+			if (!error) {
+				error = std::current_exception();
+			}
+			aborted.store(true, std::memory_order_relaxed);
+		}
+	}
+
+	/// Wait for tasks and run them until the pool stops
+	void worker_loop(const size_t tid)
+	{
+		size_t seen = 0, current = 0;
+		while (true) {
+			for (size_t spin = 0; (current = epoch.load(std::memory_order_acquire)) == seen; ++spin) {
+				if (spin < idle_spins) {
+					pause(spin);
+				} else {
+					std::unique_lock<std::mutex> lock(wake_mutex);
+					wake.wait(lock, [&]() { return epoch.load(std::memory_order_acquire) != seen; });
+				}
+			}
+			seen = current;
+			if (stopping.load(std::memory_order_relaxed)) {
+				return;
+			}
+			execute(tid);
+			finished.fetch_add(1, std::memory_order_release);
+		}
+	}
+
+	/// Give each worker the CPUs of the OpenMP thread with the same number,
+	/// if OpenMP binds its threads
+	void bind_to_openmp_places()
+	{
+#if defined(_OPENMP) && defined(__linux__)
+		if (omp_get_proc_bind() == omp_proc_bind_false) {
+			return;
+		}
+		std::vector<cpu_set_t> cpus(Nthreads);
+		std::vector<char> bound(Nthreads, 0);
+		#pragma omp parallel num_threads(static_cast<int>(Nthreads))
+		{
+			const size_t tid = static_cast<size_t>(omp_get_thread_num());
+			if (pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpus[tid]) == 0) {
+				bound[tid] = 1;
+			}
+		}
+		for (size_t tid = 1; tid < Nthreads; ++tid) {
+			if (bound[tid]) {
+				pthread_setaffinity_np(workers[tid-1].native_handle(), sizeof(cpu_set_t), &cpus[tid]);
+			}
+		}
+#endif
+	}
+};
+
+#endif
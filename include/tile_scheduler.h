@@ -0,0 +1,177 @@
+#ifndef TILE_SCHEDULER_H
+#define TILE_SCHEDULER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <atomic>
+#include "parallel.h"
+
+/*****************************************************
+ * class: TileScheduler
+ *
+ * Dynamic load balancing of the node loops of the
+ *	fused LBM steps
+ *
+ * A range of rows is split into tiles of whole rows
+ *	with about the same weight each (number of fluid
+ *	nodes). Every worker starts with a deque of
+ *	consecutive tiles of about equal total weight,
+ *	takes tiles from its front, and when it runs out
+ *	steals tiles from the backs of the other deques.
+ *
+ * Deques are ranges of tile numbers, each stored in
+ *	one atomic word, so taking and stealing a tile
+ *	is a single compare-and-swap.
+ *
+ ******************************************************/
+
+class TileScheduler {
+public:
+
+	TileScheduler() = default;
+
+	/**
+	 * Split rows first_row to end_row - 1 into tiles and deal them to the workers
+	 *
+	 * @param row_weights - weight of each row of the lattice
+	 * @param Nx - number of nodes in x direction (row length)
+	 * @param first_row - first row of the range
+	 * @param end_row - one past the last row of the range
+	 * @param nworkers - number of workers
+	 * @param tiles_per_worker - average number of tiles of each worker
+	 */
+	void build(const std::vector<size_t>& row_weights, const size_t Nx, const size_t first_row,
+					const size_t end_row, const size_t nworkers, const size_t tiles_per_worker)
+	{
+		tiles.clear();
+		// Weight before each tile
+		std::vector<size_t> tile_starts;
+		// Empty rows still cost a pass over their nodes
+		size_t total = 0;
+		for (size_t yj = first_row; yj < end_row; ++yj) {
+			total += row_weights.at(yj) + 1;
+		}
+		const size_t Ntiles = nworkers*tiles_per_worker;
+		size_t weight = 0, tile_weight = 0;
+		NodeRange tile;
+		tile.begin = first_row*Nx;
+		for (size_t yj = first_row; yj < end_row; ++yj) {
+			weight += row_weights.at(yj) + 1;
+			tile_weight += row_weights.at(yj) + 1;
+			// Tile ends where the running weight passes the next multiple of total/Ntiles
+			if ((tile_weight*Ntiles >= total) || (yj + 1 == end_row)) {
+				tile.end = (yj + 1)*Nx;
+				tiles.push_back(tile);
+				tile_starts.push_back(weight - tile_weight);
+				tile.begin = tile.end;
+				tile_weight = 0;
+			}
+		}
+		// Worker w starts with the tiles that begin in its share of the weight
+		queue_begin.assign(nworkers, 0);
+		queue_end.assign(nworkers, 0);
+		size_t it = 0;
+		for (size_t w = 0; w < nworkers; ++w) {
+			queue_begin.at(w) = it;
+			while ((it < tiles.size()) && (tile_starts.at(it)*nworkers < (w + 1)*total)) {
+				++it;
+			}
+			queue_end.at(w) = it;
+		}
+		queue_end.at(nworkers - 1) = tiles.size();
+		queues = std::vector<Deque>(nworkers);
+		reset();
+	}
+
+	/// Deal the tiles again before a pass, called outside of the workers' tasks
+	void reset()
+	{
+		for (size_t w = 0; w < queues.size(); ++w) {
+			queues[w].range.store(pack(queue_begin[w], queue_end[w]), std::memory_order_relaxed);
+		}
+	}
+
+	/// Call kernel(tile) for every tile this worker takes, own tiles first
+	/// @details Returns when all deques are empty
+	template <typename TileKernel>
+	void run(const size_t tid, TileKernel kernel)
+	{
+		size_t tile = 0;
+		while (take(queues[tid], tile)) {
+			kernel(tiles[tile]);
+		}
+		// Deques don't grow during a pass, an empty one stays empty
+		for (size_t k = 1; k < queues.size(); ++k) {
+			Deque& victim = queues[(tid + k)%queues.size()];
+			while (steal(victim, tile)) {
+				kernel(tiles[tile]);
+			}
+		}
+	}
+
+	/// Number of tiles
+	size_t size() const { return tiles.size(); }
+	/// Nodes of tile i
+	NodeRange get_tile(const size_t i) const { return tiles.at(i); }
+	/// Tiles initially dealt to worker w, [first, end)
+	NodeRange get_initial_tiles(const size_t w) const
+	{
+		NodeRange range;
+		range.begin = queue_begin.at(w);
+		range.end = queue_end.at(w);
+		return range;
+	}
+
+private:
+	// Deque of worker - front tile number in the upper,
+	// one past the back in the lower 32 bits; padded to a cache line
+	struct Deque {
+		std::atomic<std::uint64_t> range{0};
+		char padding[64 - sizeof(std::atomic<std::uint64_t>)];
+	};
+
+	std::vector<NodeRange> tiles;
+	// Initial deques
+	std::vector<size_t> queue_begin, queue_end;
+	std::vector<Deque> queues;
+
+	static std::uint64_t pack(const size_t front, const size_t back)
+		{ return (static_cast<std::uint64_t>(front) << 32) | static_cast<std::uint64_t>(back); }
+
+	/// Take the front tile of the own deque
+	static bool take(Deque& deque, size_t& tile)
+	{
+		std::uint64_t range = deque.range.load(std::memory_order_relaxed);
+		while (true) {
+			const size_t front = static_cast<size_t>(range >> 32);
+			const size_t back = static_cast<size_t>(range & 0xffffffffu);
+			if (front >= back) {
+				return false;
+			}
+			if (deque.range.compare_exchange_weak(range, pack(front + 1, back), std::memory_order_relaxed)) {
+				tile = front;
+				return true;
+			}
+		}
+	}
+
+	/// Take the back tile of another worker's deque
+	static bool steal(Deque& deque, size_t& tile)
+	{
+		std::uint64_t range = deque.range.load(std::memory_order_relaxed);
+		while (true) {
+			const size_t front = static_cast<size_t>(range >> 32);
+			const size_t back = static_cast<size_t>(range & 0xffffffffu);
+			if (front >= back) {
+				return false;
+			}
+			if (deque.range.compare_exchange_weak(range, pack(front, back - 1), std::memory_order_relaxed)) {
+				tile = back - 1;
+				return true;
+			}
+		}
+	}
+};
+
+#endif
@@ -9,7 +9,8 @@
  *
  * The arrays are flat STL vectors of dimensions
  * Nx*Ny (for macroscopic) and Nx*Ny*9 for the 
- * distribution.
+ * distribution. They are first touched in parallel 
+ * by row slabs (check parallel.h).
  * 
  * First direction (0) is the center, last (8th) is 
  * North-West.
@@ -35,6 +36,20 @@
  *
  ******************************************************/
 
+// Compile-time constants used by reference need a definition
+constexpr size_t Fluid::Ndir;
+
+// Lattice arrays go back to the shared pool
+Fluid::~Fluid()
+{
+	ScratchPool& pool = ScratchPool::shared();
+	for (LatticeVector<double>* vec : {&f_dist, &f_eq_dist, &rho, &ux, &uy, &jx, &jy, &u_eq_x, &u_eq_y,
+			&F_repulsive_x, &F_repulsive_y, &F_solid_x, &F_solid_y}) {
+		pool.release(*vec);
+	}
+	pool.release(f_dist_float);
+}
+
 // 
 // Initialization
 //
@@ -47,17 +62,11 @@ void Fluid::zero_density_ini(const Geometry& geom)
 	Ny = geom.Ny();
 	Ntot = Nx*Ny;
 	// Zero initialize all the macroscopic and intermediate variables
-	rho.resize(Nx*Ny, 0.0);
-	ux.resize(Nx*Ny, 0.0);
-	uy.resize(Nx*Ny, 0.0);
-	u_eq_x.resize(Nx*Ny, 0.0);
-	u_eq_y.resize(Nx*Ny, 0.0);
-	F_repulsive_x.resize(Nx*Ny, 0.0);
-	F_repulsive_y.resize(Nx*Ny, 0.0);
+	pooled_resize(rho, Nx, Ny, 1);
+	allocate_intermediate(true);
 	// Zero-initialized distribution function
-	f_dist.resize(Nx*Ny*Ndir, 0.0);
-	// Zero-initialized equilibrium distribution function
-	f_eq_dist.resize(Nx*Ny*Ndir, 0.0);
+	pooled_resize(f_dist, Nx, Ny, Ndir);
+	invalidate_moments();
 }
 
 // Initialization of density distributions, density and velocity arrays
@@ -68,39 +77,24 @@ void Fluid::simple_ini(const Geometry& geom, const double rho_0, const bool mcmp
 	Ny = geom.Ny();
 	Ntot = Nx*Ny;
 	const double rho_factor = static_cast<double>(Ndir);
-	// Coordinates
-	size_t xi = 0, yi = 0, ind_fi = 0, yfi = 0, dir_i = 0;
 	// Just so they are of the right size
-	rho.resize(Nx*Ny, 0.0);
-	ux.resize(Nx*Ny, 0.0);
-	uy.resize(Nx*Ny, 0.0);
-	// Only for mcmp systems
-	if (mcmp) {
-		u_eq_x.resize(Nx*Ny, 0.0);
-		u_eq_y.resize(Nx*Ny, 0.0);
-		F_repulsive_x.resize(Nx*Ny, 0.0);
-		F_repulsive_y.resize(Nx*Ny, 0.0);
-	}
+	pooled_resize(rho, Nx, Ny, 1);
+	allocate_intermediate(mcmp);
 	// Zero-initialized distribution function
-	f_dist.resize(Nx*Ny*Ndir, 0.0);
-	for (size_t i=0; i<Nx; ++i) {
-		for (size_t j=0; j<Ny; ++j) {
-			xi = i;
-			yi = j;
+	pooled_resize(f_dist, Nx, Ny, Ndir);
+	invalidate_moments();
+	#pragma omp parallel
+	{
+		const NodeRange slab = thread_slab(Nx, Ny);
+		for (size_t ai = slab.begin; ai < slab.end; ++ai) {
 			// If a fluid node, fill out the value in all directions
-			if (geom(xi,yi) == 1) {
+			if (geom(ai) == 1) {
 				for (size_t k=0; k<Ndir; ++k) {
-					dir_i = k;
-					// Size of a row is Nx (and there are Ny rows)
-					yfi = dir_i*Nx*Ny + yi*Nx;
-					ind_fi = yfi + xi;
-					f_dist.at(ind_fi) = rho_0/rho_factor;
+					f_dist.at(ai + k*Ntot) = rho_0/rho_factor;
 				}			
 			} 		
 		}
 	}
-	// Zero-initialized equilibrium distribution function
-	f_eq_dist.resize(Nx*Ny*Ndir, 0.0);
 }
 
 // Initialization of randomly perturbed density distributions
@@ -117,18 +111,12 @@ void Fluid::initialize_randomly_perturbed_density(const Geometry& geom, const do
 	double rho_rand = 0.0;
 	double rand_max = rho_0/1000.0;
 	// Just so they are of the right size
-	rho.resize(Nx*Ny, 0.0);
-	ux.resize(Nx*Ny, 0.0);
-	uy.resize(Nx*Ny, 0.0);
-	// Only for mcmp systems
-	if (mcmp) {
-		u_eq_x.resize(Nx*Ny, 0.0);
-		u_eq_y.resize(Nx*Ny, 0.0);
-		F_repulsive_x.resize(Nx*Ny, 0.0);
-		F_repulsive_y.resize(Nx*Ny, 0.0);
-	}
+	pooled_resize(rho, Nx, Ny, 1);
+	allocate_intermediate(mcmp);
 	// Zero-initialized distribution function
-	f_dist.resize(Nx*Ny*Ndir, 0.0);
+	pooled_resize(f_dist, Nx, Ny, Ndir);
+	invalidate_moments();
+	// Serial - the sequence of random numbers does not depend on the number of threads
 	for (size_t i=0; i<Nx; ++i) {
 		for (size_t j=0; j<Ny; ++j) {
 			xi = i;
@@ -146,137 +134,273 @@ void Fluid::initialize_randomly_perturbed_density(const Geometry& geom, const do
 			} 		
 		}
 	}
-	// Zero-initialized equilibrium distribution function
-	f_eq_dist.resize(Nx*Ny*Ndir, 0.0);
 }
 
 // Compute and store the force components stemming from interactions with solids
-void Fluid::add_surface_forces(const std::vector<double> Fxs, const std::vector<double> Fys)
+void Fluid::add_surface_forces(const LatticeVector<double>& Fxs, const LatticeVector<double>& Fys)
 {
-    std::transform(Fxs.cbegin(), Fxs.cend(), std::back_inserter(F_solid_x),
-                   [this](double el) { return -1.0*this->Gsolid*el; });		
-    std::transform(Fys.cbegin(), Fys.cend(), std::back_inserter(F_solid_y),
-                   [this](double el) { return -1.0*this->Gsolid*el; });
+	// Assigned in place, so repeated calls reuse the arrays; compact (sparse)
+	// forces have one value per fluid node
+	if (Fxs.size() == Nx*Ny) {
+		pooled_resize(F_solid_x, Nx, Ny, 1);
+		pooled_resize(F_solid_y, Nx, Ny, 1);
+	} else {
+		F_solid_x.resize(Fxs.size());
+		F_solid_y.resize(Fys.size());
+	}
+	std::transform(Fxs.cbegin(), Fxs.cend(), F_solid_x.begin(),
+				[this](double el) { return -1.0*this->Gsolid*el; });
+	std::transform(Fys.cbegin(), Fys.cend(), F_solid_y.begin(),
+				[this](double el) { return -1.0*this->Gsolid*el; });
 }
 
 // Initialize vectors and parameters for repulsive interactions
 void Fluid::initialize_fluid_repulsion(const double Gf)
 {
 	Gfluid_repulsion = Gf;	
-	F_repulsive_x.resize(Nx*Ny, 0.0);
-	F_repulsive_y.resize(Nx*Ny, 0.0);
+	if (!lean) {
+		pooled_resize(F_repulsive_x, Nx, Ny, 1);
+		pooled_resize(F_repulsive_y, Nx, Ny, 1);
+	}
+}
+
+// Keep only the arrays used by the fused LBM steps, or all of them
+void Fluid::set_lean_storage(const bool lean_storage)
+{
+	lean = lean_storage;
+	if (lean) {
+		for (LatticeVector<double>* vec : {&f_eq_dist, &ux, &uy, &jx, &jy, &u_eq_x, &u_eq_y,
+											&F_repulsive_x, &F_repulsive_y}) {
+			LatticeVector<double>().swap(*vec);
+		}
+		velocities_current = false;
+		momentum_current = false;
+	} else if (Ntot > 0) {
+		allocate_intermediate(true);
+	}
+}
+
+// Allocate the arrays that lean fluids don't store
+void Fluid::allocate_intermediate(const bool mcmp)
+{
+	if (lean) {
+		return;
+	}
+	pooled_resize(ux, Nx, Ny, 1);
+	pooled_resize(uy, Nx, Ny, 1);
+	// Only for mcmp systems
+	if (mcmp) {
+		pooled_resize(u_eq_x, Nx, Ny, 1);
+		pooled_resize(u_eq_y, Nx, Ny, 1);
+		pooled_resize(F_repulsive_x, Nx, Ny, 1);
+		pooled_resize(F_repulsive_y, Nx, Ny, 1);
+	}
+	// Zero-initialized equilibrium distribution function
+	pooled_resize(f_eq_dist, Nx, Ny, Ndir);
+}
+
+// Release the velocities of a lean fluid after output
+void Fluid::release_velocities()
+{
+	if (lean) {
+		LatticeVector<double>().swap(ux);
+		LatticeVector<double>().swap(uy);
+		velocities_current = false;
+	}
 }
 
 //
 // Macroscopic properties
 // 
 
-// Compute macroscopic density
+// Compute macroscopic density, and the momentum in the same pass
 void Fluid::compute_density()
 {
-	std::fill(rho.begin(), rho.end(), 0.0);
-	for (size_t i=0; i<Ntot; ++i) {
-		for (size_t j=0; j<Ndir; ++j) {
-			rho.at(i) += f_dist.at(j*Ntot+i);
-		}
+	if (rho_current) {
+		return;
 	}
+	// Momentum only if compute_momentum() allocated its arrays
+	const bool with_momentum = !momentum_current && has_momentum_arrays();
+	const MomentArrays moments = moment_arrays(true, with_momentum);
+	#pragma omp parallel
+	{
+		const NodeRange slab = thread_slab(Nx, Ny);
+		compute_moments(moments, Ntot, slab.begin, slab.end);
+	}
+	rho_current = true;
+	momentum_current = momentum_current || with_momentum;
 }
 
-// Compute macroscopic velocities
+// Compute macroscopic velocities, and the moments first if needed
 void Fluid::compute_velocities(const Geometry& geom)
 {
-	std::fill(ux.begin(), ux.end(), 0.0);
-	std::fill(uy.begin(), uy.end(), 0.0);
-	for (size_t i=0; i<Ntot; ++i) {
-		if (geom(i) == 1) {
-			for (size_t j=0; j<Ndir; ++j) {
-				ux.at(i) += f_dist.at(j*Ntot+i)*Cx.at(j); 
-				uy.at(i) += f_dist.at(j*Ntot+i)*Cy.at(j);
+	allocate_velocities();
+	if (velocities_current) {
+		return;
+	}
+	// Density and momentum in one pass, only those out of date; without 
+	// the momentum arrays the momentum goes to the velocity arrays first
+	const bool own_momentum = has_momentum_arrays();
+	const bool with_moments = !rho_current || !momentum_current || !own_momentum;
+	MomentArrays moments = moment_arrays(!rho_current, own_momentum && !momentum_current);
+	if (!own_momentum) {
+		moments.jx = ux.data();
+		moments.jy = uy.data();
+	}
+	// Momentum and velocities may be the same arrays
+	const ArrayPtr<const double> jx_in = array_ptr(own_momentum ? jx : ux);
+	const ArrayPtr<const double> jy_in = array_ptr(own_momentum ? jy : uy);
+	const ArrayPtr<double> ux_out = array_ptr(ux);
+	const ArrayPtr<double> uy_out = array_ptr(uy);
+	const RestrictPtr<const double> rho_in = array_ptr(rho);
+	#pragma omp parallel
+	{
+		const NodeRange slab = thread_slab(Nx, Ny);
+		if (with_moments) {
+			compute_moments(moments, Ntot, slab.begin, slab.end);
+		}
+		for (size_t i=slab.begin; i<slab.end; ++i) {
+			if (geom(i) == 1) {
+				ux_out[i] = jx_in[i]/rho_in[i];
+				uy_out[i] = jy_in[i]/rho_in[i];
+			} else {
+				ux_out[i] = 0.0;
+				uy_out[i] = 0.0;
 			}
-			ux.at(i) /= rho.at(i);
-			uy.at(i) /= rho.at(i);
 		}
 	}	
+	rho_current = true;
+	velocities_current = true;
+	momentum_current = own_momentum;
 }
 
 // Compute density and x and y velocity components
 void Fluid::compute_macroscopic(const Geometry& geom)
 {
-	compute_density();
+	// Both in one pass when out of date
 	compute_velocities(geom);
+	compute_density();
+}
+
+// Compute the momentum, allocated on the first call
+void Fluid::compute_momentum()
+{
+	allocate_momentum();
+	if (momentum_current) {
+		return;
+	}
+	const MomentArrays moments = moment_arrays(false, true);
+	#pragma omp parallel
+	{
+		const NodeRange slab = thread_slab(Nx, Ny);
+		compute_moments(moments, Ntot, slab.begin, slab.end);
+	}
+	momentum_current = true;
+}
+
+// Compute the momentum of two fluids
+void Fluid::compute_momentum(Fluid& fluid_1, Fluid& fluid_2)
+{
+	fluid_1.allocate_momentum();
+	fluid_2.allocate_momentum();
+	// One of them or different lattices - separately
+	if (fluid_1.momentum_current || fluid_2.momentum_current || (fluid_1.Ntot != fluid_2.Ntot)) {
+		fluid_1.compute_momentum();
+		fluid_2.compute_momentum();
+		return;
+	}
+	const MomentArrays moments_1 = fluid_1.moment_arrays(false, true);
+	const MomentArrays moments_2 = fluid_2.moment_arrays(false, true);
+	#pragma omp parallel
+	{
+		const NodeRange slab = thread_slab(fluid_1.Nx, fluid_1.Ny);
+		compute_moments(moments_1, moments_2, fluid_1.Ntot, slab.begin, slab.end);
+	}
+	for (Fluid* fluid : {&fluid_1, &fluid_2}) {
+		fluid->momentum_current = true;
+	}
+}
+
+// Allocate the velocity arrays if they are not (lean fluids)
+void Fluid::allocate_velocities()
+{
+	if ((ux.size() != Ntot) || (uy.size() != Ntot)) {
+		pooled_resize(ux, Nx, Ny, 1);
+		pooled_resize(uy, Nx, Ny, 1);
+		velocities_current = false;
+	}
+}
+
+// Allocate the momentum arrays on first use
+void Fluid::allocate_momentum()
+{
+	if (!has_momentum_arrays()) {
+		pooled_resize(jx, Nx, Ny, 1);
+		pooled_resize(jy, Nx, Ny, 1);
+		momentum_current = false;
+	}
+}
+
+// Distribution and requested outputs for the moment kernels
+MomentArrays Fluid::moment_arrays(const bool with_density, const bool with_momentum)
+{
+	if ((Ntot == 0) || (f_dist.size() != Ntot*Ndir)) {
+		throw std::runtime_error("Fluid distribution needs to be initialized and stored in double precision to compute its moments");
+	}
+	if ((with_density && (rho.size() != Ntot)) || (with_momentum && !has_momentum_arrays())) {
+		throw std::runtime_error("Fluid macroscopic arrays need one value per node to compute the moments");
+	}
+	MomentArrays moments;
+	moments.f = f_dist.data();
+	if (with_density) {
+		moments.rho = rho.data();
+	}
+	if (with_momentum) {
+		moments.jx = jx.data();
+		moments.jy = jy.data();
+	}
+	return moments;
 }
 
 // Compute the equilibrium distribution function
 void Fluid::compute_f_equilibrium(const Geometry& geom)
 {
-	double rt0 = 0.0, rt1 = 0.0, rt2 = 0.0;
-	double ueqxij = 0.0, ueqyij = 0.0, uxsq = 0.0, uysq = 0.0, uxuy5 = 0.0;
-	double uxuy6 = 0.0, uxuy7 = 0.0, uxuy8 = 0.0, usq = 0.0;
-
+	check_equilibrium_arrays(ux, uy);
 	compute_macroscopic(geom);
-	for (size_t ai = 0; ai < Ntot; ++ai) {
-
-		rt0 = wrt0*rho.at(ai);
-		rt1 = wrt1*rho.at(ai);
-	 	rt2 = wrt2*rho.at(ai);
-
-		ueqxij =  ux.at(ai);
-      	ueqyij =  uy.at(ai);
-	    uxsq   =  ueqxij * ueqxij;
-		uysq   =  ueqyij * ueqyij;
-		uxuy5  =  ueqxij +  ueqyij;
-		uxuy6  = -ueqxij +  ueqyij;
-		uxuy7  = -ueqxij - ueqyij;
-		uxuy8  =  ueqxij - ueqyij;
-		usq    =  uxsq + uysq;
-
-		f_eq_dist.at(ai) = rt0*(1.0 - feq3*usq);
-		f_eq_dist.at(ai + Ntot) = rt1*(1.0 + feq1*ueqxij + feq2*uxsq - feq3*usq);
-		f_eq_dist.at(ai + 2*Ntot) = rt1*(1.0 + feq1*ueqyij + feq2*uysq - feq3*usq);
-		f_eq_dist.at(ai + 3*Ntot) = rt1*(1.0 - feq1*ueqxij + feq2*uxsq - feq3*usq);
-		f_eq_dist.at(ai + 4*Ntot) = rt1*(1.0 - feq1*ueqyij + feq2*uysq - feq3*usq);
-		f_eq_dist.at(ai + 5*Ntot) = rt2*(1.0 + feq1*uxuy5 + feq2*uxuy5*uxuy5 - feq3*usq);
-		f_eq_dist.at(ai + 6*Ntot) = rt2*(1.0 + feq1*uxuy6 + feq2*uxuy6*uxuy6 - feq3*usq);
-		f_eq_dist.at(ai + 7*Ntot) = rt2*(1.0 + feq1*uxuy7 + feq2*uxuy7*uxuy7 - feq3*usq);
-		f_eq_dist.at(ai + 8*Ntot) = rt2*(1.0 + feq1*uxuy8 + feq2*uxuy8*uxuy8 - feq3*usq);
+	const EquilibriumCoefficients coeffs;
+	#pragma omp parallel
+	{
+		const NodeRange slab = thread_slab(Nx, Ny);
+		simd_f_equilibrium(coeffs, rho.data(), ux.data(), uy.data(), f_eq_dist.data(), 
+								Ntot, slab.begin, slab.end);
 	}			
 }
 
 // Compute the equilibrium distribution function in a multicomponent - multiphase system
 void Fluid::compute_f_equilibrium()
 {
-	double rt0 = 0.0, rt1 = 0.0, rt2 = 0.0;
-	double ueqxij = 0.0, ueqyij = 0.0, uxsq = 0.0, uysq = 0.0, uxuy5 = 0.0;
-	double uxuy6 = 0.0, uxuy7 = 0.0, uxuy8 = 0.0, usq = 0.0;
-
-	for (size_t ai = 0; ai < Ntot; ++ai) {
-
-		rt0 = wrt0*rho.at(ai);
-		rt1 = wrt1*rho.at(ai);
-	 	rt2 = wrt2*rho.at(ai);
-
-		ueqxij =  u_eq_x.at(ai);
-      	ueqyij =  u_eq_y.at(ai);
-	    uxsq   =  ueqxij * ueqxij;
-		uysq   =  ueqyij * ueqyij;
-		uxuy5  =  ueqxij +  ueqyij;
-		uxuy6  = -ueqxij +  ueqyij;
-		uxuy7  = -ueqxij - ueqyij;
-		uxuy8  =  ueqxij - ueqyij;
-		usq    =  uxsq + uysq;
-
-		f_eq_dist.at(ai) = rt0*(1.0 - feq3*usq);
-		f_eq_dist.at(ai + Ntot) = rt1*(1.0 + feq1*ueqxij + feq2*uxsq - feq3*usq);
-		f_eq_dist.at(ai + 2*Ntot) = rt1*(1.0 + feq1*ueqyij + feq2*uysq - feq3*usq);
-		f_eq_dist.at(ai + 3*Ntot) = rt1*(1.0 - feq1*ueqxij + feq2*uxsq - feq3*usq);
-		f_eq_dist.at(ai + 4*Ntot) = rt1*(1.0 - feq1*ueqyij + feq2*uysq - feq3*usq);
-		f_eq_dist.at(ai + 5*Ntot) = rt2*(1.0 + feq1*uxuy5 + feq2*uxuy5*uxuy5 - feq3*usq);
-		f_eq_dist.at(ai + 6*Ntot) = rt2*(1.0 + feq1*uxuy6 + feq2*uxuy6*uxuy6 - feq3*usq);
-		f_eq_dist.at(ai + 7*Ntot) = rt2*(1.0 + feq1*uxuy7 + feq2*uxuy7*uxuy7 - feq3*usq);
-		f_eq_dist.at(ai + 8*Ntot) = rt2*(1.0 + feq1*uxuy8 + feq2*uxuy8*uxuy8 - feq3*usq);
+	check_equilibrium_arrays(u_eq_x, u_eq_y);
+	const EquilibriumCoefficients coeffs;
+	#pragma omp parallel
+	{
+		const NodeRange slab = thread_slab(Nx, Ny);
+		simd_f_equilibrium(coeffs, rho.data(), u_eq_x.data(), u_eq_y.data(), f_eq_dist.data(), 
+								Ntot, slab.begin, slab.end);
 	}			
 }
 
+// Throws if the arrays used by the equilibrium kernels are not allocated 
+void Fluid::check_equilibrium_arrays(const LatticeVector<double>& u_x, const LatticeVector<double>& u_y) const
+{
+	if (lean) {
+		throw std::runtime_error("Fluid with lean storage has no equilibrium arrays, use the fused LBM steps");
+	}
+	if ((rho.size() < Ntot) || (u_x.size() < Ntot) || (u_y.size() < Ntot) 
+			|| (f_eq_dist.size() < Ntot*Ndir)) {
+		throw std::runtime_error("Fluid arrays need to be initialized before computing the equilibrium distribution");
+	}
+}
+
 //
 // Setters
 //
@@ -297,6 +421,7 @@ void Fluid::restart_from_file(const std::string& fname)
 			std::copy(temp_2D.at(yj).cbegin(), temp_2D.at(yj).cend(), f_dist.begin() + (id*Ntot + yj*Nx));
 		}
  	}
+	invalidate_moments();
 }
 
 //
@@ -304,48 +429,20 @@ void Fluid::restart_from_file(const std::string& fname)
 //
 
 // Save a 2D variable to file
-void Fluid::write_var(const std::vector<double>& variable, const std::string& fname) const
+void Fluid::write_var(const LatticeVector<double>& variable, const std::string& fname) const
 {
-	// Convert to a 2D vector - outer - rows (0 to Ny-1), inner - columns (0 to Nx-1)
-	std::vector<std::vector<double>> temp_2D;
-	std::vector<double> one_row;
-	one_row.resize(Nx, -1.0);
-	size_t ind = 0;
-	for (size_t i=0; i<Nx*Ny; ++i) {
-		// First element of the first row
-		if (i == 0) {
-			one_row.at(ind++) = variable.at(i);
-			continue;
-		}
-		// Last row
-		if (i == Nx*Ny-1) {
-			one_row.at(Nx-1) = variable.at(i);
-			temp_2D.push_back(one_row);
-			continue;
-		}
-		if ((ind > 0) && (ind < Nx)) {
-			// All but the first element of any row
-			one_row.at(ind++) = variable.at(i); 
-		} else {
-			// First element from second row on
-			ind = 0;
-			temp_2D.push_back(one_row);
-			std::fill(one_row.begin(), one_row.end(), -1.0);
-			one_row.at(ind++) = variable.at(i);
-		}
-	}
-	// Write to file
+	// Rows 0 to Ny-1 of Nx columns each, written straight from the flat array
 	std::string delim{" "};
 	bool single_file = true; 
 	std::vector<size_t> dims = {Ny,Nx,0};
 	LbmIO lbm_io(fname, delim, single_file, dims);
-	lbm_io.write_vector(temp_2D);
+	lbm_io.write_flat(variable);
 }
 
 // Save a 3D variable to file
-void Fluid::write_var(const std::vector<double>& variable, const std::string& fname, const bool is_3D) const
+void Fluid::write_var(const LatticeVector<double>& variable, const std::string& fname, const bool is_3D) const
 {
-	std::vector<double> temp(Nx*Ny, -1.0);
+	LatticeVector<double> temp(Nx*Ny, -1.0);
 	for (size_t i=0; i<Ndir; ++i) {
 		std::copy(variable.cbegin() + i*Nx*Ny, variable.cbegin() + (i+1)*Nx*Ny, temp.begin());
 		write_var(temp, fname + "_" + std::to_string(i) + ".txt");
@@ -355,11 +452,12 @@ void Fluid::write_var(const std::vector<double>& variable, const std::string& fn
 void Fluid::save_state(const std::string& frho, const std::string& fux,
                         const std::string& fuy, const int step, const Geometry& geom)
 {
-	compute_density(); 
+	// One pass for all three, skipped if they are up to date
+	compute_macroscopic(geom);
 	write_var(rho, frho + "_" + std::to_string(step) + ".txt");
-	compute_velocities(geom); 
 	write_var(ux, fux + "_" + std::to_string(step) + ".txt");
 	write_var(uy, fuy + "_" + std::to_string(step) + ".txt");
+	release_velocities();
 }
 
 
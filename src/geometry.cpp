@@ -239,6 +239,52 @@ std::vector<std::vector<size_t>> Geometry::create_built_in_object
 	}
 }
 
+//
+// Compact storage
+//
+
+// Node type flags of each node
+std::vector<std::uint8_t> Geometry::node_types() const
+{
+	std::vector<std::uint8_t> types(_Nx*_Ny, solid);
+	size_t xn = 0, yn = 0;
+	for (size_t yi = 0; yi < _Ny; ++yi) {
+		for (size_t xi = 0; xi < _Nx; ++xi) {
+			if (geom.at(yi*_Nx + xi) == 0) {
+				continue;
+			}
+			std::uint8_t type = fluid;
+			if ((xi == 0) || (yi == 0) || (xi + 1 == _Nx) || (yi + 1 == _Ny)) {
+				type |= periodic_edge;
+			}
+			// Neighbors in the eight moving directions, periodic
+			for (int dy = -1; dy <= 1; ++dy) {
+				for (int dx = -1; dx <= 1; ++dx) {
+					xn = (xi + _Nx + dx) % _Nx;
+					yn = (yi + _Ny + dy) % _Ny;
+					if (geom.at(yn*_Nx + xn) == 0) {
+						type |= wall_adjacent;
+					}
+				}
+			}
+			types.at(yi*_Nx + xi) = type;
+		}
+	}
+	return types;
+}
+
+// Fluid nodes as bits 
+std::vector<std::uint64_t> Geometry::fluid_bitmask() const
+{
+	std::vector<std::uint64_t> mask((geom.size() + 63)/64, 0);
+	for (size_t ind = 0; ind < geom.size(); ++ind) {
+		if (geom.at(ind) == 1) {
+			mask.at(ind/64) |= (std::uint64_t(1) << (ind%64));
+		}
+	}
+	return mask;
+}
+
 //
 // I/O
 //
@@ -7,70 +7,110 @@
  *
  ******************************************************/
 
+// Compile-time constants used by reference need a definition
+constexpr size_t LBM::Ndir;
+constexpr size_t LBM::tiles_per_worker;
+constexpr size_t LBM::pad_lead;
+
+namespace {
+	// Distribution values in double precision - stored as they are, or in single 
+	// precision as the deviation from an offset (weight times the reference density)
+	inline double widen(const double stored, const double) 
+		{ return stored; }
+	inline double widen(const float stored, const double offset) 
+		{ return static_cast<double>(stored) + offset; }
+	inline void narrow(double& stored, const double value, const double) 
+		{ stored = value; }
+	inline void narrow(float& stored, const double value, const double offset) 
+		{ stored = static_cast<float>(value - offset); }
+}
+
+// Temporary arrays go back to the shared pool
+LBM::~LBM()
+{
+	ScratchPool& pool = ScratchPool::shared();
+	for (LatticeVector<double>* vec : {&temp_f_dist, &temp_f_dist_spare, &temp_uc_x, &temp_uc_y}) {
+		pool.release(*vec);
+	}
+	pool.release(temp_f_float);
+	pool.release(temp_f_float_spare);
+}
+
 // Initializes a droplet of one fluid in the other fluid 
-void LBM::initialize_droplet(const Geometry& geom, Fluid& bulk, Fluid& droplet, 
+void LBM::initialize_droplet(const Geometry& /*geom*/, Fluid& bulk, Fluid& droplet, 
 								const double rho_bulk, const double rho_droplet,
 								const double rho_b_in_d, const double rho_d_in_b, 
 								const double xc, const double yc, const double radius)
 {
 	// Initialize directly through density distributions
-	std::vector<double>& f_dist_bulk = bulk.get_f_dist();
-	std::vector<double>& f_dist_droplet = droplet.get_f_dist();
+	LatticeVector<double>& f_dist_bulk = bulk.get_f_dist();
+	LatticeVector<double>& f_dist_droplet = droplet.get_f_dist();
+	const RestrictPtr<const std::uint8_t> types = array_ptr(node_type);
 
-	int xi = 0, yj =0;
-	for (size_t ai = 0; ai < Ntot; ++ai) {
-		xi = ai%Nx; 
-		yj = ((ai-xi)/Nx)%Ny;
-		
-		// Skip solid nodes 
-		if (geom(ai) == 0) {
-			continue;
-		}
-
-		// If the point is in the droplet - initialize it with the droplet density set 
-		if (((static_cast<double>(xi) - xc)*(static_cast<double>(xi) - xc) 
-				+ (static_cast<double>(yj) - yc)*(static_cast<double>(yj) - yc)) <= radius*radius) {
-			for (size_t dj = 0; dj < Ndir; ++dj) {
-				// Dissolved density of the bulk fluid inside the droplet					
-				f_dist_bulk.at(ai + dj*Ntot) = rho_b_in_d/Ndir;			
-				// Nominal density of the droplet fluid
-				f_dist_droplet.at(ai + dj*Ntot) = rho_droplet/Ndir;
-			}		
-		} else {
-			for (size_t dj = 0; dj < Ndir; ++dj) {
-				// Nominal density of the bulk fluid					
-				f_dist_bulk.at(ai + dj*Ntot) = rho_bulk/Ndir;			
-				// Dissolved density of the droplet fluid inside the bulk
-				f_dist_droplet.at(ai + dj*Ntot) = rho_d_in_b/Ndir;
+	#pragma omp parallel
+	{
+		const NodeRange slab = thread_slab(Nx, Ny);
+		int xi = 0, yj =0;
+		for (size_t ai = slab.begin; ai < slab.end; ++ai) {
+			xi = ai%Nx; 
+			yj = ((ai-xi)/Nx)%Ny;
+			
+			// Skip solid nodes 
+			if (types[ai] == Geometry::solid) {
+				continue;
 			}
-		} 
+
+			// If the point is in the droplet - initialize it with the droplet density set 
+			if (((static_cast<double>(xi) - xc)*(static_cast<double>(xi) - xc) 
+					+ (static_cast<double>(yj) - yc)*(static_cast<double>(yj) - yc)) <= radius*radius) {
+				for (size_t dj = 0; dj < Ndir; ++dj) {
+					// Dissolved density of the bulk fluid inside the droplet					
+					f_dist_bulk.at(ai + dj*Ntot) = rho_b_in_d/Ndir;			
+					// Nominal density of the droplet fluid
+					f_dist_droplet.at(ai + dj*Ntot) = rho_droplet/Ndir;
+				}		
+			} else {
+				for (size_t dj = 0; dj < Ndir; ++dj) {
+					// Nominal density of the bulk fluid					
+					f_dist_bulk.at(ai + dj*Ntot) = rho_bulk/Ndir;			
+					// Dissolved density of the droplet fluid inside the bulk
+					f_dist_droplet.at(ai + dj*Ntot) = rho_d_in_b/Ndir;
+				}
+			} 
+		}
 	}
+	bulk.invalidate_moments();
+	droplet.invalidate_moments();
 }
 
 // Initializes a rectangular area of one fluid in the other fluid 
-void LBM::initialize_fluid_rectangle(const Geometry& geom, Fluid& bulk, Fluid& droplet, 
+void LBM::initialize_fluid_rectangle(const Geometry& /*geom*/, Fluid& bulk, Fluid& droplet, 
 								const double rho_bulk, const double rho_droplet,
 								const double rho_b_in_d, const double rho_d_in_b, 
 								const double xc, const double yc,
 								const double half_Lx, const double half_Ly)
 {
 	// Initialize directly through density distributions
-	std::vector<double>& f_dist_bulk = bulk.get_f_dist();
-	std::vector<double>& f_dist_droplet = droplet.get_f_dist();
+	LatticeVector<double>& f_dist_bulk = bulk.get_f_dist();
+	LatticeVector<double>& f_dist_droplet = droplet.get_f_dist();
+	const RestrictPtr<const std::uint8_t> types = array_ptr(node_type);
 
 	// First initialize the continuous fluid	
-	for (size_t ai = 0; ai < Ntot; ++ai) {
-		// Skip solid nodes 
-		if (geom(ai) == 0) {
-			continue;
-		}
-		for (size_t dj = 0; dj < Ndir; ++dj) {
-			// Nominal density of the bulk fluid					
-			f_dist_bulk.at(ai + dj*Ntot) = rho_bulk/Ndir;			
-			// Dissolved density of the droplet fluid inside the bulk
-			f_dist_droplet.at(ai + dj*Ntot) = rho_d_in_b/Ndir;
+	#pragma omp parallel
+	{
+		const NodeRange slab = thread_slab(Nx, Ny);
+		for (size_t ai = slab.begin; ai < slab.end; ++ai) {
+			// Skip solid nodes 
+			if (types[ai] == Geometry::solid) {
+				continue;
+			}
+			for (size_t dj = 0; dj < Ndir; ++dj) {
+				// Nominal density of the bulk fluid					
+				f_dist_bulk.at(ai + dj*Ntot) = rho_bulk/Ndir;			
+				// Dissolved density of the droplet fluid inside the bulk
+				f_dist_droplet.at(ai + dj*Ntot) = rho_d_in_b/Ndir;
+			}
 		}
-	 
 	}
 
 	// Then initialize the droplet in a form of a rectangle	
@@ -83,7 +123,7 @@ void LBM::initialize_fluid_rectangle(const Geometry& geom, Fluid& bulk, Fluid& d
 	for (int xi = x0; xi <= xf; ++xi) {
 		for (int yj = y0; yj <= yf; ++yj) {
 			// Skip solid nodes 
-			if (geom(xi, yj) == 0) {
+			if (types[yj*Nx + xi] == Geometry::solid) {
 				continue;
 			}
 			for (size_t dj = 0; dj < Ndir; ++dj) {
@@ -96,176 +136,154 @@ void LBM::initialize_fluid_rectangle(const Geometry& geom, Fluid& bulk, Fluid& d
 
 		} 
 	}
+	bulk.invalidate_moments();
+	droplet.invalidate_moments();
 }
 
 // Computes the force from fluid-solid interactions
-void LBM::compute_solid_surface_force(const Geometry& geom, Fluid& fluid_1, Fluid& fluid_2)
+void LBM::compute_solid_surface_force(const Geometry& /*geom*/, Fluid& fluid_1, Fluid& fluid_2)
 {
 	// Compute the common force components (fixed for stationary solids)
-	std::vector<double> Fxs(Ntot, 0.0);
-	std::vector<double> Fys(Ntot, 0.0);
-	int inei = 0, jnei = 0;
-	int xi = 0, yj =0;
+	LatticeVector<double> Fxs, Fys;
+	pooled_resize(Fxs, Nx, Ny, 1);
+	pooled_resize(Fys, Nx, Ny, 1);
 
-	for (size_t ai = 0; ai < Ntot; ++ai) {
-		xi = ai%Nx; 
-		yj = ((ai-xi)/Nx)%Ny;
-		// Skip solid nodes 
-		if (geom(ai) == 0) {
-			continue;
-		}
-		// All non-stationary lattice directions
-		for (size_t dj = 1; dj < Ndir; ++dj) {
-			// Counting for periodic boundaries
-			if (Cx[dj] > 0) {
-				inei = (xi+Cx[dj] < static_cast<int>(Nx)) ? (xi+Cx[dj]) : 0;
-			} else {
-				inei = (xi+Cx[dj] >= 0) ? (xi+Cx[dj]) : static_cast<int>(Nx)-1;
-			}	
-			if (Cy[dj] > 0) {
-				jnei = (yj+Cy[dj] < static_cast<int>(Ny)) ? (yj+Cy[dj]) : 0;
-			} else {
-				jnei = (yj+Cy[dj] >= 0) ? (yj+Cy[dj]) : static_cast<int>(Ny)-1;
-			}
-			// Force is non-zero only if the neighbor is a solid node
-			if (geom(inei, jnei) == 0) {
-				Fxs.at(ai) += solid_weights.at(dj)*Cx.at(dj);
-				Fys.at(ai) += solid_weights.at(dj)*Cy.at(dj);				
-			} 		
-		}
+	// Force is non-zero only along the links to solid nodes
+	size_t ai = 0, dj = 0;
+	for (const auto& link : bb_links) {
+		ai = link.source%Ntot;
+		dj = link.source/Ntot;
+		Fxs.at(ai) += Lattice::w[dj]*Lattice::cx[dj];
+		Fys.at(ai) += Lattice::w[dj]*Lattice::cy[dj];
 	}
 
 	// Specific values for each fluid
 	fluid_1.add_surface_forces(Fxs, Fys);
 	fluid_2.add_surface_forces(Fxs, Fys);
+	ScratchPool::shared().release(Fxs);
+	ScratchPool::shared().release(Fys);
 }
 
 // Computes the force from the repulsive fluid-fluid interactions for both fluids
-void LBM::compute_fluid_repulsive_interactions(const Geometry& geom, Fluid& fluid_1, Fluid& fluid_2)
+void LBM::compute_fluid_repulsive_interactions(const Geometry& /*geom*/, Fluid& fluid_1, Fluid& fluid_2)
 {
+	check_dense_layout();
+	check_full_storage(fluid_1);
+	check_full_storage(fluid_2);
 	// Compute the x and y force components in one loop for both fluids 
-	std::vector<double>& Fx_1 = fluid_1.get_repulsive_force_x();
-	std::vector<double>& Fy_1 = fluid_1.get_repulsive_force_y();
-	std::vector<double>& Fx_2 = fluid_2.get_repulsive_force_x();
-	std::vector<double>& Fy_2 = fluid_2.get_repulsive_force_y();
-	// Reset the forces first
-	std::fill(Fx_1.begin(), Fx_1.end(), 0.0);
-	std::fill(Fy_1.begin(), Fy_1.end(), 0.0);
-	std::fill(Fx_2.begin(), Fx_2.end(), 0.0);
-	std::fill(Fy_2.begin(), Fy_2.end(), 0.0);
-
+	const RestrictPtr<double> Fx_1 = array_ptr(fluid_1.get_repulsive_force_x());
+	const RestrictPtr<double> Fy_1 = array_ptr(fluid_1.get_repulsive_force_y());
+	const RestrictPtr<double> Fx_2 = array_ptr(fluid_2.get_repulsive_force_x());
+	const RestrictPtr<double> Fy_2 = array_ptr(fluid_2.get_repulsive_force_y());
 	// Assuming the potential is equal to density and the density
 	// is precomputed
-	const std::vector<double>& psi_1 = fluid_1.get_rho();
-    const std::vector<double>& psi_2 = fluid_2.get_rho();
+	const RestrictPtr<const double> psi_1 = array_ptr(static_cast<const Fluid&>(fluid_1).get_rho());
+	const RestrictPtr<const double> psi_2 = array_ptr(static_cast<const Fluid&>(fluid_2).get_rho());
+	const RestrictPtr<const std::uint32_t> neighbors = array_ptr(fluid_neighbors);
+	const RestrictPtr<const std::uint8_t> types = array_ptr(node_type);
 
 	// Interaction potentials
 	const double Gf_1 = -1.0*fluid_1.get_repulsive_g_fluid();
 	const double Gf_2 = -1.0*fluid_2.get_repulsive_g_fluid();
 
-	int inei = 0, jnei = 0, ij = 0;
-	int xi = 0, yj =0;
-
-	for (size_t ai = 0; ai < Ntot; ++ai) {
-		xi = ai%Nx; 
-		yj = ((ai-xi)/Nx)%Ny;
-		// Skip solid nodes 
-		if (geom(ai) == 0) {
-			continue;
-		}
-		// All non-stationary lattice directions
-		for (size_t dj = 1; dj < Ndir; ++dj) {
-			// Counting for periodic boundaries
-			if (Cx[dj] > 0) {
-				inei = (xi+Cx[dj] < static_cast<int>(Nx)) ? (xi+Cx[dj]) : 0;
-			} else {
-				inei = (xi+Cx[dj] >= 0) ? (xi+Cx[dj]) : static_cast<int>(Nx)-1;
-			}	
-			if (Cy[dj] > 0) {
-				jnei = (yj+Cy[dj] < static_cast<int>(Ny)) ? (yj+Cy[dj]) : 0;
-			} else {
-				jnei = (yj+Cy[dj] >= 0) ? (yj+Cy[dj]) : static_cast<int>(Ny)-1;
-			}
+	#pragma omp parallel
+	{
+		const NodeRange slab = active_slab();
+		std::uint32_t ij = 0;
+		for (size_t ai = slab.begin; ai < slab.end; ++ai) {
+			// Reset the forces first
+			Fx_1[ai] = 0.0;
+			Fy_1[ai] = 0.0;
+			Fx_2[ai] = 0.0;
+			Fy_2[ai] = 0.0;
 			// Skip solid nodes 
-			if (geom(inei, jnei) == 0) {
+			if (types[ai] == Geometry::solid) {
 				continue;
 			}
-			// Back to linear index
-			ij = static_cast<size_t>(jnei*Nx + inei);
-			// Compute the forces and accumulate
-			Fx_1.at(ai) += repulsion_weights.at(dj)*Cx.at(dj)*psi_2.at(ij);
-			Fy_1.at(ai) += repulsion_weights.at(dj)*Cy.at(dj)*psi_2.at(ij);
-			Fx_2.at(ai) += repulsion_weights.at(dj)*Cx.at(dj)*psi_1.at(ij);
-			Fy_2.at(ai) += repulsion_weights.at(dj)*Cy.at(dj)*psi_1.at(ij);	
+			// All non-stationary lattice directions
+			for (size_t dj = 1; dj < Ndir; ++dj) {
+				// Skip solid nodes 
+				ij = neighbors[ai + dj*Ntot];
+				if (ij == no_neighbor) {
+					continue;
+				}
+				// Compute the forces and accumulate
+				Fx_1[ai] += Lattice::w[dj]*Lattice::cx[dj]*psi_2[ij];
+				Fy_1[ai] += Lattice::w[dj]*Lattice::cy[dj]*psi_2[ij];
+				Fx_2[ai] += Lattice::w[dj]*Lattice::cx[dj]*psi_1[ij];
+				Fy_2[ai] += Lattice::w[dj]*Lattice::cy[dj]*psi_1[ij];	
+			}
+			Fx_1[ai] *= Gf_1*psi_1[ai];	
+			Fy_1[ai] *= Gf_1*psi_1[ai];
+			Fx_2[ai] *= Gf_2*psi_2[ai];	
+			Fy_2[ai] *= Gf_2*psi_2[ai];
 		}
-		Fx_1.at(ai) *= Gf_1*psi_1.at(ai);	
-		Fy_1.at(ai) *= Gf_1*psi_1.at(ai);
-		Fx_2.at(ai) *= Gf_2*psi_2.at(ai);	
-		Fy_2.at(ai) *= Gf_2*psi_2.at(ai);
 	}
 }
 
 // Calculate the equilibrium velocities
-void LBM::compute_equilibrium_velocities(Geometry& geom, Fluid& fluid_1, Fluid& fluid_2)
+void LBM::compute_equilibrium_velocities(Geometry& /*geom*/, Fluid& fluid_1, Fluid& fluid_2)
 {
+	check_dense_layout();
+	check_full_storage(fluid_1);
+	check_full_storage(fluid_2);
 	// Note --- assumes the macroscopic density is already computed
+	// Momentum - usually computed with the density, otherwise in one pass 
+	// over both distributions
+	Fluid::compute_momentum(fluid_1, fluid_2);
+	const Fluid& fluid_1_in = fluid_1;
+	const Fluid& fluid_2_in = fluid_2;
+
 	const double omega_1 = fluid_1.get_omega();
 	const double inv_omega_1 = 1.0/omega_1;
-	const std::vector<double>& rho_1 = fluid_1.get_rho();
-	const std::vector<double>& f_dist_1 = fluid_1.get_f_dist();
-	std::vector<double>& ux_1 = fluid_1.get_ux();	
-	std::vector<double>& uy_1 = fluid_1.get_uy();
-	std::vector<double>& u_eq_x_1 = fluid_1.get_u_eq_x();	
-	std::vector<double>& u_eq_y_1 = fluid_1.get_u_eq_y();
-	std::vector<double>& F_fr_x_1 = fluid_1.get_repulsive_force_x();
-	std::vector<double>& F_fr_y_1 = fluid_1.get_repulsive_force_y();
-	const std::vector<double>& Fs_x_1 = fluid_1.get_fluid_solid_force_x();
-	const std::vector<double>& Fs_y_1 = fluid_1.get_fluid_solid_force_y();
+	const RestrictPtr<const double> rho_1 = array_ptr(fluid_1_in.get_rho());
+	const RestrictPtr<const double> jx_1 = array_ptr(fluid_1_in.get_momentum_x());
+	const RestrictPtr<const double> jy_1 = array_ptr(fluid_1_in.get_momentum_y());
+	const RestrictPtr<double> u_eq_x_1 = array_ptr(fluid_1.get_u_eq_x());
+	const RestrictPtr<double> u_eq_y_1 = array_ptr(fluid_1.get_u_eq_y());
+	const RestrictPtr<const double> F_fr_x_1 = array_ptr(fluid_1.get_repulsive_force_x());
+	const RestrictPtr<const double> F_fr_y_1 = array_ptr(fluid_1.get_repulsive_force_y());
+	const RestrictPtr<const double> Fs_x_1 = array_ptr(fluid_1.get_fluid_solid_force_x());
+	const RestrictPtr<const double> Fs_y_1 = array_ptr(fluid_1.get_fluid_solid_force_y());
 
 	const double omega_2 = fluid_2.get_omega();
 	const double inv_omega_2 = 1.0/omega_2;
-	const std::vector<double>& rho_2 = fluid_2.get_rho();
-	const std::vector<double>& f_dist_2 = fluid_2.get_f_dist();
-	std::vector<double>& ux_2 = fluid_2.get_ux();	
-	std::vector<double>& uy_2 = fluid_2.get_uy();
-	std::vector<double>& u_eq_x_2 = fluid_2.get_u_eq_x();	
-	std::vector<double>& u_eq_y_2 = fluid_2.get_u_eq_y();
-	std::vector<double>& F_fr_x_2 = fluid_2.get_repulsive_force_x();
-	std::vector<double>& F_fr_y_2 = fluid_2.get_repulsive_force_y();
-	const std::vector<double>& Fs_x_2 = fluid_2.get_fluid_solid_force_x();
-	const std::vector<double>& Fs_y_2 = fluid_2.get_fluid_solid_force_y();
+	const RestrictPtr<const double> rho_2 = array_ptr(fluid_2_in.get_rho());
+	const RestrictPtr<const double> jx_2 = array_ptr(fluid_2_in.get_momentum_x());
+	const RestrictPtr<const double> jy_2 = array_ptr(fluid_2_in.get_momentum_y());
+	const RestrictPtr<double> u_eq_x_2 = array_ptr(fluid_2.get_u_eq_x());
+	const RestrictPtr<double> u_eq_y_2 = array_ptr(fluid_2.get_u_eq_y());
+	const RestrictPtr<const double> F_fr_x_2 = array_ptr(fluid_2.get_repulsive_force_x());
+	const RestrictPtr<const double> F_fr_y_2 = array_ptr(fluid_2.get_repulsive_force_y());
+	const RestrictPtr<const double> Fs_x_2 = array_ptr(fluid_2.get_fluid_solid_force_x());
+	const RestrictPtr<const double> Fs_y_2 = array_ptr(fluid_2.get_fluid_solid_force_y());
+
+	const RestrictPtr<double> uc_x = array_ptr(temp_uc_x);
+	const RestrictPtr<double> uc_y = array_ptr(temp_uc_y);
+	const RestrictPtr<const std::uint8_t> types = array_ptr(node_type);
 
 	// For numeric comparisons
 	const double tol = 1e-16;
 
 	// Compute composite velocity
-	std::fill(ux_1.begin(), ux_1.end(), 0.0);
-	std::fill(uy_1.begin(), uy_1.end(), 0.0);
-	std::fill(ux_2.begin(), ux_2.end(), 0.0);
-	std::fill(uy_2.begin(), uy_2.end(), 0.0);
-
-	for (size_t i=0; i<Ntot; ++i) {
-		if (geom(i) == 1) {
-			// Unweighted (by density) macroscopic velocity
-			for (size_t j=0; j<Ndir; ++j) {
-				ux_1.at(i) += f_dist_1.at(j*Ntot+i)*Cx.at(j); 
-				uy_1.at(i) += f_dist_1.at(j*Ntot+i)*Cy.at(j);
-				ux_2.at(i) += f_dist_2.at(j*Ntot+i)*Cx.at(j); 
-				uy_2.at(i) += f_dist_2.at(j*Ntot+i)*Cy.at(j);
-			}
+	#pragma omp parallel
+	{
+		const NodeRange slab = active_slab();
+		for (size_t i=slab.begin; i<slab.end; ++i) {
+			if (types[i] != Geometry::solid) {
+				// Composite velocity from the momentum (unweighted macroscopic velocity)
+				uc_x[i] = (jx_1[i]*omega_1+jx_2[i]*omega_2)/(rho_1[i]*omega_1+rho_2[i]*omega_2);  
+				uc_y[i] = (jy_1[i]*omega_1+jy_2[i]*omega_2)/(rho_1[i]*omega_1+rho_2[i]*omega_2);
 
-			// Composite velocity
-			temp_uc_x.at(i) = (ux_1.at(i)*omega_1+ux_2.at(i)*omega_2)/(rho_1.at(i)*omega_1+rho_2.at(i)*omega_2);  
-			temp_uc_y.at(i) = (uy_1.at(i)*omega_1+uy_2.at(i)*omega_2)/(rho_1.at(i)*omega_1+rho_2.at(i)*omega_2);
-
-			// Equilibrium velocities
-			if (!equal_floats(rho_1.at(i), 0.0, tol)) {	
-				u_eq_x_1.at(i) = temp_uc_x.at(i) + F_fr_x_1.at(i)*inv_omega_1/rho_1.at(i) + Fs_x_1.at(i)*inv_omega_1;
- 				u_eq_y_1.at(i) = temp_uc_y.at(i) + F_fr_y_1.at(i)*inv_omega_1/rho_1.at(i) + Fs_y_1.at(i)*inv_omega_1;			
-			}
-			if (!equal_floats(rho_2.at(i), 0.0, tol)) {	
-				u_eq_x_2.at(i) = temp_uc_x.at(i) + F_fr_x_2.at(i)*inv_omega_2/rho_2.at(i) + Fs_x_2.at(i)*inv_omega_2;
- 				u_eq_y_2.at(i) = temp_uc_y.at(i) + F_fr_y_2.at(i)*inv_omega_2/rho_2.at(i) + Fs_y_2.at(i)*inv_omega_2;			
+				// Equilibrium velocities
+				if (!equal_floats(rho_1[i], 0.0, tol)) {	
+					u_eq_x_1[i] = uc_x[i] + F_fr_x_1[i]*inv_omega_1/rho_1[i] + Fs_x_1[i]*inv_omega_1;
+ 					u_eq_y_1[i] = uc_y[i] + F_fr_y_1[i]*inv_omega_1/rho_1[i] + Fs_y_1[i]*inv_omega_1;			
+				}
+				if (!equal_floats(rho_2[i], 0.0, tol)) {	
+					u_eq_x_2[i] = uc_x[i] + F_fr_x_2[i]*inv_omega_2/rho_2[i] + Fs_x_2[i]*inv_omega_2;
+ 					u_eq_y_2[i] = uc_y[i] + F_fr_y_2[i]*inv_omega_2/rho_2[i] + Fs_y_2[i]*inv_omega_2;			
+				}
 			}
 		}
 	}
@@ -274,162 +292,1361 @@ void LBM::compute_equilibrium_velocities(Geometry& geom, Fluid& fluid_1, Fluid&
 // Collision step for a single fluid
 void LBM::collide(const Geometry& geom, Fluid& fluid_1)
 {
+	check_double_precision();
+	check_dense_layout();
 	// Equilibrium distribution and arrays
 	fluid_1.compute_f_equilibrium(geom);
-	std::vector<double>& f_dist = fluid_1.get_f_dist();
-	const std::vector<double>& f_eq_dist = fluid_1.get_f_eq_dist();
+	LatticeVector<double>& f_dist = fluid_1.get_f_dist();
+	const LatticeVector<double>& f_eq_dist = fluid_1.get_f_eq_dist();
 	double omega = fluid_1.get_omega();
-	// Collision
-	for (size_t ai = 0; ai < Ntot; ++ai) {
-		for (size_t dj = 0; dj < Ndir; ++dj) {						
-			f_dist.at(ai + dj*Ntot) = (1.0 - omega)*f_dist.at(ai + dj*Ntot) + omega*f_eq_dist.at(ai + dj*Ntot);							
+	// Collision, vectorized direction by direction
+	#pragma omp parallel
+	{
+		const NodeRange slab = active_slab();
+		for (size_t dj = 0; dj < Ndir; ++dj) {
+			simd_relax(f_dist.data() + dj*Ntot, f_eq_dist.data() + dj*Ntot, omega, slab.begin, slab.end);
 		}
 	}
+	fluid_1.invalidate_moments();
 }
 
 // Collision step for two fluids
 void LBM::collide(Fluid& fluid_1, Fluid& fluid_2)
 {
+	check_double_precision();
+	check_dense_layout();
 	// Equilibrium distributions and arrays
 	fluid_1.compute_f_equilibrium();
 	fluid_2.compute_f_equilibrium();
 
-	std::vector<double>& f_dist_1 = fluid_1.get_f_dist();
-	std::vector<double>& f_dist_2 = fluid_2.get_f_dist();
+	LatticeVector<double>& f_dist_1 = fluid_1.get_f_dist();
+	LatticeVector<double>& f_dist_2 = fluid_2.get_f_dist();
 
-	const std::vector<double>& f_eq_dist_1 = fluid_1.get_f_eq_dist();
+	const LatticeVector<double>& f_eq_dist_1 = fluid_1.get_f_eq_dist();
 	double omega_1 = fluid_1.get_omega();
-	const std::vector<double>& f_eq_dist_2 = fluid_2.get_f_eq_dist();
+	const LatticeVector<double>& f_eq_dist_2 = fluid_2.get_f_eq_dist();
 	double omega_2 = fluid_2.get_omega();
 
-	// Collision
-	for (size_t ai = 0; ai < Ntot; ++ai) {
-		for (size_t dj = 0; dj < Ndir; ++dj) {						
-			f_dist_1.at(ai + dj*Ntot) = (1.0 - omega_1)*f_dist_1.at(ai + dj*Ntot) + omega_1*f_eq_dist_1.at(ai + dj*Ntot);							
-			f_dist_2.at(ai + dj*Ntot) = (1.0 - omega_2)*f_dist_2.at(ai + dj*Ntot) + omega_2*f_eq_dist_2.at(ai + dj*Ntot);
+	// Collision, vectorized direction by direction
+	#pragma omp parallel
+	{
+		const NodeRange slab = active_slab();
+		for (size_t dj = 0; dj < Ndir; ++dj) {
+			simd_relax(f_dist_1.data() + dj*Ntot, f_eq_dist_1.data() + dj*Ntot, omega_1, slab.begin, slab.end);
+			simd_relax(f_dist_2.data() + dj*Ntot, f_eq_dist_2.data() + dj*Ntot, omega_2, slab.begin, slab.end);
 		}
 	}
+	fluid_1.invalidate_moments();
+	fluid_2.invalidate_moments();
 }
 
 // Add an external volume force to a single fluid (gravity, pressure drop)
-void LBM::add_volume_force(const Geometry& geom, Fluid& fluid_1, const std::vector<double>& force)
+void LBM::add_volume_force(const Geometry& /*geom*/, Fluid& fluid_1, const std::vector<double>& force)
 {
-	std::vector<double>& f_dist = fluid_1.get_f_dist();
-	for (size_t ai = 0; ai < Ntot; ++ai) {
-		if (geom(ai) == 1) {
-			for (size_t dj = 0; dj < Ndir; ++dj) {						
-				f_dist.at(ai + dj*Ntot) += force.at(dj);							
+	if (force.size() != Ndir) {
+		throw std::invalid_argument("Volume force needs one value per lattice direction");
+	}
+	check_double_precision();
+	check_dense_layout();
+	const RestrictPtr<double> f_dist = array_ptr(fluid_1.get_f_dist());
+	const RestrictPtr<const double> f_force = array_ptr(force);
+	const RestrictPtr<const std::uint8_t> types = array_ptr(node_type);
+	#pragma omp parallel
+	{
+		const NodeRange slab = active_slab();
+		for (size_t ai = slab.begin; ai < slab.end; ++ai) {
+			if (types[ai] != Geometry::solid) {
+				for (size_t dj = 0; dj < Ndir; ++dj) {						
+					f_dist[ai + dj*Ntot] += f_force[dj];
+				}
 			}
 		}
 	}
+	fluid_1.invalidate_moments();
 }
 
 // Add an external volume force to a two species - two fluid system (gravity, pressure drop)
-void LBM::add_volume_force(const Geometry& geom, Fluid& fluid_1, Fluid& fluid_2, const std::vector<double>& force)
+void LBM::add_volume_force(const Geometry& /*geom*/, Fluid& fluid_1, Fluid& fluid_2, const std::vector<double>& force)
 {
-	std::vector<double>& f_dist_1 = fluid_1.get_f_dist();
-	std::vector<double>& f_dist_2 = fluid_2.get_f_dist();
-	for (size_t ai = 0; ai < Ntot; ++ai) {
-		if (geom(ai) == 1) {
-			for (size_t dj = 0; dj < Ndir; ++dj) {						
-				f_dist_1.at(ai + dj*Ntot) += force.at(dj);						
-				f_dist_2.at(ai + dj*Ntot) += force.at(dj);
+	if (force.size() != Ndir) {
+		throw std::invalid_argument("Volume force needs one value per lattice direction");
+	}
+	check_double_precision();
+	check_dense_layout();
+	const RestrictPtr<double> f_dist_1 = array_ptr(fluid_1.get_f_dist());
+	const RestrictPtr<double> f_dist_2 = array_ptr(fluid_2.get_f_dist());
+	const RestrictPtr<const double> f_force = array_ptr(force);
+	const RestrictPtr<const std::uint8_t> types = array_ptr(node_type);
+	#pragma omp parallel
+	{
+		const NodeRange slab = active_slab();
+		for (size_t ai = slab.begin; ai < slab.end; ++ai) {
+			if (types[ai] != Geometry::solid) {
+				for (size_t dj = 0; dj < Ndir; ++dj) {						
+					f_dist_1[ai + dj*Ntot] += f_force[dj];
+					f_dist_2[ai + dj*Ntot] += f_force[dj];
+				}
 			}
 		}
 	}
+	fluid_1.invalidate_moments();
+	fluid_2.invalidate_moments();
 }
 
 // Streaming step for a single phase fluid
-void LBM::stream(const Geometry& geom, Fluid& fluid_1)
+void LBM::stream(const Geometry& /*geom*/, Fluid& fluid_1)
 {
-	std::vector<double>& f_dist = fluid_1.get_f_dist();
-	int ist = 0, jst = 0;
-	int xi = 0, yj =0, ijk_final = 0, bb_ijk_final = 0, ijk_ini = 0;
-	// Stream with boundary conditions
-	for (size_t ai = 0; ai < Ntot; ++ai) {
-		xi = ai%Nx; 
-		yj = ((ai-xi)/Nx)%Ny;
-		// 1 - fluid node, 0 - solid
-		if (geom(ai) == 1) {
-			// Lattice direction 0
-			temp_f_dist.at(ai) = f_dist.at(ai);
-			// Remaining directions
-			for (size_t dj = 1; dj < Ndir; ++dj) {
-				// Counting for periodic boundaries
-				if (Cx[dj] > 0) {
-					ist = (xi+Cx[dj] < static_cast<int>(Nx)) ? (xi+Cx[dj]) : 0;
-				} else {
-					ist = (xi+Cx[dj] >= 0) ? (xi+Cx[dj]) : static_cast<int>(Nx)-1;
-				}	
-				if (Cy[dj] > 0) {
-					jst = (yj+Cy[dj] < static_cast<int>(Ny)) ? (yj+Cy[dj]) : 0;
-				} else {
-					jst = (yj+Cy[dj] >= 0) ? (yj+Cy[dj]) : static_cast<int>(Ny)-1;
-				}
-				// Streaming with bounce-back
-				ijk_ini = static_cast<size_t>(dj*Ntot + yj*Nx + xi);
-				if (geom(ist,jst) == 1) {
-					ijk_final = static_cast<size_t>(dj*Ntot + jst*Nx + ist);
-					temp_f_dist.at(ijk_final) = f_dist.at(ijk_ini);
-				} else {
-					bb_ijk_final = static_cast<size_t>(bb_rules[dj-1]*Ntot + yj*Nx + xi);
-					temp_f_dist.at(bb_ijk_final) = f_dist.at(ijk_ini);	
-				}			
-			}
+	if (streaming == aa_pattern) {
+		throw std::runtime_error("Separate streaming is not available in the aa_pattern mode, use step()");
+	}
+	check_double_precision();
+	check_dense_layout();
+	LatticeVector<double>& f_dist = fluid_1.get_f_dist();
+	const ArrayPtr<const double> f_old = array_ptr(f_dist);
+	const ArrayPtr<double> f_new = array_ptr(temp_f_dist);
+	const RestrictPtr<const BounceBackLink> links = array_ptr(bb_links);
+	#pragma omp parallel
+	{
+		const NodeRange slab = active_slab();
+		// Plain shift - solid nodes hold zeros, values exchanged
+		// with them are corrected next
+		for (size_t dj = 0; dj < Ndir; ++dj) {
+			shift_plane(f_dist, temp_f_dist, dj, slab);
+		}
+		// Bounce-back targets can be shifted from other slabs
+		#pragma omp barrier
+		const NodeRange slab_links = links_of(slab);
+		for (size_t li = slab_links.begin; li < slab_links.end; ++li) {
+			f_new[links[li].target] = f_old[links[li].source];
+			f_new[links[li].solid] = 0.0;
 		}
 	}
 	// Reassign and fill temp with 0s just in case
 	std::swap(temp_f_dist, f_dist);
-	std::fill(temp_f_dist.begin(), temp_f_dist.end(), 0.0);
+	slab_fill(temp_f_dist, Nx, Ny, Ndir, 0.0);
+	fluid_1.invalidate_moments();
 }
 
 // Streaming step for a two fluid species and two phases
-void LBM::stream(const Geometry& geom, Fluid& fluid_1, Fluid& fluid_2)
+void LBM::stream(const Geometry& /*geom*/, Fluid& fluid_1, Fluid& fluid_2)
+{
+	if (streaming == aa_pattern) {
+		throw std::runtime_error("Separate streaming is not available in the aa_pattern mode, use step()");
+	}
+	check_double_precision();
+	check_dense_layout();
+	LatticeVector<double>& f_dist_1 = fluid_1.get_f_dist();
+	LatticeVector<double>& f_dist_2 = fluid_2.get_f_dist();
+	const ArrayPtr<const double> f_old_1 = array_ptr(f_dist_1);
+	const ArrayPtr<const double> f_old_2 = array_ptr(f_dist_2);
+	const ArrayPtr<double> f_new_1 = array_ptr(temp_f_dist);
+	const ArrayPtr<double> f_new_2 = array_ptr(temp_f_dist_spare);
+	const RestrictPtr<const BounceBackLink> links = array_ptr(bb_links);
+	#pragma omp parallel
+	{
+		const NodeRange slab = active_slab();
+		// Plain shift - solid nodes hold zeros, values exchanged
+		// with them are corrected next
+		for (size_t dj = 0; dj < Ndir; ++dj) {
+			shift_plane(f_dist_1, temp_f_dist, dj, slab);
+			shift_plane(f_dist_2, temp_f_dist_spare, dj, slab);
+		}
+		// Bounce-back targets can be shifted from other slabs
+		#pragma omp barrier
+		const NodeRange slab_links = links_of(slab);
+		for (size_t li = slab_links.begin; li < slab_links.end; ++li) {
+			f_new_1[links[li].target] = f_old_1[links[li].source];
+			f_new_2[links[li].target] = f_old_2[links[li].source];
+			f_new_1[links[li].solid] = 0.0;
+			f_new_2[links[li].solid] = 0.0;
+		}
+	}
+	// Reassign and fill temp with 0s just in case
+	std::swap(temp_f_dist, f_dist_1);
+	slab_fill(temp_f_dist, Nx, Ny, Ndir, 0.0);
+	std::swap(temp_f_dist_spare, f_dist_2);
+	slab_fill(temp_f_dist_spare, Nx, Ny, Ndir, 0.0);
+	fluid_1.invalidate_moments();
+	fluid_2.invalidate_moments();
+}
+
+// Move one plane of a range of rows by one link, periodic
+void LBM::shift_plane(const LatticeVector<double>& f_dist, LatticeVector<double>& temp, 
+						const size_t dj, const NodeRange range) const
 {
-	std::vector<double>& f_dist_1 = fluid_1.get_f_dist();
-	std::vector<double>& f_dist_2 = fluid_2.get_f_dist();
+	// Node xi moves to (xi + x_shift)%Nx in row (yj + cy)%Ny
+	const size_t x_shift = (Nx + Lattice::cx[dj])%Nx;
+	const size_t plane = dj*Ntot;
+	size_t row_target = 0;
+	for (size_t row = range.begin; row < range.end; row += Nx) {
+		row_target = ((row/Nx + Ny + Lattice::cy[dj])%Ny)*Nx;
+		auto src = f_dist.cbegin() + plane + row;
+		auto dest = temp.begin() + plane + row_target;
+		std::copy(src, src + (Nx - x_shift), dest + x_shift);
+		std::copy(src + (Nx - x_shift), src + Nx, dest);
+	}
+}
 
-	int ist = 0, jst = 0;
-	int xi = 0, yj =0, ijk_final = 0, bb_ijk_final = 0, ijk_ini = 0;
-	// Stream with boundary conditions
-	for (size_t ai = 0; ai < Ntot; ++ai) {
-		xi = ai%Nx; 
-		yj = ((ai-xi)/Nx)%Ny;
-		// 1 - fluid node, 0 - solid
-		if (geom(ai) == 1) {
-			// Lattice direction 0
-			temp_f_dist.at(ai) = f_dist_1.at(ai);
-			temp_f_dist_spare.at(ai) = f_dist_2.at(ai);
-			// Remaining directions
+// Collision, volume force, and streaming in one pass for a single fluid
+void LBM::step(const Geometry& /*geom*/, Fluid& fluid_1, const std::vector<double>& force)
+{
+	if (force.size() != Ndir) {
+		throw std::invalid_argument("Volume force needs one value per lattice direction");
+	}
+	if (layout == padded) {
+		check_padded(fluid_1);
+		step_padded(fluid_1, fluid_1.get_f_dist(), force);
+	} else if (precision == mixed_precision) {
+		check_single_precision(fluid_1);
+		step_fluid(fluid_1, fluid_1.get_f_dist_float(), temp_f_float, force);
+	} else {
+		step_fluid(fluid_1, fluid_1.get_f_dist(), temp_f_dist, force);
+	}
+	fluid_1.invalidate_moments();
+}
+
+// Single fluid step on distributions stored as Real
+template <typename Real>
+void LBM::step_fluid(Fluid& fluid_1, LatticeVector<Real>& f_dist, 
+						LatticeVector<Real>& temp, const std::vector<double>& force)
+{
+	// Streamed values go to the same lattice in the aa_pattern mode
+	LatticeVector<Real>& f_out = (streaming == aa_pattern) ? f_dist : temp;
+	// Each streaming target is written by exactly one node 
+	ThreadPool& team = workers();
+	prepare_tiles();
+	auto update = [&](const size_t tid)
+	{
+		scheduled_pass(tid, update_tiles, active_slab(tid), [&](const NodeRange range)
+			{ update_fluid_nodes(fluid_1, f_dist, f_out, force, range); });
+	};
+	team.run(update);
+	// Every fluid slot was written, solid slots are still zero
+	if (streaming == aa_pattern) {
+		aa_odd = !aa_odd;
+	} else {
+		std::swap(temp, f_dist);
+	}
+}
+
+// Collision, volume force, and streaming of the fluid nodes in a range, single fluid
+template <typename Real>
+void LBM::update_fluid_nodes(const Fluid& fluid_1, LatticeVector<Real>& f_dist, LatticeVector<Real>& f_out, 
+								const std::vector<double>& force, const NodeRange range) const
+{
+	const ArrayPtr<Real> f = array_ptr(f_dist);
+	const ArrayPtr<Real> f_new = array_ptr(f_out);
+	const RestrictPtr<const double> f_force = array_ptr(force);
+	const RestrictPtr<const std::uint8_t> types = array_ptr(node_type);
+	const double omega = fluid_1.get_omega();
+	// Stored values are deviations from the rest state in single precision
+	double offset[Ndir] = {};
+	for (size_t dj = 0; dj < Ndir; ++dj) {
+		offset[dj] = Lattice::w[dj]*fluid_1.get_reference_density();
+	}
+
+	// Same shifts for all bulk nodes
+	std::ptrdiff_t bulk_read[Ndir] = {}, bulk_write[Ndir] = {};
+	for (size_t dj = 0; dj < Ndir; ++dj) {
+		bulk_read[dj] = bulk_read_shift(dj);
+		bulk_write[dj] = bulk_write_shift(dj);
+	}
+
+	// Collision and streaming of fluid node ai, bulk nodes use the fixed shifts
+	auto update_node = [&](const size_t ai, const bool bulk)
+	{
+		double f_node[Ndir], feq[Ndir];
+		// Moments from a single read of the distribution
+		double rho = 0.0, ux = 0.0, uy = 0.0;
+		for (size_t dj = 0; dj < Ndir; ++dj) {
+			f_node[dj] = widen(f[bulk ? ai + bulk_read[dj] : read_index(ai, dj)], offset[dj]);
+			rho += f_node[dj];
+		}
+		for (size_t dj = 0; dj < Ndir; ++dj) {
+			ux += f_node[dj]*Lattice::cx[dj];
+			uy += f_node[dj]*Lattice::cy[dj];
+		}
+		ux /= rho;
+		uy /= rho;
+
+		// Collision and volume force
+		fluid_1.node_f_equilibrium(rho, ux, uy, feq);
+		for (size_t dj = 0; dj < Ndir; ++dj) {
+			f_node[dj] = (1.0 - omega)*f_node[dj] + omega*feq[dj];
+			f_node[dj] += f_force[dj];
+		}
+
+		// Streaming, with bounce-back resolved in the table for boundary nodes
+		for (size_t dj = 0; dj < Ndir; ++dj) {
+			narrow(f_new[bulk ? ai + bulk_write[dj] : write_index(ai, dj)], f_node[dj], offset[dj]);
+		}
+	};
+
+	for_each_node(range, 
+		[&](const size_t begin, const size_t end) 
+		{
+			#pragma omp simd
+			for (size_t ai = begin; ai < end; ++ai) {
+				update_node(ai, true);
+			}
+		},
+		[&](const size_t ai)
+		{
+			// Solid nodes hold no fluid and stay zero
+			if (types[ai] != Geometry::solid) {
+				update_node(ai, false);
+			}
+		});
+}
+
+// Single fluid step in the padded layout
+void LBM::step_padded(Fluid& fluid_1, LatticeVector<double>& f_dist, const std::vector<double>& force)
+{
+	ThreadPool& team = workers();
+	prepare_tiles();
+	auto update = [&](const size_t tid)
+	{
+		scheduled_pass(tid, update_tiles, active_slab(tid), [&](const NodeRange range)
+			{ update_padded_nodes(fluid_1, f_dist, temp_f_dist, force, range); });
+		// Ghost cells are written by the edge rows of all slabs
+		team.barrier();
+		for (size_t dj = 1 + tid; dj < Ndir; dj += team.size()) {
+			fold_ghosts(temp_f_dist, dj);
+		}
+	};
+	team.run(update);
+	// Every fluid slot was written, solid slots and unused ghost cells are still zero
+	std::swap(temp_f_dist, f_dist);
+}
+
+// Collision, volume force, and streaming of the fluid nodes in a range, padded layout
+void LBM::update_padded_nodes(const Fluid& fluid_1, const LatticeVector<double>& f_dist, 
+								LatticeVector<double>& f_out, const std::vector<double>& force, 
+								const NodeRange range) const
+{
+	const ArrayPtr<const double> f = array_ptr(f_dist);
+	const ArrayPtr<double> f_new = array_ptr(f_out);
+	const RestrictPtr<const double> f_force = array_ptr(force);
+	const RestrictPtr<const std::uint32_t> targets = array_ptr(padded_targets);
+	const RestrictPtr<const std::uint8_t> types = array_ptr(node_type);
+	const double omega = fluid_1.get_omega();
+
+	// Same shifts from the padded position for all nodes, no periodic wrap
+	std::ptrdiff_t read_shift[Ndir] = {}, write_shift[Ndir] = {};
+	for (size_t dj = 0; dj < Ndir; ++dj) {
+		read_shift[dj] = static_cast<std::ptrdiff_t>(dj*padded_plane);
+		write_shift[dj] = read_shift[dj] + Lattice::cx[dj] + Lattice::cy[dj]*static_cast<std::ptrdiff_t>(row_pitch);
+	}
+
+	// Collision and streaming of fluid node ai at padded position pi, 
+	// nodes with solid neighbors use the table
+	auto update_node = [&](const size_t ai, const size_t pi, const bool bulk)
+	{
+		double f_node[Ndir], feq[Ndir];
+		double rho = 0.0, ux = 0.0, uy = 0.0;
+		for (size_t dj = 0; dj < Ndir; ++dj) {
+			f_node[dj] = f[pi + read_shift[dj]];
+			rho += f_node[dj];
+		}
+		for (size_t dj = 0; dj < Ndir; ++dj) {
+			ux += f_node[dj]*Lattice::cx[dj];
+			uy += f_node[dj]*Lattice::cy[dj];
+		}
+		ux /= rho;
+		uy /= rho;
+
+		fluid_1.node_f_equilibrium(rho, ux, uy, feq);
+		for (size_t dj = 0; dj < Ndir; ++dj) {
+			f_node[dj] = (1.0 - omega)*f_node[dj] + omega*feq[dj];
+			f_node[dj] += f_force[dj];
+		}
+
+		for (size_t dj = 0; dj < Ndir; ++dj) {
+			f_new[bulk ? pi + write_shift[dj] : targets[ai + dj*Ntot]] = f_node[dj];
+		}
+	};
+
+	for_each_node(padded_runs, range, 
+		[&](const size_t begin, const size_t end) 
+		{
+			const size_t shift = padded_shift(begin/Nx);
+			#pragma omp simd
+			for (size_t ai = begin; ai < end; ++ai) {
+				update_node(ai, ai + shift, true);
+			}
+		},
+		[&](const size_t ai)
+		{
+			if (types[ai] != Geometry::solid) {
+				update_node(ai, ai + padded_shift(ai/Nx), false);
+			}
+		});
+}
+
+// Copy the ghost cells of direction dj that received streamed values to their periodic images
+void LBM::fold_ghosts(LatticeVector<double>& f_out, const size_t dj) const
+{
+	const ArrayPtr<double> f = array_ptr(f_out);
+	const std::ptrdiff_t plane = static_cast<std::ptrdiff_t>(dj*padded_plane);
+	const std::ptrdiff_t cx = Lattice::cx[dj], cy = Lattice::cy[dj];
+	const std::ptrdiff_t Nx_s = static_cast<std::ptrdiff_t>(Nx), Ny_s = static_cast<std::ptrdiff_t>(Ny);
+	// Edge the values enter through and the ghost cells past the opposite one
+	const std::ptrdiff_t edge_x = (cx > 0) ? 0 : Nx_s - 1, ghost_x = (cx > 0) ? Nx_s : -1;
+	const std::ptrdiff_t edge_y = (cy > 0) ? 0 : Ny_s - 1, ghost_y = (cy > 0) ? Ny_s : -1;
+	// Nodes of the edge row whose source is in the ghost row only, and 
+	// of the edge column whose source is in the ghost column only
+	const std::ptrdiff_t x_first = (cx > 0) ? 1 : 0, x_end = (cx < 0) ? Nx_s - 1 : Nx_s;
+	const std::ptrdiff_t y_first = (cy > 0) ? 1 : 0, y_end = (cy < 0) ? Ny_s - 1 : Ny_s;
+	if (cy != 0) {
+		for (std::ptrdiff_t xi = x_first; xi < x_end; ++xi) {
+			f[plane + padded_index(xi, edge_y)] = f[plane + padded_index(xi, ghost_y)];
+		}
+	}
+	if (cx != 0) {
+		for (std::ptrdiff_t yj = y_first; yj < y_end; ++yj) {
+			f[plane + padded_index(edge_x, yj)] = f[plane + padded_index(ghost_x, yj)];
+		}
+	}
+	// Diagonal through the corner
+	if ((cx != 0) && (cy != 0)) {
+		f[plane + padded_index(edge_x, edge_y)] = f[plane + padded_index(ghost_x, ghost_y)];
+	}
+}
+
+// Two fluid species - two phase time step in two passes over the lattice
+void LBM::step(const Geometry& /*geom*/, Fluid& fluid_1, Fluid& fluid_2, const std::vector<double>& force)
+{
+	if (force.size() != Ndir) {
+		throw std::invalid_argument("Volume force needs one value per lattice direction");
+	}
+	check_dense_layout();
+	if (precision == mixed_precision) {
+		check_single_precision(fluid_1);
+		check_single_precision(fluid_2);
+		step_fluids(fluid_1, fluid_2, fluid_1.get_f_dist_float(), fluid_2.get_f_dist_float(), 
+						temp_f_float, temp_f_float_spare, force);
+	} else {
+		step_fluids(fluid_1, fluid_2, fluid_1.get_f_dist(), fluid_2.get_f_dist(), 
+						temp_f_dist, temp_f_dist_spare, force);
+	}
+	fluid_1.invalidate_moments();
+	fluid_2.invalidate_moments();
+}
+
+// Two fluid step on distributions stored as Real
+template <typename Real>
+void LBM::step_fluids(Fluid& fluid_1, Fluid& fluid_2, 
+						LatticeVector<Real>& f_dist_1, LatticeVector<Real>& f_dist_2, 
+						LatticeVector<Real>& temp_1, LatticeVector<Real>& temp_2, 
+						const std::vector<double>& force)
+{
+	if ((fluid_1.get_fluid_solid_force_x().size() < Ntot) || (fluid_2.get_fluid_solid_force_x().size() < Ntot)) {
+		throw std::runtime_error("Fluid-solid forces need to be computed before the first step");
+	}
+
+	// Streamed values go to the same lattices in the aa_pattern mode
+	LatticeVector<Real>& f_out_1 = (streaming == aa_pattern) ? f_dist_1 : temp_1;
+	LatticeVector<Real>& f_out_2 = (streaming == aa_pattern) ? f_dist_2 : temp_2;
+	LatticeVector<double>& rho_1 = fluid_1.get_rho();
+	LatticeVector<double>& rho_2 = fluid_2.get_rho();
+
+	// Densities are also needed in the rows next to the active ones
+	const size_t rho_begin = (row_begin > 0) ? row_begin - 1 : 0;
+	const size_t rho_end = std::min(row_end + 1, Ny);
+
+	ThreadPool& team = workers();
+	prepare_tiles();
+	auto update = [&](const size_t tid)
+	{
+		// First pass - densities of both fluids, they are also the potentials
+		// for the repulsive interactions with the neighbors
+		scheduled_pass(tid, density_tiles, thread_slab(Nx, rho_begin, rho_end, tid, team.size()), 
+			[&](const NodeRange range)
+			{ fluid_densities(fluid_1, fluid_2, f_dist_1, f_dist_2, rho_1, rho_2, range); });
+		// Neighbor densities from other slabs are needed next
+		team.barrier();
+		// Second pass - everything else node by node
+		scheduled_pass(tid, update_tiles, active_slab(tid), [&](const NodeRange range)
+			{ update_fluids_nodes(fluid_1, fluid_2, f_dist_1, f_dist_2, f_out_1, f_out_2, force, range); });
+	};
+	team.run(update);
+	// Every fluid slot was written, solid slots are still zero
+	if (streaming == aa_pattern) {
+		aa_odd = !aa_odd;
+	} else {
+		std::swap(temp_1, f_dist_1);
+		std::swap(temp_2, f_dist_2);
+	}
+}
+
+// Densities of both fluids at the fluid nodes in a range
+template <typename Real>
+void LBM::fluid_densities(const Fluid& fluid_1, const Fluid& fluid_2, const LatticeVector<Real>& f_dist_1, 
+							const LatticeVector<Real>& f_dist_2, LatticeVector<double>& rho_out_1, 
+							LatticeVector<double>& rho_out_2, const NodeRange range) const
+{
+	const RestrictPtr<const Real> f_1 = array_ptr(f_dist_1);
+	const RestrictPtr<const Real> f_2 = array_ptr(f_dist_2);
+	const RestrictPtr<double> rho_1 = array_ptr(rho_out_1);
+	const RestrictPtr<double> rho_2 = array_ptr(rho_out_2);
+	const RestrictPtr<const std::uint8_t> types = array_ptr(node_type);
+	// Stored values are deviations from the rest state in single precision
+	double offset_1[Ndir] = {}, offset_2[Ndir] = {};
+	std::ptrdiff_t bulk_read[Ndir] = {};
+	for (size_t dj = 0; dj < Ndir; ++dj) {
+		offset_1[dj] = Lattice::w[dj]*fluid_1.get_reference_density();
+		offset_2[dj] = Lattice::w[dj]*fluid_2.get_reference_density();
+		bulk_read[dj] = bulk_read_shift(dj);
+	}
+
+	auto node_density = [&](const size_t ai, const bool bulk)
+	{
+		double rho_node_1 = 0.0, rho_node_2 = 0.0;
+		for (size_t dj = 0; dj < Ndir; ++dj) {
+			const size_t ijk = bulk ? ai + bulk_read[dj] : read_index(ai, dj);
+			rho_node_1 += widen(f_1[ijk], offset_1[dj]);
+			rho_node_2 += widen(f_2[ijk], offset_2[dj]);
+		}
+		rho_1[ai] = rho_node_1;
+		rho_2[ai] = rho_node_2;
+	};
+
+	for_each_node(range,
+		[&](const size_t begin, const size_t end)
+		{
+			#pragma omp simd
+			for (size_t ai = begin; ai < end; ++ai) {
+				node_density(ai, true);
+			}
+		},
+		[&](const size_t ai)
+		{
+			if (types[ai] != Geometry::solid) {
+				node_density(ai, false);
+			}
+		});
+}
+
+// Repulsive forces, collision, volume force, and streaming of the fluid nodes in a range, two fluids
+template <typename Real>
+void LBM::update_fluids_nodes(const Fluid& fluid_1, const Fluid& fluid_2, 
+								LatticeVector<Real>& f_dist_1, LatticeVector<Real>& f_dist_2, 
+								LatticeVector<Real>& f_out_1, LatticeVector<Real>& f_out_2, 
+								const std::vector<double>& force, const NodeRange range) const
+{
+	const RestrictPtr<const double> rho_1 = array_ptr(fluid_1.get_rho());
+	const RestrictPtr<const double> Fs_x_1 = array_ptr(fluid_1.get_fluid_solid_force_x());
+	const RestrictPtr<const double> Fs_y_1 = array_ptr(fluid_1.get_fluid_solid_force_y());
+	const double omega_1 = fluid_1.get_omega();
+	const double inv_omega_1 = 1.0/omega_1;
+	const double Gf_1 = -1.0*fluid_1.get_repulsive_g_fluid();
+
+	const RestrictPtr<const double> rho_2 = array_ptr(fluid_2.get_rho());
+	const RestrictPtr<const double> Fs_x_2 = array_ptr(fluid_2.get_fluid_solid_force_x());
+	const RestrictPtr<const double> Fs_y_2 = array_ptr(fluid_2.get_fluid_solid_force_y());
+	const double omega_2 = fluid_2.get_omega();
+	const double inv_omega_2 = 1.0/omega_2;
+	const double Gf_2 = -1.0*fluid_2.get_repulsive_g_fluid();
+
+	// Output is the same lattice in the aa_pattern mode
+	const ArrayPtr<Real> f_1 = array_ptr(f_dist_1);
+	const ArrayPtr<Real> f_2 = array_ptr(f_dist_2);
+	const ArrayPtr<Real> f_new_1 = array_ptr(f_out_1);
+	const ArrayPtr<Real> f_new_2 = array_ptr(f_out_2);
+	const RestrictPtr<const double> f_force = array_ptr(force);
+	const RestrictPtr<const std::uint32_t> neighbors = array_ptr(fluid_neighbors);
+	const RestrictPtr<const std::uint8_t> types = array_ptr(node_type);
+	const double tol = 1e-16;
+	// Stored values are deviations from the rest state in single precision
+	double offset_1[Ndir] = {}, offset_2[Ndir] = {};
+	for (size_t dj = 0; dj < Ndir; ++dj) {
+		offset_1[dj] = Lattice::w[dj]*fluid_1.get_reference_density();
+		offset_2[dj] = Lattice::w[dj]*fluid_2.get_reference_density();
+	}
+
+	// Same shifts for all bulk nodes
+	std::ptrdiff_t bulk_read[Ndir] = {}, bulk_write[Ndir] = {};
+	for (size_t dj = 0; dj < Ndir; ++dj) {
+		bulk_read[dj] = bulk_read_shift(dj);
+		bulk_write[dj] = bulk_write_shift(dj);
+	}
+
+	// Bulk nodes use the fixed shifts and have only fluid neighbors
+	auto update_node = [&](const size_t ai, const bool bulk)
+	{
+		double f_node_1[Ndir], f_node_2[Ndir], feq[Ndir];
+
+		// Repulsive fluid-fluid forces from the neighbor potentials
+		double Fx_1 = 0.0, Fy_1 = 0.0, Fx_2 = 0.0, Fy_2 = 0.0;
+		for (size_t dj = 1; dj < Ndir; ++dj) {
+			const size_t ij = bulk ? ai + neighbor_offset[dj] : neighbors[ai + dj*Ntot];
+			if (!bulk && (ij == no_neighbor)) {
+				continue;
+			}
+			Fx_1 += Lattice::w[dj]*Lattice::cx[dj]*rho_2[ij];
+			Fy_1 += Lattice::w[dj]*Lattice::cy[dj]*rho_2[ij];
+			Fx_2 += Lattice::w[dj]*Lattice::cx[dj]*rho_1[ij];
+			Fy_2 += Lattice::w[dj]*Lattice::cy[dj]*rho_1[ij];
+		}
+		Fx_1 *= Gf_1*rho_1[ai];
+		Fy_1 *= Gf_1*rho_1[ai];
+		Fx_2 *= Gf_2*rho_2[ai];
+		Fy_2 *= Gf_2*rho_2[ai];
+
+		// Unweighted (by density) macroscopic velocities
+		double jx_1 = 0.0, jy_1 = 0.0, jx_2 = 0.0, jy_2 = 0.0;
+		for (size_t dj = 0; dj < Ndir; ++dj) {
+			const size_t ijk = bulk ? ai + bulk_read[dj] : read_index(ai, dj);
+			f_node_1[dj] = widen(f_1[ijk], offset_1[dj]);
+			f_node_2[dj] = widen(f_2[ijk], offset_2[dj]);
+			jx_1 += f_node_1[dj]*Lattice::cx[dj];
+			jy_1 += f_node_1[dj]*Lattice::cy[dj];
+			jx_2 += f_node_2[dj]*Lattice::cx[dj];
+			jy_2 += f_node_2[dj]*Lattice::cy[dj];
+		}
+
+		// Composite velocity
+		const double uc_x = (jx_1*omega_1+jx_2*omega_2)/(rho_1[ai]*omega_1+rho_2[ai]*omega_2);
+		const double uc_y = (jy_1*omega_1+jy_2*omega_2)/(rho_1[ai]*omega_1+rho_2[ai]*omega_2);
+
+		// Equilibrium velocity, collision, and volume force - first fluid
+		// Forces act only where the fluid is present (selected, not branched)
+		bool has_fluid = !equal_floats(rho_1[ai], 0.0, tol);
+		double u_eq_x = has_fluid ? uc_x + Fx_1*inv_omega_1/rho_1[ai] + Fs_x_1[ai]*inv_omega_1 : uc_x;
+		double u_eq_y = has_fluid ? uc_y + Fy_1*inv_omega_1/rho_1[ai] + Fs_y_1[ai]*inv_omega_1 : uc_y;
+		fluid_1.node_f_equilibrium(rho_1[ai], u_eq_x, u_eq_y, feq);
+		for (size_t dj = 0; dj < Ndir; ++dj) {
+			f_node_1[dj] = (1.0 - omega_1)*f_node_1[dj] + omega_1*feq[dj];
+			f_node_1[dj] += f_force[dj];
+		}
+
+		// Second fluid
+		// Forces act only where the fluid is present (selected, not branched)
+		has_fluid = !equal_floats(rho_2[ai], 0.0, tol);
+		u_eq_x = has_fluid ? uc_x + Fx_2*inv_omega_2/rho_2[ai] + Fs_x_2[ai]*inv_omega_2 : uc_x;
+		u_eq_y = has_fluid ? uc_y + Fy_2*inv_omega_2/rho_2[ai] + Fs_y_2[ai]*inv_omega_2 : uc_y;
+		fluid_2.node_f_equilibrium(rho_2[ai], u_eq_x, u_eq_y, feq);
+		for (size_t dj = 0; dj < Ndir; ++dj) {
+			f_node_2[dj] = (1.0 - omega_2)*f_node_2[dj] + omega_2*feq[dj];
+			f_node_2[dj] += f_force[dj];
+		}
+
+		// Streaming, with bounce-back resolved in the table for boundary nodes
+		for (size_t dj = 0; dj < Ndir; ++dj) {
+			const size_t ijk = bulk ? ai + bulk_write[dj] : write_index(ai, dj);
+			narrow(f_new_1[ijk], f_node_1[dj], offset_1[dj]);
+			narrow(f_new_2[ijk], f_node_2[dj], offset_2[dj]);
+		}
+	};
+
+	for_each_node(range,
+		[&](const size_t begin, const size_t end)
+		{
+			#pragma omp simd
+			for (size_t ai = begin; ai < end; ++ai) {
+				update_node(ai, true);
+			}
+		},
+		[&](const size_t ai)
+		{
+			if (types[ai] != Geometry::solid) {
+				update_node(ai, false);
+			}
+		});
+}
+
+// Single fluid step with a halo exchange overlapped with the interior update
+void LBM::step(const Geometry& /*geom*/, Fluid& fluid_1, const std::vector<double>& force, HaloExchange& halo)
+{
+	if (force.size() != Ndir) {
+		throw std::invalid_argument("Volume force needs one value per lattice direction");
+	}
+	check_overlap();
+	LatticeVector<double>& f_dist = fluid_1.get_f_dist();
+	ThreadPool& team = workers();
+	prepare_tiles();
+	auto update = [&](const size_t tid)
+	{
+		// Boundary strips are split by columns, the interior is scheduled as in step()
+		const NodeRange columns = thread_slab(1, 0, Nx, tid, team.size());
+		timed_pass(tid, [&]()
+			{
+				update_fluid_nodes(fluid_1, f_dist, temp_f_dist, force, row_part(row_begin, columns));
+				if (row_end - 1 > row_begin) {
+					update_fluid_nodes(fluid_1, f_dist, temp_f_dist, force, row_part(row_end - 1, columns));
+				}
+			});
+		team.barrier();
+		// Interior rows don't stream into the rows next to the active ones
+		if (tid == 0) {
+			halo.start_stream_exchange(temp_f_dist);
+		}
+		scheduled_pass(tid, interior_tiles, interior_slab(tid), [&](const NodeRange range)
+			{ update_fluid_nodes(fluid_1, f_dist, temp_f_dist, force, range); });
+	};
+	team.run(update);
+	std::swap(temp_f_dist, f_dist);
+	fluid_1.invalidate_moments();
+}
+
+// Two fluid step with density and streaming halo exchanges overlapped with the interior
+void LBM::step(const Geometry& /*geom*/, Fluid& fluid_1, Fluid& fluid_2, const std::vector<double>& force, 
+					HaloExchange& halo)
+{
+	if (force.size() != Ndir) {
+		throw std::invalid_argument("Volume force needs one value per lattice direction");
+	}
+	if ((fluid_1.get_fluid_solid_force_x().size() < Ntot) || (fluid_2.get_fluid_solid_force_x().size() < Ntot)) {
+		throw std::runtime_error("Fluid-solid forces need to be computed before the first step");
+	}
+	check_overlap();
+	LatticeVector<double>& f_dist_1 = fluid_1.get_f_dist();
+	LatticeVector<double>& f_dist_2 = fluid_2.get_f_dist();
+	LatticeVector<double>& rho_1 = fluid_1.get_rho();
+	LatticeVector<double>& rho_2 = fluid_2.get_rho();
+	ThreadPool& team = workers();
+	prepare_tiles();
+	auto update = [&](const size_t tid)
+	{
+		const NodeRange columns = thread_slab(1, 0, Nx, tid, team.size());
+		const NodeRange interior = interior_slab(tid);
+		// Densities - boundary strips first, the rest while they are sent
+		timed_pass(tid, [&]()
+			{
+				fluid_densities(fluid_1, fluid_2, f_dist_1, f_dist_2, rho_1, rho_2, row_part(row_begin, columns));
+				if (row_end - 1 > row_begin) {
+					fluid_densities(fluid_1, fluid_2, f_dist_1, f_dist_2, rho_1, rho_2, row_part(row_end - 1, columns));
+				}
+			});
+		team.barrier();
+		if (tid == 0) {
+			halo.start_density_exchange(fluid_1, fluid_2);
+		}
+		scheduled_pass(tid, interior_density_tiles, interior, [&](const NodeRange range)
+			{ fluid_densities(fluid_1, fluid_2, f_dist_1, f_dist_2, rho_1, rho_2, range); });
+		if (tid == 0) {
+			halo.finish_density_exchange(fluid_1, fluid_2);
+		}
+		team.barrier();
+		// Update - same order as the single fluid step
+		timed_pass(tid, [&]()
+			{
+				update_fluids_nodes(fluid_1, fluid_2, f_dist_1, f_dist_2, temp_f_dist, temp_f_dist_spare, 
+										force, row_part(row_begin, columns));
+				if (row_end - 1 > row_begin) {
+					update_fluids_nodes(fluid_1, fluid_2, f_dist_1, f_dist_2, temp_f_dist, temp_f_dist_spare, 
+											force, row_part(row_end - 1, columns));
+				}
+			});
+		team.barrier();
+		if (tid == 0) {
+			halo.start_stream_exchange(temp_f_dist, temp_f_dist_spare);
+		}
+		scheduled_pass(tid, interior_tiles, interior, [&](const NodeRange range)
+			{ update_fluids_nodes(fluid_1, fluid_2, f_dist_1, f_dist_2, temp_f_dist, temp_f_dist_spare, 
+									force, range); });
+	};
+	team.run(update);
+	std::swap(temp_f_dist, f_dist_1);
+	std::swap(temp_f_dist_spare, f_dist_2);
+	fluid_1.invalidate_moments();
+	fluid_2.invalidate_moments();
+}
+
+// Several single fluid steps with temporal blocking
+void LBM::advance(const Geometry& geom, Fluid& fluid_1, const std::vector<double>& force, 
+					const size_t nsteps, const size_t depth)
+{
+	if (force.size() != Ndir) {
+		throw std::invalid_argument("Volume force needs one value per lattice direction");
+	}
+	check_blocking(depth);
+	if (precision == mixed_precision) {
+		check_single_precision(fluid_1);
+	}
+	// Too few rows for the wavefront 
+	if (Ny < 3) {
+		for (size_t it = 0; it < nsteps; ++it) {
+			step(geom, fluid_1, force);
+		}
+		return;
+	}
+	for (size_t done = 0; done < nsteps; done += depth) {
+		if (precision == mixed_precision) {
+			advance_fluid(fluid_1, fluid_1.get_f_dist_float(), temp_f_float, force, std::min(depth, nsteps - done));
+		} else {
+			advance_fluid(fluid_1, fluid_1.get_f_dist(), temp_f_dist, force, std::min(depth, nsteps - done));
+		}
+	}
+	fluid_1.invalidate_moments();
+}
+
+// Temporally blocked single fluid steps on distributions stored as Real
+template <typename Real>
+void LBM::advance_fluid(Fluid& fluid_1, LatticeVector<Real>& f_dist, LatticeVector<Real>& temp, 
+							const std::vector<double>& force, const size_t levels)
+{
+	// Step k reads lattice k%2 and streams into the other one; its rows start
+	// at row k and lag 1 row behind step k-1, whose rows next to them are then 
+	// complete; the 2nd row of lag keeps the steps of a wave from sharing rows
+	LatticeVector<Real>* lattices[2] = {&f_dist, &temp};
+	wavefront(levels, 1, 2, 1, 
+		[&](const size_t, const size_t k, const size_t p, const NodeRange columns)
+		{
+			update_fluid_nodes(fluid_1, *lattices[k%2], *lattices[(k+1)%2], force, 
+									row_part((k + p)%Ny, columns));
+		});
+	// Same as after every step of step() 
+	if (levels%2 == 1) {
+		std::swap(temp, f_dist);
+	}
+}
+
+// Several two fluid steps with temporal blocking
+void LBM::advance(const Geometry& geom, Fluid& fluid_1, Fluid& fluid_2, const std::vector<double>& force, 
+					const size_t nsteps, const size_t depth)
+{
+	if (force.size() != Ndir) {
+		throw std::invalid_argument("Volume force needs one value per lattice direction");
+	}
+	if ((fluid_1.get_fluid_solid_force_x().size() < Ntot) || (fluid_2.get_fluid_solid_force_x().size() < Ntot)) {
+		throw std::runtime_error("Fluid-solid forces need to be computed before the first step");
+	}
+	check_blocking(depth);
+	if (precision == mixed_precision) {
+		check_single_precision(fluid_1);
+		check_single_precision(fluid_2);
+	}
+	// Too few rows for the wavefront 
+	if (Ny < 3) {
+		for (size_t it = 0; it < nsteps; ++it) {
+			step(geom, fluid_1, fluid_2, force);
+		}
+		return;
+	}
+	for (size_t done = 0; done < nsteps; done += depth) {
+		if (precision == mixed_precision) {
+			advance_fluids(fluid_1, fluid_2, fluid_1.get_f_dist_float(), fluid_2.get_f_dist_float(), 
+								temp_f_float, temp_f_float_spare, force, std::min(depth, nsteps - done));
+		} else {
+			advance_fluids(fluid_1, fluid_2, fluid_1.get_f_dist(), fluid_2.get_f_dist(), 
+								temp_f_dist, temp_f_dist_spare, force, std::min(depth, nsteps - done));
+		}
+	}
+	fluid_1.invalidate_moments();
+	fluid_2.invalidate_moments();
+}
+
+// Temporally blocked two fluid steps on distributions stored as Real
+template <typename Real>
+void LBM::advance_fluids(Fluid& fluid_1, Fluid& fluid_2, LatticeVector<Real>& f_dist_1, 
+							LatticeVector<Real>& f_dist_2, LatticeVector<Real>& temp_1, 
+							LatticeVector<Real>& temp_2, const std::vector<double>& force, 
+							const size_t levels)
+{
+	// Same as the single fluid, but a row of step k also needs the densities 
+	// of its neighbors, which need complete distributions 2 rows away - step k 
+	// starts at row 2k and lags 2 rows behind step k-1, and 1 more row keeps 
+	// the steps of a wave from sharing rows, densities included; 
+	// first pass computes the densities 1 row ahead, second pass updates the rows
+	LatticeVector<double>& rho_1 = fluid_1.get_rho();
+	LatticeVector<double>& rho_2 = fluid_2.get_rho();
+	LatticeVector<Real>* lattices_1[2] = {&f_dist_1, &temp_1};
+	LatticeVector<Real>* lattices_2[2] = {&f_dist_2, &temp_2};
+	wavefront(levels, 2, 3, 2, 
+		[&](const size_t phase, const size_t k, const size_t p, const NodeRange columns)
+		{
+			const size_t yj = (2*k + p)%Ny;
+			LatticeVector<Real>& f_1 = *lattices_1[k%2];
+			LatticeVector<Real>& f_2 = *lattices_2[k%2];
+			if (phase == 0) {
+				// First row of a step also needs its own and previous densities, 
+				// the last two rows already have all of them
+				if (p == 0) {
+					fluid_densities(fluid_1, fluid_2, f_1, f_2, rho_1, rho_2, row_part((yj + Ny - 1)%Ny, columns));
+					fluid_densities(fluid_1, fluid_2, f_1, f_2, rho_1, rho_2, row_part(yj, columns));
+				}
+				if (p + 2 < Ny) {
+					fluid_densities(fluid_1, fluid_2, f_1, f_2, rho_1, rho_2, row_part((yj + 1)%Ny, columns));
+				}
+			} else {
+				update_fluids_nodes(fluid_1, fluid_2, f_1, f_2, *lattices_1[(k+1)%2], 
+										*lattices_2[(k+1)%2], force, row_part(yj, columns));
+			}
+		});
+	if (levels%2 == 1) {
+		std::swap(temp_1, f_dist_1);
+		std::swap(temp_2, f_dist_2);
+	}
+}
+
+// Restrict the collision and streaming operations to a range of rows
+void LBM::set_active_rows(const size_t first_row, const size_t end_row)
+{
+	if ((first_row >= end_row) || (end_row > Ny)) {
+		throw std::invalid_argument("Active rows need to be a non-empty range within the lattice");
+	}
+	row_begin = first_row;
+	row_end = end_row;
+}
+
+// Finish the in-place streaming of the last aa_pattern step for a single fluid
+void LBM::synchronize(const Geometry& /*geom*/, Fluid& fluid_1)
+{
+	if (!aa_odd) {
+		return;
+	}
+	if (precision == mixed_precision) {
+		swap_links(fluid_1.get_f_dist_float());
+	} else {
+		swap_links(fluid_1.get_f_dist());
+	}
+	aa_odd = false;
+	fluid_1.invalidate_moments();
+}
+
+// Finish the in-place streaming of the last aa_pattern step for two fluids
+void LBM::synchronize(const Geometry& /*geom*/, Fluid& fluid_1, Fluid& fluid_2)
+{
+	if (!aa_odd) {
+		return;
+	}
+	if (precision == mixed_precision) {
+		swap_links(fluid_1.get_f_dist_float());
+		swap_links(fluid_2.get_f_dist_float());
+	} else {
+		swap_links(fluid_1.get_f_dist());
+		swap_links(fluid_2.get_f_dist());
+	}
+	aa_odd = false;
+	fluid_1.invalidate_moments();
+	fluid_2.invalidate_moments();
+}
+
+// Swap the values on each fluid-fluid link to finish in-place streaming
+template <typename Real>
+void LBM::swap_links(LatticeVector<Real>& f_dist)
+{
+	// After an odd number of steps the value leaving a node in direction dj is in its opposite 
+	// slot; each link is swapped once, from the node it points away from; values 
+	// bounced back from solids are already in place
+	const size_t half_directions[4] = {1, 2, 5, 6};
+	const ArrayPtr<Real> f = array_ptr(f_dist);
+	const RestrictPtr<const std::uint32_t> neighbors = array_ptr(fluid_neighbors);
+	const RestrictPtr<const std::uint8_t> types = array_ptr(node_type);
+	#pragma omp parallel
+	{
+		const NodeRange slab = active_slab();
+		std::uint32_t ij = 0;
+		for (size_t ai = slab.begin; ai < slab.end; ++ai) {
+			if (types[ai] == Geometry::solid) {
+				continue;
+			}
+			for (const size_t dj : half_directions) {
+				ij = neighbors[ai + dj*Ntot];
+				if (ij == no_neighbor) {
+					continue;
+				}
+				std::swap(f[ai + Lattice::opposite[dj]*Ntot], f[ij + dj*Ntot]);
+			}
+		}
+	}
+}
+
+//
+// Mixed precision storage
+//
+
+// Store the distribution of an initialized fluid in single precision
+void LBM::compress(const Geometry& /*geom*/, Fluid& fluid_1, const bool deviation)
+{
+	if (precision != mixed_precision) {
+		throw std::runtime_error("Single precision storage needs the mixed_precision mode");
+	}
+	LatticeVector<double>& f_dist = fluid_1.get_f_dist();
+	if (f_dist.size() != Ntot*Ndir) {
+		throw std::invalid_argument("Fluid needs to be initialized with the geometry of this LBM");
+	}
+
+	const RestrictPtr<const std::uint8_t> types = array_ptr(node_type);
+
+	// Reference density - mean density of the fluid nodes
+	double rho_ref = 0.0;
+	if (deviation) {
+		double rho_sum = 0.0;
+		size_t Nfluid = 0;
+		#pragma omp parallel reduction(+:rho_sum, Nfluid)
+		{
+			const NodeRange slab = thread_slab(Nx, Ny);
+			for (size_t ai = slab.begin; ai < slab.end; ++ai) {
+				if (types[ai] != Geometry::solid) {
+					for (size_t dj = 0; dj < Ndir; ++dj) {
+						rho_sum += f_dist[ai + dj*Ntot];
+					}
+					++Nfluid;
+				}
+			}
+		}
+		rho_ref = (Nfluid > 0) ? rho_sum/Nfluid : 0.0;
+	}
+
+	// Solid slots stay zero
+	LatticeVector<float>& f_float = fluid_1.get_f_dist_float();
+	pooled_resize(f_float, Nx, Ny, Ndir);
+	#pragma omp parallel
+	{
+		const NodeRange slab = thread_slab(Nx, Ny);
+		for (size_t ai = slab.begin; ai < slab.end; ++ai) {
+			if (types[ai] != Geometry::solid) {
+				for (size_t dj = 0; dj < Ndir; ++dj) {
+					narrow(f_float[ai + dj*Ntot], f_dist[ai + dj*Ntot], Lattice::w[dj]*rho_ref);
+				}
+			}
+		}
+	}
+	fluid_1.set_reference_density(rho_ref);
+	LatticeVector<double>().swap(f_dist);
+	LatticeVector<double>().swap(fluid_1.get_f_eq_dist());
+	fluid_1.invalidate_moments();
+}
+
+// Restore the double precision distribution of a compressed fluid
+void LBM::expand(const Geometry& /*geom*/, Fluid& fluid_1)
+{
+	check_single_precision(fluid_1);
+	const LatticeVector<float>& f_float = fluid_1.get_f_dist_float();
+	const double rho_ref = fluid_1.get_reference_density();
+	LatticeVector<double>& f_dist = fluid_1.get_f_dist();
+	pooled_resize(f_dist, Nx, Ny, Ndir);
+	const RestrictPtr<const std::uint8_t> types = array_ptr(node_type);
+
+	#pragma omp parallel
+	{
+		const NodeRange slab = thread_slab(Nx, Ny);
+		for (size_t ai = slab.begin; ai < slab.end; ++ai) {
+			if (types[ai] != Geometry::solid) {
+				for (size_t dj = 0; dj < Ndir; ++dj) {
+					f_dist[ai + dj*Ntot] = widen(f_float[ai + dj*Ntot], Lattice::w[dj]*rho_ref);
+				}
+			}
+		}
+	}
+	if (!fluid_1.is_lean()) {
+		pooled_resize(fluid_1.get_f_eq_dist(), Nx, Ny, Ndir);
+	}
+	LatticeVector<float>().swap(fluid_1.get_f_dist_float());
+	fluid_1.set_reference_density(0.0);
+	fluid_1.invalidate_moments();
+}
+
+//
+// Padded layout
+//
+
+// Copy the distribution of an initialized fluid to the padded layout
+void LBM::pad(const Geometry& /*geom*/, Fluid& fluid_1)
+{
+	if (layout != padded) {
+		throw std::runtime_error("Padded storage needs the padded layout");
+	}
+	LatticeVector<double>& f_dist = fluid_1.get_f_dist();
+	if (f_dist.size() != Ntot*Ndir) {
+		throw std::invalid_argument("Fluid needs to be initialized with the geometry of this LBM");
+	}
+
+	// Ghost cells and the ends of the rows stay zero
+	LatticeVector<double> f_padded;
+	first_touch_resize(f_padded, row_pitch, Ny + 2, Ndir);
+	#pragma omp parallel
+	{
+		const NodeRange slab = thread_slab(Nx, Ny);
+		for (size_t dj = 0; dj < Ndir; ++dj) {
+			for (size_t row = slab.begin; row < slab.end; row += Nx) {
+				std::copy(f_dist.cbegin() + dj*Ntot + row, f_dist.cbegin() + dj*Ntot + row + Nx, 
+							f_padded.begin() + dj*padded_plane + row + padded_shift(row/Nx));
+			}
+		}
+	}
+	ScratchPool::shared().release(f_dist);
+	f_dist.swap(f_padded);
+	ScratchPool::shared().release(fluid_1.get_f_eq_dist());
+	fluid_1.invalidate_moments();
+}
+
+// Restore the dense distribution of a padded fluid
+void LBM::unpad(const Geometry& /*geom*/, Fluid& fluid_1)
+{
+	check_padded(fluid_1);
+	LatticeVector<double>& f_padded = fluid_1.get_f_dist();
+	LatticeVector<double> f_dist;
+	pooled_resize(f_dist, Nx, Ny, Ndir);
+	#pragma omp parallel
+	{
+		const NodeRange slab = thread_slab(Nx, Ny);
+		for (size_t dj = 0; dj < Ndir; ++dj) {
+			for (size_t row = slab.begin; row < slab.end; row += Nx) {
+				auto src = f_padded.cbegin() + dj*padded_plane + row + padded_shift(row/Nx);
+				std::copy(src, src + Nx, f_dist.begin() + dj*Ntot + row);
+			}
+		}
+	}
+	f_padded.swap(f_dist);
+	LatticeVector<double>().swap(f_dist);
+	if (!fluid_1.is_lean()) {
+		pooled_resize(fluid_1.get_f_eq_dist(), Nx, Ny, Ndir);
+	}
+	fluid_1.invalidate_moments();
+}
+
+// Throws if temporal blocking is not available in this configuration
+void LBM::check_blocking(const size_t depth) const
+{
+	if (depth == 0) {
+		throw std::invalid_argument("Temporal blocking needs at least one step per wavefront");
+	}
+	if (streaming == aa_pattern) {
+		throw std::runtime_error("Temporal blocking is not available in the aa_pattern mode, use step()");
+	}
+	if ((row_begin != 0) || (row_end != Ny)) {
+		throw std::runtime_error("Temporal blocking needs all rows active");
+	}
+	check_dense_layout();
+}
+
+// Build the tiles for the current workers and active rows if needed, and deal them
+void LBM::prepare_tiles()
+{
+	if (schedule != work_stealing) {
+		return;
+	}
+	const std::array<size_t, 3> key = {{pool->size(), row_begin, row_end}};
+	if (key != tiles_key) {
+		// Weight of a row is its number of fluid nodes
+		std::vector<size_t> row_weights(Ny, 0);
+		for (size_t ai = 0; ai < Ntot; ++ai) {
+			if (node_type[ai] != Geometry::solid) {
+				++row_weights[ai/Nx];
+			}
+		}
+		// Densities are also needed in the rows next to the active ones
+		const size_t rho_begin = (row_begin > 0) ? row_begin - 1 : 0;
+		const size_t rho_end = std::min(row_end + 1, Ny);
+		// Boundary strips are the first and the last active row
+		const size_t interior_begin = row_begin + 1;
+		const size_t interior_end = std::max(interior_begin, row_end - 1);
+		update_tiles.build(row_weights, Nx, row_begin, row_end, pool->size(), tiles_per_worker);
+		density_tiles.build(row_weights, Nx, rho_begin, rho_end, pool->size(), tiles_per_worker);
+		interior_tiles.build(row_weights, Nx, interior_begin, interior_end, pool->size(), tiles_per_worker);
+		interior_density_tiles.build(row_weights, Nx, interior_begin, interior_end, pool->size(), tiles_per_worker);
+		tiles_key = key;
+	} else {
+		update_tiles.reset();
+		density_tiles.reset();
+		interior_tiles.reset();
+		interior_density_tiles.reset();
+	}
+}
+
+// Throws if the overlapped halo exchange is not available in this configuration
+void LBM::check_overlap() const
+{
+	if ((streaming == aa_pattern) || (precision == mixed_precision)) {
+		throw std::runtime_error("Overlapped halo exchange needs the two_lattice mode and double precision");
+	}
+	check_dense_layout();
+}
+
+// Throws if the separate operations are not available in this mode
+void LBM::check_double_precision() const
+{
+	if (precision == mixed_precision) {
+		throw std::runtime_error("Separate operations are not available in the mixed_precision mode, use step()");
+	}
+}
+
+// Throws if a fluid was not compressed for the mixed_precision steps
+void LBM::check_single_precision(const Fluid& fluid_1) const
+{
+	if (fluid_1.get_f_dist_float().size() != Ntot*Ndir) {
+		throw std::runtime_error("Fluid needs to be compressed to single precision before the first step");
+	}
+}
+
+// Throws if an operation other than the single fluid step is used in the padded layout
+void LBM::check_dense_layout() const
+{
+	if (layout == padded) {
+		throw std::runtime_error("Only the single fluid step() is available in the padded layout");
+	}
+}
+
+// Throws if a fluid was not padded for the padded layout steps
+void LBM::check_padded(const Fluid& fluid_1) const
+{
+	if (fluid_1.get_f_dist().size() != padded_plane*Ndir) {
+		throw std::runtime_error("Fluid needs to be padded before the first step in the padded layout");
+	}
+	if ((row_begin != 0) || (row_end != Ny)) {
+		throw std::runtime_error("Steps in the padded layout need all rows active");
+	}
+}
+
+// Throws if a fluid doesn't store the arrays of the separate operations
+void LBM::check_full_storage(const Fluid& fluid_1) const
+{
+	if (fluid_1.is_lean()) {
+		throw std::runtime_error("Separate operations need fluids with full storage, lean fluids are advanced with step()");
+	}
+}
+
+// Compute the node types, neighbor and streaming tables for a static geometry
+void LBM::build_lattice_tables(const Geometry& geom)
+{
+	if (Ntot*Ndir >= static_cast<size_t>(no_neighbor)) {
+		throw std::runtime_error("Domain too large for 32-bit lattice tables");
+	}
+
+	// Tables are read in the same row slabs as the distributions
+	first_touch_resize(fluid_neighbors, Nx, Ny, Ndir);
+	first_touch_resize(stream_targets, Nx, Ny, Ndir);
+	first_touch_resize(node_type, Nx, Ny, 1);
+	const std::vector<std::uint8_t> types = geom.node_types();
+
+	#pragma omp parallel
+	{
+		const NodeRange slab = thread_slab(Nx, Ny);
+		std::copy(types.cbegin() + slab.begin, types.cbegin() + slab.end, node_type.begin() + slab.begin);
+		// All slabs are needed for the neighbors
+		#pragma omp barrier
+
+		int inei = 0, jnei = 0;
+		int xi = 0, yj =0;
+		size_t ij = 0;
+		for (size_t ai = slab.begin; ai < slab.end; ++ai) {
+			xi = ai%Nx; 
+			yj = ((ai-xi)/Nx)%Ny;
+			// Solid nodes are never streamed, point to their own slots
+			for (size_t dj = 0; dj < Ndir; ++dj) {
+				fluid_neighbors.at(ai + dj*Ntot) = no_neighbor;
+				stream_targets.at(ai + dj*Ntot) = static_cast<std::uint32_t>(ai + dj*Ntot);
+			}
+			if (node_type.at(ai) == Geometry::solid) {
+				continue;
+			}
+			fluid_neighbors.at(ai) = static_cast<std::uint32_t>(ai);
 			for (size_t dj = 1; dj < Ndir; ++dj) {
 				// Counting for periodic boundaries
-				if (Cx[dj] > 0) {
-					ist = (xi+Cx[dj] < static_cast<int>(Nx)) ? (xi+Cx[dj]) : 0;
+				if (Lattice::cx[dj] > 0) {
+					inei = (xi+Lattice::cx[dj] < static_cast<int>(Nx)) ? (xi+Lattice::cx[dj]) : 0;
 				} else {
-					ist = (xi+Cx[dj] >= 0) ? (xi+Cx[dj]) : static_cast<int>(Nx)-1;
+					inei = (xi+Lattice::cx[dj] >= 0) ? (xi+Lattice::cx[dj]) : static_cast<int>(Nx)-1;
 				}	
-				if (Cy[dj] > 0) {
-					jst = (yj+Cy[dj] < static_cast<int>(Ny)) ? (yj+Cy[dj]) : 0;
+				if (Lattice::cy[dj] > 0) {
+					jnei = (yj+Lattice::cy[dj] < static_cast<int>(Ny)) ? (yj+Lattice::cy[dj]) : 0;
 				} else {
-					jst = (yj+Cy[dj] >= 0) ? (yj+Cy[dj]) : static_cast<int>(Ny)-1;
+					jnei = (yj+Lattice::cy[dj] >= 0) ? (yj+Lattice::cy[dj]) : static_cast<int>(Ny)-1;
 				}
-				// Streaming with bounce-back
-				ijk_ini = static_cast<size_t>(dj*Ntot + yj*Nx + xi);
-				if (geom(ist,jst) == 1) {
-					ijk_final = static_cast<size_t>(dj*Ntot + jst*Nx + ist);
-					temp_f_dist.at(ijk_final) = f_dist_1.at(ijk_ini);
-					temp_f_dist_spare.at(ijk_final) = f_dist_2.at(ijk_ini);
+				// Streaming to a fluid neighbor or bounce-back from a solid one
+				ij = static_cast<size_t>(jnei*Nx + inei);
+				if (node_type.at(ij) != Geometry::solid) {
+					fluid_neighbors.at(ai + dj*Ntot) = static_cast<std::uint32_t>(ij);
+					stream_targets.at(ai + dj*Ntot) = static_cast<std::uint32_t>(dj*Ntot + ij);
 				} else {
-					bb_ijk_final = static_cast<size_t>(bb_rules[dj-1]*Ntot + yj*Nx + xi);
-					temp_f_dist.at(bb_ijk_final) = f_dist_1.at(ijk_ini);
-					temp_f_dist_spare.at(bb_ijk_final) = f_dist_2.at(ijk_ini);
-				}			
+					stream_targets.at(ai + dj*Ntot) = static_cast<std::uint32_t>(Lattice::opposite[dj]*Ntot + ai);
+				}
 			}
 		}
 	}
-	// Reassign and fill temp with 0s just in case
-	std::swap(temp_f_dist, f_dist_1);
-	std::fill(temp_f_dist.begin(), temp_f_dist.end(), 0.0);
-	std::swap(temp_f_dist_spare, f_dist_2);
-	std::fill(temp_f_dist_spare.begin(), temp_f_dist_spare.end(), 0.0);
+	// Fluid-solid links, row by row
+	bb_links.clear();
+	bb_link_rows.assign(Ny + 1, 0);
+	BounceBackLink link;
+	size_t ij = 0;
+	for (size_t ai = 0; ai < Ntot; ++ai) {
+		if ((node_type.at(ai) & Geometry::wall_adjacent) != 0) {
+			for (size_t dj = 1; dj < Ndir; ++dj) {
+				if (fluid_neighbors.at(ai + dj*Ntot) != no_neighbor) {
+					continue;
+				}
+				ij = ((ai/Nx + Ny + Lattice::cy[dj])%Ny)*Nx + (ai%Nx + Nx + Lattice::cx[dj])%Nx;
+				link.source = static_cast<std::uint32_t>(ai + dj*Ntot);
+				link.target = static_cast<std::uint32_t>(ai + Lattice::opposite[dj]*Ntot);
+				link.solid = static_cast<std::uint32_t>(ij + dj*Ntot);
+				bb_links.push_back(link);
+			}
+		}
+		bb_link_rows.at(ai/Nx + 1) = bb_links.size();
+	}
+
+	// Bulk nodes - no periodic wrap and no bounce-back
+	for (size_t dj = 0; dj < Ndir; ++dj) {
+		neighbor_offset[dj] = Lattice::cx[dj] + Lattice::cy[dj]*static_cast<std::ptrdiff_t>(Nx);
+	}
+	bulk_runs.clear();
+	NodeRange run;
+	for (size_t ai = 0; ai < Ntot; ++ai) {
+		// Lattice edges are never bulk, so runs end with the row
+		if (node_type.at(ai) == Geometry::fluid) {
+			run.begin = (run.begin == run.end) ? ai : run.begin;
+			run.end = ai + 1;
+		} else if (run.begin != run.end) {
+			bulk_runs.push_back(run);
+			run = NodeRange();
+		}
+	}
+	if (layout == padded) {
+		build_padded_tables();
+	}
+}
+
+// Streaming targets and fixed offset runs of the padded layout
+void LBM::build_padded_tables()
+{
+	if (padded_plane*Ndir >= static_cast<size_t>(no_neighbor)) {
+		throw std::runtime_error("Domain too large for 32-bit lattice tables");
+	}
+	first_touch_resize(padded_targets, Nx, Ny, Ndir);
+	const std::ptrdiff_t Nx_s = static_cast<std::ptrdiff_t>(Nx), Ny_s = static_cast<std::ptrdiff_t>(Ny);
+
+	#pragma omp parallel
+	{
+		const NodeRange slab = thread_slab(Nx, Ny);
+		std::ptrdiff_t xi = 0, yj = 0, cx = 0, cy = 0, inei = 0, jnei = 0;
+		for (size_t ai = slab.begin; ai < slab.end; ++ai) {
+			xi = static_cast<std::ptrdiff_t>(ai%Nx);
+			yj = static_cast<std::ptrdiff_t>(ai/Nx);
+			for (size_t dj = 0; dj < Ndir; ++dj) {
+				cx = Lattice::cx[dj];
+				cy = Lattice::cy[dj];
+				// Streaming without wrap, past the edges into the ghost cells
+				padded_targets.at(ai + dj*Ntot) = static_cast<std::uint32_t>(dj*padded_plane + padded_index(xi + cx, yj + cy));
+				if ((node_type.at(ai) == Geometry::solid) || (fluid_neighbors.at(ai + dj*Ntot) != no_neighbor)) {
+					continue;
+				}
+				// Bounce-back as if streamed back from the solid neighbor, so a 
+				// value returning across an edge lands in the ghost cell past it 
+				inei = (xi + cx + Nx_s)%Nx_s;
+				jnei = (yj + cy + Ny_s)%Ny_s;
+				padded_targets.at(ai + dj*Ntot) = static_cast<std::uint32_t>(Lattice::opposite[dj]*padded_plane 
+														+ padded_index(inei - cx, jnei - cy));
+			}
+		}
+	}
+
+	// Fluid nodes without solid neighbors, edges included; runs end with the row
+	padded_runs.clear();
+	NodeRange run;
+	for (size_t ai = 0; ai < Ntot; ++ai) {
+		if ((node_type.at(ai) != Geometry::solid) && ((node_type.at(ai) & Geometry::wall_adjacent) == 0)) {
+			run.begin = (run.begin == run.end) ? ai : run.begin;
+			run.end = ai + 1;
+		} else if (run.begin != run.end) {
+			padded_runs.push_back(run);
+			run = NodeRange();
+		}
+		if ((ai%Nx == Nx - 1) && (run.begin != run.end)) {
+			padded_runs.push_back(run);
+			run = NodeRange();
+		}
+	}
 }
@@ -0,0 +1,279 @@
+#include "../../include/mpi/distributed_lbm.h"
+
+/*****************************************************
+ * class: DistributedLBM
+ *
+ * LBM operations on a domain decomposed among MPI
+ *	ranks into slabs of whole rows
+ *
+ ******************************************************/
+
+// Compile-time constants used by reference need a definition
+constexpr size_t DistributedLBM::Ndir;
+
+namespace {
+	/// Rank of this process in comm
+	int comm_rank(MPI_Comm comm)
+	{
+		int rank = 0;
+		MPI_Comm_rank(comm, &rank);
+		return rank;
+	}
+
+	/// Number of processes in comm
+	int comm_size(MPI_Comm comm)
+	{
+		int size = 1;
+		MPI_Comm_size(comm, &size);
+		return size;
+	}
+}
+
+// Constructor - row slabs, local geometry, and the local LBM
+DistributedLBM::DistributedLBM(const Geometry& global_geom, MPI_Comm comm_in) :
+	comm(comm_in), rank(comm_rank(comm_in)), nranks(comm_size(comm_in)),
+	rank_up((rank + 1)%nranks), rank_down((rank - 1 + nranks)%nranks),
+	Nx(global_geom.Nx()), Ny(global_geom.Ny()),
+	first_row(rank_first_row(rank)), Ny_own(rank_first_row(rank + 1) - first_row),
+	Ny_local(Ny_own + 2), Ntot_local(Nx*Ny_local),
+	local_geom(make_local_geometry(global_geom)), lbm(local_geom)
+{
+	// Halo rows are only updated through the exchanges
+	lbm.set_active_rows(1, Ny_local - 1);
+}
+
+// Initializes a droplet of one fluid in the other fluid
+void DistributedLBM::initialize_droplet(Fluid& bulk, Fluid& droplet,
+								const double rho_bulk, const double rho_droplet,
+								const double rho_b_in_d, const double rho_d_in_b,
+								const double xc, const double yc, const double radius)
+{
+	// Local row 1 is the first own row
+	const double yc_local = yc - static_cast<double>(first_row) + 1.0;
+	lbm.initialize_droplet(local_geom, bulk, droplet, rho_bulk, rho_droplet,
+							rho_b_in_d, rho_d_in_b, xc, yc_local, radius);
+}
+
+// Complete time step for a single fluid
+void DistributedLBM::step(Fluid& fluid_1, const std::vector<double>& force)
+{
+	OverlappedExchange halo(*this);
+	lbm.step(local_geom, fluid_1, force, halo);
+	finish_streamed({&fluid_1.get_f_dist()});
+	fluid_1.invalidate_moments();
+}
+
+// Complete time step for a two fluid species - two phase system
+void DistributedLBM::step(Fluid& fluid_1, Fluid& fluid_2, const std::vector<double>& force)
+{
+	// Halo densities, exchanged during the step, are the neighbor potentials
+	OverlappedExchange halo(*this);
+	lbm.step(local_geom, fluid_1, fluid_2, force, halo);
+	finish_streamed({&fluid_1.get_f_dist(), &fluid_2.get_f_dist()});
+	fluid_1.invalidate_moments();
+	fluid_2.invalidate_moments();
+}
+
+// Send values streamed into the halo rows to the ranks that own them
+void DistributedLBM::exchange_streamed(Fluid& fluid_1)
+{
+	exchange_streamed(std::vector<LatticeVector<double>*>{&fluid_1.get_f_dist()});
+	fluid_1.invalidate_moments();
+}
+
+// Send values streamed into the halo rows to the ranks that own them, both fluids
+void DistributedLBM::exchange_streamed(Fluid& fluid_1, Fluid& fluid_2)
+{
+	exchange_streamed(std::vector<LatticeVector<double>*>{&fluid_1.get_f_dist(), &fluid_2.get_f_dist()});
+	fluid_1.invalidate_moments();
+	fluid_2.invalidate_moments();
+}
+
+// Copy neighbor densities into the halo rows
+void DistributedLBM::exchange_density(Fluid& fluid_1, Fluid& fluid_2)
+{
+	exchange_rows({&fluid_1.get_rho(), &fluid_2.get_rho()}, 1);
+}
+
+// Copy neighbor distributions into the halo rows
+void DistributedLBM::exchange_distributions(Fluid& fluid_1, Fluid& fluid_2)
+{
+	exchange_rows({&fluid_1.get_f_dist(), &fluid_2.get_f_dist()}, Ndir);
+	fluid_1.invalidate_moments();
+	fluid_2.invalidate_moments();
+}
+
+// Gather the own rows of a macroscopic field on rank 0
+std::vector<double> DistributedLBM::gather(const LatticeVector<double>& local_field) const
+{
+	if (local_field.size() != Ntot_local) {
+		throw std::invalid_argument("Field size does not match the local lattice");
+	}
+
+	std::vector<int> counts(nranks, 0), displs(nranks, 0);
+	for (int r = 0; r < nranks; ++r) {
+		counts.at(r) = static_cast<int>(Nx*(rank_first_row(r + 1) - rank_first_row(r)));
+		displs.at(r) = static_cast<int>(Nx*rank_first_row(r));
+	}
+
+	std::vector<double> global_field;
+	if (rank == 0) {
+		global_field.resize(Nx*Ny, 0.0);
+	}
+	MPI_Gatherv(local_field.data() + Nx, static_cast<int>(Nx*Ny_own), MPI_DOUBLE,
+					global_field.data(), counts.data(), displs.data(), MPI_DOUBLE, 0, comm);
+	return global_field;
+}
+
+// Gather the own rows of a density distribution on rank 0
+std::vector<double> DistributedLBM::gather_distribution(const LatticeVector<double>& local_dist) const
+{
+	if (local_dist.size() != Ntot_local*Ndir) {
+		throw std::invalid_argument("Distribution size does not match the local lattice");
+	}
+
+	std::vector<int> counts(nranks, 0), displs(nranks, 0);
+	for (int r = 0; r < nranks; ++r) {
+		counts.at(r) = static_cast<int>(Nx*(rank_first_row(r + 1) - rank_first_row(r)));
+		displs.at(r) = static_cast<int>(Nx*rank_first_row(r));
+	}
+
+	std::vector<double> global_dist;
+	if (rank == 0) {
+		global_dist.resize(Nx*Ny*Ndir, 0.0);
+	}
+	// One direction at a time, each is a separate Nx*Ny plane
+	for (size_t dj = 0; dj < Ndir; ++dj) {
+		MPI_Gatherv(local_dist.data() + dj*Ntot_local + Nx, static_cast<int>(Nx*Ny_own), MPI_DOUBLE,
+						(rank == 0) ? global_dist.data() + dj*Nx*Ny : nullptr,
+						counts.data(), displs.data(), MPI_DOUBLE, 0, comm);
+	}
+	return global_dist;
+}
+
+// Geometry of the own rows with one halo row on each side
+Geometry DistributedLBM::make_local_geometry(const Geometry& global_geom) const
+{
+	if (Ny < static_cast<size_t>(nranks)) {
+		throw std::invalid_argument("Every rank needs at least one row of the domain");
+	}
+
+	Geometry geom(Nx, Ny_local);
+	size_t global_row = 0;
+	for (size_t yj = 0; yj < Ny_local; ++yj) {
+		// Halo rows wrap around periodically
+		global_row = (first_row + Ny + yj - 1)%Ny;
+		for (size_t xi = 0; xi < Nx; ++xi) {
+			if (global_geom(xi, global_row) == 0) {
+				geom.set_node_solid(xi, yj);
+			}
+		}
+	}
+	return geom;
+}
+
+// Start sending own boundary rows of all arrays to the halo rows of the neighbors
+void DistributedLBM::post_rows(const std::vector<LatticeVector<double>*>& arrays,
+									const size_t Nplanes)
+{
+	const size_t count = arrays.size()*Nplanes*Nx;
+	send_up.resize(count);
+	send_down.resize(count);
+	recv_up.resize(count);
+	recv_down.resize(count);
+
+	MPI_Irecv(recv_down.data(), static_cast<int>(count), MPI_DOUBLE, rank_down, 0, comm, &requests[0]);
+	MPI_Irecv(recv_up.data(), static_cast<int>(count), MPI_DOUBLE, rank_up, 1, comm, &requests[1]);
+
+	// Last own row goes up, first own row goes down
+	const size_t top_own = (Ny_local - 2)*Nx, bottom_own = Nx;
+	size_t ib = 0;
+	for (const auto arr : arrays) {
+		for (size_t k = 0; k < Nplanes; ++k) {
+			for (size_t xi = 0; xi < Nx; ++xi, ++ib) {
+				send_up[ib] = (*arr)[top_own + xi + k*Ntot_local];
+				send_down[ib] = (*arr)[bottom_own + xi + k*Ntot_local];
+			}
+		}
+	}
+
+	MPI_Isend(send_up.data(), static_cast<int>(count), MPI_DOUBLE, rank_up, 0, comm, &requests[2]);
+	MPI_Isend(send_down.data(), static_cast<int>(count), MPI_DOUBLE, rank_down, 1, comm, &requests[3]);
+}
+
+// Wait for the boundary rows of the neighbors and store them in the halo rows
+void DistributedLBM::finish_rows(const std::vector<LatticeVector<double>*>& arrays,
+									const size_t Nplanes)
+{
+	MPI_Waitall(4, requests, MPI_STATUSES_IGNORE);
+
+	const size_t top_halo = (Ny_local - 1)*Nx, bottom_halo = 0;
+	size_t ib = 0;
+	for (const auto arr : arrays) {
+		for (size_t k = 0; k < Nplanes; ++k) {
+			for (size_t xi = 0; xi < Nx; ++xi, ++ib) {
+				(*arr)[bottom_halo + xi + k*Ntot_local] = recv_down[ib];
+				(*arr)[top_halo + xi + k*Ntot_local] = recv_up[ib];
+			}
+		}
+	}
+}
+
+// Start sending values streamed into the halo rows to the ranks that own them
+void DistributedLBM::post_streamed(const std::vector<LatticeVector<double>*>& f_dists)
+{
+	// Three directions cross each boundary
+	const size_t count = f_dists.size()*up_dirs.size()*Nx;
+	send_up.resize(count);
+	send_down.resize(count);
+	recv_up.resize(count);
+	recv_down.resize(count);
+
+	MPI_Irecv(recv_down.data(), static_cast<int>(count), MPI_DOUBLE, rank_down, 2, comm, &requests[0]);
+	MPI_Irecv(recv_up.data(), static_cast<int>(count), MPI_DOUBLE, rank_up, 3, comm, &requests[1]);
+
+	const size_t top_halo = (Ny_local - 1)*Nx, bottom_halo = 0;
+	size_t ib = 0;
+	for (const auto f_dist : f_dists) {
+		for (size_t k = 0; k < up_dirs.size(); ++k) {
+			for (size_t xi = 0; xi < Nx; ++xi, ++ib) {
+				send_up[ib] = (*f_dist)[top_halo + xi + up_dirs[k]*Ntot_local];
+				send_down[ib] = (*f_dist)[bottom_halo + xi + down_dirs[k]*Ntot_local];
+			}
+		}
+	}
+
+	MPI_Isend(send_up.data(), static_cast<int>(count), MPI_DOUBLE, rank_up, 2, comm, &requests[2]);
+	MPI_Isend(send_down.data(), static_cast<int>(count), MPI_DOUBLE, rank_down, 3, comm, &requests[3]);
+}
+
+// Wait for the values streamed into the own rows by the neighbors and store them
+void DistributedLBM::finish_streamed(const std::vector<LatticeVector<double>*>& f_dists)
+{
+	MPI_Waitall(4, requests, MPI_STATUSES_IGNORE);
+
+	// A value was streamed only if both its source (in the halo row) and
+	// its target are fluid nodes - otherwise the target holds a bounced-back value
+	const size_t top_own = (Ny_local - 2)*Nx, bottom_own = Nx;
+	const size_t top_halo = (Ny_local - 1)*Nx, bottom_halo = 0;
+	const int Nx_int = static_cast<int>(Nx);
+	size_t xs = 0, dj = 0, ib = 0;
+	for (const auto f_dist : f_dists) {
+		for (size_t k = 0; k < up_dirs.size(); ++k) {
+			for (size_t xi = 0; xi < Nx; ++xi, ++ib) {
+				// Coming from below, source in the lower halo row
+				dj = up_dirs[k];
+				xs = static_cast<size_t>((static_cast<int>(xi) - Lattice::cx[dj] + Nx_int)%Nx_int);
+				if ((local_geom(bottom_own + xi) == 1) && (local_geom(bottom_halo + xs) == 1)) {
+					(*f_dist)[bottom_own + xi + dj*Ntot_local] = recv_down[ib];
+				}
+				// Coming from above, source in the upper halo row
+				dj = down_dirs[k];
+				xs = static_cast<size_t>((static_cast<int>(xi) - Lattice::cx[dj] + Nx_int)%Nx_int);
+				if ((local_geom(top_own + xi) == 1) && (local_geom(top_halo + xs) == 1)) {
+					(*f_dist)[top_own + xi + dj*Ntot_local] = recv_up[ib];
+				}
+			}
+		}
+	}
+}
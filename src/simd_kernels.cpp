@@ -0,0 +1,317 @@
+#include "../include/simd_kernels.h"
+
+/*****************************************************
+ * Vectorized node kernels
+ *
+ * Explicit versions are compiled for the x86 targets
+ *	with function attributes, so this file needs no
+ *	special compiler flags and runs on any CPU
+ *
+ ******************************************************/
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define LBM_X86_SIMD
+#include <immintrin.h>
+#endif
+
+// Multiplies and adds stay separate, as in the scalar code
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize ("fp-contract=off")
+#endif
+
+namespace {
+
+	//
+	// Scalar versions
+	//
+
+	void f_equilibrium_scalar(const EquilibriumCoefficients& c, const double* rho,
+								const double* ux, const double* uy, double* f_eq,
+								const size_t Ntot, const size_t begin, const size_t end)
+	{
+		for (size_t ai = begin; ai < end; ++ai) {
+			const double rt0 = c.wrt0*rho[ai];
+			const double rt1 = c.wrt1*rho[ai];
+			const double rt2 = c.wrt2*rho[ai];
+
+			const double uxsq  =  ux[ai] * ux[ai];
+			const double uysq  =  uy[ai] * uy[ai];
+			const double uxuy5 =  ux[ai] +  uy[ai];
+			const double uxuy6 = -ux[ai] +  uy[ai];
+			const double uxuy7 = -ux[ai] - uy[ai];
+			const double uxuy8 =  ux[ai] - uy[ai];
+			const double usq   =  uxsq + uysq;
+
+			f_eq[ai]          = rt0*(1.0 - c.feq3*usq);
+			f_eq[ai + Ntot]   = rt1*(1.0 + c.feq1*ux[ai] + c.feq2*ux[ai]*ux[ai] - c.feq3*usq);
+			f_eq[ai + 2*Ntot] = rt1*(1.0 + c.feq1*uy[ai] + c.feq2*uy[ai]*uy[ai] - c.feq3*usq);
+			f_eq[ai + 3*Ntot] = rt1*(1.0 - c.feq1*ux[ai] + c.feq2*ux[ai]*ux[ai] - c.feq3*usq);
+			f_eq[ai + 4*Ntot] = rt1*(1.0 - c.feq1*uy[ai] + c.feq2*uy[ai]*uy[ai] - c.feq3*usq);
+			f_eq[ai + 5*Ntot] = rt2*(1.0 + c.feq1*uxuy5 + c.feq2*uxuy5*uxuy5 - c.feq3*usq);
+			f_eq[ai + 6*Ntot] = rt2*(1.0 + c.feq1*uxuy6 + c.feq2*uxuy6*uxuy6 - c.feq3*usq);
+			f_eq[ai + 7*Ntot] = rt2*(1.0 + c.feq1*uxuy7 + c.feq2*uxuy7*uxuy7 - c.feq3*usq);
+			f_eq[ai + 8*Ntot] = rt2*(1.0 + c.feq1*uxuy8 + c.feq2*uxuy8*uxuy8 - c.feq3*usq);
+		}
+	}
+
+	void relax_scalar(double* f, const double* f_eq, const double omega,
+						const size_t begin, const size_t end)
+	{
+		for (size_t i = begin; i < end; ++i) {
+			f[i] = (1.0 - omega)*f[i] + omega*f_eq[i];
+		}
+	}
+
+#ifdef LBM_X86_SIMD
+
+	//
+	// AVX2 versions - 4 nodes per instruction
+	//
+
+	__attribute__((target("avx2")))
+	void f_equilibrium_avx2(const EquilibriumCoefficients& c, const double* rho,
+								const double* ux, const double* uy, double* f_eq,
+								const size_t Ntot, const size_t begin, const size_t end)
+	{
+		const __m256d one = _mm256_set1_pd(1.0);
+		const __m256d sign = _mm256_set1_pd(-0.0);
+		const __m256d w0 = _mm256_set1_pd(c.wrt0), w1 = _mm256_set1_pd(c.wrt1), w2 = _mm256_set1_pd(c.wrt2);
+		const __m256d c1 = _mm256_set1_pd(c.feq1), c2 = _mm256_set1_pd(c.feq2), c3 = _mm256_set1_pd(c.feq3);
+
+		size_t ai = begin;
+		for (; ai + 4 <= end; ai += 4) {
+			const __m256d r = _mm256_loadu_pd(rho + ai);
+			const __m256d vx = _mm256_loadu_pd(ux + ai);
+			const __m256d vy = _mm256_loadu_pd(uy + ai);
+			const __m256d rt0 = _mm256_mul_pd(w0, r);
+			const __m256d rt1 = _mm256_mul_pd(w1, r);
+			const __m256d rt2 = _mm256_mul_pd(w2, r);
+
+			const __m256d uxsq = _mm256_mul_pd(vx, vx);
+			const __m256d uysq = _mm256_mul_pd(vy, vy);
+			const __m256d neg_ux = _mm256_xor_pd(vx, sign);
+			const __m256d uxuy5 = _mm256_add_pd(vx, vy);
+			const __m256d uxuy6 = _mm256_add_pd(neg_ux, vy);
+			const __m256d uxuy7 = _mm256_sub_pd(neg_ux, vy);
+			const __m256d uxuy8 = _mm256_sub_pd(vx, vy);
+			const __m256d c3usq = _mm256_mul_pd(c3, _mm256_add_pd(uxsq, uysq));
+
+			// rt*(1.0 +/- c1*u + c2*u*u - c3*usq), left to right
+			const __m256d c1ux = _mm256_mul_pd(c1, vx), c1uy = _mm256_mul_pd(c1, vy);
+			const __m256d c2uxsq = _mm256_mul_pd(_mm256_mul_pd(c2, vx), vx);
+			const __m256d c2uysq = _mm256_mul_pd(_mm256_mul_pd(c2, vy), vy);
+			_mm256_storeu_pd(f_eq + ai, _mm256_mul_pd(rt0, _mm256_sub_pd(one, c3usq)));
+			_mm256_storeu_pd(f_eq + ai + Ntot, _mm256_mul_pd(rt1, _mm256_sub_pd(_mm256_add_pd(
+								_mm256_add_pd(one, c1ux), c2uxsq), c3usq)));
+			_mm256_storeu_pd(f_eq + ai + 2*Ntot, _mm256_mul_pd(rt1, _mm256_sub_pd(_mm256_add_pd(
+								_mm256_add_pd(one, c1uy), c2uysq), c3usq)));
+			_mm256_storeu_pd(f_eq + ai + 3*Ntot, _mm256_mul_pd(rt1, _mm256_sub_pd(_mm256_add_pd(
+								_mm256_sub_pd(one, c1ux), c2uxsq), c3usq)));
+			_mm256_storeu_pd(f_eq + ai + 4*Ntot, _mm256_mul_pd(rt1, _mm256_sub_pd(_mm256_add_pd(
+								_mm256_sub_pd(one, c1uy), c2uysq), c3usq)));
+			_mm256_storeu_pd(f_eq + ai + 5*Ntot, _mm256_mul_pd(rt2, _mm256_sub_pd(_mm256_add_pd(
+								_mm256_add_pd(one, _mm256_mul_pd(c1, uxuy5)),
+								_mm256_mul_pd(_mm256_mul_pd(c2, uxuy5), uxuy5)), c3usq)));
+			_mm256_storeu_pd(f_eq + ai + 6*Ntot, _mm256_mul_pd(rt2, _mm256_sub_pd(_mm256_add_pd(
+								_mm256_add_pd(one, _mm256_mul_pd(c1, uxuy6)),
+								_mm256_mul_pd(_mm256_mul_pd(c2, uxuy6), uxuy6)), c3usq)));
+			_mm256_storeu_pd(f_eq + ai + 7*Ntot, _mm256_mul_pd(rt2, _mm256_sub_pd(_mm256_add_pd(
+								_mm256_add_pd(one, _mm256_mul_pd(c1, uxuy7)),
+								_mm256_mul_pd(_mm256_mul_pd(c2, uxuy7), uxuy7)), c3usq)));
+			_mm256_storeu_pd(f_eq + ai + 8*Ntot, _mm256_mul_pd(rt2, _mm256_sub_pd(_mm256_add_pd(
+								_mm256_add_pd(one, _mm256_mul_pd(c1, uxuy8)),
+								_mm256_mul_pd(_mm256_mul_pd(c2, uxuy8), uxuy8)), c3usq)));
+		}
+		// Remainder
+		f_equilibrium_scalar(c, rho, ux, uy, f_eq, Ntot, ai, end);
+	}
+
+	__attribute__((target("avx2")))
+	void relax_avx2(double* f, const double* f_eq, const double omega,
+						const size_t begin, const size_t end)
+	{
+		const __m256d keep = _mm256_set1_pd(1.0 - omega);
+		const __m256d om = _mm256_set1_pd(omega);
+		size_t i = begin;
+		for (; i + 4 <= end; i += 4) {
+			_mm256_storeu_pd(f + i, _mm256_add_pd(_mm256_mul_pd(keep, _mm256_loadu_pd(f + i)),
+								_mm256_mul_pd(om, _mm256_loadu_pd(f_eq + i))));
+		}
+		relax_scalar(f, f_eq, omega, i, end);
+	}
+
+	//
+	// AVX-512 versions - 8 nodes per instruction
+	//
+
+	__attribute__((target("avx512f")))
+	void f_equilibrium_avx512(const EquilibriumCoefficients& c, const double* rho,
+								const double* ux, const double* uy, double* f_eq,
+								const size_t Ntot, const size_t begin, const size_t end)
+	{
+		const __m512d one = _mm512_set1_pd(1.0);
+		const __m512d w0 = _mm512_set1_pd(c.wrt0), w1 = _mm512_set1_pd(c.wrt1), w2 = _mm512_set1_pd(c.wrt2);
+		const __m512d c1 = _mm512_set1_pd(c.feq1), c2 = _mm512_set1_pd(c.feq2), c3 = _mm512_set1_pd(c.feq3);
+
+		size_t ai = begin;
+		for (; ai + 8 <= end; ai += 8) {
+			const __m512d r = _mm512_loadu_pd(rho + ai);
+			const __m512d vx = _mm512_loadu_pd(ux + ai);
+			const __m512d vy = _mm512_loadu_pd(uy + ai);
+			const __m512d rt0 = _mm512_mul_pd(w0, r);
+			const __m512d rt1 = _mm512_mul_pd(w1, r);
+			const __m512d rt2 = _mm512_mul_pd(w2, r);
+
+			const __m512d uxsq = _mm512_mul_pd(vx, vx);
+			const __m512d uysq = _mm512_mul_pd(vy, vy);
+			// Exact negation - flips the sign bit, including zeros
+			const __m512d neg_ux = _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(vx),
+										_mm512_castpd_si512(_mm512_set1_pd(-0.0))));
+			const __m512d uxuy5 = _mm512_add_pd(vx, vy);
+			const __m512d uxuy6 = _mm512_add_pd(neg_ux, vy);
+			const __m512d uxuy7 = _mm512_sub_pd(neg_ux, vy);
+			const __m512d uxuy8 = _mm512_sub_pd(vx, vy);
+			const __m512d c3usq = _mm512_mul_pd(c3, _mm512_add_pd(uxsq, uysq));
+
+			const __m512d c1ux = _mm512_mul_pd(c1, vx), c1uy = _mm512_mul_pd(c1, vy);
+			const __m512d c2uxsq = _mm512_mul_pd(_mm512_mul_pd(c2, vx), vx);
+			const __m512d c2uysq = _mm512_mul_pd(_mm512_mul_pd(c2, vy), vy);
+			_mm512_storeu_pd(f_eq + ai, _mm512_mul_pd(rt0, _mm512_sub_pd(one, c3usq)));
+			_mm512_storeu_pd(f_eq + ai + Ntot, _mm512_mul_pd(rt1, _mm512_sub_pd(_mm512_add_pd(
+								_mm512_add_pd(one, c1ux), c2uxsq), c3usq)));
+			_mm512_storeu_pd(f_eq + ai + 2*Ntot, _mm512_mul_pd(rt1, _mm512_sub_pd(_mm512_add_pd(
+								_mm512_add_pd(one, c1uy), c2uysq), c3usq)));
+			_mm512_storeu_pd(f_eq + ai + 3*Ntot, _mm512_mul_pd(rt1, _mm512_sub_pd(_mm512_add_pd(
+								_mm512_sub_pd(one, c1ux), c2uxsq), c3usq)));
+			_mm512_storeu_pd(f_eq + ai + 4*Ntot, _mm512_mul_pd(rt1, _mm512_sub_pd(_mm512_add_pd(
+								_mm512_sub_pd(one, c1uy), c2uysq), c3usq)));
+			_mm512_storeu_pd(f_eq + ai + 5*Ntot, _mm512_mul_pd(rt2, _mm512_sub_pd(_mm512_add_pd(
+								_mm512_add_pd(one, _mm512_mul_pd(c1, uxuy5)),
+								_mm512_mul_pd(_mm512_mul_pd(c2, uxuy5), uxuy5)), c3usq)));
+			_mm512_storeu_pd(f_eq + ai + 6*Ntot, _mm512_mul_pd(rt2, _mm512_sub_pd(_mm512_add_pd(
+								_mm512_add_pd(one, _mm512_mul_pd(c1, uxuy6)),
+								_mm512_mul_pd(_mm512_mul_pd(c2, uxuy6), uxuy6)), c3usq)));
+			_mm512_storeu_pd(f_eq + ai + 7*Ntot, _mm512_mul_pd(rt2, _mm512_sub_pd(_mm512_add_pd(
+								_mm512_add_pd(one, _mm512_mul_pd(c1, uxuy7)),
+								_mm512_mul_pd(_mm512_mul_pd(c2, uxuy7), uxuy7)), c3usq)));
+			_mm512_storeu_pd(f_eq + ai + 8*Ntot, _mm512_mul_pd(rt2, _mm512_sub_pd(_mm512_add_pd(
+								_mm512_add_pd(one, _mm512_mul_pd(c1, uxuy8)),
+								_mm512_mul_pd(_mm512_mul_pd(c2, uxuy8), uxuy8)), c3usq)));
+		}
+		// Remainder
+		f_equilibrium_scalar(c, rho, ux, uy, f_eq, Ntot, ai, end);
+	}
+
+	__attribute__((target("avx512f")))
+	void relax_avx512(double* f, const double* f_eq, const double omega,
+						const size_t begin, const size_t end)
+	{
+		const __m512d keep = _mm512_set1_pd(1.0 - omega);
+		const __m512d om = _mm512_set1_pd(omega);
+		size_t i = begin;
+		for (; i + 8 <= end; i += 8) {
+			_mm512_storeu_pd(f + i, _mm512_add_pd(_mm512_mul_pd(keep, _mm512_loadu_pd(f + i)),
+								_mm512_mul_pd(om, _mm512_loadu_pd(f_eq + i))));
+		}
+		relax_scalar(f, f_eq, omega, i, end);
+	}
+
+#endif
+
+	/// Instruction set used by the kernels, the best one unless changed
+	SimdLevel& active_level()
+	{
+		static SimdLevel level = detect_simd_level();
+		return level;
+	}
+}
+
+//
+// Instruction set selection
+//
+
+// Best instruction set supported by this CPU
+SimdLevel detect_simd_level()
+{
+#ifdef LBM_X86_SIMD
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) {
+		return SimdLevel::avx512;
+	}
+	if (__builtin_cpu_supports("avx2")) {
+		return SimdLevel::avx2;
+	}
+#endif
+	return SimdLevel::scalar;
+}
+
+// Instruction set currently used by the kernels
+SimdLevel get_simd_level()
+{
+	return active_level();
+}
+
+// Select the instruction set used by the kernels
+void set_simd_level(const SimdLevel level)
+{
+	if (static_cast<int>(level) > static_cast<int>(detect_simd_level())) {
+		throw std::invalid_argument("Instruction set " + simd_level_name(level) + " not supported by this CPU");
+	}
+	active_level() = level;
+}
+
+// Name of an instruction set
+std::string simd_level_name(const SimdLevel level)
+{
+	switch (level) {
+		case SimdLevel::avx512:
+			return "AVX-512";
+		case SimdLevel::avx2:
+			return "AVX2";
+		default:
+			return "scalar";
+	}
+}
+
+//
+// Kernels
+//
+
+// Equilibrium distribution of nodes begin to end - 1
+void simd_f_equilibrium(const EquilibriumCoefficients& coeffs, const double* rho,
+							const double* ux, const double* uy, double* f_eq,
+							const size_t Ntot, const size_t begin, const size_t end)
+{
+	switch (active_level()) {
+#ifdef LBM_X86_SIMD
+		case SimdLevel::avx512:
+			f_equilibrium_avx512(coeffs, rho, ux, uy, f_eq, Ntot, begin, end);
+			break;
+		case SimdLevel::avx2:
+			f_equilibrium_avx2(coeffs, rho, ux, uy, f_eq, Ntot, begin, end);
+			break;
+#endif
+		default:
+			f_equilibrium_scalar(coeffs, rho, ux, uy, f_eq, Ntot, begin, end);
+	}
+}
+
+// BGK relaxation of values begin to end - 1
+void simd_relax(double* f, const double* f_eq, const double omega,
+					const size_t begin, const size_t end)
+{
+	switch (active_level()) {
+#ifdef LBM_X86_SIMD
+		case SimdLevel::avx512:
+			relax_avx512(f, f_eq, omega, begin, end);
+			break;
+		case SimdLevel::avx2:
+			relax_avx2(f, f_eq, omega, begin, end);
+			break;
+#endif
+		default:
+			relax_scalar(f, f_eq, omega, begin, end);
+	}
+}
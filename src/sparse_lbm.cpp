@@ -0,0 +1,435 @@
+#include "../include/sparse_lbm.h"
+
+/*****************************************************
+ * class: SparseLBM
+ *
+ * LBM time steps on fluid nodes only, with compact
+ *	storage and precomputed neighbor indices
+ *
+ ******************************************************/
+
+// Compile-time constants used by reference need a definition
+constexpr size_t SparseLBM::Ndir;
+
+namespace {
+	/// Replace an array with an empty one, releasing its memory
+	void release(LatticeVector<double>& vec)
+	{
+		LatticeVector<double>().swap(vec);
+	}
+}
+
+// Constructor - numbering of fluid nodes, tables, and temporary arrays
+SparseLBM::SparseLBM(const Geometry& geom)
+{
+	Nx = geom.Nx(); Ny = geom.Ny(); Ntot = Nx*Ny;
+	build_lattice_tables(geom);
+	first_touch_resize(temp_f_dist, 1, Nfluid, Ndir);
+	first_touch_resize(temp_f_dist_spare, 1, Nfluid, Ndir);
+}
+
+//
+// Storage conversions
+//
+
+// Convert an initialized fluid to the compact storage
+void SparseLBM::compact(Fluid& fluid) const
+{
+	LatticeVector<double>& f_dist = fluid.get_f_dist();
+	if (f_dist.size() != Ntot*Ndir) {
+		throw std::invalid_argument("Fluid needs to be initialized with the geometry of this SparseLBM");
+	}
+	f_dist = compact_array(f_dist, Ndir);
+
+	// Kept if present, they are used by the two fluid step
+	for (LatticeVector<double>* vec : {&fluid.get_rho(),
+			&fluid.get_fluid_solid_force_x(), &fluid.get_fluid_solid_force_y()}) {
+		if (vec->size() == Ntot) {
+			*vec = compact_array(*vec, 1);
+		} else {
+			release(*vec);
+		}
+	}
+	// Not used by the steps
+	release(fluid.get_f_eq_dist());
+	release(fluid.get_ux());
+	release(fluid.get_uy());
+	release(fluid.get_momentum_x());
+	release(fluid.get_momentum_y());
+	release(fluid.get_u_eq_x());
+	release(fluid.get_u_eq_y());
+	release(fluid.get_repulsive_force_x());
+	release(fluid.get_repulsive_force_y());
+	fluid.invalidate_moments();
+}
+
+// Restore the dense arrays of a compacted fluid
+void SparseLBM::expand(Fluid& fluid) const
+{
+	check_compact(fluid);
+	LatticeVector<double>& f_dist = fluid.get_f_dist();
+	f_dist = dense_array(f_dist, Ndir);
+
+	LatticeVector<double>& rho = fluid.get_rho();
+	if (rho.size() == Nfluid) {
+		rho = dense_array(rho, 1);
+	} else {
+		first_touch_resize(rho, Nx, Ny, 1);
+	}
+	// Fluid-solid forces stay empty if they were not computed
+	for (LatticeVector<double>* vec : {&fluid.get_fluid_solid_force_x(), &fluid.get_fluid_solid_force_y()}) {
+		if (vec->size() == Nfluid) {
+			*vec = dense_array(*vec, 1);
+		}
+	}
+	fluid.invalidate_moments();
+	// Lean fluids only store the arrays restored above
+	if (fluid.is_lean()) {
+		return;
+	}
+	first_touch_resize(fluid.get_f_eq_dist(), Nx, Ny, Ndir);
+	first_touch_resize(fluid.get_ux(), Nx, Ny, 1);
+	first_touch_resize(fluid.get_uy(), Nx, Ny, 1);
+	first_touch_resize(fluid.get_u_eq_x(), Nx, Ny, 1);
+	first_touch_resize(fluid.get_u_eq_y(), Nx, Ny, 1);
+	first_touch_resize(fluid.get_repulsive_force_x(), Nx, Ny, 1);
+	first_touch_resize(fluid.get_repulsive_force_y(), Nx, Ny, 1);
+}
+
+// Dense Nx*Ny copy of a compact macroscopic property
+LatticeVector<double> SparseLBM::dense_field(const LatticeVector<double>& compact_field) const
+{
+	if (compact_field.size() != Nfluid) {
+		throw std::invalid_argument("Field needs one value per fluid node");
+	}
+	return dense_array(compact_field, 1);
+}
+
+//
+// Time steps
+//
+
+// Computes the force from fluid-solid interactions
+void SparseLBM::compute_solid_surface_force(Fluid& fluid_1, Fluid& fluid_2)
+{
+	check_compact(fluid_1);
+	check_compact(fluid_2);
+
+	// Compute the common force components (fixed for stationary solids)
+	LatticeVector<double> Fxs(Nfluid, 0.0);
+	LatticeVector<double> Fys(Nfluid, 0.0);
+
+	for (size_t ak = 0; ak < Nfluid; ++ak) {
+		for (size_t dj = 1; dj < Ndir; ++dj) {
+			// Force is non-zero only if the neighbor is a solid node
+			if (fluid_neighbors[ak + dj*Nfluid] == no_neighbor) {
+				Fxs.at(ak) += Lattice::w[dj]*Lattice::cx[dj];
+				Fys.at(ak) += Lattice::w[dj]*Lattice::cy[dj];
+			}
+		}
+	}
+
+	// Specific values for each fluid
+	fluid_1.add_surface_forces(Fxs, Fys);
+	fluid_2.add_surface_forces(Fxs, Fys);
+}
+
+// Collision, volume force, and streaming in one pass for a single fluid
+void SparseLBM::step(Fluid& fluid_1, const std::vector<double>& force)
+{
+	if (force.size() != Ndir) {
+		throw std::invalid_argument("Volume force needs one value per lattice direction");
+	}
+	check_compact(fluid_1);
+
+	LatticeVector<double>& f_dist = fluid_1.get_f_dist();
+	const RestrictPtr<const double> f = array_ptr(f_dist);
+	const RestrictPtr<double> f_new = array_ptr(temp_f_dist);
+	const RestrictPtr<const double> f_force = array_ptr(force);
+	const RestrictPtr<const std::uint32_t> targets = array_ptr(stream_targets);
+	const double omega = fluid_1.get_omega();
+
+	#pragma omp parallel
+	{
+		const NodeRange block = thread_block(Nfluid);
+		double f_node[Ndir] = {}, feq[Ndir] = {};
+		double rho = 0.0, ux = 0.0, uy = 0.0;
+
+		for (size_t ak = block.begin; ak < block.end; ++ak) {
+			// Moments from a single read of the distribution
+			rho = 0.0; ux = 0.0; uy = 0.0;
+			for (size_t dj = 0; dj < Ndir; ++dj) {
+				f_node[dj] = f[ak + dj*Nfluid];
+				rho += f_node[dj];
+			}
+			for (size_t dj = 0; dj < Ndir; ++dj) {
+				ux += f_node[dj]*Lattice::cx[dj];
+				uy += f_node[dj]*Lattice::cy[dj];
+			}
+			ux /= rho;
+			uy /= rho;
+
+			// Collision and volume force
+			fluid_1.node_f_equilibrium(rho, ux, uy, feq);
+			for (size_t dj = 0; dj < Ndir; ++dj) {
+				f_node[dj] = (1.0 - omega)*f_node[dj] + omega*feq[dj];
+				f_node[dj] += f_force[dj];
+			}
+
+			// Streaming with bounce-back resolved in the table
+			for (size_t dj = 0; dj < Ndir; ++dj) {
+				f_new[targets[ak + dj*Nfluid]] = f_node[dj];
+			}
+		}
+	}
+	// Every slot was written
+	std::swap(temp_f_dist, f_dist);
+	fluid_1.invalidate_moments();
+}
+
+// Two fluid species - two phase time step in two passes over the fluid nodes
+void SparseLBM::step(Fluid& fluid_1, Fluid& fluid_2, const std::vector<double>& force)
+{
+	if (force.size() != Ndir) {
+		throw std::invalid_argument("Volume force needs one value per lattice direction");
+	}
+	check_compact(fluid_1);
+	check_compact(fluid_2);
+
+	if ((fluid_1.get_fluid_solid_force_x().size() < Nfluid) || (fluid_2.get_fluid_solid_force_x().size() < Nfluid)) {
+		throw std::runtime_error("Fluid-solid forces need to be computed before the first step");
+	}
+	// Densities are kept in the compact storage
+	first_touch_resize(fluid_1.get_rho(), 1, Nfluid, 1);
+	first_touch_resize(fluid_2.get_rho(), 1, Nfluid, 1);
+
+	LatticeVector<double>& f_dist_1 = fluid_1.get_f_dist();
+	const RestrictPtr<const double> f_1 = array_ptr(f_dist_1);
+	const RestrictPtr<double> rho_1 = array_ptr(fluid_1.get_rho());
+	const RestrictPtr<const double> Fs_x_1 = array_ptr(fluid_1.get_fluid_solid_force_x());
+	const RestrictPtr<const double> Fs_y_1 = array_ptr(fluid_1.get_fluid_solid_force_y());
+	const double omega_1 = fluid_1.get_omega();
+	const double inv_omega_1 = 1.0/omega_1;
+	const double Gf_1 = -1.0*fluid_1.get_repulsive_g_fluid();
+
+	LatticeVector<double>& f_dist_2 = fluid_2.get_f_dist();
+	const RestrictPtr<const double> f_2 = array_ptr(f_dist_2);
+	const RestrictPtr<double> rho_2 = array_ptr(fluid_2.get_rho());
+	const RestrictPtr<const double> Fs_x_2 = array_ptr(fluid_2.get_fluid_solid_force_x());
+	const RestrictPtr<const double> Fs_y_2 = array_ptr(fluid_2.get_fluid_solid_force_y());
+	const double omega_2 = fluid_2.get_omega();
+	const double inv_omega_2 = 1.0/omega_2;
+	const double Gf_2 = -1.0*fluid_2.get_repulsive_g_fluid();
+
+	const RestrictPtr<double> f_new_1 = array_ptr(temp_f_dist);
+	const RestrictPtr<double> f_new_2 = array_ptr(temp_f_dist_spare);
+	const RestrictPtr<const double> f_force = array_ptr(force);
+	const RestrictPtr<const std::uint32_t> neighbors = array_ptr(fluid_neighbors);
+	const RestrictPtr<const std::uint32_t> targets = array_ptr(stream_targets);
+	const double tol = 1e-16;
+
+	#pragma omp parallel
+	{
+		const NodeRange block = thread_block(Nfluid);
+
+		// First pass - densities of both fluids, they are also the potentials
+		// for the repulsive interactions with the neighbors
+		for (size_t ak = block.begin; ak < block.end; ++ak) {
+			rho_1[ak] = 0.0;
+			rho_2[ak] = 0.0;
+			for (size_t dj = 0; dj < Ndir; ++dj) {
+				rho_1[ak] += f_1[ak + dj*Nfluid];
+				rho_2[ak] += f_2[ak + dj*Nfluid];
+			}
+		}
+		// Neighbor densities from other blocks are needed next
+		#pragma omp barrier
+
+		// Second pass - everything else node by node
+		double f_node_1[Ndir] = {}, f_node_2[Ndir] = {}, feq[Ndir] = {};
+		double Fx_1 = 0.0, Fy_1 = 0.0, Fx_2 = 0.0, Fy_2 = 0.0;
+		double jx_1 = 0.0, jy_1 = 0.0, jx_2 = 0.0, jy_2 = 0.0;
+		double uc_x = 0.0, uc_y = 0.0, u_eq_x = 0.0, u_eq_y = 0.0;
+		std::uint32_t ij = 0;
+		size_t ijk = 0;
+
+		for (size_t ak = block.begin; ak < block.end; ++ak) {
+			// Repulsive fluid-fluid forces from the neighbor potentials
+			Fx_1 = 0.0; Fy_1 = 0.0; Fx_2 = 0.0; Fy_2 = 0.0;
+			for (size_t dj = 1; dj < Ndir; ++dj) {
+				ij = neighbors[ak + dj*Nfluid];
+				if (ij == no_neighbor) {
+					continue;
+				}
+				Fx_1 += Lattice::w[dj]*Lattice::cx[dj]*rho_2[ij];
+				Fy_1 += Lattice::w[dj]*Lattice::cy[dj]*rho_2[ij];
+				Fx_2 += Lattice::w[dj]*Lattice::cx[dj]*rho_1[ij];
+				Fy_2 += Lattice::w[dj]*Lattice::cy[dj]*rho_1[ij];
+			}
+			Fx_1 *= Gf_1*rho_1[ak];
+			Fy_1 *= Gf_1*rho_1[ak];
+			Fx_2 *= Gf_2*rho_2[ak];
+			Fy_2 *= Gf_2*rho_2[ak];
+
+			// Unweighted (by density) macroscopic velocities
+			jx_1 = 0.0; jy_1 = 0.0; jx_2 = 0.0; jy_2 = 0.0;
+			for (size_t dj = 0; dj < Ndir; ++dj) {
+				ijk = ak + dj*Nfluid;
+				f_node_1[dj] = f_1[ijk];
+				f_node_2[dj] = f_2[ijk];
+				jx_1 += f_node_1[dj]*Lattice::cx[dj];
+				jy_1 += f_node_1[dj]*Lattice::cy[dj];
+				jx_2 += f_node_2[dj]*Lattice::cx[dj];
+				jy_2 += f_node_2[dj]*Lattice::cy[dj];
+			}
+
+			// Composite velocity
+			uc_x = (jx_1*omega_1+jx_2*omega_2)/(rho_1[ak]*omega_1+rho_2[ak]*omega_2);
+			uc_y = (jy_1*omega_1+jy_2*omega_2)/(rho_1[ak]*omega_1+rho_2[ak]*omega_2);
+
+			// Equilibrium velocity, collision, and volume force - first fluid
+			u_eq_x = uc_x;
+			u_eq_y = uc_y;
+			if (!equal_floats(rho_1[ak], 0.0, tol)) {
+				u_eq_x = uc_x + Fx_1*inv_omega_1/rho_1[ak] + Fs_x_1[ak]*inv_omega_1;
+				u_eq_y = uc_y + Fy_1*inv_omega_1/rho_1[ak] + Fs_y_1[ak]*inv_omega_1;
+			}
+			fluid_1.node_f_equilibrium(rho_1[ak], u_eq_x, u_eq_y, feq);
+			for (size_t dj = 0; dj < Ndir; ++dj) {
+				f_node_1[dj] = (1.0 - omega_1)*f_node_1[dj] + omega_1*feq[dj];
+				f_node_1[dj] += f_force[dj];
+			}
+
+			// Second fluid
+			u_eq_x = uc_x;
+			u_eq_y = uc_y;
+			if (!equal_floats(rho_2[ak], 0.0, tol)) {
+				u_eq_x = uc_x + Fx_2*inv_omega_2/rho_2[ak] + Fs_x_2[ak]*inv_omega_2;
+				u_eq_y = uc_y + Fy_2*inv_omega_2/rho_2[ak] + Fs_y_2[ak]*inv_omega_2;
+			}
+			fluid_2.node_f_equilibrium(rho_2[ak], u_eq_x, u_eq_y, feq);
+			for (size_t dj = 0; dj < Ndir; ++dj) {
+				f_node_2[dj] = (1.0 - omega_2)*f_node_2[dj] + omega_2*feq[dj];
+				f_node_2[dj] += f_force[dj];
+			}
+
+			// Streaming with bounce-back resolved in the table
+			for (size_t dj = 0; dj < Ndir; ++dj) {
+				ijk = targets[ak + dj*Nfluid];
+				f_new_1[ijk] = f_node_1[dj];
+				f_new_2[ijk] = f_node_2[dj];
+			}
+		}
+	}
+	// Every slot was written
+	std::swap(temp_f_dist, f_dist_1);
+	std::swap(temp_f_dist_spare, f_dist_2);
+	fluid_1.invalidate_moments();
+	fluid_2.invalidate_moments();
+}
+
+//
+// Private methods
+//
+
+// Compute the fluid node numbering and the compact tables
+void SparseLBM::build_lattice_tables(const Geometry& geom)
+{
+	if (Ntot*Ndir >= static_cast<size_t>(no_neighbor)) {
+		throw std::runtime_error("Domain too large for 32-bit lattice tables");
+	}
+
+	// Fluid nodes in the row-major order, compact index of each lattice node
+	std::vector<std::uint32_t> compact_index(Ntot, no_neighbor);
+	fluid_nodes.clear();
+	for (size_t ai = 0; ai < Ntot; ++ai) {
+		if (geom(ai) == 1) {
+			compact_index.at(ai) = static_cast<std::uint32_t>(fluid_nodes.size());
+			fluid_nodes.push_back(static_cast<std::uint32_t>(ai));
+		}
+	}
+	Nfluid = fluid_nodes.size();
+
+	// Tables are read in the same blocks as the distributions
+	first_touch_resize(fluid_neighbors, 1, Nfluid, Ndir);
+	first_touch_resize(stream_targets, 1, Nfluid, Ndir);
+
+	#pragma omp parallel
+	{
+		const NodeRange block = thread_block(Nfluid);
+		int inei = 0, jnei = 0;
+		int xi = 0, yj = 0;
+		size_t ai = 0;
+		std::uint32_t kn = 0;
+		for (size_t ak = block.begin; ak < block.end; ++ak) {
+			ai = fluid_nodes[ak];
+			xi = ai%Nx;
+			yj = ((ai-xi)/Nx)%Ny;
+			fluid_neighbors.at(ak) = static_cast<std::uint32_t>(ak);
+			stream_targets.at(ak) = static_cast<std::uint32_t>(ak);
+			for (size_t dj = 1; dj < Ndir; ++dj) {
+				// Counting for periodic boundaries
+				if (Lattice::cx[dj] > 0) {
+					inei = (xi+Lattice::cx[dj] < static_cast<int>(Nx)) ? (xi+Lattice::cx[dj]) : 0;
+				} else {
+					inei = (xi+Lattice::cx[dj] >= 0) ? (xi+Lattice::cx[dj]) : static_cast<int>(Nx)-1;
+				}
+				if (Lattice::cy[dj] > 0) {
+					jnei = (yj+Lattice::cy[dj] < static_cast<int>(Ny)) ? (yj+Lattice::cy[dj]) : 0;
+				} else {
+					jnei = (yj+Lattice::cy[dj] >= 0) ? (yj+Lattice::cy[dj]) : static_cast<int>(Ny)-1;
+				}
+				// Streaming to a fluid neighbor or bounce-back from a solid one
+				kn = compact_index[jnei*Nx + inei];
+				fluid_neighbors.at(ak + dj*Nfluid) = kn;
+				if (kn != no_neighbor) {
+					stream_targets.at(ak + dj*Nfluid) = static_cast<std::uint32_t>(dj*Nfluid + kn);
+				} else {
+					stream_targets.at(ak + dj*Nfluid) = static_cast<std::uint32_t>(Lattice::opposite[dj]*Nfluid + ak);
+				}
+			}
+		}
+	}
+}
+
+// Compact copy of a dense array of Nplanes planes
+LatticeVector<double> SparseLBM::compact_array(const LatticeVector<double>& dense, const size_t Nplanes) const
+{
+	LatticeVector<double> compact;
+	first_touch_resize(compact, 1, Nfluid, Nplanes);
+	#pragma omp parallel
+	{
+		const NodeRange block = thread_block(Nfluid);
+		for (size_t k = 0; k < Nplanes; ++k) {
+			for (size_t ak = block.begin; ak < block.end; ++ak) {
+				compact[ak + k*Nfluid] = dense[fluid_nodes[ak] + k*Ntot];
+			}
+		}
+	}
+	return compact;
+}
+
+// Dense copy of a compact array of Nplanes planes, zero in solid nodes
+LatticeVector<double> SparseLBM::dense_array(const LatticeVector<double>& compact, const size_t Nplanes) const
+{
+	LatticeVector<double> dense;
+	first_touch_resize(dense, Nx, Ny, Nplanes);
+	#pragma omp parallel
+	{
+		const NodeRange block = thread_block(Nfluid);
+		for (size_t k = 0; k < Nplanes; ++k) {
+			for (size_t ak = block.begin; ak < block.end; ++ak) {
+				dense[fluid_nodes[ak] + k*Ntot] = compact[ak + k*Nfluid];
+			}
+		}
+	}
+	return dense;
+}
+
+// Throws if the distribution of the fluid is not in the compact storage
+void SparseLBM::check_compact(const Fluid& fluid) const
+{
+	if (fluid.get_f_dist().size() != Nfluid*Ndir) {
+		throw std::runtime_error("Fluid needs to be compacted with this SparseLBM first");
+	}
+}
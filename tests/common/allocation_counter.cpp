@@ -0,0 +1,78 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "allocation_counter.h"
+
+/*************************************************************** 
+ * Heap allocation counter for tests - replacement global
+ * operator new and delete
+ **************************************************************/
+
+namespace {
+	std::atomic<bool> counting{false};
+	std::atomic<size_t> allocations{0};
+
+	void* counted_malloc(const size_t bytes)
+	{
+		if (counting.load(std::memory_order_relaxed)) {
+			allocations.fetch_add(1, std::memory_order_relaxed);
+		}
+		return std::malloc((bytes > 0) ? bytes : 1);
+	}
+}
+
+void start_allocation_count()
+{
+	allocations.store(0);
+	counting.store(true);
+}
+
+size_t stop_allocation_count()
+{
+	counting.store(false);
+	return allocations.load();
+}
+
+void* operator new(size_t bytes)
+{
+	void* ptr = counted_malloc(bytes);
+	if (!ptr) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void* operator new[](size_t bytes)
+{
+	return operator new(bytes);
+}
+
+void* operator new(size_t bytes, const std::nothrow_t&) noexcept
+{
+	return counted_malloc(bytes);
+}
+
+void* operator new[](size_t bytes, const std::nothrow_t&) noexcept
+{
+	return counted_malloc(bytes);
+}
+
+void operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+	std::free(ptr);
+}
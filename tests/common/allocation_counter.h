@@ -0,0 +1,27 @@
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+#include <cstddef>
+
+/*************************************************************** 
+ * Heap allocation counter for tests
+ *
+ * Opt-in - linking allocation_counter.cpp replaces the global
+ * operator new and delete of the test program with versions
+ * that count allocations between the calls below. Lattice
+ * arrays are allocated through operator new too, so every
+ * heap allocation of the library code is counted.
+***************************************************************/
+
+/**
+ * \brief Start counting heap allocations of all threads from zero
+ */
+void start_allocation_count();
+
+/**
+ * \brief Stop counting
+ * @returns number of allocations since start_allocation_count()
+ */
+size_t stop_allocation_count();
+
+#endif
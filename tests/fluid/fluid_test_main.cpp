@@ -12,6 +12,8 @@
 bool empty_geom();
 bool fluid_with_walls();
 bool object_array();
+bool lazy_macroscopic();
+bool momentum_with_density();
 
 // Supporting functions
 bool check_from_files(const std::string&, const double, const Geometry&);
@@ -23,6 +25,8 @@ int main()
 	test_pass(empty_geom(), "Just the fluid");
 	test_pass(fluid_with_walls(), "Fluid surrounded by walls");
 	test_pass(object_array(), "Fluid and a staggered array");
+	test_pass(lazy_macroscopic(), "Density and velocities computed only when out of date");
+	test_pass(momentum_with_density(), "Momentum computed with the density, one and two fluids");
 }
 
 bool empty_geom()
@@ -191,13 +195,193 @@ bool check_values(const std::string& fname, const double exp_value, const Geomet
 	return true;
 }
 
+/// Density and velocities computed once per change of the distribution, 
+/// the same in one pass as in separate ones
+bool lazy_macroscopic()
+{
+	const size_t Nx = 15, Ny = 12, Ntot = Nx*Ny, Ndir = 9;
+	Geometry geom(Nx, Ny);
+	geom.add_walls(1, "x");
+	Fluid fluid;
+	fluid.simple_ini(geom, 1.2);
+	if (fluid.is_density_current() || fluid.are_velocities_current()) {
+		std::cerr << "Initialized fluid has no density and velocities yet" << std::endl;
+		return false;
+	}
+	// Distribution with a flow
+	LatticeVector<double>& f_dist = fluid.get_f_dist();
+	for (size_t ai = 0; ai < Ntot; ++ai) {
+		for (size_t dj = 0; dj < Ndir; ++dj) {
+			f_dist.at(ai + dj*Ntot) *= 1.0 + 0.01*dj + 0.001*(ai%7);
+		}
+	}
+
+	// Density first, then velocities with that density
+	Fluid separate(fluid);
+	separate.compute_density();
+	if (!separate.is_density_current() || separate.are_velocities_current()) {
+		std::cerr << "Only the density should be up to date" << std::endl;
+		return false;
+	}
+	separate.compute_velocities(geom);
+	// Both in one pass
+	fluid.compute_velocities(geom);
+	if (!fluid.is_density_current() || !fluid.are_velocities_current()) {
+		std::cerr << "Density and velocities should be up to date" << std::endl;
+		return false;
+	}
+	const Fluid& fluid_ref = fluid;
+	const Fluid& separate_ref = separate;
+	if ((fluid_ref.get_rho() != separate_ref.get_rho()) || (fluid_ref.get_ux() != separate_ref.get_ux()) 
+			|| (fluid_ref.get_uy() != separate_ref.get_uy())) {
+		std::cerr << "One pass and separate moments differ" << std::endl;
+		return false;
+	}
+	// Expected moments
+	for (size_t ai = 0; ai < Ntot; ++ai) {
+		double rho = 0.0, jx = 0.0;
+		for (size_t dj = 0; dj < Ndir; ++dj) {
+			rho += fluid_ref.get_f_dist().at(ai + dj*Ntot);
+			jx += fluid_ref.get_f_dist().at(ai + dj*Ntot)*Lattice::cx[dj];
+		}
+		const double ux = (geom(ai) == 1) ? jx/rho : 0.0;
+		if (!float_equality<double>(fluid_ref.get_rho().at(ai), rho, 1e-12) 
+				|| !float_equality<double>(fluid_ref.get_ux().at(ai), ux, 1e-12)) {
+			std::cerr << "Wrong density or velocity" << std::endl;
+			return false;
+		}
+	}
+
+	// Const and macroscopic getters do not change anything
+	fluid_ref.get_f_dist();
+	fluid.get_rho();
+	if (!fluid.is_density_current() || !fluid.are_velocities_current()) {
+		std::cerr << "Read-only getters should not make the moments out of date" << std::endl;
+		return false;
+	}
+	// Modified distribution is noticed
+	fluid.get_f_dist().at(Nx + 4) += 0.5;
+	if (fluid.is_density_current() || fluid.are_velocities_current() || fluid.is_momentum_current()) {
+		std::cerr << "Modified distribution should make the moments out of date" << std::endl;
+		return false;
+	}
+	// Also through a reference kept from before a computation, once invalidated
+	LatticeVector<double>& kept = fluid.get_f_dist();
+	fluid.compute_macroscopic(geom);
+	kept.at(Nx + 4) -= 0.5;
+	fluid.invalidate_moments();
+	fluid.compute_macroscopic(geom);
+	if (!float_equality<double>(fluid_ref.get_rho().at(Nx + 4), separate_ref.get_rho().at(Nx + 4), 1e-12)) {
+		std::cerr << "Density not recomputed after invalidation" << std::endl;
+		return false;
+	}
+	kept.at(Nx + 4) += 0.5;
+	fluid.invalidate_moments();
+	fluid.compute_macroscopic(geom);
+	if (!float_equality<double>(fluid_ref.get_rho().at(Nx + 4), separate_ref.get_rho().at(Nx + 4) + 0.5, 1e-12)) {
+		std::cerr << "Density not recomputed after a change" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+/// Momentum from the density pass, the momentum pass, and the two fluid pass
+bool momentum_with_density()
+{
+	const size_t Nx = 11, Ny = 9, Ntot = Nx*Ny, Ndir = 9;
+	Geometry geom(Nx, Ny);
+	geom.add_walls(1, "y");
+	Fluid fluid_1, fluid_2;
+	fluid_1.simple_ini(geom, 1.0);
+	fluid_2.simple_ini(geom, 0.3);
+	for (Fluid* fluid : {&fluid_1, &fluid_2}) {
+		LatticeVector<double>& f_dist = fluid->get_f_dist();
+		for (size_t ai = 0; ai < Ntot; ++ai) {
+			for (size_t dj = 0; dj < Ndir; ++dj) {
+				f_dist.at(ai + dj*Ntot) *= 1.0 + 0.02*dj*(ai%3);
+			}
+		}
+	}
+	Fluid only_momentum_1(fluid_1), only_momentum_2(fluid_2);
+	Fluid pair_1(fluid_1), pair_2(fluid_2);
+	// Reads through it keep the moments
+	const LatticeVector<double>& f_dist_1 = static_cast<const Fluid&>(fluid_1).get_f_dist();
+
+	// Density pass fills the momentum once its arrays exist
+	fluid_1.compute_density();
+	if (fluid_1.is_momentum_current() || !fluid_1.get_momentum_x().empty()) {
+		std::cerr << "Density pass should not store the momentum before it was computed" << std::endl;
+		return false;
+	}
+	for (Fluid* fluid : {&fluid_1, &fluid_2}) {
+		fluid->compute_momentum();
+		fluid->invalidate_moments();
+	}
+	fluid_1.compute_density();
+	only_momentum_1.compute_momentum();
+	Fluid::compute_momentum(pair_1, pair_2);
+	if (!fluid_1.is_momentum_current() || !pair_1.is_momentum_current() || !pair_2.is_momentum_current()) {
+		std::cerr << "Momentum should be up to date" << std::endl;
+		return false;
+	}
+	if (only_momentum_1.is_density_current()) {
+		std::cerr << "Momentum pass should not compute the density" << std::endl;
+		return false;
+	}
+	fluid_2.compute_density();
+	for (size_t ai = 0; ai < Ntot; ++ai) {
+		double jx = 0.0, jy = 0.0;
+		for (size_t dj = 0; dj < Ndir; ++dj) {
+			jx += f_dist_1.at(ai + dj*Ntot)*Lattice::cx[dj];
+			jy += f_dist_1.at(ai + dj*Ntot)*Lattice::cy[dj];
+		}
+		if (!float_equality<double>(fluid_1.get_momentum_x().at(ai), jx, 1e-12) 
+				|| !float_equality<double>(fluid_1.get_momentum_y().at(ai), jy, 1e-12)) {
+			std::cerr << "Wrong momentum" << std::endl;
+			return false;
+		}
+	}
+	if ((only_momentum_1.get_momentum_x() != fluid_1.get_momentum_x()) || (pair_1.get_momentum_y() != fluid_1.get_momentum_y())
+			|| (pair_2.get_momentum_x() != fluid_2.get_momentum_x())) {
+		std::cerr << "Momentum differs among the passes" << std::endl;
+		return false;
+	}
+	// Velocities follow from the momentum without reading the distribution,
+	// from a fluid without momentum arrays they come from the distribution
+	Fluid fresh(fluid_1), no_momentum;
+	no_momentum.simple_ini(geom, 1.0);
+	no_momentum.get_f_dist() = f_dist_1;
+	if (!fluid_1.is_momentum_current()) {
+		std::cerr << "Const reads should keep the momentum" << std::endl;
+		return false;
+	}
+	fresh.invalidate_moments();
+	fluid_1.compute_velocities(geom);
+	fresh.compute_velocities(geom);
+	no_momentum.compute_velocities(geom);
+	if (!fluid_1.is_momentum_current() || (fluid_1.get_ux() != fresh.get_ux()) || (fluid_1.get_uy() != fresh.get_uy())
+			|| (no_momentum.get_ux() != fresh.get_ux()) || (no_momentum.get_uy() != fresh.get_uy())) {
+		std::cerr << "Velocities from the momentum differ" << std::endl;
+		return false;
+	}
+	// Velocity arrays never hold the momentum
+	const LatticeVector<double> ux = fluid_1.get_ux();
+	fluid_1.invalidate_moments();
+	fluid_1.compute_density();
+	if ((fluid_1.get_ux() != ux) || (fluid_1.get_momentum_x() == ux)) {
+		std::cerr << "Density pass should only write the density and the momentum" << std::endl;
+		return false;
+	}
+	return true;
+}
+
 /// Verifies correctness of the equilibrium density distribution for zero velocity
 bool check_equilibrium_distribution(Fluid& fluid, const size_t Nx, const size_t Ny, const Geometry& geom)
 {
 	fluid.compute_f_equilibrium(geom);
 	size_t Ntot = Nx*Ny;
-	const std::vector<double>& f_eq_dist = fluid.get_f_eq_dist(); 
-	const std::vector<double>& rho = fluid.get_rho();
+	const LatticeVector<double>& f_eq_dist = fluid.get_f_eq_dist(); 
+	const LatticeVector<double>& rho = fluid.get_rho();
 	std::vector<double> wrts = fluid.get_wrts();
 	double tol = 1e-5;
 
@@ -208,14 +392,14 @@ bool check_equilibrium_distribution(Fluid& fluid, const size_t Nx, const size_t
 			return false;
 		}
 		for (int idir = 1; idir <= 4; ++idir) {
-			if (!float_equality<double>(f_eq_dist.at(ai + idir*Ntot), rho.at(ai)*wrts.at(1), tol)) {
+			if (!float_equality<double>(f_eq_dist.at(ai + idir*Ntot), rho.at(ai)*wrts.at(idir), tol)) {
 				std::cerr << "Wrong value of the equilibrium distribution" 
 						  << " function in the direction  " << idir << std::endl;
 				return false;
 			}
 		}
 		for (int idir = 5; idir <= 8; ++idir) {
-			if (!float_equality<double>(f_eq_dist.at(ai + idir*Ntot), rho.at(ai)*wrts.at(2), tol)) {
+			if (!float_equality<double>(f_eq_dist.at(ai + idir*Ntot), rho.at(ai)*wrts.at(idir), tol)) {
 				std::cerr << "Wrong value of the equilibrium distribution" 
 						  << " function in the direction  " << idir << std::endl;
 				return false;
@@ -237,8 +237,8 @@ bool check_equilibrium_distribution(Fluid& fluid, const size_t Nx, const size_t
 {
 	fluid.compute_f_equilibrium();
 	size_t Ntot = Nx*Ny;
-	const std::vector<double>& f_eq_dist = fluid.get_f_eq_dist(); 
-	const std::vector<double>& rho = fluid.get_rho();
+	const LatticeVector<double>& f_eq_dist = fluid.get_f_eq_dist(); 
+	const LatticeVector<double>& rho = fluid.get_rho();
 	std::vector<double> wrts = fluid.get_wrts();
 	double tol = 1e-5;
 
@@ -249,14 +249,14 @@ bool check_equilibrium_distribution(Fluid& fluid, const size_t Nx, const size_t
 			return false;
 		}
 		for (int idir = 1; idir <= 4; ++idir) {
-			if (!float_equality<double>(f_eq_dist.at(ai + idir*Ntot), rho.at(ai)*wrts.at(1), tol)) {
+			if (!float_equality<double>(f_eq_dist.at(ai + idir*Ntot), rho.at(ai)*wrts.at(idir), tol)) {
 				std::cerr << "Wrong value of the equilibrium distribution" 
 						  << " function in the direction  " << idir << std::endl;
 				return false;
 			}
 		}
 		for (int idir = 5; idir <= 8; ++idir) {
-			if (!float_equality<double>(f_eq_dist.at(ai + idir*Ntot), rho.at(ai)*wrts.at(2), tol)) {
+			if (!float_equality<double>(f_eq_dist.at(ai + idir*Ntot), rho.at(ai)*wrts.at(idir), tol)) {
 				std::cerr << "Wrong value of the equilibrium distribution" 
 						  << " function in the direction  " << idir << std::endl;
 				return false;
@@ -11,7 +11,8 @@ path_exe = '../../executables/'
 cx = 'g++'
 std = '-std=c++11'
 opt = '-O0'
-other = '-Wall'
+# Debug configuration - bounds-checked array access in the kernels
+other = '-Wall -DLBM_CHECKED'
 # Common source files
 src_files = path + 'geometry.cpp' + ' ' + path + 'misc_checks.cpp '
 src_files += path + 'geom_object/rectangle.cpp' + ' ' + path + 'geom_object/ellipse.cpp'
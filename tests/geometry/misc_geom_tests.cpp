@@ -11,6 +11,8 @@ void y_wall_test_suite();
 void wall_exception_suite();
 bool indexing_test();
 bool changing_individual_nodes_test();
+bool node_types_test();
+bool fluid_bitmask_test();
 
 // Supporting functions
 void make_walls(const size_t, const size_t, const size_t, const std::string);
@@ -33,6 +35,8 @@ int main()
 	wall_exception_suite();
 	test_pass(indexing_test(), "Indexing");	
 	test_pass(changing_individual_nodes_test(), "Changing individual nodes");
+	test_pass(node_types_test(), "Compact node types");
+	test_pass(fluid_bitmask_test(), "Packed fluid bitmask");
 }
 
 /// \brief Reads a geometry file, then writes it to a separate file
@@ -187,3 +191,66 @@ void make_and_save_walls(const size_t Nx, const size_t Ny, const std::string fna
 	geom.add_walls(dh, dir);
 	geom.write(fname);
 }
+
+/// \brief Checks the node type flags 
+/// \details Walls in y, a single solid node in the middle, 
+///		and a single solid node on the bottom edge
+bool node_types_test()
+{
+	size_t Nx = 12, Ny = 9;
+	Geometry geom(Nx, Ny);
+	geom.add_walls(1, "y");
+	geom.set_node_solid(6, 4);
+	geom.set_node_solid(4, 0);
+	const std::vector<std::uint8_t> types = geom.node_types();
+	if (types.size() != Nx*Ny) {
+		return false;
+	}
+	// Expected flags from the definition
+	for (size_t yi = 0; yi < Ny; ++yi) {
+		for (size_t xi = 0; xi < Nx; ++xi) {
+			std::uint8_t expected = Geometry::solid;
+			if (geom(xi, yi) == 1) {
+				expected = Geometry::fluid;
+				if ((yi == 0) || (yi == Ny - 1)) {
+					expected |= Geometry::periodic_edge;
+				}
+				// Next to the walls, the middle node, or the edge node 
+				// that is also next to the top edge through the periodic boundary
+				if ((xi == 1) || (xi == Nx - 2) 
+						|| ((xi >= 5) && (xi <= 7) && (yi >= 3) && (yi <= 5)) 
+						|| ((xi >= 3) && (xi <= 5) && ((yi <= 1) || (yi == Ny - 1)))) {
+					expected |= Geometry::wall_adjacent;
+				}
+			}
+			if (types.at(yi*Nx + xi) != expected) {
+				return false;
+			}
+		}
+	}
+	// Bulk nodes have no flag other than fluid
+	return (types.at(2*Nx + 3) == Geometry::fluid);
+}
+
+/// \brief Checks the packed fluid bitmask against the geometry 
+bool fluid_bitmask_test()
+{
+	size_t Nx = 30, Ny = 7;
+	Geometry geom(Nx, Ny);
+	geom.add_walls(2, "x");
+	geom.set_node_solid(17, 3);
+	geom.set_node_solid(29, 5);
+	const std::vector<std::uint64_t> mask = geom.fluid_bitmask();
+	// Last word is partially used
+	if (mask.size() != (Nx*Ny + 63)/64) {
+		return false;
+	}
+	for (size_t ind = 0; ind < Nx*Ny; ++ind) {
+		const bool bit = ((mask.at(ind/64) >> (ind%64)) & 1) == 1;
+		if (bit != (geom(ind) == 1)) {
+			return false;
+		}
+	}
+	// Unused bits are zero
+	return ((mask.back() >> ((Nx*Ny)%64)) == 0);
+}
@@ -0,0 +1,164 @@
+#include "../../include/lbm.h"
+#include "../common/test_utils.h"
+#include "../common/allocation_counter.h"
+#include "lbm_tests.h"
+
+/*****************************************************
+ *
+ * Test suite for heap allocations of the time steps -
+ *	after the first steps (setup of the workers and
+ *	tiles) steps need to run without any
+ *
+ *****************************************************/
+
+bool single_phase_allocation_test();
+bool two_phase_allocation_test();
+bool step_variants_allocation_test();
+
+// Supporting functions
+Geometry make_allocation_geometry();
+std::vector<double> make_force(const double scale);
+// Allocations of nsteps calls of step(), counted after warm_up calls
+template <typename Step>
+size_t count_step_allocations(Step step, const int warm_up, const int nsteps);
+
+int main()
+{
+	test_pass(single_phase_allocation_test(), "Single phase steps without heap allocations");
+	test_pass(two_phase_allocation_test(), "Two phase steps without heap allocations");
+	test_pass(step_variants_allocation_test(), "Schedules, in-place streaming, padded, and blocked steps without heap allocations");
+}
+
+/// Two-lattice and single precision steps, serial and parallel
+bool single_phase_allocation_test()
+{
+	Geometry geom = make_allocation_geometry();
+	const std::vector<double> force = make_force(1e-5);
+
+	for (const int nthreads : {1, 3}) {
+		set_num_threads(nthreads);
+		Fluid fluid("fluid", 1.0/3, 0.8);
+		fluid.simple_ini(geom, 1.5);
+		LBM lbm(geom);
+		const size_t count = count_step_allocations([&]() { lbm.step(geom, fluid, force); }, 2, 10);
+
+		Fluid float_fluid("float", 1.0/3, 0.8);
+		float_fluid.simple_ini(geom, 1.5);
+		LBM lbm_float(geom, LBM::two_lattice, LBM::mixed_precision);
+		lbm_float.compress(geom, float_fluid);
+		const size_t count_float = count_step_allocations([&]() { lbm_float.step(geom, float_fluid, force); }, 2, 10);
+
+		set_num_threads(1);
+		if ((count != 0) || (count_float != 0)) {
+			std::cerr << "Single phase steps with " << nthreads << " threads allocated "
+						<< count << " and " << count_float << " times" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+/// Droplet in a channel, serial and parallel
+bool two_phase_allocation_test()
+{
+	Geometry geom = make_allocation_geometry();
+	const std::vector<double> force = make_force(1e-6);
+
+	for (const int nthreads : {1, 3}) {
+		set_num_threads(nthreads);
+		LBM lbm(geom);
+		Fluid bulk("bulk", 1.0/3, 1.0), droplet("droplet", 1.0/3, 0.9);
+		bulk.zero_density_ini(geom);
+		droplet.zero_density_ini(geom);
+		bulk.initialize_interactions(0.1, 0.9);
+		droplet.initialize_interactions(-0.1, 0.9);
+		lbm.initialize_fluid_rectangle(geom, bulk, droplet, 2.0, 2.0, 0.06, 0.06, 30, 20, 8, 6);
+		lbm.compute_solid_surface_force(geom, bulk, droplet);
+		// Repeated setup overwrites the forces
+		lbm.compute_solid_surface_force(geom, bulk, droplet);
+		if (bulk.get_fluid_solid_force_x().size() != geom.Nx()*geom.Ny()) {
+			std::cerr << "Fluid-solid forces appended instead of overwritten" << std::endl;
+			set_num_threads(1);
+			return false;
+		}
+		const size_t count = count_step_allocations([&]() { lbm.step(geom, bulk, droplet, force); }, 2, 10);
+
+		set_num_threads(1);
+		if (count != 0) {
+			std::cerr << "Two phase steps with " << nthreads << " threads allocated "
+						<< count << " times" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+/// Work stealing, in-place streaming, overlapped halo exchange, padded layout, and temporal blocking
+bool step_variants_allocation_test()
+{
+	Geometry geom = make_allocation_geometry();
+	const std::vector<double> force = make_force(1e-5);
+	set_num_threads(3);
+
+	Fluid fluid("fluid", 1.0/3, 0.8);
+	fluid.simple_ini(geom, 1.5);
+	LBM lbm_tiles(geom);
+	lbm_tiles.set_schedule(LBM::work_stealing);
+	const size_t count_tiles = count_step_allocations([&]() { lbm_tiles.step(geom, fluid, force); }, 2, 10);
+
+	LBM lbm_aa(geom, LBM::aa_pattern);
+	const size_t count_aa = count_step_allocations([&]() { lbm_aa.step(geom, fluid, force); }, 2, 10);
+	lbm_aa.synchronize(geom, fluid);
+
+	LBM lbm_halo(geom);
+	LBM::HaloExchange no_exchange;
+	const size_t count_halo = count_step_allocations([&]() { lbm_halo.step(geom, fluid, force, no_exchange); }, 2, 10);
+
+	LBM lbm_padded(geom, LBM::two_lattice, LBM::double_precision, LBM::padded);
+	lbm_padded.pad(geom, fluid);
+	const size_t count_padded = count_step_allocations([&]() { lbm_padded.step(geom, fluid, force); }, 2, 10);
+	lbm_padded.unpad(geom, fluid);
+
+	LBM lbm_blocked(geom);
+	const size_t count_blocked = count_step_allocations([&]() { lbm_blocked.advance(geom, fluid, force, 9, 4); }, 1, 3);
+	set_num_threads(1);
+
+	if ((count_tiles != 0) || (count_aa != 0) || (count_halo != 0) || (count_padded != 0) || (count_blocked != 0)) {
+		std::cerr << "Allocations in the step variants: work stealing " << count_tiles
+					<< ", aa pattern " << count_aa << ", halo " << count_halo
+					<< ", padded " << count_padded << ", blocked " << count_blocked << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Channel with an object
+Geometry make_allocation_geometry()
+{
+	Geometry geom(60, 41);
+	geom.add_walls(2, "y");
+	geom.add_ellipse(9, 7, 20, 20);
+	return geom;
+}
+
+// Multidirectional volume force
+std::vector<double> make_force(const double scale)
+{
+	std::vector<double> force{0, 1, 0, -1, 0, 1, -1, -1, 1};
+	std::for_each(force.begin(), force.end(), [scale](double& el) { el *= scale; });
+	return force;
+}
+
+// Allocations of nsteps calls of step(), counted after warm_up calls
+template <typename Step>
+size_t count_step_allocations(Step step, const int warm_up, const int nsteps)
+{
+	for (int iter = 0; iter < warm_up; ++iter) {
+		step();
+	}
+	start_allocation_count();
+	for (int iter = 0; iter < nsteps; ++iter) {
+		step();
+	}
+	return stop_allocation_count();
+}
@@ -0,0 +1,229 @@
+#include "../../include/lbm.h"
+#include "../common/test_utils.h"
+#include "lbm_tests.h"
+
+/*****************************************************
+ *
+ * Test suite for the temporally blocked steps -
+ *	results are compared with the same number of
+ *	regular steps
+ *
+ *****************************************************/
+
+bool single_phase_blocking_test();
+bool single_phase_short_domain_test();
+bool two_phase_blocking_test();
+bool mixed_precision_blocking_test();
+bool blocking_errors_test();
+
+// Supporting functions
+bool compare_single_phase_advance(const Geometry& geom, const size_t nsteps, const size_t depth);
+bool compare_two_phase_advance(const Geometry& geom, const size_t nsteps, const size_t depth);
+
+int main()
+{
+	test_pass(single_phase_blocking_test(), "Blocked single phase steps, array of objects");
+	test_pass(single_phase_short_domain_test(), "Blocked single phase steps, fewer rows than steps");
+	test_pass(two_phase_blocking_test(), "Blocked two phase steps, droplet in a channel");
+	test_pass(mixed_precision_blocking_test(), "Blocked steps with single precision storage");
+	test_pass(blocking_errors_test(), "Configurations without temporal blocking");
+}
+
+/// Objects touching the periodic edges, several depths, number
+/// of steps not a multiple of the depth
+bool single_phase_blocking_test()
+{
+	Geometry geom(70, 31);
+	geom.add_walls(2, "y");
+	geom.add_ellipse(9, 7, 20, 3);
+	geom.add_ellipse(11, 9, 45, 18);
+	geom.set_node_solid(10, 30);
+
+	for (const size_t depth : {1, 2, 3, 4, 8}) {
+		if (!compare_single_phase_advance(geom, 23, depth)) {
+			std::cerr << "Blocked single phase steps differ for depth " << depth << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+/// Wavefront wraps around the lattice several times
+bool single_phase_short_domain_test()
+{
+	Geometry geom(20, 5);
+	geom.set_node_solid(4, 0);
+	geom.set_node_solid(12, 2);
+
+	if (!compare_single_phase_advance(geom, 17, 8)) {
+		std::cerr << "Blocked single phase steps differ in a short domain" << std::endl;
+		return false;
+	}
+	// Too short for the wavefront, regular steps
+	Geometry flat(20, 2);
+	return compare_single_phase_advance(flat, 5, 4);
+}
+
+/// Droplet flowing in a channel, densities from the last step also compared
+bool two_phase_blocking_test()
+{
+	Geometry geom(50, 36);
+	geom.add_walls(2, "y");
+	geom.add_rectangle(7, 5, 25, 3);
+
+	for (const size_t depth : {1, 3, 4, 7}) {
+		if (!compare_two_phase_advance(geom, 19, depth)) {
+			std::cerr << "Blocked two phase steps differ for depth " << depth << std::endl;
+			return false;
+		}
+	}
+	Geometry short_geom(30, 6);
+	short_geom.add_walls(1, "y");
+	if (!compare_two_phase_advance(short_geom, 11, 5)) {
+		std::cerr << "Blocked two phase steps differ in a short domain" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+/// Blocked steps on float distributions are the same as the regular ones
+bool mixed_precision_blocking_test()
+{
+	Geometry geom(40, 24);
+	geom.add_walls(1, "x");
+	geom.add_circle(7, 20, 12);
+	std::vector<double> vol_force{0, 1, 0, -1, 0, 1, -1, -1, 1};
+	std::for_each(vol_force.begin(), vol_force.end(), [](double& el) { el *= 1e-5; });
+
+	LBM lbm_regular(geom, LBM::two_lattice, LBM::mixed_precision);
+	LBM lbm_blocked(geom, LBM::two_lattice, LBM::mixed_precision);
+	Fluid regular_fluid("regular", 1.0/3, 0.8), blocked_fluid("blocked", 1.0/3, 0.8);
+	regular_fluid.simple_ini(geom, 1.5);
+	blocked_fluid.simple_ini(geom, 1.5);
+	lbm_regular.compress(geom, regular_fluid);
+	lbm_blocked.compress(geom, blocked_fluid);
+
+	for (int iter = 0; iter < 13; ++iter) {
+		lbm_regular.step(geom, regular_fluid, vol_force);
+	}
+	lbm_blocked.advance(geom, blocked_fluid, vol_force, 13, 4);
+
+	lbm_regular.expand(geom, regular_fluid);
+	lbm_blocked.expand(geom, blocked_fluid);
+	return same_distributions(regular_fluid, blocked_fluid, 1e-14);
+}
+
+/// In-place streaming, restricted rows, and zero depth are rejected
+bool blocking_errors_test()
+{
+	Geometry geom(20, 10);
+	Fluid fluid("fluid", 1.0/3, 1.0);
+	fluid.simple_ini(geom, 1.0);
+	const std::vector<double> no_force(9, 0.0);
+
+	LBM lbm_aa(geom, LBM::aa_pattern);
+	LBM lbm_rows(geom);
+	lbm_rows.set_active_rows(1, 9);
+	LBM lbm(geom);
+
+	bool thrown = false;
+	try {
+		lbm_aa.advance(geom, fluid, no_force, 4);
+	} catch (const std::runtime_error& e) {
+		thrown = true;
+	}
+	if (!thrown) {
+		std::cerr << "Blocked steps should throw in the aa_pattern mode" << std::endl;
+		return false;
+	}
+	thrown = false;
+	try {
+		lbm_rows.advance(geom, fluid, no_force, 4);
+	} catch (const std::runtime_error& e) {
+		thrown = true;
+	}
+	if (!thrown) {
+		std::cerr << "Blocked steps should throw with restricted active rows" << std::endl;
+		return false;
+	}
+	thrown = false;
+	try {
+		lbm.advance(geom, fluid, no_force, 4, 0);
+	} catch (const std::invalid_argument& e) {
+		thrown = true;
+	}
+	if (!thrown) {
+		std::cerr << "Blocked steps should throw for zero depth" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Run the same single phase flow with regular and with blocked steps,
+// true if the final distributions are the same
+bool compare_single_phase_advance(const Geometry& geom, const size_t nsteps, const size_t depth)
+{
+	const double tol = 1e-14;
+	std::vector<double> vol_force{0, 1, 0, -1, 0, 1, -1, -1, 1};
+	std::for_each(vol_force.begin(), vol_force.end(), [](double& el) { el *= 1e-4; });
+
+	LBM lbm_regular(geom);
+	LBM lbm_blocked(geom);
+	Fluid regular_fluid("regular", 1.0/3, 0.8), blocked_fluid("blocked", 1.0/3, 0.8);
+	regular_fluid.simple_ini(geom, 1.5);
+	blocked_fluid.simple_ini(geom, 1.5);
+
+	for (size_t iter = 0; iter < nsteps; ++iter) {
+		lbm_regular.step(geom, regular_fluid, vol_force);
+	}
+	lbm_blocked.advance(geom, blocked_fluid, vol_force, nsteps, depth);
+
+	return same_distributions(regular_fluid, blocked_fluid, tol);
+}
+
+// Run the same droplet flow with regular and with blocked steps, true
+// if the final distributions and densities are the same
+bool compare_two_phase_advance(const Geometry& geom, const size_t nsteps, const size_t depth)
+{
+	const double tol = 1e-14;
+	const double rho_bulk = 2.0, rho_droplet = 2.0;
+	const double rho_b_in_d = 0.06, rho_d_in_b = 0.06;
+	const double G_solids_bulk = 0.1, G_repulsive = 0.9;
+	const double xc = geom.Nx()/2, yc = geom.Ny()/2;
+	const double half_Lx = geom.Nx()/5, half_Ly = geom.Ny()/5;
+	std::vector<double> vol_force{0, 1, 0, -1, 0, 1, -1, -1, 1};
+	std::for_each(vol_force.begin(), vol_force.end(), [](double& el) { el *= 1e-5; });
+
+	LBM lbm_regular(geom);
+	LBM lbm_blocked(geom);
+	std::vector<Fluid> fluids;
+	for (const std::string name : {"regular_bulk", "regular_droplet", "blocked_bulk", "blocked_droplet"}) {
+		fluids.emplace_back(name, 1.0/3, (fluids.size()%2 == 0) ? 1.0 : 0.9);
+		fluids.back().zero_density_ini(geom);
+		fluids.back().initialize_interactions((fluids.size()%2 == 1) ? G_solids_bulk : -G_solids_bulk, G_repulsive);
+	}
+	lbm_regular.initialize_fluid_rectangle(geom, fluids.at(0), fluids.at(1), rho_bulk,
+						rho_droplet, rho_b_in_d, rho_d_in_b, xc, yc, half_Lx, half_Ly);
+	lbm_regular.compute_solid_surface_force(geom, fluids.at(0), fluids.at(1));
+	lbm_blocked.initialize_fluid_rectangle(geom, fluids.at(2), fluids.at(3), rho_bulk,
+						rho_droplet, rho_b_in_d, rho_d_in_b, xc, yc, half_Lx, half_Ly);
+	lbm_blocked.compute_solid_surface_force(geom, fluids.at(2), fluids.at(3));
+
+	for (size_t iter = 0; iter < nsteps; ++iter) {
+		lbm_regular.step(geom, fluids.at(0), fluids.at(1), vol_force);
+	}
+	lbm_blocked.advance(geom, fluids.at(2), fluids.at(3), vol_force, nsteps, depth);
+
+	if (!same_distributions(fluids.at(0), fluids.at(2), tol)
+			|| !same_distributions(fluids.at(1), fluids.at(3), tol)) {
+		return false;
+	}
+	// Densities are from the beginning of the last step in both cases
+	for (size_t i = 0; i < geom.Nx()*geom.Ny(); ++i) {
+		if (!float_equality(fluids.at(0).get_rho().at(i), fluids.at(2).get_rho().at(i), tol)
+				|| !float_equality(fluids.at(1).get_rho().at(i), fluids.at(3).get_rho().at(i), tol)) {
+			return false;
+		}
+	}
+	return true;
+}
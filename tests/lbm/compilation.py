@@ -11,13 +11,16 @@ path_exe = '../../executables/'
 cx = 'g++'
 std = '-std=c++11'
 opt = '-O0'
-other = '-Wall'
+# Debug configuration - bounds-checked array access in the kernels
+other = '-Wall -fopenmp -DLBM_CHECKED'
 
 # Common source files
 src_files = path + 'geometry.cpp' + ' ' + path + 'misc_checks.cpp '
 src_files += path + 'geom_object/rectangle.cpp' + ' ' + path + 'geom_object/ellipse.cpp'
 src_files += ' ' + path + 'fluid.cpp'
+src_files += ' ' + path + 'simd_kernels.cpp'
 src_files += ' ' + path + 'lbm.cpp'
+src_files += ' ' + path + 'sparse_lbm.cpp'
 src_files += ' ' + path + 'io_operations/FileHandler.cpp'
 src_files += ' ' + path + 'arrays/regular_array.cpp'
 src_files += ' ' + path + 'utils.cpp'
@@ -59,6 +62,87 @@ compile_com = ' '.join([cx, std, opt, other, '-o', exe_name, spec_files, tst_fil
 subprocess.call([compile_com], shell=True)
 subprocess.call(['mv ' + exe_name + ' ' + path_exe], shell=True)
 
+## Fused time steps compared with separate operations
+# Name of the executable
+exe_name = 'lbm_tst_fused'
+# Files needed only for this build
+spec_files = 'fused_step_tests.cpp '
+compile_com = ' '.join([cx, std, opt, other, '-o', exe_name, spec_files, tst_files, src_files])
+subprocess.call([compile_com], shell=True)
+subprocess.call(['mv ' + exe_name + ' ' + path_exe], shell=True)
+
+## Shared memory parallelization - serial and parallel results
+# Name of the executable
+exe_name = 'lbm_tst_omp'
+# Files needed only for this build
+spec_files = 'parallel_tests.cpp '
+compile_com = ' '.join([cx, std, opt, other, '-o', exe_name, spec_files, tst_files, src_files])
+subprocess.call([compile_com], shell=True)
+subprocess.call(['mv ' + exe_name + ' ' + path_exe], shell=True)
+
+## Fluid-only storage compared with the fused time steps
+# Name of the executable
+exe_name = 'lbm_tst_sparse'
+# Files needed only for this build
+spec_files = 'sparse_tests.cpp '
+compile_com = ' '.join([cx, std, opt, other, '-o', exe_name, spec_files, tst_files, src_files])
+subprocess.call([compile_com], shell=True)
+subprocess.call(['mv ' + exe_name + ' ' + path_exe], shell=True)
+
+## Vectorized kernels compared with the scalar ones
+# Name of the executable
+exe_name = 'lbm_tst_simd'
+# Files needed only for this build
+spec_files = 'simd_tests.cpp '
+compile_com = ' '.join([cx, std, opt, other, '-o', exe_name, spec_files, tst_files, src_files])
+subprocess.call([compile_com], shell=True)
+subprocess.call(['mv ' + exe_name + ' ' + path_exe], shell=True)
+
+## Single precision storage compared with the double precision steps
+# Name of the executable
+exe_name = 'lbm_tst_mixed'
+# Files needed only for this build
+spec_files = 'mixed_precision_tests.cpp '
+compile_com = ' '.join([cx, std, opt, other, '-o', exe_name, spec_files, tst_files, src_files])
+subprocess.call([compile_com], shell=True)
+subprocess.call(['mv ' + exe_name + ' ' + path_exe], shell=True)
+
+## Lattice descriptors
+# Name of the executable
+exe_name = 'lbm_tst_lattice'
+# Files needed only for this build
+spec_files = 'lattice_tests.cpp '
+compile_com = ' '.join([cx, std, opt, other, '-o', exe_name, spec_files, tst_files, src_files])
+subprocess.call([compile_com], shell=True)
+subprocess.call(['mv ' + exe_name + ' ' + path_exe], shell=True)
+
+## Temporally blocked steps compared with the regular steps
+# Name of the executable
+exe_name = 'lbm_tst_blocking'
+# Files needed only for this build
+spec_files = 'blocking_tests.cpp '
+compile_com = ' '.join([cx, std, opt, other, '-o', exe_name, spec_files, tst_files, src_files])
+subprocess.call([compile_com], shell=True)
+subprocess.call(['mv ' + exe_name + ' ' + path_exe], shell=True)
+
+## Padded layout compared with the dense steps
+# Name of the executable
+exe_name = 'lbm_tst_padded'
+# Files needed only for this build
+spec_files = 'padded_layout_tests.cpp '
+compile_com = ' '.join([cx, std, opt, other, '-o', exe_name, spec_files, tst_files, src_files])
+subprocess.call([compile_com], shell=True)
+subprocess.call(['mv ' + exe_name + ' ' + path_exe], shell=True)
+
+## Heap allocations of the time steps
+# Name of the executable
+exe_name = 'lbm_tst_alloc'
+# Files needed only for this build - the counter replaces the global operator new
+spec_files = 'allocation_tests.cpp ../common/allocation_counter.cpp '
+compile_com = ' '.join([cx, std, opt, other, '-o', exe_name, spec_files, tst_files, src_files])
+subprocess.call([compile_com], shell=True)
+subprocess.call(['mv ' + exe_name + ' ' + path_exe], shell=True)
+
 ### The following code is compiled with maximum optimizations
 ## Reason: these are regression tests that run for quite a bit
 #opt = '-O0'
@@ -0,0 +1,593 @@
+#include "../../include/lbm.h"
+#include "../common/test_utils.h"
+#include "lbm_tests.h"
+
+/*****************************************************
+ *
+ * Test suite for the fused LBM time steps - results
+ *	are compared with the sequence of separate
+ *	operations they replace
+ *
+ *****************************************************/
+
+bool single_phase_fused_empty_test();
+bool single_phase_fused_walls_test();
+bool single_phase_fused_array_test();
+bool two_phase_fused_periodic_test();
+bool two_phase_fused_channel_test();
+bool single_phase_aa_pattern_test();
+bool two_phase_aa_pattern_test();
+bool checked_access_test();
+bool bounce_back_links_test();
+bool overlapped_single_phase_test();
+bool overlapped_two_phase_test();
+bool lean_storage_test();
+
+// Supporting functions
+bool compare_single_phase_step(const Geometry& geom, const double rho_ini,
+				const std::vector<double>& vol_force, const int max_iter);
+bool compare_two_phase_step(Geometry& geom, const double G_solids_bulk,
+				const std::vector<double>& vol_force, const int max_iter);
+bool compare_two_phase_aa_step(Geometry& geom, const std::vector<double>& vol_force, 
+				const int max_iter);
+
+// Records the order of the halo exchange hooks
+class HookRecorder : public LBM::HaloExchange {
+public:
+	std::string calls;
+	void start_density_exchange(Fluid&, Fluid&) override { calls += "d"; }
+	void finish_density_exchange(Fluid&, Fluid&) override { calls += "w"; }
+	void start_stream_exchange(LatticeVector<double>&) override { calls += "s"; }
+	void start_stream_exchange(LatticeVector<double>&, LatticeVector<double>&) override { calls += "S"; }
+};
+
+int main()
+{
+	test_pass(single_phase_fused_empty_test(), "Fused single phase step, empty domain");
+	test_pass(single_phase_fused_walls_test(), "Fused single phase step, x walls");
+	test_pass(single_phase_fused_array_test(), "Fused single phase step, array of objects, y walls");
+	test_pass(two_phase_fused_periodic_test(), "Fused two phase step, droplet in a periodic domain");
+	test_pass(two_phase_fused_channel_test(), "Fused two phase step, droplet flowing in a channel");
+	test_pass(single_phase_aa_pattern_test(), "In-place (AA pattern) single phase step");
+	test_pass(two_phase_aa_pattern_test(), "In-place (AA pattern) two phase step");
+	test_pass(checked_access_test(), "Bounds-checked kernel access in the debug configuration");
+	test_pass(bounce_back_links_test(), "Separate streaming with bounce-back links");
+	test_pass(overlapped_single_phase_test(), "Single phase step with an overlapped halo exchange");
+	test_pass(overlapped_two_phase_test(), "Two phase step with overlapped halo exchanges");
+	test_pass(lean_storage_test(), "Fused steps of fluids with lean storage");
+}
+
+/// Empty periodic domain with a multidirectional force
+bool single_phase_fused_empty_test()
+{
+	Geometry geom(25, 16);
+	std::vector<double> vol_force{0, 1, 0, -1, 0, 1, -1, -1, 1};
+	std::for_each(vol_force.begin(), vol_force.end(), [](double& el) { el *= 1e-5; });
+
+	if (!compare_single_phase_step(geom, 2.5, vol_force, 50)) {
+		std::cerr << "Fused step differs from separate operations for empty domain" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+/// Walls spanning the x direction, force along the channel
+bool single_phase_fused_walls_test()
+{
+	Geometry geom(40, 20);
+	geom.add_walls(3, "x");
+	std::vector<double> vol_force{0, 1, 0, -1, 0, 1, -1, -1, 1};
+	std::for_each(vol_force.begin(), vol_force.end(), [](double& el) { el *= 1e-4; });
+
+	if (!compare_single_phase_step(geom, 2.0, vol_force, 100)) {
+		std::cerr << "Fused step differs from separate operations for x walls" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+/// Staggered array of ellipses between walls spanning the y direction
+bool single_phase_fused_array_test()
+{
+	Geometry geom(200, 100);
+	geom.add_walls(2, "y");
+	geom.add_array({5, 7, 10, 15}, {{5, 190},{3, 70}}, {20, 5}, "ellipse");
+	std::vector<double> vol_force{0, 0, 1, 0, -1, 1, 1, -1, -1};
+	std::for_each(vol_force.begin(), vol_force.end(), [](double& el) { el *= 1e-4; });
+
+	if (!compare_single_phase_step(geom, 1.0, vol_force, 100)) {
+		std::cerr << "Fused step differs from separate operations for an array of objects" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+/// Stationary droplet in a fully periodic domain, no volume force
+bool two_phase_fused_periodic_test()
+{
+	Geometry geom(60, 50);
+	const std::vector<double> no_force(9, 0.0);
+
+	if (!compare_two_phase_step(geom, 0.0, no_force, 100)) {
+		std::cerr << "Fused step differs from separate operations for a periodic domain" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+/// Droplet between walls spanning the y direction, wetting walls, force along the channel
+bool two_phase_fused_channel_test()
+{
+	Geometry geom(50, 70);
+	geom.add_walls(2, "y");
+	std::vector<double> vol_force{0, 0, 1, 0, -1, 1, 1, -1, -1};
+	std::for_each(vol_force.begin(), vol_force.end(), [](double& el) { el *= 1e-5; });
+
+	if (!compare_two_phase_step(geom, 0.2, vol_force, 100)) {
+		std::cerr << "Fused step differs from separate operations for a channel" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+/// Single phase flow past two ellipses with in-place streaming, odd and even 
+///	number of steps, synchronization in the middle of the run
+bool single_phase_aa_pattern_test()
+{
+	const double tol = 1e-14;
+	Geometry geom(60, 40);
+	geom.add_walls(2, "y");
+	geom.add_ellipse(11, 7, 15, 12);
+	geom.add_ellipse(7, 11, 40, 25);
+	std::vector<double> vol_force{0, 1, 0, -1, 0, 1, -1, -1, 1};
+	std::for_each(vol_force.begin(), vol_force.end(), [](double& el) { el *= 1e-4; });
+
+	Fluid regular_fluid("regular", 1.0/3, 0.8);
+	Fluid aa_fluid("aa", 1.0/3, 0.8);
+	regular_fluid.simple_ini(geom, 1.5);
+	aa_fluid.simple_ini(geom, 1.5);
+
+	LBM lbm_regular(geom);
+	LBM lbm_aa(geom, LBM::aa_pattern);
+
+	// Separate streaming is not supported
+	bool thrown = false;
+	try {
+		lbm_aa.stream(geom, aa_fluid);
+	} catch (const std::runtime_error& e) {
+		thrown = true;
+	}
+	if (!thrown) {
+		std::cerr << "Separate streaming should throw in the aa_pattern mode" << std::endl;
+		return false;
+	}
+
+	for (int iter = 0; iter<51; ++iter) {
+		lbm_regular.step(geom, regular_fluid, vol_force);
+		lbm_aa.step(geom, aa_fluid, vol_force);
+		if (iter == 24) {
+			// Odd number of steps
+			lbm_aa.synchronize(geom, aa_fluid);
+			if (!lbm_aa.is_synchronized() || !same_distributions(regular_fluid, aa_fluid, tol)) {
+				std::cerr << "In-place streaming differs after an odd number of steps" << std::endl;
+				return false;
+			}
+		}
+		if (iter == 26) {
+			// Two more steps after synchronizing - already in the regular layout
+			if (!lbm_aa.is_synchronized() || !same_distributions(regular_fluid, aa_fluid, tol)) {
+				std::cerr << "In-place streaming differs after an even number of steps" << std::endl;
+				return false;
+			}
+		}
+	}
+	lbm_aa.synchronize(geom, aa_fluid);
+
+	return same_distributions(regular_fluid, aa_fluid, tol);
+}
+
+/// Shift and bounce-back fix-up compared with streaming node by node 
+/// with the geometry checked for each direction
+bool bounce_back_links_test()
+{
+	const size_t Nx = 33, Ny = 21, Ntot = Nx*Ny, Ndir = Lattice::Q;
+	Geometry geom(Nx, Ny);
+	geom.add_walls(2, "x");
+	geom.add_ellipse(9, 5, 10, 8);
+	// Solids on the periodic edges
+	geom.set_node_solid(0, 10);
+	geom.set_node_solid(Nx-1, 4);
+
+	Fluid fluid("fluid", 1.0/3, 1.0);
+	fluid.simple_ini(geom, 1.0);
+	// Distinct value in each fluid slot
+	LatticeVector<double>& f_dist = fluid.get_f_dist();
+	for (size_t ai = 0; ai < Ntot; ++ai) {
+		for (size_t dj = 0; dj < Ndir; ++dj) {
+			f_dist.at(ai + dj*Ntot) = (geom(ai) == 1) ? 1.0 + ai + 0.1*dj : 0.0;
+		}
+	}
+	const LatticeVector<double> f_ini = f_dist;
+
+	LBM lbm(geom);
+	lbm.stream(geom, fluid);
+
+	// Expected values
+	std::vector<double> f_expected(Ntot*Ndir, 0.0);
+	size_t xn = 0, yn = 0;
+	for (size_t ai = 0; ai < Ntot; ++ai) {
+		if (geom(ai) == 0) {
+			continue;
+		}
+		for (size_t dj = 0; dj < Ndir; ++dj) {
+			xn = (ai%Nx + Nx + Lattice::cx[dj])%Nx;
+			yn = (ai/Nx + Ny + Lattice::cy[dj])%Ny;
+			if (geom(xn, yn) == 1) {
+				f_expected.at(yn*Nx + xn + dj*Ntot) = f_ini.at(ai + dj*Ntot);
+			} else {
+				f_expected.at(ai + Lattice::opposite[dj]*Ntot) = f_ini.at(ai + dj*Ntot);
+			}
+		}
+	}
+	for (size_t ijk = 0; ijk < Ntot*Ndir; ++ijk) {
+		if (f_dist.at(ijk) != f_expected.at(ijk)) {
+			std::cerr << "Streamed value differs at position " << ijk << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+/// Droplet in a channel with in-place streaming
+bool two_phase_aa_pattern_test()
+{
+	Geometry geom(50, 40);
+	geom.add_walls(2, "y");
+	std::vector<double> vol_force{0, 1, 0, -1, 0, 1, -1, -1, 1};
+	std::for_each(vol_force.begin(), vol_force.end(), [](double& el) { el *= 1e-5; });
+
+	if (!compare_two_phase_aa_step(geom, vol_force, 77)) {
+		std::cerr << "In-place streaming differs for a droplet in a channel" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+/// Boundary strips first, for active rows with and without an interior
+bool overlapped_single_phase_test()
+{
+	Geometry geom(45, 37);
+	geom.add_walls(2, "y");
+	geom.add_ellipse(11, 7, 15, 18);
+	geom.add_rectangle(5, 9, 35, 10);
+	std::vector<double> vol_force{0, 1, 0, -1, 0, 1, -1, -1, 1};
+	std::for_each(vol_force.begin(), vol_force.end(), [](double& el) { el *= 1e-4; });
+	const std::vector<std::vector<size_t>> active_rows = {{0, 37}, {3, 4}, {3, 5}, {1, 36}, {5, 30}};
+
+	for (const auto& rows : active_rows) {
+		Fluid regular_fluid("regular", 1.0/3, 0.8), overlapped_fluid("overlapped", 1.0/3, 0.8);
+		regular_fluid.simple_ini(geom, 1.5);
+		overlapped_fluid.simple_ini(geom, 1.5);
+		LBM lbm_regular(geom), lbm_overlapped(geom);
+		lbm_regular.set_active_rows(rows.at(0), rows.at(1));
+		lbm_overlapped.set_active_rows(rows.at(0), rows.at(1));
+		HookRecorder halo;
+		for (int iter = 0; iter < 20; ++iter) {
+			lbm_regular.step(geom, regular_fluid, vol_force);
+			lbm_overlapped.step(geom, overlapped_fluid, vol_force, halo);
+		}
+		if (!same_distributions(regular_fluid, overlapped_fluid, 0.0)) {
+			std::cerr << "Overlapped step differs for rows " << rows.at(0) << " to " << rows.at(1) << std::endl;
+			return false;
+		}
+		if (halo.calls != std::string(20, 's')) {
+			std::cerr << "Wrong halo exchange hooks: " << halo.calls << std::endl;
+			return false;
+		}
+	}
+
+	// Only the two_lattice mode
+	LBM lbm_aa(geom, LBM::aa_pattern);
+	Fluid fluid("fluid", 1.0/3, 0.8);
+	fluid.simple_ini(geom, 1.5);
+	HookRecorder halo;
+	bool thrown = false;
+	try {
+		lbm_aa.step(geom, fluid, vol_force, halo);
+	} catch (const std::runtime_error& e) {
+		thrown = true;
+	}
+	if (!thrown) {
+		std::cerr << "Overlapped step should throw in the aa_pattern mode" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+/// All rows active - densities of the periodic neighbors are computed 
+/// by the step itself, so the hooks don't need to do anything
+bool overlapped_two_phase_test()
+{
+	Geometry geom(50, 40);
+	geom.add_walls(2, "y");
+	const double G_solids_bulk = 0.2, G_repulsive = 0.9;
+	std::vector<double> vol_force{0, 1, 0, -1, 0, 1, -1, -1, 1};
+	std::for_each(vol_force.begin(), vol_force.end(), [](double& el) { el *= 1e-5; });
+
+	LBM lbm_regular(geom), lbm_overlapped(geom);
+	std::vector<Fluid> fluids;
+	for (const std::string name : {"regular_bulk", "regular_droplet", "overlapped_bulk", "overlapped_droplet"}) {
+		fluids.emplace_back(name, 1.0/3, (fluids.size()%2 == 0) ? 1.0 : 0.9);
+		fluids.back().zero_density_ini(geom);
+		fluids.back().initialize_interactions((fluids.size()%2 == 1) ? G_solids_bulk : -G_solids_bulk, G_repulsive);
+	}
+	lbm_regular.initialize_droplet(geom, fluids.at(0), fluids.at(1), 2.0, 2.0, 0.06, 0.06, 25, 20, 7);
+	lbm_regular.compute_solid_surface_force(geom, fluids.at(0), fluids.at(1));
+	lbm_overlapped.initialize_droplet(geom, fluids.at(2), fluids.at(3), 2.0, 2.0, 0.06, 0.06, 25, 20, 7);
+	lbm_overlapped.compute_solid_surface_force(geom, fluids.at(2), fluids.at(3));
+
+	HookRecorder halo;
+	for (int iter = 0; iter < 30; ++iter) {
+		lbm_regular.step(geom, fluids.at(0), fluids.at(1), vol_force);
+		lbm_overlapped.step(geom, fluids.at(2), fluids.at(3), vol_force, halo);
+	}
+	if (!same_distributions(fluids.at(0), fluids.at(2), 0.0)
+			|| !same_distributions(fluids.at(1), fluids.at(3), 0.0)
+			|| !(fluids.at(1).get_rho() == fluids.at(3).get_rho())) {
+		std::cerr << "Overlapped two phase step differs from the regular one" << std::endl;
+		return false;
+	}
+	std::string expected;
+	for (int iter = 0; iter < 30; ++iter) {
+		expected += "dwS";
+	}
+	if (halo.calls != expected) {
+		std::cerr << "Wrong order of the halo exchange hooks: " << halo.calls << std::endl;
+		return false;
+	}
+	return true;
+}
+
+/// Lean fluids give the same results without the intermediate arrays,
+/// velocities only exist during output, separate operations throw
+bool lean_storage_test()
+{
+	const double tol = 1e-14;
+	Geometry geom(40, 30);
+	geom.add_walls(2, "y");
+	geom.add_rectangle(7, 5, 20, 3);
+	std::vector<double> vol_force{0, 1, 0, -1, 0, 1, -1, -1, 1};
+	std::for_each(vol_force.begin(), vol_force.end(), [](double& el) { el *= 1e-5; });
+
+	LBM lbm_full(geom);
+	LBM lbm_lean(geom);
+	std::vector<Fluid> fluids;
+	for (const std::string name : {"full_bulk", "full_droplet", "lean_bulk", "lean_droplet"}) {
+		fluids.emplace_back(name, 1.0/3, (fluids.size()%2 == 0) ? 1.0 : 0.9);
+		// Lean before initialization, the arrays are never allocated
+		fluids.back().set_lean_storage(fluids.size() > 2);
+		fluids.back().zero_density_ini(geom);
+		fluids.back().initialize_interactions((fluids.size()%2 == 1) ? 0.1 : -0.1, 0.9);
+	}
+	lbm_full.initialize_fluid_rectangle(geom, fluids.at(0), fluids.at(1), 2.0, 2.0, 0.06, 0.06, 20, 15, 8, 6);
+	lbm_full.compute_solid_surface_force(geom, fluids.at(0), fluids.at(1));
+	lbm_lean.initialize_fluid_rectangle(geom, fluids.at(2), fluids.at(3), 2.0, 2.0, 0.06, 0.06, 20, 15, 8, 6);
+	lbm_lean.compute_solid_surface_force(geom, fluids.at(2), fluids.at(3));
+
+	Fluid& lean = fluids.at(2);
+	if (!lean.get_f_eq_dist().empty() || !lean.get_ux().empty() || !lean.get_u_eq_x().empty() 
+			|| !lean.get_repulsive_force_x().empty() || (lean.get_rho().size() != geom.Nx()*geom.Ny())) {
+		std::cerr << "Lean fluid should only store the arrays of the fused steps" << std::endl;
+		return false;
+	}
+
+	for (int iter = 0; iter < 15; ++iter) {
+		lbm_full.step(geom, fluids.at(0), fluids.at(1), vol_force);
+		lbm_lean.step(geom, fluids.at(2), fluids.at(3), vol_force);
+	}
+	if (!same_distributions(fluids.at(0), fluids.at(2), tol)
+			|| !same_distributions(fluids.at(1), fluids.at(3), tol)) {
+		std::cerr << "Lean fluids should have the same distributions" << std::endl;
+		return false;
+	}
+
+	// Velocities on request, released after output
+	fluids.at(0).compute_macroscopic(geom);
+	fluids.at(2).compute_macroscopic(geom);
+	for (size_t i = 0; i < geom.Nx()*geom.Ny(); ++i) {
+		if (!float_equality(fluids.at(0).get_ux().at(i), fluids.at(2).get_ux().at(i), tol)) {
+			std::cerr << "Lean fluid should have the same velocities" << std::endl;
+			return false;
+		}
+	}
+	fluids.at(2).write_ux("lean_ux.txt", geom);
+	std::remove("lean_ux.txt");
+	if (!lean.get_ux().empty() || !lean.get_uy().empty()) {
+		std::cerr << "Velocities of a lean fluid should be released after output" << std::endl;
+		return false;
+	}
+
+	bool thrown = false;
+	try {
+		lbm_lean.compute_fluid_repulsive_interactions(geom, fluids.at(2), fluids.at(3));
+	} catch (const std::runtime_error& e) {
+		thrown = true;
+	}
+	if (!thrown) {
+		std::cerr << "Separate operations should throw for lean fluids" << std::endl;
+		return false;
+	}
+
+	// Back to full storage, separate operations work again
+	Fluid single("single", 1.0/3, 0.8);
+	single.simple_ini(geom, 1.2);
+	single.set_lean_storage(true);
+	thrown = false;
+	try {
+		lbm_full.collide(geom, single);
+	} catch (const std::runtime_error& e) {
+		thrown = true;
+	}
+	single.set_lean_storage(false);
+	lbm_full.collide(geom, single);
+	if (!thrown || (single.get_f_eq_dist().size() != 9*geom.Nx()*geom.Ny())) {
+		std::cerr << "Full storage should be restored" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Run the same single phase flow with separate operations and with
+// the fused step, true if the final distributions are the same
+bool compare_single_phase_step(const Geometry& geom, const double rho_ini,
+				const std::vector<double>& vol_force, const int max_iter)
+{
+	const double tol = 1e-14;
+
+	Fluid separate_fluid("separate", 1.0/3, 0.8);
+	Fluid fused_fluid("fused", 1.0/3, 0.8);
+	separate_fluid.simple_ini(geom, rho_ini);
+	fused_fluid.simple_ini(geom, rho_ini);
+
+	LBM lbm_separate(geom);
+	LBM lbm_fused(geom);
+
+	for (int iter = 0; iter<max_iter; ++iter) {
+		lbm_separate.collide(geom, separate_fluid);
+		lbm_separate.add_volume_force(geom, separate_fluid, vol_force);
+		lbm_separate.stream(geom, separate_fluid);
+
+		lbm_fused.step(geom, fused_fluid, vol_force);
+	}
+
+	return same_distributions(separate_fluid, fused_fluid, tol);
+}
+
+// Run the same two phase flow with separate operations and with 
+// the fused step, true if the final distributions and densities are the same
+bool compare_two_phase_step(Geometry& geom, const double G_solids_bulk,
+				const std::vector<double>& vol_force, const int max_iter)
+{
+	const double tol = 1e-14;
+	const double rho_bulk = 2.0, rho_droplet = 2.0;
+	const double rho_b_in_d = 0.06, rho_d_in_b = 0.06;
+	const double G_repulsive = 0.9;
+	const double xc = geom.Nx()/2, yc = geom.Ny()/2;
+	const double half_Lx = geom.Nx()/5, half_Ly = geom.Ny()/5;
+
+	LBM lbm_separate(geom);
+	LBM lbm_fused(geom);
+
+	Fluid separate_bulk("separate_bulk", 1.0/3, 1.0), separate_droplet("separate_droplet", 1.0/3, 0.9);
+	separate_bulk.zero_density_ini(geom);
+	separate_droplet.zero_density_ini(geom);
+	separate_bulk.initialize_interactions(G_solids_bulk, G_repulsive);
+	separate_droplet.initialize_interactions(-1.0*G_solids_bulk, G_repulsive);
+	lbm_separate.initialize_fluid_rectangle(geom, separate_bulk, separate_droplet, rho_bulk, 
+						rho_droplet, rho_b_in_d, rho_d_in_b, xc, yc, half_Lx, half_Ly);
+	lbm_separate.compute_solid_surface_force(geom, separate_bulk, separate_droplet);
+
+	Fluid fused_bulk("fused_bulk", 1.0/3, 1.0), fused_droplet("fused_droplet", 1.0/3, 0.9);
+	fused_bulk.zero_density_ini(geom);
+	fused_droplet.zero_density_ini(geom);
+	fused_bulk.initialize_interactions(G_solids_bulk, G_repulsive);
+	fused_droplet.initialize_interactions(-1.0*G_solids_bulk, G_repulsive);
+	lbm_fused.initialize_fluid_rectangle(geom, fused_bulk, fused_droplet, rho_bulk, 
+						rho_droplet, rho_b_in_d, rho_d_in_b, xc, yc, half_Lx, half_Ly);
+	lbm_fused.compute_solid_surface_force(geom, fused_bulk, fused_droplet);
+
+	for (int iter = 0; iter<max_iter; ++iter) {
+		separate_bulk.compute_density();
+		separate_droplet.compute_density();
+		lbm_separate.compute_fluid_repulsive_interactions(geom, separate_bulk, separate_droplet);
+		lbm_separate.compute_equilibrium_velocities(geom, separate_bulk, separate_droplet);
+		lbm_separate.collide(separate_bulk, separate_droplet);
+		lbm_separate.add_volume_force(geom, separate_bulk, separate_droplet, vol_force);
+		lbm_separate.stream(geom, separate_bulk, separate_droplet);
+
+		lbm_fused.step(geom, fused_bulk, fused_droplet, vol_force);
+	}
+
+	if (!same_distributions(separate_bulk, fused_bulk, tol) 
+			|| !same_distributions(separate_droplet, fused_droplet, tol)) {
+		return false;
+	}
+	// Densities are from the beginning of the last step in both cases
+	const LatticeVector<double>& rho_separate = separate_droplet.get_rho();
+	const LatticeVector<double>& rho_fused = fused_droplet.get_rho();
+	for (size_t i = 0; i < rho_separate.size(); ++i) {
+		if (!float_equality(rho_separate.at(i), rho_fused.at(i), tol)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Run the same two phase flow with regular and in-place streaming, 
+// true if the final distributions are the same
+bool compare_two_phase_aa_step(Geometry& geom, const std::vector<double>& vol_force, 
+				const int max_iter)
+{
+	const double tol = 1e-14;
+	const double G_solids_bulk = 0.2, G_repulsive = 0.9;
+	const double xc = geom.Nx()/2, yc = geom.Ny()/2;
+	const double radius = geom.Ny()/5;
+
+	LBM lbm_regular(geom);
+	LBM lbm_aa(geom, LBM::aa_pattern);
+
+	Fluid regular_bulk("regular_bulk", 1.0/3, 1.0), regular_droplet("regular_droplet", 1.0/3, 0.9);
+	Fluid aa_bulk("aa_bulk", 1.0/3, 1.0), aa_droplet("aa_droplet", 1.0/3, 0.9);
+	for (Fluid* fluid : {&regular_bulk, &regular_droplet, &aa_bulk, &aa_droplet}) {
+		fluid->zero_density_ini(geom);
+	}
+	regular_bulk.initialize_interactions(G_solids_bulk, G_repulsive);
+	regular_droplet.initialize_interactions(-1.0*G_solids_bulk, G_repulsive);
+	aa_bulk.initialize_interactions(G_solids_bulk, G_repulsive);
+	aa_droplet.initialize_interactions(-1.0*G_solids_bulk, G_repulsive);
+
+	lbm_regular.initialize_droplet(geom, regular_bulk, regular_droplet, 2.0, 2.0, 0.06, 0.06, xc, yc, radius);
+	lbm_regular.compute_solid_surface_force(geom, regular_bulk, regular_droplet);
+	lbm_aa.initialize_droplet(geom, aa_bulk, aa_droplet, 2.0, 2.0, 0.06, 0.06, xc, yc, radius);
+	lbm_aa.compute_solid_surface_force(geom, aa_bulk, aa_droplet);
+
+	for (int iter = 0; iter<max_iter; ++iter) {
+		lbm_regular.step(geom, regular_bulk, regular_droplet, vol_force);
+		lbm_aa.step(geom, aa_bulk, aa_droplet, vol_force);
+	}
+	lbm_aa.synchronize(geom, aa_bulk, aa_droplet);
+
+	return same_distributions(regular_bulk, aa_bulk, tol) 
+				&& same_distributions(regular_droplet, aa_droplet, tol);
+}
+
+/// Kernel array views and geometry access throw on out of range
+/// indices when compiled with LBM_CHECKED, nothing to test otherwise
+bool checked_access_test()
+{
+#ifdef LBM_CHECKED
+	Geometry geom(25, 16);
+	LatticeVector<double> values(10, 1.0);
+	const RestrictPtr<double> view = array_ptr(values);
+	bool thrown_geom = false, thrown_view = false;
+	try {
+		geom(25*16);
+	} catch (const std::out_of_range& e) {
+		thrown_geom = true;
+	}
+	try {
+		view[10] = 0.0;
+	} catch (const std::out_of_range& e) {
+		thrown_view = true;
+	}
+	if (!thrown_geom || !thrown_view) {
+		std::cerr << "Out of range access should throw in the debug configuration" << std::endl;
+		return false;
+	}
+	if (view[9] != 1.0) {
+		std::cerr << "Wrong value accessed through the array view" << std::endl;
+		return false;
+	}
+#endif
+	return true;
+}
@@ -0,0 +1,55 @@
+#include "../../include/lattice.h"
+#include "../common/test_utils.h"
+
+/*****************************************************
+ *
+ * Test suite for the lattice descriptors - weights,
+ *	velocities, and opposite directions need to be
+ *	consistent for every velocity set
+ *
+ *****************************************************/
+
+template <typename Descriptor>
+bool descriptor_test();
+
+int main()
+{
+	test_pass(descriptor_test<D2Q9<>>(), "D2Q9 lattice descriptor");
+	test_pass(descriptor_test<D2Q5<>>(), "D2Q5 lattice descriptor");
+}
+
+/// Weights sum to one, lattice is isotropic with the speed of sound
+/// from the equilibrium coefficient, and opposite directions are reversed
+template <typename Descriptor>
+bool descriptor_test()
+{
+	const double tol = 1e-15;
+	double w_sum = 0.0, cxx = 0.0, cyy = 0.0, cxy = 0.0, cx = 0.0, cy = 0.0;
+	for (size_t dj = 0; dj < Descriptor::Q; ++dj) {
+		w_sum += Descriptor::w[dj];
+		cx += Descriptor::w[dj]*Descriptor::cx[dj];
+		cy += Descriptor::w[dj]*Descriptor::cy[dj];
+		cxx += Descriptor::w[dj]*Descriptor::cx[dj]*Descriptor::cx[dj];
+		cyy += Descriptor::w[dj]*Descriptor::cy[dj]*Descriptor::cy[dj];
+		cxy += Descriptor::w[dj]*Descriptor::cx[dj]*Descriptor::cy[dj];
+
+		const size_t opp = Descriptor::opposite[dj];
+		if ((Descriptor::opposite[opp] != dj) || (Descriptor::cx[opp] != -Descriptor::cx[dj])
+				|| (Descriptor::cy[opp] != -Descriptor::cy[dj]) || (Descriptor::w[opp] != Descriptor::w[dj])) {
+			std::cerr << "Wrong opposite of direction " << dj << std::endl;
+			return false;
+		}
+	}
+	// Rest direction first
+	if ((Descriptor::cx[0] != 0) || (Descriptor::cy[0] != 0)) {
+		std::cerr << "First direction should be the rest direction" << std::endl;
+		return false;
+	}
+	const double cs2 = 1.0/Descriptor::feq1;
+	if ((std::abs(w_sum - 1.0) > tol) || (std::abs(cx) > tol) || (std::abs(cy) > tol)
+			|| (std::abs(cxx - cs2) > tol) || (std::abs(cyy - cs2) > tol) || (std::abs(cxy) > tol)) {
+		std::cerr << "Weights are not consistent with the velocities" << std::endl;
+		return false;
+	}
+	return true;
+}
@@ -309,3 +309,20 @@ bool check_distributions(const std::string& fname, const std::string& path,
 	}
 	return true;
 }
+
+// Compare density distributions of two fluids node by node
+bool same_distributions(const Fluid& fluid_1, const Fluid& fluid_2, const double tol)
+{
+	const LatticeVector<double>& f_dist_1 = fluid_1.get_f_dist();
+	const LatticeVector<double>& f_dist_2 = fluid_2.get_f_dist();
+
+	if (f_dist_1.size() != f_dist_2.size()) {
+		return false;
+	}
+	for (size_t i = 0; i < f_dist_1.size(); ++i) {
+		if (!float_equality(f_dist_1.at(i), f_dist_2.at(i), tol)) {
+			return false;
+		}
+	}
+	return true;
+}
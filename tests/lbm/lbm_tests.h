@@ -155,4 +155,14 @@ bool check_macroscopic(const std::string& fname, const std::string& path,
 bool check_distributions(const std::string& fname, const std::string& path, 
 				const std::string& file_extension, const std::string& prop_name);
 
+/**
+ * Compare density distributions of two fluids node by node 
+ * 
+ * @param fluid_1 - first fluid
+ * @param fluid_2 - second fluid
+ * @param tol - relative tolerance for the comparison
+ * @return true if the distributions are the same size and equal within tol
+ **/
+bool same_distributions(const Fluid& fluid_1, const Fluid& fluid_2, const double tol);
+
 #endif
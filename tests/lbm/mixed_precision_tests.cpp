@@ -0,0 +1,243 @@
+#include "../../include/lbm.h"
+#include "../common/test_utils.h"
+#include "lbm_tests.h"
+
+/*****************************************************
+ *
+ * Test suite for the mixed precision mode - single
+ *	precision storage needs to stay close to the
+ *	double precision steps, closer when stored as
+ *	the deviation from the rest state
+ *
+ *****************************************************/
+
+bool compress_expand_test();
+bool mixed_precision_errors_test();
+bool single_phase_mixed_test();
+bool two_phase_mixed_test();
+
+// Supporting functions
+Geometry make_channel_geometry();
+double relative_difference(const Fluid& reference, const Fluid& fluid);
+void run_single_phase(const Geometry& geom, Fluid& fluid, LBM& lbm, const std::vector<double>& vol_force);
+void run_two_phase(const Geometry& geom, Fluid& bulk, Fluid& droplet, LBM& lbm, const std::vector<double>& vol_force);
+
+// Maximum relative differences from the double precision steps
+const double float_tol = 1e-5;
+// Single precision rounding
+const double round_off = 1e-7;
+
+int main()
+{
+	test_pass(compress_expand_test(), "Single precision storage and expansion");
+	test_pass(mixed_precision_errors_test(), "Operations not available in the mixed precision mode");
+	test_pass(single_phase_mixed_test(), "Single phase step with single precision storage");
+	test_pass(two_phase_mixed_test(), "Two phase step with single precision storage");
+}
+
+/// Compressed fluids keep only the single precision distribution,
+/// expansion restores it within the single precision rounding
+bool compress_expand_test()
+{
+	Geometry geom = make_channel_geometry();
+	LBM lbm(geom, LBM::two_lattice, LBM::mixed_precision);
+	Fluid dense("dense", 1.0/3, 0.8);
+	dense.simple_ini(geom, 1.5);
+
+	for (const bool deviation : {false, true}) {
+		Fluid fluid("compressed", 1.0/3, 0.8);
+		fluid.simple_ini(geom, 1.5);
+		lbm.compress(geom, fluid, deviation);
+		if ((fluid.get_f_dist_float().size() != geom.Nx()*geom.Ny()*9)
+				|| !fluid.get_f_dist().empty() || !fluid.get_f_eq_dist().empty()) {
+			std::cerr << "Compressed arrays have wrong sizes" << std::endl;
+			return false;
+		}
+		// Uniform density is the rest state
+		const double rho_ref = deviation ? 1.5 : 0.0;
+		if (std::abs(fluid.get_reference_density() - rho_ref) > 1e-12) {
+			std::cerr << "Wrong reference density" << std::endl;
+			return false;
+		}
+		lbm.expand(geom, fluid);
+		if (!fluid.get_f_dist_float().empty() || (fluid.get_f_eq_dist().size() != geom.Nx()*geom.Ny()*9)) {
+			std::cerr << "Expanded arrays have wrong sizes" << std::endl;
+			return false;
+		}
+		if (relative_difference(dense, fluid) > round_off) {
+			std::cerr << "Expanded distribution differs from the original" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+/// Separate operations and uncompressed fluids are rejected
+bool mixed_precision_errors_test()
+{
+	Geometry geom = make_channel_geometry();
+	LBM lbm(geom, LBM::two_lattice, LBM::mixed_precision);
+	LBM double_lbm(geom);
+	Fluid fluid("water", 1.0/3, 0.8);
+	fluid.simple_ini(geom, 1.5);
+	const std::vector<double> vol_force(9, 0.0);
+
+	bool thrown = false;
+	try {
+		lbm.step(geom, fluid, vol_force);
+	} catch (const std::runtime_error& e) {
+		thrown = true;
+	}
+	if (!thrown) {
+		std::cerr << "Step with an uncompressed fluid should throw" << std::endl;
+		return false;
+	}
+
+	thrown = false;
+	try {
+		double_lbm.compress(geom, fluid);
+	} catch (const std::runtime_error& e) {
+		thrown = true;
+	}
+	if (!thrown) {
+		std::cerr << "Compression in the double precision mode should throw" << std::endl;
+		return false;
+	}
+
+	lbm.compress(geom, fluid);
+	thrown = false;
+	try {
+		lbm.collide(geom, fluid);
+	} catch (const std::runtime_error& e) {
+		thrown = true;
+	}
+	if (!thrown) {
+		std::cerr << "Separate collision in the mixed precision mode should throw" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+/// Force driven channel flow, both streaming schemes
+bool single_phase_mixed_test()
+{
+	Geometry geom = make_channel_geometry();
+	std::vector<double> vol_force{0, 1, 0, -1, 0, 1, -1, -1, 1};
+	std::for_each(vol_force.begin(), vol_force.end(), [](double& el) { el *= 1e-5; });
+
+	LBM double_lbm(geom);
+	Fluid reference("reference", 1.0/3, 0.8);
+	reference.simple_ini(geom, 1.5);
+	run_single_phase(geom, reference, double_lbm, vol_force);
+
+	for (const LBM::Streaming mode : {LBM::two_lattice, LBM::aa_pattern}) {
+		double errors[2] = {};
+		for (const bool deviation : {false, true}) {
+			LBM lbm(geom, mode, LBM::mixed_precision);
+			Fluid fluid("mixed", 1.0/3, 0.8);
+			fluid.simple_ini(geom, 1.5);
+			lbm.compress(geom, fluid, deviation);
+			run_single_phase(geom, fluid, lbm, vol_force);
+			lbm.synchronize(geom, fluid);
+			lbm.expand(geom, fluid);
+			errors[deviation] = relative_difference(reference, fluid);
+		}
+		if ((errors[0] > float_tol) || (errors[1] > float_tol)) {
+			std::cerr << "Single phase mixed precision error too large: "
+					  << errors[0] << " " << errors[1] << std::endl;
+			return false;
+		}
+		if (errors[1] > errors[0]) {
+			std::cerr << "Deviation storage should be more accurate: "
+					  << errors[0] << " " << errors[1] << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+/// Droplet in a channel with wetting walls
+bool two_phase_mixed_test()
+{
+	Geometry geom = make_channel_geometry();
+	std::vector<double> vol_force{0, 1, 0, -1, 0, 1, -1, -1, 1};
+	std::for_each(vol_force.begin(), vol_force.end(), [](double& el) { el *= 1e-6; });
+
+	LBM double_lbm(geom);
+	Fluid ref_bulk("ref_bulk", 1.0/3, 1.0), ref_droplet("ref_droplet", 1.0/3, 0.9);
+	run_two_phase(geom, ref_bulk, ref_droplet, double_lbm, vol_force);
+
+	double errors[2] = {};
+	for (const bool deviation : {false, true}) {
+		LBM lbm(geom, LBM::two_lattice, LBM::mixed_precision);
+		Fluid bulk("bulk", 1.0/3, 1.0), droplet("droplet", 1.0/3, 0.9);
+		// Initialized in double precision, compressed before the steps
+		bulk.zero_density_ini(geom);
+		droplet.zero_density_ini(geom);
+		bulk.initialize_interactions(0.2, 0.9);
+		droplet.initialize_interactions(-0.2, 0.9);
+		lbm.initialize_droplet(geom, bulk, droplet, 2.0, 2.0, 0.06, 0.06, 25, 16, 7);
+		lbm.compute_solid_surface_force(geom, bulk, droplet);
+		lbm.compress(geom, bulk, deviation);
+		lbm.compress(geom, droplet, deviation);
+		for (int iter = 0; iter<41; ++iter) {
+			lbm.step(geom, bulk, droplet, vol_force);
+		}
+		lbm.expand(geom, bulk);
+		lbm.expand(geom, droplet);
+		errors[deviation] = std::max(relative_difference(ref_bulk, bulk), relative_difference(ref_droplet, droplet));
+	}
+	if ((errors[0] > float_tol) || (errors[1] > float_tol)) {
+		std::cerr << "Two phase mixed precision error too large: "
+				  << errors[0] << " " << errors[1] << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Channel with walls and two objects, odd dimensions
+Geometry make_channel_geometry()
+{
+	Geometry geom(51, 33);
+	geom.add_walls(1, "x");
+	geom.add_ellipse(9, 7, 12, 16);
+	geom.add_rectangle(5, 9, 35, 10);
+	return geom;
+}
+
+// Largest difference in the distributions relative to the largest reference value
+double relative_difference(const Fluid& reference, const Fluid& fluid)
+{
+	const LatticeVector<double>& f_ref = reference.get_f_dist();
+	const LatticeVector<double>& f = fluid.get_f_dist();
+	double max_diff = 0.0, max_ref = 0.0;
+	for (size_t ijk = 0; ijk < f_ref.size(); ++ijk) {
+		max_diff = std::max(max_diff, std::abs(f.at(ijk) - f_ref.at(ijk)));
+		max_ref = std::max(max_ref, std::abs(f_ref.at(ijk)));
+	}
+	return max_diff/max_ref;
+}
+
+// Flow driven by a multidirectional force
+void run_single_phase(const Geometry& geom, Fluid& fluid, LBM& lbm, const std::vector<double>& vol_force)
+{
+	const int max_iter = 41;
+	for (int iter = 0; iter<max_iter; ++iter) {
+		lbm.step(geom, fluid, vol_force);
+	}
+}
+
+// Double precision droplet run
+void run_two_phase(const Geometry& geom, Fluid& bulk, Fluid& droplet, LBM& lbm, const std::vector<double>& vol_force)
+{
+	const int max_iter = 41;
+	bulk.zero_density_ini(geom);
+	droplet.zero_density_ini(geom);
+	bulk.initialize_interactions(0.2, 0.9);
+	droplet.initialize_interactions(-0.2, 0.9);
+	lbm.initialize_droplet(geom, bulk, droplet, 2.0, 2.0, 0.06, 0.06, 25, 16, 7);
+	lbm.compute_solid_surface_force(geom, bulk, droplet);
+	for (int iter = 0; iter<max_iter; ++iter) {
+		lbm.step(geom, bulk, droplet, vol_force);
+	}
+}
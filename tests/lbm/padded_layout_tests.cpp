@@ -0,0 +1,217 @@
+#include "../../include/lbm.h"
+#include "../common/test_utils.h"
+#include "lbm_tests.h"
+
+/*****************************************************
+ *
+ * Test suite for the padded layout - steps through
+ *	the ghost frame need to give exactly the same
+ *	distributions as the dense steps
+ *
+ *****************************************************/
+
+bool pad_unpad_test();
+bool padded_layout_errors_test();
+bool padded_channel_test();
+bool padded_periodic_edges_test();
+
+// Supporting functions
+Geometry make_edge_geometry();
+// True if the padded steps give the same distributions as the dense ones,
+// for both schedules and several numbers of threads
+bool compare_padded_steps(const Geometry& geom, const std::vector<double>& vol_force, const int max_iter);
+
+int main()
+{
+	test_pass(pad_unpad_test(), "Padding and restoring the dense distribution");
+	test_pass(padded_layout_errors_test(), "Operations not available in the padded layout");
+	test_pass(padded_channel_test(), "Padded single phase step, channel with objects");
+	test_pass(padded_periodic_edges_test(), "Padded single phase step, solids on the periodic edges");
+}
+
+/// Padded fluids are larger and come back unchanged
+bool pad_unpad_test()
+{
+	Geometry geom = make_edge_geometry();
+	const size_t Ntot = geom.Nx()*geom.Ny();
+	LBM lbm(geom, LBM::two_lattice, LBM::double_precision, LBM::padded);
+	Fluid dense("dense", 1.0/3, 0.8);
+	Fluid fluid("padded", 1.0/3, 0.8);
+	dense.simple_ini(geom, 1.5);
+	fluid.simple_ini(geom, 1.5);
+	// Distinct values in every slot
+	for (size_t i = 0; i < Ntot*9; ++i) {
+		dense.get_f_dist().at(i) += 1e-3*i;
+		fluid.get_f_dist().at(i) += 1e-3*i;
+	}
+
+	lbm.pad(geom, fluid);
+	// Ghost frame and row pitch of whole 64 byte lines
+	if ((fluid.get_f_dist().size() < (geom.Nx() + 2)*(geom.Ny() + 2)*9)
+			|| (fluid.get_f_dist().size()%(8*9) != 0) || !fluid.get_f_eq_dist().empty()) {
+		std::cerr << "Padded arrays have wrong sizes" << std::endl;
+		return false;
+	}
+	lbm.unpad(geom, fluid);
+	if ((fluid.get_f_eq_dist().size() != Ntot*9) || (fluid.get_f_dist() != dense.get_f_dist())) {
+		std::cerr << "Restored distribution differs from the original" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+/// Other modes, unpadded fluids, and other operations are rejected
+bool padded_layout_errors_test()
+{
+	Geometry geom = make_edge_geometry();
+	LBM lbm(geom, LBM::two_lattice, LBM::double_precision, LBM::padded);
+	LBM dense_lbm(geom);
+	Fluid fluid("water", 1.0/3, 0.8);
+	fluid.simple_ini(geom, 1.5);
+	const std::vector<double> vol_force(9, 0.0);
+
+	bool thrown = false;
+	try {
+		LBM aa_lbm(geom, LBM::aa_pattern, LBM::double_precision, LBM::padded);
+	} catch (const std::invalid_argument& e) {
+		thrown = true;
+	}
+	if (!thrown) {
+		std::cerr << "Padded layout in the aa_pattern mode should throw" << std::endl;
+		return false;
+	}
+
+	thrown = false;
+	try {
+		lbm.step(geom, fluid, vol_force);
+	} catch (const std::runtime_error& e) {
+		thrown = true;
+	}
+	if (!thrown) {
+		std::cerr << "Step with an unpadded fluid should throw" << std::endl;
+		return false;
+	}
+
+	thrown = false;
+	try {
+		dense_lbm.pad(geom, fluid);
+	} catch (const std::runtime_error& e) {
+		thrown = true;
+	}
+	if (!thrown) {
+		std::cerr << "Padding in the dense layout should throw" << std::endl;
+		return false;
+	}
+
+	lbm.pad(geom, fluid);
+	thrown = false;
+	try {
+		lbm.collide(geom, fluid);
+	} catch (const std::runtime_error& e) {
+		thrown = true;
+	}
+	if (!thrown) {
+		std::cerr << "Separate collision in the padded layout should throw" << std::endl;
+		return false;
+	}
+
+	thrown = false;
+	try {
+		fluid.compute_density();
+	} catch (const std::exception& e) {
+		thrown = true;
+	}
+	if (!thrown) {
+		std::cerr << "Moments of a padded fluid should throw" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+/// Walls along x and two objects, multidirectional force
+bool padded_channel_test()
+{
+	Geometry geom(61, 40);
+	geom.add_walls(2, "y");
+	geom.add_ellipse(11, 7, 15, 12);
+	geom.add_ellipse(7, 11, 40, 25);
+	std::vector<double> vol_force{0, 1, 0, -1, 0, 1, -1, -1, 1};
+	std::for_each(vol_force.begin(), vol_force.end(), [](double& el) { el *= 1e-4; });
+
+	if (!compare_padded_steps(geom, vol_force, 40)) {
+		std::cerr << "Padded steps differ from the dense ones in a channel" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+/// Fully periodic domain with solids on the edges and corners, so that
+/// values also bounce back across the edges
+bool padded_periodic_edges_test()
+{
+	std::vector<double> vol_force{0, 1, 0, -1, 0, 1, -1, -1, 1};
+	std::for_each(vol_force.begin(), vol_force.end(), [](double& el) { el *= 1e-4; });
+
+	if (!compare_padded_steps(make_edge_geometry(), vol_force, 40)) {
+		std::cerr << "Padded steps differ from the dense ones with solids on the edges" << std::endl;
+		return false;
+	}
+	// Single column and single row lattices
+	if (!compare_padded_steps(Geometry(1, 9), vol_force, 10)
+			|| !compare_padded_steps(Geometry(9, 1), vol_force, 10)) {
+		std::cerr << "Padded steps differ from the dense ones for a single column or row" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Periodic domain with solid nodes on all edges, in the corners, and next to them
+Geometry make_edge_geometry()
+{
+	const size_t Nx = 33, Ny = 21;
+	Geometry geom(Nx, Ny);
+	geom.add_ellipse(9, 5, 16, 10);
+	geom.set_node_solid(0, 10);
+	geom.set_node_solid(Nx-1, 4);
+	geom.set_node_solid(7, 0);
+	geom.set_node_solid(20, Ny-1);
+	geom.set_node_solid(0, 0);
+	geom.set_node_solid(Nx-1, Ny-1);
+	geom.set_node_solid(1, Ny-1);
+	geom.set_node_solid(Nx-2, 0);
+	return geom;
+}
+
+// True if the padded steps give the same distributions as the dense ones,
+// for both schedules and several numbers of threads
+bool compare_padded_steps(const Geometry& geom, const std::vector<double>& vol_force, const int max_iter)
+{
+	Fluid reference("reference", 1.0/3, 0.8);
+	reference.simple_ini(geom, 1.5);
+	LBM dense_lbm(geom);
+	for (int iter = 0; iter < max_iter; ++iter) {
+		dense_lbm.step(geom, reference, vol_force);
+	}
+
+	for (const int nthreads : {1, 3}) {
+		for (const LBM::Schedule sched : {LBM::static_slabs, LBM::work_stealing}) {
+			set_num_threads(nthreads);
+			LBM lbm(geom, LBM::two_lattice, LBM::double_precision, LBM::padded);
+			lbm.set_schedule(sched);
+			Fluid fluid("padded", 1.0/3, 0.8);
+			fluid.simple_ini(geom, 1.5);
+			lbm.pad(geom, fluid);
+			for (int iter = 0; iter < max_iter; ++iter) {
+				lbm.step(geom, fluid, vol_force);
+			}
+			lbm.unpad(geom, fluid);
+			set_num_threads(1);
+			// Same operations in the same order, bit for bit
+			if (fluid.get_f_dist() != reference.get_f_dist()) {
+				std::cerr << "Padded steps with " << nthreads << " threads differ" << std::endl;
+				return false;
+			}
+		}
+	}
+	return true;
+}
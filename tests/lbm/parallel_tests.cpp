@@ -0,0 +1,573 @@
+#include "../../include/lbm.h"
+#include "../common/test_utils.h"
+#include "lbm_tests.h"
+
+/*****************************************************
+ *
+ * Test suite for the shared memory parallelization -
+ *	results with different numbers of threads need
+ *	to be identical to the serial ones
+ *
+ *****************************************************/
+
+bool thread_count_test();
+bool single_phase_separate_threads_test();
+bool single_phase_step_threads_test();
+bool two_phase_separate_threads_test();
+bool two_phase_step_threads_test();
+bool thread_pool_test();
+bool thread_pool_errors_test();
+bool thread_count_change_test();
+bool tile_scheduler_test();
+bool work_stealing_step_test();
+bool busy_times_test();
+bool overlapped_schedule_test();
+bool scratch_pool_test();
+
+// Supporting functions
+Geometry make_test_geometry();
+// overlapped - fused steps with (empty) halo exchanges
+void run_single_phase(const Geometry& geom, Fluid& fluid, const bool fused,
+						const LBM::Streaming mode, const int nthreads, 
+						const LBM::Schedule sched = LBM::static_slabs, const bool overlapped = false);
+void run_two_phase(Geometry& geom, Fluid& bulk, Fluid& droplet, const bool fused,
+						const int nthreads, const LBM::Schedule sched = LBM::static_slabs, 
+						const bool overlapped = false);
+bool same_macroscopic(Fluid& fluid_1, Fluid& fluid_2, const Geometry& geom);
+
+// Thread counts to compare with the serial run
+const std::vector<int> thread_counts = {2, 3, 5};
+
+int main()
+{
+	test_pass(thread_count_test(), "Setting the number of threads");
+	test_pass(single_phase_separate_threads_test(), "Single phase separate operations, serial and parallel");
+	test_pass(single_phase_step_threads_test(), "Single phase fused step, serial and parallel");
+	test_pass(two_phase_separate_threads_test(), "Two phase separate operations, serial and parallel");
+	test_pass(two_phase_step_threads_test(), "Two phase fused step, serial and parallel");
+	test_pass(thread_pool_test(), "Persistent workers and barriers");
+	test_pass(thread_pool_errors_test(), "Exceptions thrown by the workers");
+	test_pass(thread_count_change_test(), "Fused steps with a changing number of threads");
+	test_pass(tile_scheduler_test(), "Tiles weighted by fluid nodes and work stealing");
+	test_pass(work_stealing_step_test(), "Fused steps with work stealing, serial and parallel");
+	test_pass(busy_times_test(), "Busy time of each worker");
+	test_pass(overlapped_schedule_test(), "Steps with halo exchanges, work stealing and busy times");
+	test_pass(scratch_pool_test(), "Lattice arrays reused between simulations");
+}
+
+/// Runtime control of the number of threads
+bool thread_count_test()
+{
+	bool thrown = false;
+	try {
+		set_num_threads(0);
+	} catch (const std::invalid_argument& e) {
+		thrown = true;
+	}
+	if (!thrown) {
+		std::cerr << "Zero threads should not be accepted" << std::endl;
+		return false;
+	}
+#ifdef _OPENMP
+	set_num_threads(3);
+	if (get_num_threads() != 3) {
+		std::cerr << "Number of threads was not set" << std::endl;
+		return false;
+	}
+#else
+	if (get_num_threads() != 1) {
+		std::cerr << "Serial build should report one thread" << std::endl;
+		return false;
+	}
+#endif
+	return true;
+}
+
+/// Collide, volume force, and stream called separately
+bool single_phase_separate_threads_test()
+{
+	Geometry geom = make_test_geometry();
+	Fluid serial_fluid("serial", 1.0/3, 0.8);
+	run_single_phase(geom, serial_fluid, false, LBM::two_lattice, 1);
+
+	for (const int nthreads : thread_counts) {
+		Fluid fluid("parallel", 1.0/3, 0.8);
+		run_single_phase(geom, fluid, false, LBM::two_lattice, nthreads);
+		if (!same_distributions(serial_fluid, fluid, 0.0)
+				|| !same_macroscopic(serial_fluid, fluid, geom)) {
+			std::cerr << "Separate operations differ with " << nthreads << " threads" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+/// Fused step with both streaming modes
+bool single_phase_step_threads_test()
+{
+	Geometry geom = make_test_geometry();
+	Fluid serial_fluid("serial", 1.0/3, 0.8);
+	run_single_phase(geom, serial_fluid, true, LBM::two_lattice, 1);
+
+	for (const int nthreads : thread_counts) {
+		Fluid fluid("parallel", 1.0/3, 0.8), aa_fluid("parallel_aa", 1.0/3, 0.8);
+		run_single_phase(geom, fluid, true, LBM::two_lattice, nthreads);
+		run_single_phase(geom, aa_fluid, true, LBM::aa_pattern, nthreads);
+		if (!same_distributions(serial_fluid, fluid, 0.0)
+				|| !same_distributions(serial_fluid, aa_fluid, 0.0)) {
+			std::cerr << "Fused step differs with " << nthreads << " threads" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+/// Full sequence of separate two phase operations
+bool two_phase_separate_threads_test()
+{
+	Geometry geom = make_test_geometry();
+	Fluid serial_bulk("serial_bulk", 1.0/3, 1.0), serial_droplet("serial_droplet", 1.0/3, 0.9);
+	run_two_phase(geom, serial_bulk, serial_droplet, false, 1);
+
+	for (const int nthreads : thread_counts) {
+		Fluid bulk("bulk", 1.0/3, 1.0), droplet("droplet", 1.0/3, 0.9);
+		run_two_phase(geom, bulk, droplet, false, nthreads);
+		if (!same_distributions(serial_bulk, bulk, 0.0)
+				|| !same_distributions(serial_droplet, droplet, 0.0)) {
+			std::cerr << "Separate two phase operations differ with " << nthreads << " threads" << std::endl;
+			return false;
+		}
+		// Intermediate arrays are stored by the separate operations
+		if (!(serial_droplet.get_u_eq_x() == droplet.get_u_eq_x())
+				|| !(serial_bulk.get_repulsive_force_y() == bulk.get_repulsive_force_y())) {
+			std::cerr << "Two phase intermediate properties differ with " << nthreads << " threads" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+/// Fused two phase step
+bool two_phase_step_threads_test()
+{
+	Geometry geom = make_test_geometry();
+	Fluid serial_bulk("serial_bulk", 1.0/3, 1.0), serial_droplet("serial_droplet", 1.0/3, 0.9);
+	run_two_phase(geom, serial_bulk, serial_droplet, true, 1);
+
+	for (const int nthreads : thread_counts) {
+		Fluid bulk("bulk", 1.0/3, 1.0), droplet("droplet", 1.0/3, 0.9);
+		run_two_phase(geom, bulk, droplet, true, nthreads);
+		if (!same_distributions(serial_bulk, bulk, 0.0)
+				|| !same_distributions(serial_droplet, droplet, 0.0)) {
+			std::cerr << "Fused two phase step differs with " << nthreads << " threads" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+/// Every worker runs each task once, no worker passes a barrier early
+bool thread_pool_test()
+{
+	for (const size_t nthreads : {1, 2, 5}) {
+		ThreadPool pool(nthreads);
+		std::vector<size_t> calls(nthreads, 0), phase_1(nthreads, 0), phase_2(nthreads, 0);
+		std::atomic<bool> early{false};
+		for (size_t it = 1; it <= 200; ++it) {
+			auto task = [&](const size_t tid)
+			{
+				++calls.at(tid);
+				phase_1.at(tid) = it;
+				pool.barrier();
+				for (size_t other = 0; other < nthreads; ++other) {
+					if (phase_1.at(other) != it) {
+						early = true;
+					}
+				}
+				pool.barrier();
+				phase_2.at(tid) = it;
+			};
+			pool.run(task);
+			// Task is complete on return
+			if (std::count(phase_2.begin(), phase_2.end(), it) != static_cast<long>(nthreads)) {
+				std::cerr << "Workers still running after the task returned" << std::endl;
+				return false;
+			}
+		}
+		if (early) {
+			std::cerr << "A worker passed the barrier early with " << nthreads << " threads" << std::endl;
+			return false;
+		}
+		if (std::count(calls.begin(), calls.end(), 200) != static_cast<long>(nthreads)) {
+			std::cerr << "Workers did not run every task once with " << nthreads << " threads" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+/// Exception from one worker stops the task and the pool stays usable
+bool thread_pool_errors_test()
+{
+	ThreadPool pool(4);
+	std::vector<int> finished(4, 0);
+	auto failing = [&](const size_t tid)
+	{
+		if (tid == 2) {
+			throw std::runtime_error("worker failed");
+		}
+		pool.barrier();
+		finished.at(tid) = 1;
+	};
+	bool thrown = false;
+	try {
+		pool.run(failing);
+	} catch (const std::runtime_error& e) {
+		thrown = (std::string(e.what()) == "worker failed");
+	}
+	if (!thrown || (std::count(finished.begin(), finished.end(), 1) != 0)) {
+		std::cerr << "Worker exception was not passed on, or the others passed the barrier" << std::endl;
+		return false;
+	}
+	auto working = [&](const size_t tid)
+	{
+		pool.barrier();
+		finished.at(tid) = 1;
+	};
+	pool.run(working);
+	if (std::count(finished.begin(), finished.end(), 1) != 4) {
+		std::cerr << "Pool does not work after an exception" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+/// Workers are restarted when the number of threads changes between steps
+bool thread_count_change_test()
+{
+	Geometry geom = make_test_geometry();
+	Fluid serial_fluid("serial", 1.0/3, 0.8);
+	run_single_phase(geom, serial_fluid, true, LBM::two_lattice, 1);
+
+	std::vector<double> vol_force{0, 1, 0, -1, 0, 1, -1, -1, 1};
+	std::for_each(vol_force.begin(), vol_force.end(), [](double& el) { el *= 1e-4; });
+	Fluid fluid("changing", 1.0/3, 0.8);
+	fluid.simple_ini(geom, 1.5);
+	LBM lbm(geom);
+	for (int iter = 0; iter < 41; ++iter) {
+		set_num_threads(1 + iter%4);
+		lbm.step(geom, fluid, vol_force);
+	}
+	set_num_threads(1);
+	return same_distributions(serial_fluid, fluid, 0.0);
+}
+
+/// Tiles cover the rows once, dealt by weight, each taken exactly once
+bool tile_scheduler_test()
+{
+	const size_t Nx = 10, Ny = 40, nworkers = 4;
+	// Open rows at the top only
+	std::vector<size_t> row_weights(Ny, 0);
+	for (size_t yj = 30; yj < Ny; ++yj) {
+		row_weights.at(yj) = Nx;
+	}
+	TileScheduler tiles;
+	tiles.build(row_weights, Nx, 2, 39, nworkers, 4);
+
+	size_t next = 2*Nx;
+	for (size_t i = 0; i < tiles.size(); ++i) {
+		if (tiles.get_tile(i).begin != next || tiles.get_tile(i).end <= next) {
+			std::cerr << "Tiles are not consecutive rows" << std::endl;
+			return false;
+		}
+		next = tiles.get_tile(i).end;
+	}
+	if (next != 39*Nx) {
+		std::cerr << "Tiles don't cover the rows" << std::endl;
+		return false;
+	}
+	// Weighted tiles - open rows are split finer than the solid ones
+	const NodeRange last = tiles.get_tile(tiles.size() - 1);
+	if ((last.end - last.begin) > 2*Nx || (tiles.get_tile(0).end - tiles.get_tile(0).begin) < 5*Nx) {
+		std::cerr << "Tiles are not weighted by the fluid nodes" << std::endl;
+		return false;
+	}
+	if ((tiles.get_initial_tiles(0).begin != 0) || (tiles.get_initial_tiles(nworkers - 1).end != tiles.size())) {
+		std::cerr << "Not all tiles were dealt" << std::endl;
+		return false;
+	}
+
+	ThreadPool pool(nworkers);
+	std::vector<std::atomic<int>> taken(tiles.size());
+	for (int pass = 0; pass < 50; ++pass) {
+		for (auto& count : taken) {
+			count = 0;
+		}
+		tiles.reset();
+		auto task = [&](const size_t tid)
+		{
+			tiles.run(tid, [&](const NodeRange tile)
+				{
+					for (size_t i = 0; i < tiles.size(); ++i) {
+						if (tiles.get_tile(i).begin == tile.begin) {
+							++taken.at(i);
+						}
+					}
+				});
+		};
+		pool.run(task);
+		for (const auto& count : taken) {
+			if (count != 1) {
+				std::cerr << "A tile was not taken exactly once" << std::endl;
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/// Both step pipelines with both streaming modes, solid half of the domain
+bool work_stealing_step_test()
+{
+	Geometry geom = make_test_geometry();
+	geom.add_rectangle(45, 11, 22, 30);
+
+	Fluid serial_fluid("serial", 1.0/3, 0.8);
+	run_single_phase(geom, serial_fluid, true, LBM::two_lattice, 1);
+	Fluid serial_bulk("serial_bulk", 1.0/3, 1.0), serial_droplet("serial_droplet", 1.0/3, 0.9);
+	run_two_phase(geom, serial_bulk, serial_droplet, true, 1);
+
+	for (const int nthreads : thread_counts) {
+		Fluid fluid("stealing", 1.0/3, 0.8), aa_fluid("stealing_aa", 1.0/3, 0.8);
+		run_single_phase(geom, fluid, true, LBM::two_lattice, nthreads, LBM::work_stealing);
+		run_single_phase(geom, aa_fluid, true, LBM::aa_pattern, nthreads, LBM::work_stealing);
+		if (!same_distributions(serial_fluid, fluid, 0.0)
+				|| !same_distributions(serial_fluid, aa_fluid, 0.0)) {
+			std::cerr << "Single phase step with work stealing differs with " << nthreads << " threads" << std::endl;
+			return false;
+		}
+		Fluid bulk("bulk", 1.0/3, 1.0), droplet("droplet", 1.0/3, 0.9);
+		run_two_phase(geom, bulk, droplet, true, nthreads, LBM::work_stealing);
+		if (!same_distributions(serial_bulk, bulk, 0.0)
+				|| !same_distributions(serial_droplet, droplet, 0.0)) {
+			std::cerr << "Two phase step with work stealing differs with " << nthreads << " threads" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+/// One busy time per worker, zero after a reset
+bool busy_times_test()
+{
+	Geometry geom = make_test_geometry();
+	Fluid fluid("fluid", 1.0/3, 0.8);
+	fluid.simple_ini(geom, 1.5);
+#ifdef _OPENMP
+	const size_t nthreads = 3;
+#else
+	const size_t nthreads = 1;
+#endif
+	set_num_threads(static_cast<int>(nthreads));
+	LBM lbm(geom);
+	lbm.set_schedule(LBM::work_stealing);
+	for (int iter = 0; iter < 5; ++iter) {
+		lbm.step(geom, fluid, std::vector<double>(9, 0.0));
+	}
+	set_num_threads(1);
+
+	const std::vector<double>& busy = lbm.get_busy_times();
+	if ((busy.size() != nthreads) || (busy.at(0) <= 0.0)) {
+		std::cerr << "Wrong busy times of the workers" << std::endl;
+		return false;
+	}
+	lbm.reset_busy_times();
+	if (std::count(busy.begin(), busy.end(), 0.0) != static_cast<long>(nthreads)) {
+		std::cerr << "Busy times were not reset" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+/// Interior of the steps with halo exchanges follows the schedule, 
+/// boundary strips and interior count in the busy times
+bool overlapped_schedule_test()
+{
+	Geometry geom = make_test_geometry();
+	Fluid serial_fluid("serial", 1.0/3, 0.8);
+	run_single_phase(geom, serial_fluid, true, LBM::two_lattice, 1);
+	Fluid serial_bulk("serial_bulk", 1.0/3, 1.0), serial_droplet("serial_droplet", 1.0/3, 0.9);
+	run_two_phase(geom, serial_bulk, serial_droplet, true, 1);
+
+	for (const int nthreads : thread_counts) {
+		for (const LBM::Schedule sched : {LBM::static_slabs, LBM::work_stealing}) {
+			Fluid fluid("overlapped", 1.0/3, 0.8);
+			run_single_phase(geom, fluid, true, LBM::two_lattice, nthreads, sched, true);
+			Fluid bulk("bulk", 1.0/3, 1.0), droplet("droplet", 1.0/3, 0.9);
+			run_two_phase(geom, bulk, droplet, true, nthreads, sched, true);
+			if (!same_distributions(serial_fluid, fluid, 0.0) || !same_distributions(serial_bulk, bulk, 0.0)
+					|| !same_distributions(serial_droplet, droplet, 0.0)) {
+				std::cerr << "Steps with halo exchanges differ with " << nthreads << " threads" << std::endl;
+				return false;
+			}
+		}
+	}
+
+	// Every worker updates part of the boundary strips
+	Fluid fluid("fluid", 1.0/3, 0.8);
+	fluid.simple_ini(geom, 1.5);
+	set_num_threads(3);
+	LBM lbm(geom);
+	lbm.set_schedule(LBM::work_stealing);
+	LBM::HaloExchange halo;
+	for (int iter = 0; iter < 5; ++iter) {
+		lbm.step(geom, fluid, std::vector<double>(9, 0.0), halo);
+	}
+	set_num_threads(1);
+	const std::vector<double>& busy = lbm.get_busy_times();
+	if ((busy.size() != 3) || (std::count(busy.begin(), busy.end(), 0.0) != 0)) {
+		std::cerr << "Steps with halo exchanges should count in the busy times" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+/// Consecutive simulations reuse the arrays of the previous ones with the same
+/// results, a new domain size frees them; large arrays are aligned to huge pages
+bool scratch_pool_test()
+{
+	ScratchPool& pool = ScratchPool::shared();
+	pool.clear();
+	Geometry geom = make_test_geometry();
+	std::vector<LatticeVector<double>> f_final;
+	std::vector<size_t> kept;
+	for (int sim = 0; sim < 2; ++sim) {
+		kept.push_back(pool.kept_bytes());
+		Fluid fluid("fluid", 1.0/3, 0.8);
+		fluid.simple_ini(geom, 1.5);
+		kept.push_back(pool.kept_bytes());
+		run_single_phase(geom, fluid, true, LBM::two_lattice, 1);
+		f_final.push_back(fluid.get_f_dist());
+	}
+	// Nothing kept before the first simulation, the second one takes 
+	// the distribution from the arrays of the first
+	if ((kept.at(0) != 0) || (kept.at(2) == 0) 
+			|| (kept.at(2) - kept.at(3) < geom.Nx()*geom.Ny()*9*sizeof(double))) {
+		std::cerr << "Arrays of the first simulation should be reused" << std::endl;
+		return false;
+	}
+	for (size_t i = 0; i < f_final.at(0).size(); ++i) {
+		if (!float_equality(f_final.at(0).at(i), f_final.at(1).at(i), 1e-15)) {
+			std::cerr << "Simulation with reused arrays differs" << std::endl;
+			return false;
+		}
+	}
+
+	// New domain size, kept arrays are freed before allocating
+	LatticeVector<double> field;
+	pooled_resize(field, 10, 12, 1);
+	if (pool.kept_bytes() != 0) {
+		std::cerr << "Arrays of another domain should be freed" << std::endl;
+		return false;
+	}
+	pool.release(field);
+	if (!field.empty() || (pool.kept_bytes() != 10*12*sizeof(double))) {
+		std::cerr << "Released array should be kept" << std::endl;
+		return false;
+	}
+	pool.clear();
+
+	LatticeVector<double> large(300000), page(1000);
+	if ((reinterpret_cast<std::uintptr_t>(large.data())%FirstTouchAllocator<double>::huge_page_size != 0)
+			|| (reinterpret_cast<std::uintptr_t>(page.data())%FirstTouchAllocator<double>::page_size != 0)) {
+		std::cerr << "Lattice arrays should be page-aligned" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Walls and an object, number of rows not divisible by the thread counts
+Geometry make_test_geometry()
+{
+	Geometry geom(45, 37);
+	geom.add_walls(2, "y");
+	geom.add_ellipse(11, 7, 15, 18);
+	geom.add_rectangle(5, 9, 35, 10);
+	return geom;
+}
+
+// Flow driven by a multidirectional force with a given number of threads
+void run_single_phase(const Geometry& geom, Fluid& fluid, const bool fused,
+						const LBM::Streaming mode, const int nthreads, const LBM::Schedule sched,
+						const bool overlapped)
+{
+	LBM::HaloExchange halo;
+	const int max_iter = 41;
+	std::vector<double> vol_force{0, 1, 0, -1, 0, 1, -1, -1, 1};
+	std::for_each(vol_force.begin(), vol_force.end(), [](double& el) { el *= 1e-4; });
+
+	set_num_threads(nthreads);
+	fluid.simple_ini(geom, 1.5);
+	LBM lbm(geom, mode);
+	lbm.set_schedule(sched);
+	for (int iter = 0; iter<max_iter; ++iter) {
+		if (overlapped) {
+			lbm.step(geom, fluid, vol_force, halo);
+		} else if (fused) {
+			lbm.step(geom, fluid, vol_force);
+		} else {
+			lbm.collide(geom, fluid);
+			lbm.add_volume_force(geom, fluid, vol_force);
+			lbm.stream(geom, fluid);
+		}
+	}
+	lbm.synchronize(geom, fluid);
+	set_num_threads(1);
+}
+
+// Droplet in a channel with a given number of threads
+void run_two_phase(Geometry& geom, Fluid& bulk, Fluid& droplet, const bool fused,
+						const int nthreads, const LBM::Schedule sched, const bool overlapped)
+{
+	LBM::HaloExchange halo;
+	const int max_iter = 41;
+	const double G_solids_bulk = 0.2, G_repulsive = 0.9;
+	std::vector<double> vol_force{0, 1, 0, -1, 0, 1, -1, -1, 1};
+	std::for_each(vol_force.begin(), vol_force.end(), [](double& el) { el *= 1e-5; });
+
+	set_num_threads(nthreads);
+	LBM lbm(geom);
+	lbm.set_schedule(sched);
+	bulk.zero_density_ini(geom);
+	droplet.zero_density_ini(geom);
+	bulk.initialize_interactions(G_solids_bulk, G_repulsive);
+	droplet.initialize_interactions(-1.0*G_solids_bulk, G_repulsive);
+	lbm.initialize_droplet(geom, bulk, droplet, 2.0, 2.0, 0.06, 0.06, 30, 20, 6);
+	lbm.compute_solid_surface_force(geom, bulk, droplet);
+
+	for (int iter = 0; iter<max_iter; ++iter) {
+		if (overlapped) {
+			lbm.step(geom, bulk, droplet, vol_force, halo);
+		} else if (fused) {
+			lbm.step(geom, bulk, droplet, vol_force);
+		} else {
+			bulk.compute_density();
+			droplet.compute_density();
+			lbm.compute_fluid_repulsive_interactions(geom, bulk, droplet);
+			lbm.compute_equilibrium_velocities(geom, bulk, droplet);
+			lbm.collide(bulk, droplet);
+			lbm.add_volume_force(geom, bulk, droplet, vol_force);
+			lbm.stream(geom, bulk, droplet);
+		}
+	}
+	set_num_threads(1);
+}
+
+// True if densities and velocities of both fluids are identical
+bool same_macroscopic(Fluid& fluid_1, Fluid& fluid_2, const Geometry& geom)
+{
+	fluid_1.compute_macroscopic(geom);
+	fluid_2.compute_macroscopic(geom);
+	return (fluid_1.get_rho() == fluid_2.get_rho()) && (fluid_1.get_ux() == fluid_2.get_ux())
+				&& (fluid_1.get_uy() == fluid_2.get_uy());
+}
@@ -39,5 +39,41 @@ subprocess.call([path_exe + 'lbm_tst_multi'], shell=True)
 ut.msg('Droplet immersed in a continuous liquid', RED)
 subprocess.call([path_exe + 'lbm_tst_drop'], shell=True)
 
+# Fused time steps - compared with the separate operations
+ut.msg('Fused time steps', RED)
+subprocess.call([path_exe + 'lbm_tst_fused'], shell=True)
+
+# Shared memory parallelization - compared with serial runs
+ut.msg('Serial and parallel runs', RED)
+subprocess.call([path_exe + 'lbm_tst_omp'], shell=True)
+
+# Fluid-only storage - compared with the fused time steps
+ut.msg('Time steps on fluid nodes only', RED)
+subprocess.call([path_exe + 'lbm_tst_sparse'], shell=True)
+
+# Vectorized kernels - compared with the scalar ones
+ut.msg('Vectorized kernels', RED)
+subprocess.call([path_exe + 'lbm_tst_simd'], shell=True)
+
+# Mixed precision - compared with the double precision steps
+ut.msg('Single precision storage', RED)
+subprocess.call([path_exe + 'lbm_tst_mixed'], shell=True)
+
+# Velocity sets - consistency of the constants
+ut.msg('Lattice descriptors', RED)
+subprocess.call([path_exe + 'lbm_tst_lattice'], shell=True)
+
+# Temporal blocking - compared with the regular steps
+ut.msg('Temporally blocked steps', RED)
+subprocess.call([path_exe + 'lbm_tst_blocking'], shell=True)
+
+# Padded layout - compared with the dense steps
+ut.msg('Steps in the padded layout', RED)
+subprocess.call([path_exe + 'lbm_tst_padded'], shell=True)
+
+# Heap allocations - none in the steps after the setup
+ut.msg('Allocation-free steps', RED)
+subprocess.call([path_exe + 'lbm_tst_alloc'], shell=True)
+
 #ut.msg('Restart test', RED)
 #subprocess.call([path_exe + 'lbm_rt'], shell=True)
@@ -0,0 +1,243 @@
+#include "../../include/lbm.h"
+#include "../../include/simd_kernels.h"
+#include "../common/test_utils.h"
+#include "lbm_tests.h"
+
+/*****************************************************
+ *
+ * Test suite for the vectorized kernels - every
+ *	instruction set supported by this CPU needs to
+ *	give the same results as the scalar kernels
+ *
+ *****************************************************/
+
+bool simd_level_test();
+bool equilibrium_kernel_test();
+bool relax_kernel_test();
+bool single_phase_simd_test();
+bool two_phase_simd_test();
+
+// Supporting functions
+std::vector<SimdLevel> supported_levels();
+Geometry make_test_geometry();
+void run_single_phase(const Geometry& geom, Fluid& fluid);
+void run_two_phase(Geometry& geom, Fluid& bulk, Fluid& droplet);
+
+int main()
+{
+	std::cout << "Detected instruction set: " << simd_level_name(detect_simd_level()) << std::endl;
+	test_pass(simd_level_test(), "Selecting the instruction set");
+	test_pass(equilibrium_kernel_test(), "Vectorized equilibrium distribution");
+	test_pass(relax_kernel_test(), "Vectorized relaxation");
+	test_pass(single_phase_simd_test(), "Single phase separate operations, scalar and vectorized");
+	test_pass(two_phase_simd_test(), "Two phase separate operations, scalar and vectorized");
+}
+
+/// Best level is used by default, unsupported levels are rejected
+bool simd_level_test()
+{
+	if (get_simd_level() != detect_simd_level()) {
+		std::cerr << "Best instruction set should be the default" << std::endl;
+		return false;
+	}
+	if (detect_simd_level() != SimdLevel::avx512) {
+		bool thrown = false;
+		try {
+			set_simd_level(SimdLevel::avx512);
+		} catch (const std::invalid_argument& e) {
+			thrown = true;
+		}
+		if (!thrown) {
+			std::cerr << "Unsupported instruction set should not be accepted" << std::endl;
+			return false;
+		}
+	}
+	set_simd_level(SimdLevel::scalar);
+	if (get_simd_level() != SimdLevel::scalar) {
+		std::cerr << "Instruction set was not changed" << std::endl;
+		return false;
+	}
+	set_simd_level(detect_simd_level());
+	return true;
+}
+
+/// Equilibrium of each instruction set matches the Fluid node equilibrium,
+/// including ranges that are not multiples of the vector width
+bool equilibrium_kernel_test()
+{
+	const size_t Ntot = 37;
+	std::vector<double> rho(Ntot), ux(Ntot), uy(Ntot);
+	for (size_t ai = 0; ai < Ntot; ++ai) {
+		rho.at(ai) = 1.0 + 0.01*ai;
+		ux.at(ai) = 0.003*ai - 0.05;
+		uy.at(ai) = 0.04 - 0.002*ai;
+	}
+	// Zero velocity components with both signs
+	ux.at(3) = -0.0;
+	uy.at(3) = 0.0;
+	ux.at(12) = 0.0;
+	uy.at(12) = -0.0;
+
+	Fluid fluid("water");
+	const EquilibriumCoefficients coeffs;
+	std::vector<double> expected(Ntot*9, -1.0);
+	double feq[9] = {};
+	for (size_t ai = 3; ai < Ntot - 2; ++ai) {
+		fluid.node_f_equilibrium(rho.at(ai), ux.at(ai), uy.at(ai), feq);
+		for (size_t dj = 0; dj < 9; ++dj) {
+			expected.at(ai + dj*Ntot) = feq[dj];
+		}
+	}
+
+	for (const SimdLevel level : supported_levels()) {
+		set_simd_level(level);
+		std::vector<double> f_eq(Ntot*9, -1.0);
+		simd_f_equilibrium(coeffs, rho.data(), ux.data(), uy.data(), f_eq.data(), Ntot, 3, Ntot - 2);
+		if (f_eq != expected) {
+			std::cerr << "Equilibrium differs with " << simd_level_name(level) << std::endl;
+			set_simd_level(detect_simd_level());
+			return false;
+		}
+	}
+	set_simd_level(detect_simd_level());
+	return true;
+}
+
+/// Relaxation of each instruction set matches the scalar formula
+bool relax_kernel_test()
+{
+	const size_t N = 29;
+	const double omega = 1.0/0.8;
+	std::vector<double> f_ini(N), f_eq(N), expected(N);
+	for (size_t i = 0; i < N; ++i) {
+		f_ini.at(i) = 0.1 + 0.003*i;
+		f_eq.at(i) = 0.11 - 0.001*i;
+		expected.at(i) = f_ini.at(i);
+		if ((i >= 1) && (i < N - 3)) {
+			expected.at(i) = (1.0 - omega)*f_ini.at(i) + omega*f_eq.at(i);
+		}
+	}
+
+	for (const SimdLevel level : supported_levels()) {
+		set_simd_level(level);
+		std::vector<double> f = f_ini;
+		simd_relax(f.data(), f_eq.data(), omega, 1, N - 3);
+		if (f != expected) {
+			std::cerr << "Relaxation differs with " << simd_level_name(level) << std::endl;
+			set_simd_level(detect_simd_level());
+			return false;
+		}
+	}
+	set_simd_level(detect_simd_level());
+	return true;
+}
+
+/// Collide, volume force, and stream with each instruction set
+bool single_phase_simd_test()
+{
+	Geometry geom = make_test_geometry();
+	set_simd_level(SimdLevel::scalar);
+	Fluid scalar_fluid("scalar", 1.0/3, 0.8);
+	run_single_phase(geom, scalar_fluid);
+
+	for (const SimdLevel level : supported_levels()) {
+		set_simd_level(level);
+		Fluid fluid("vectorized", 1.0/3, 0.8);
+		run_single_phase(geom, fluid);
+		if (!same_distributions(scalar_fluid, fluid, 0.0)) {
+			std::cerr << "Single phase flow differs with " << simd_level_name(level) << std::endl;
+			set_simd_level(detect_simd_level());
+			return false;
+		}
+	}
+	set_simd_level(detect_simd_level());
+	return true;
+}
+
+/// Separate two phase operations with each instruction set
+bool two_phase_simd_test()
+{
+	Geometry geom = make_test_geometry();
+	set_simd_level(SimdLevel::scalar);
+	Fluid scalar_bulk("scalar_bulk", 1.0/3, 1.0), scalar_droplet("scalar_droplet", 1.0/3, 0.9);
+	run_two_phase(geom, scalar_bulk, scalar_droplet);
+
+	for (const SimdLevel level : supported_levels()) {
+		set_simd_level(level);
+		Fluid bulk("bulk", 1.0/3, 1.0), droplet("droplet", 1.0/3, 0.9);
+		run_two_phase(geom, bulk, droplet);
+		if (!same_distributions(scalar_bulk, bulk, 0.0) || !same_distributions(scalar_droplet, droplet, 0.0)) {
+			std::cerr << "Two phase flow differs with " << simd_level_name(level) << std::endl;
+			set_simd_level(detect_simd_level());
+			return false;
+		}
+	}
+	set_simd_level(detect_simd_level());
+	return true;
+}
+
+// All instruction sets supported by this CPU
+std::vector<SimdLevel> supported_levels()
+{
+	std::vector<SimdLevel> levels = {SimdLevel::scalar};
+	if (static_cast<int>(detect_simd_level()) >= static_cast<int>(SimdLevel::avx2)) {
+		levels.push_back(SimdLevel::avx2);
+	}
+	if (detect_simd_level() == SimdLevel::avx512) {
+		levels.push_back(SimdLevel::avx512);
+	}
+	return levels;
+}
+
+// Odd row length so that slabs are not multiples of the vector width
+Geometry make_test_geometry()
+{
+	Geometry geom(47, 37);
+	geom.add_walls(2, "x");
+	geom.add_ellipse(11, 7, 15, 18);
+	geom.add_rectangle(5, 9, 35, 10);
+	return geom;
+}
+
+// Flow driven by a multidirectional force
+void run_single_phase(const Geometry& geom, Fluid& fluid)
+{
+	const int max_iter = 41;
+	std::vector<double> vol_force{0, 1, 0, -1, 0, 1, -1, -1, 1};
+	std::for_each(vol_force.begin(), vol_force.end(), [](double& el) { el *= 1e-4; });
+
+	fluid.simple_ini(geom, 1.5);
+	LBM lbm(geom);
+	for (int iter = 0; iter<max_iter; ++iter) {
+		lbm.collide(geom, fluid);
+		lbm.add_volume_force(geom, fluid, vol_force);
+		lbm.stream(geom, fluid);
+	}
+}
+
+// Droplet in a channel
+void run_two_phase(Geometry& geom, Fluid& bulk, Fluid& droplet)
+{
+	const int max_iter = 41;
+	const double G_solids_bulk = 0.2, G_repulsive = 0.9;
+	std::vector<double> vol_force{0, 1, 0, -1, 0, 1, -1, -1, 1};
+	std::for_each(vol_force.begin(), vol_force.end(), [](double& el) { el *= 1e-5; });
+
+	LBM lbm(geom);
+	bulk.zero_density_ini(geom);
+	droplet.zero_density_ini(geom);
+	bulk.initialize_interactions(G_solids_bulk, G_repulsive);
+	droplet.initialize_interactions(-1.0*G_solids_bulk, G_repulsive);
+	lbm.initialize_droplet(geom, bulk, droplet, 2.0, 2.0, 0.06, 0.06, 30, 20, 6);
+	lbm.compute_solid_surface_force(geom, bulk, droplet);
+
+	for (int iter = 0; iter<max_iter; ++iter) {
+		bulk.compute_density();
+		droplet.compute_density();
+		lbm.compute_fluid_repulsive_interactions(geom, bulk, droplet);
+		lbm.compute_equilibrium_velocities(geom, bulk, droplet);
+		lbm.collide(bulk, droplet);
+		lbm.add_volume_force(geom, bulk, droplet, vol_force);
+		lbm.stream(geom, bulk, droplet);
+	}
+}
@@ -0,0 +1,246 @@
+#include "../../include/lbm.h"
+#include "../../include/sparse_lbm.h"
+#include "../common/test_utils.h"
+#include "lbm_tests.h"
+
+/*****************************************************
+ *
+ * Test suite for the fluid-only (sparse) storage -
+ *	time steps on compacted fluids need to give
+ *	the same results as the fused LBM steps
+ *
+ *****************************************************/
+
+bool compact_storage_test();
+bool not_compacted_test();
+bool single_phase_sparse_test();
+bool two_phase_sparse_test();
+
+// Supporting functions
+Geometry make_porous_geometry();
+size_t count_fluid_nodes(const Geometry& geom);
+
+// Thread counts for the sparse runs
+const std::vector<int> thread_counts = {1, 3};
+
+int main()
+{
+	test_pass(compact_storage_test(), "Compact storage and expansion");
+	test_pass(not_compacted_test(), "Steps with fluids that were not compacted");
+	test_pass(single_phase_sparse_test(), "Single phase step on fluid nodes only");
+	test_pass(two_phase_sparse_test(), "Two phase step on fluid nodes only");
+}
+
+/// Compact arrays scale with the number of fluid nodes, expansion restores the fluid
+bool compact_storage_test()
+{
+	Geometry geom = make_porous_geometry();
+	SparseLBM sparse_lbm(geom);
+	const size_t Nfluid = count_fluid_nodes(geom);
+	if (sparse_lbm.get_Nfluid() != Nfluid) {
+		std::cerr << "Wrong number of fluid nodes" << std::endl;
+		return false;
+	}
+
+	Fluid dense("dense", 1.0/3, 0.8), fluid("compacted", 1.0/3, 0.8);
+	dense.simple_ini(geom, 1.5);
+	fluid.simple_ini(geom, 1.5);
+	dense.compute_density();
+	fluid.compute_density();
+	sparse_lbm.compact(fluid);
+	if ((fluid.get_f_dist().size() != Nfluid*9) || (fluid.get_rho().size() != Nfluid)
+			|| !fluid.get_ux().empty() || !fluid.get_f_eq_dist().empty()) {
+		std::cerr << "Compact arrays have wrong sizes" << std::endl;
+		return false;
+	}
+
+	// Dense view of a compact property
+	const LatticeVector<double> rho = sparse_lbm.dense_field(fluid.get_rho());
+	if (rho != dense.get_rho()) {
+		std::cerr << "Dense view of the density differs from the original" << std::endl;
+		return false;
+	}
+
+	sparse_lbm.expand(fluid);
+	if (!same_distributions(dense, fluid, 0.0)) {
+		std::cerr << "Expanded distribution differs from the original" << std::endl;
+		return false;
+	}
+	fluid.compute_macroscopic(geom);
+	dense.compute_macroscopic(geom);
+	if ((fluid.get_ux() != dense.get_ux()) || (fluid.get_uy() != dense.get_uy())) {
+		std::cerr << "Velocities of the expanded fluid differ from the original" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+/// Steps need compacted fluids
+bool not_compacted_test()
+{
+	Geometry geom = make_porous_geometry();
+	SparseLBM sparse_lbm(geom);
+	Fluid fluid("dense", 1.0/3, 0.8);
+	fluid.simple_ini(geom, 1.5);
+	const std::vector<double> vol_force(9, 0.0);
+
+	bool thrown = false;
+	try {
+		sparse_lbm.step(fluid, vol_force);
+	} catch (const std::runtime_error& e) {
+		thrown = true;
+	}
+	if (!thrown) {
+		std::cerr << "Step with a dense fluid should throw" << std::endl;
+		return false;
+	}
+
+	// Compacted but without the fluid-solid forces
+	Fluid bulk("bulk"), droplet("droplet");
+	bulk.simple_ini(geom, 1.0, true);
+	droplet.simple_ini(geom, 1.0, true);
+	sparse_lbm.compact(bulk);
+	sparse_lbm.compact(droplet);
+	thrown = false;
+	try {
+		sparse_lbm.step(bulk, droplet);
+	} catch (const std::runtime_error& e) {
+		thrown = true;
+	}
+	if (!thrown) {
+		std::cerr << "Two phase step without fluid-solid forces should throw" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+/// Flow driven by a multidirectional force through an array of objects
+bool single_phase_sparse_test()
+{
+	const int max_iter = 41;
+	Geometry geom = make_porous_geometry();
+	std::vector<double> vol_force{0, 1, 0, -1, 0, 1, -1, -1, 1};
+	std::for_each(vol_force.begin(), vol_force.end(), [](double& el) { el *= 1e-4; });
+
+	LBM lbm(geom);
+	Fluid dense("dense", 1.0/3, 0.8);
+	dense.simple_ini(geom, 1.5);
+	for (int iter = 0; iter<max_iter; ++iter) {
+		lbm.step(geom, dense, vol_force);
+	}
+	dense.compute_macroscopic(geom);
+
+	for (const int nthreads : thread_counts) {
+		set_num_threads(nthreads);
+		SparseLBM sparse_lbm(geom);
+		Fluid fluid("sparse", 1.0/3, 0.8);
+		fluid.simple_ini(geom, 1.5);
+		sparse_lbm.compact(fluid);
+		for (int iter = 0; iter<max_iter; ++iter) {
+			sparse_lbm.step(fluid, vol_force);
+		}
+		sparse_lbm.expand(fluid);
+		set_num_threads(1);
+
+		if (!same_distributions(dense, fluid, 0.0)) {
+			std::cerr << "Sparse single phase step differs with " << nthreads << " threads" << std::endl;
+			return false;
+		}
+		fluid.compute_macroscopic(geom);
+		if ((fluid.get_rho() != dense.get_rho()) || (fluid.get_ux() != dense.get_ux())
+				|| (fluid.get_uy() != dense.get_uy())) {
+			std::cerr << "Sparse single phase macroscopic properties differ" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+/// Droplet with wetting solids flowing through an array of objects
+bool two_phase_sparse_test()
+{
+	const int max_iter = 41;
+	const double G_solids_bulk = 0.2, G_repulsive = 0.9;
+	Geometry geom = make_porous_geometry();
+	std::vector<double> vol_force{0, 1, 0, -1, 0, 1, -1, -1, 1};
+	std::for_each(vol_force.begin(), vol_force.end(), [](double& el) { el *= 1e-5; });
+
+	LBM lbm(geom);
+	Fluid dense_bulk("dense_bulk", 1.0/3, 1.0), dense_droplet("dense_droplet", 1.0/3, 0.9);
+	dense_bulk.zero_density_ini(geom);
+	dense_droplet.zero_density_ini(geom);
+	dense_bulk.initialize_interactions(G_solids_bulk, G_repulsive);
+	dense_droplet.initialize_interactions(-1.0*G_solids_bulk, G_repulsive);
+	lbm.initialize_droplet(geom, dense_bulk, dense_droplet, 2.0, 2.0, 0.06, 0.06, 31, 20, 7);
+	lbm.compute_solid_surface_force(geom, dense_bulk, dense_droplet);
+	for (int iter = 0; iter<max_iter; ++iter) {
+		lbm.step(geom, dense_bulk, dense_droplet, vol_force);
+	}
+
+	for (const int nthreads : thread_counts) {
+		set_num_threads(nthreads);
+		SparseLBM sparse_lbm(geom);
+		Fluid bulk("bulk", 1.0/3, 1.0), droplet("droplet", 1.0/3, 0.9);
+		bulk.zero_density_ini(geom);
+		droplet.zero_density_ini(geom);
+		bulk.initialize_interactions(G_solids_bulk, G_repulsive);
+		droplet.initialize_interactions(-1.0*G_solids_bulk, G_repulsive);
+		// Dense initialization through the LBM class
+		lbm.initialize_droplet(geom, bulk, droplet, 2.0, 2.0, 0.06, 0.06, 31, 20, 7);
+		sparse_lbm.compact(bulk);
+		sparse_lbm.compact(droplet);
+		sparse_lbm.compute_solid_surface_force(bulk, droplet);
+		for (int iter = 0; iter<max_iter; ++iter) {
+			sparse_lbm.step(bulk, droplet, vol_force);
+		}
+		// Densities from the last step
+		const LatticeVector<double> rho_bulk = sparse_lbm.dense_field(bulk.get_rho());
+		sparse_lbm.expand(bulk);
+		sparse_lbm.expand(droplet);
+		set_num_threads(1);
+
+		if (!same_distributions(dense_bulk, bulk, 0.0) || !same_distributions(dense_droplet, droplet, 0.0)) {
+			std::cerr << "Sparse two phase step differs with " << nthreads << " threads" << std::endl;
+			return false;
+		}
+		if ((rho_bulk != dense_bulk.get_rho()) || (bulk.get_rho() != dense_bulk.get_rho())
+				|| (droplet.get_rho() != dense_droplet.get_rho())) {
+			std::cerr << "Sparse two phase densities differ" << std::endl;
+			return false;
+		}
+		if ((bulk.get_fluid_solid_force_x() != dense_bulk.get_fluid_solid_force_x())
+				|| (droplet.get_fluid_solid_force_y() != dense_droplet.get_fluid_solid_force_y())) {
+			std::cerr << "Sparse fluid-solid forces differ" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+// Walls and a staggered array of objects, most nodes are solid
+Geometry make_porous_geometry()
+{
+	Geometry geom(62, 44);
+	geom.add_walls(1, "y");
+	geom.add_rectangle(11, 9, 8, 6);
+	geom.add_rectangle(11, 9, 8, 26);
+	geom.add_ellipse(13, 11, 19, 16);
+	geom.add_ellipse(13, 11, 19, 36);
+	geom.add_rectangle(11, 9, 44, 6);
+	geom.add_rectangle(11, 9, 44, 26);
+	geom.add_ellipse(13, 11, 55, 16);
+	geom.add_ellipse(13, 11, 55, 36);
+	return geom;
+}
+
+// Number of fluid nodes in a geometry
+size_t count_fluid_nodes(const Geometry& geom)
+{
+	size_t Nfluid = 0;
+	for (size_t ai = 0; ai < geom.Nx()*geom.Ny(); ++ai) {
+		if (geom(ai) == 1) {
+			++Nfluid;
+		}
+	}
+	return Nfluid;
+}
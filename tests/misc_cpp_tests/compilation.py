@@ -63,3 +63,13 @@ spec_files = 'lbm_io_tests.cpp'
 compile_com = ' '.join([cx, std, opt, other, '-o', exe_name, tst_files, src_files, spec_files])
 subprocess.call([compile_com], shell=True)
 subprocess.call(['mv ' + exe_name + ' ' + path_exe], shell=True)
+
+### Test suite 4
+# snapshot_writer.h tests
+# Name of the executable
+exe_name = 'snapshot_writer_tests'
+# Files needed only for this build
+spec_files = 'snapshot_writer_tests.cpp'
+compile_com = ' '.join([cx, std, opt, other, '-pthread', '-o', exe_name, tst_files, src_files, spec_files])
+subprocess.call([compile_com], shell=True)
+subprocess.call(['mv ' + exe_name + ' ' + path_exe], shell=True)
@@ -29,3 +29,7 @@ subprocess.call([path_exe + 'file_hdl_tests'], shell=True)
 # LbmIO class
 ut.msg('LbmIO class', CYAN)
 subprocess.call([path_exe + 'lbm_io_tests'], shell=True)
+
+# SnapshotWriter class
+ut.msg('SnapshotWriter class', CYAN)
+subprocess.call([path_exe + 'snapshot_writer_tests'], shell=True)
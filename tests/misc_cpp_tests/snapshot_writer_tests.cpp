@@ -0,0 +1,166 @@
+#include "../common/test_utils.h"
+#include <string>
+#include <cstdio>
+#include "../../include/io_operations/snapshot_writer.h"
+
+/***************************************************************
+ * Suite for testing SnapshotWriter class for background output
+***************************************************************/
+
+// Tests
+bool same_as_lbm_io_test();
+bool full_queue_test();
+bool write_error_test();
+
+// Supporting functions
+std::vector<double> make_field(const size_t Nx, const size_t Ny, const double shift);
+std::string file_contents(const std::string& fname);
+
+int main()
+{
+	test_pass(same_as_lbm_io_test(), "SnapshotWriter files same as from LbmIO");
+	test_pass(full_queue_test(), "SnapshotWriter with a full queue");
+	test_pass(write_error_test(), "SnapshotWriter errors");
+}
+
+/// Written file is the same as the one from LbmIO, field reused
+/// right after queueing
+bool same_as_lbm_io_test()
+{
+	const size_t Nx = 13, Ny = 7;
+	std::vector<double> field = make_field(Nx, Ny, 0.5);
+	std::vector<std::vector<double>> rows;
+	for (size_t yj = 0; yj < Ny; ++yj) {
+		rows.emplace_back(field.begin() + yj*Nx, field.begin() + (yj + 1)*Nx);
+	}
+	LbmIO lbm_io("snapshot_expected.txt", " ", true, {Ny, Nx, 0});
+	lbm_io.write_vector(rows);
+
+	{
+		SnapshotWriter writer;
+		writer.write(field, Nx, Ny, "snapshot_async.txt");
+		std::fill(field.begin(), field.end(), -1.0);
+	}
+	const bool same = !file_contents("snapshot_expected.txt").empty()
+				&& (file_contents("snapshot_expected.txt") == file_contents("snapshot_async.txt"));
+	std::remove("snapshot_expected.txt");
+	std::remove("snapshot_async.txt");
+	if (!same) {
+		std::cerr << "Snapshot file differs from the LbmIO one" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+/// More snapshots than the queue holds, all written in full
+bool full_queue_test()
+{
+	const size_t Nx = 40, Ny = 30, Nsnap = 12;
+	SnapshotWriter writer(1);
+	for (size_t i = 0; i < Nsnap; ++i) {
+		writer.write(make_field(Nx, Ny, i), Nx, Ny, "snapshot_" + std::to_string(i) + ".txt");
+		if (writer.queued() > 1) {
+			std::cerr << "Too many snapshots in the queue" << std::endl;
+			return false;
+		}
+	}
+	writer.flush();
+	if (writer.queued() != 0) {
+		std::cerr << "Snapshots left in the queue after flush" << std::endl;
+		return false;
+	}
+	for (size_t i = 0; i < Nsnap; ++i) {
+		const std::string fname("snapshot_" + std::to_string(i) + ".txt");
+		LbmIO lbm_io(fname, " ", true, {Ny, Nx, 0});
+		const std::vector<std::vector<double>> rows = lbm_io.read_vector<double>();
+		std::remove(fname.c_str());
+		const std::vector<double> expected = make_field(Nx, Ny, i);
+		if (rows.size() != Ny) {
+			std::cerr << "Wrong number of rows in " << fname << std::endl;
+			return false;
+		}
+		for (size_t yj = 0; yj < Ny; ++yj) {
+			if (rows.at(yj).size() != Nx) {
+				std::cerr << "Wrong number of columns in " << fname << std::endl;
+				return false;
+			}
+			for (size_t xi = 0; xi < Nx; ++xi) {
+				if (!float_equality(rows.at(yj).at(xi), expected.at(yj*Nx + xi), 1e-5)) {
+					std::cerr << "Wrong value in " << fname << std::endl;
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+/// Failed write is reported by the next call, the writer can be used
+/// afterwards; too small fields and an empty queue are rejected
+bool write_error_test()
+{
+	const size_t Nx = 5, Ny = 4;
+	const std::vector<double> field = make_field(Nx, Ny, 1.0);
+	SnapshotWriter writer;
+
+	bool thrown = false;
+	try {
+		writer.write(field, Nx, Ny, "no_such_directory/snapshot.txt");
+		writer.flush();
+	} catch (const std::ios_base::failure& e) {
+		thrown = true;
+	}
+	if (!thrown) {
+		std::cerr << "Failed snapshot write should throw" << std::endl;
+		return false;
+	}
+	writer.write(field, Nx, Ny, "snapshot_after_error.txt");
+	writer.flush();
+	const bool written = !file_contents("snapshot_after_error.txt").empty();
+	std::remove("snapshot_after_error.txt");
+	if (!written) {
+		std::cerr << "Writer should work after an error" << std::endl;
+		return false;
+	}
+
+	thrown = false;
+	try {
+		writer.write(field, Nx + 1, Ny, "snapshot_too_small.txt");
+	} catch (const std::invalid_argument& e) {
+		thrown = true;
+	}
+	if (!thrown) {
+		std::cerr << "Field smaller than Nx*Ny should throw" << std::endl;
+		return false;
+	}
+	thrown = false;
+	try {
+		SnapshotWriter no_queue(0);
+	} catch (const std::invalid_argument& e) {
+		thrown = true;
+	}
+	if (!thrown) {
+		std::cerr << "Queue without space should throw" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Row-major Nx*Ny field with values that differ among nodes
+std::vector<double> make_field(const size_t Nx, const size_t Ny, const double shift)
+{
+	std::vector<double> field(Nx*Ny, 0.0);
+	for (size_t i = 0; i < Nx*Ny; ++i) {
+		field.at(i) = shift + 0.125*i - 1.0/(i + 3.0);
+	}
+	return field;
+}
+
+// Whole file as a string, empty if it can't be opened
+std::string file_contents(const std::string& fname)
+{
+	std::ifstream in(fname);
+	std::stringstream contents;
+	contents << in.rdbuf();
+	return contents.str();
+}
@@ -0,0 +1,36 @@
+# Script for compiling the MPI tests
+
+import subprocess, glob, os
+
+### Input 
+# Path to the main directory
+path = '../../src/'
+# Path to executables 
+path_exe = '../../executables/'
+# Compiler options
+cx = 'mpicxx'
+std = '-std=c++11'
+opt = '-O0'
+# Debug configuration - bounds-checked array access in the kernels
+other = '-Wall -fopenmp -DLBM_CHECKED'
+
+# Common source files
+src_files = path + 'geometry.cpp' + ' ' + path + 'misc_checks.cpp '
+src_files += path + 'geom_object/rectangle.cpp' + ' ' + path + 'geom_object/ellipse.cpp'
+src_files += ' ' + path + 'fluid.cpp'
+src_files += ' ' + path + 'simd_kernels.cpp'
+src_files += ' ' + path + 'lbm.cpp'
+src_files += ' ' + path + 'mpi/distributed_lbm.cpp'
+src_files += ' ' + path + 'io_operations/FileHandler.cpp'
+src_files += ' ' + path + 'arrays/regular_array.cpp'
+src_files += ' ' + path + 'utils.cpp'
+tst_files = '../common/test_utils.cpp'
+
+## Domain decomposition - distributed and single process results
+# Name of the executable
+exe_name = 'mpi_tst'
+# Files needed only for this build
+spec_files = 'mpi_tests.cpp '
+compile_com = ' '.join([cx, std, opt, other, '-o', exe_name, spec_files, tst_files, src_files])
+subprocess.call([compile_com], shell=True)
+subprocess.call(['mv ' + exe_name + ' ' + path_exe], shell=True)
@@ -0,0 +1,212 @@
+#include "../../include/mpi/distributed_lbm.h"
+#include "../common/test_utils.h"
+
+/*****************************************************
+ *
+ * Test suite for the MPI domain decomposition -
+ *	results gathered from all ranks are compared
+ *	with a single process run on rank 0
+ *
+ * Run with mpirun -np N for any N that does not
+ *	exceed the number of rows
+ *
+ *****************************************************/
+
+bool single_phase_distributed_test();
+bool two_phase_distributed_test();
+bool two_phase_separate_operations_test();
+
+// Supporting functions
+Geometry make_test_geometry();
+bool same_on_root(const std::vector<double>& distributed, const LatticeVector<double>& serial);
+bool all_ranks_agree(const bool pass);
+
+int main(int argc, char** argv)
+{
+	MPI_Init(&argc, &argv);
+	int rank = 0;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+	// Collective calls - all ranks run every test
+	const bool single_phase = single_phase_distributed_test();
+	const bool two_phase = two_phase_distributed_test();
+	const bool separate = two_phase_separate_operations_test();
+
+	if (rank == 0) {
+		test_pass(single_phase, "Distributed single phase step");
+		test_pass(two_phase, "Distributed two phase step");
+		test_pass(separate, "Distributed separate two phase operations");
+	}
+
+	MPI_Finalize();
+}
+
+/// Single phase flow past objects between walls, periodic in y across ranks
+bool single_phase_distributed_test()
+{
+	const int max_iter = 60;
+	Geometry geom = make_test_geometry();
+	std::vector<double> vol_force{0, 1, 0, -1, 0, 1, -1, -1, 1};
+	std::for_each(vol_force.begin(), vol_force.end(), [](double& el) { el *= 1e-4; });
+
+	DistributedLBM dlbm(geom);
+	Fluid fluid("distributed", 1.0/3, 0.8);
+	fluid.simple_ini(dlbm.get_local_geometry(), 1.5);
+	for (int iter = 0; iter<max_iter; ++iter) {
+		dlbm.step(fluid, vol_force);
+	}
+	const std::vector<double> f_dist = dlbm.gather_distribution(fluid.get_f_dist());
+	fluid.compute_density();
+	const std::vector<double> rho = dlbm.gather(fluid.get_rho());
+
+	bool pass = true;
+	if (dlbm.get_rank() == 0) {
+		LBM lbm(geom);
+		Fluid serial_fluid("serial", 1.0/3, 0.8);
+		serial_fluid.simple_ini(geom, 1.5);
+		for (int iter = 0; iter<max_iter; ++iter) {
+			lbm.step(geom, serial_fluid, vol_force);
+		}
+		serial_fluid.compute_density();
+		pass = same_on_root(f_dist, serial_fluid.get_f_dist())
+					&& same_on_root(rho, serial_fluid.get_rho());
+		if (!pass) {
+			std::cerr << "Distributed single phase flow differs from the serial one" << std::endl;
+		}
+	}
+	return all_ranks_agree(pass);
+}
+
+/// Droplet in a channel with wetting walls, fused step
+bool two_phase_distributed_test()
+{
+	const int max_iter = 60;
+	const double G_solids_bulk = 0.2, G_repulsive = 0.9;
+	Geometry geom = make_test_geometry();
+	std::vector<double> vol_force{0, 1, 0, -1, 0, 1, -1, -1, 1};
+	std::for_each(vol_force.begin(), vol_force.end(), [](double& el) { el *= 1e-5; });
+
+	DistributedLBM dlbm(geom);
+	const Geometry& local_geom = dlbm.get_local_geometry();
+	Fluid bulk("bulk", 1.0/3, 1.0), droplet("droplet", 1.0/3, 0.9);
+	bulk.zero_density_ini(local_geom);
+	droplet.zero_density_ini(local_geom);
+	bulk.initialize_interactions(G_solids_bulk, G_repulsive);
+	droplet.initialize_interactions(-1.0*G_solids_bulk, G_repulsive);
+	dlbm.initialize_droplet(bulk, droplet, 2.0, 2.0, 0.06, 0.06, 30, 20, 7);
+	dlbm.compute_solid_surface_force(bulk, droplet);
+	for (int iter = 0; iter<max_iter; ++iter) {
+		dlbm.step(bulk, droplet, vol_force);
+	}
+	const std::vector<double> f_bulk = dlbm.gather_distribution(bulk.get_f_dist());
+	const std::vector<double> f_droplet = dlbm.gather_distribution(droplet.get_f_dist());
+
+	bool pass = true;
+	if (dlbm.get_rank() == 0) {
+		LBM lbm(geom);
+		Fluid serial_bulk("serial_bulk", 1.0/3, 1.0), serial_droplet("serial_droplet", 1.0/3, 0.9);
+		serial_bulk.zero_density_ini(geom);
+		serial_droplet.zero_density_ini(geom);
+		serial_bulk.initialize_interactions(G_solids_bulk, G_repulsive);
+		serial_droplet.initialize_interactions(-1.0*G_solids_bulk, G_repulsive);
+		lbm.initialize_droplet(geom, serial_bulk, serial_droplet, 2.0, 2.0, 0.06, 0.06, 30, 20, 7);
+		lbm.compute_solid_surface_force(geom, serial_bulk, serial_droplet);
+		for (int iter = 0; iter<max_iter; ++iter) {
+			lbm.step(geom, serial_bulk, serial_droplet, vol_force);
+		}
+		pass = same_on_root(f_bulk, serial_bulk.get_f_dist())
+					&& same_on_root(f_droplet, serial_droplet.get_f_dist());
+		if (!pass) {
+			std::cerr << "Distributed two phase flow differs from the serial one" << std::endl;
+		}
+	}
+	return all_ranks_agree(pass);
+}
+
+/// Droplet in a periodic domain, separate operations with
+/// the density and streaming halo exchanges
+bool two_phase_separate_operations_test()
+{
+	const int max_iter = 40;
+	const double G_repulsive = 0.9;
+	Geometry geom(50, 40);
+
+	DistributedLBM dlbm(geom);
+	const Geometry& local_geom = dlbm.get_local_geometry();
+	LBM& lbm = dlbm.get_lbm();
+	Geometry local_geom_nc = local_geom;
+	Fluid bulk("bulk", 1.0/3, 1.0), droplet("droplet", 1.0/3, 0.9);
+	bulk.zero_density_ini(local_geom);
+	droplet.zero_density_ini(local_geom);
+	bulk.initialize_interactions(0.0, G_repulsive);
+	droplet.initialize_interactions(0.0, G_repulsive);
+	// Droplet across the periodic boundary in y
+	dlbm.initialize_droplet(bulk, droplet, 2.0, 2.0, 0.06, 0.06, 25, 3, 8);
+	dlbm.compute_solid_surface_force(bulk, droplet);
+	for (int iter = 0; iter<max_iter; ++iter) {
+		bulk.compute_density();
+		droplet.compute_density();
+		dlbm.exchange_density(bulk, droplet);
+		lbm.compute_fluid_repulsive_interactions(local_geom, bulk, droplet);
+		lbm.compute_equilibrium_velocities(local_geom_nc, bulk, droplet);
+		lbm.collide(bulk, droplet);
+		lbm.stream(local_geom, bulk, droplet);
+		dlbm.exchange_streamed(bulk, droplet);
+	}
+	const std::vector<double> f_bulk = dlbm.gather_distribution(bulk.get_f_dist());
+	const std::vector<double> f_droplet = dlbm.gather_distribution(droplet.get_f_dist());
+
+	bool pass = true;
+	if (dlbm.get_rank() == 0) {
+		LBM serial_lbm(geom);
+		Fluid serial_bulk("serial_bulk", 1.0/3, 1.0), serial_droplet("serial_droplet", 1.0/3, 0.9);
+		serial_bulk.zero_density_ini(geom);
+		serial_droplet.zero_density_ini(geom);
+		serial_bulk.initialize_interactions(0.0, G_repulsive);
+		serial_droplet.initialize_interactions(0.0, G_repulsive);
+		serial_lbm.initialize_droplet(geom, serial_bulk, serial_droplet, 2.0, 2.0, 0.06, 0.06, 25, 3, 8);
+		serial_lbm.compute_solid_surface_force(geom, serial_bulk, serial_droplet);
+		for (int iter = 0; iter<max_iter; ++iter) {
+			serial_bulk.compute_density();
+			serial_droplet.compute_density();
+			serial_lbm.compute_fluid_repulsive_interactions(geom, serial_bulk, serial_droplet);
+			serial_lbm.compute_equilibrium_velocities(geom, serial_bulk, serial_droplet);
+			serial_lbm.collide(serial_bulk, serial_droplet);
+			serial_lbm.stream(geom, serial_bulk, serial_droplet);
+		}
+		pass = same_on_root(f_bulk, serial_bulk.get_f_dist())
+					&& same_on_root(f_droplet, serial_droplet.get_f_dist());
+		if (!pass) {
+			std::cerr << "Distributed separate operations differ from the serial ones" << std::endl;
+		}
+	}
+	return all_ranks_agree(pass);
+}
+
+// Walls spanning the y direction and two objects,
+// fluid crosses the periodic boundary in y
+Geometry make_test_geometry()
+{
+	Geometry geom(60, 40);
+	geom.add_walls(2, "y");
+	geom.add_ellipse(11, 7, 15, 12);
+	geom.add_rectangle(5, 9, 45, 30);
+	return geom;
+}
+
+// Gathered distributed result is identical to the serial one (rank 0 only)
+bool same_on_root(const std::vector<double>& distributed, const LatticeVector<double>& serial)
+{
+	if (distributed.size() != serial.size()) {
+		return false;
+	}
+	return std::equal(distributed.begin(), distributed.end(), serial.begin());
+}
+
+// Result from rank 0 shared with all the ranks
+bool all_ranks_agree(const bool pass)
+{
+	int flag = pass ? 1 : 0;
+	MPI_Bcast(&flag, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	return flag == 1;
+}
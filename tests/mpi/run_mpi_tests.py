@@ -0,0 +1,30 @@
+import subprocess
+
+import sys
+py_path = '../../scripts/'
+sys.path.insert(0, py_path)
+
+import utils as ut
+from colors import *
+
+py_version = 'python3'
+
+# Directory with executables
+path_exe = '../../executables/'
+
+# Numbers of MPI processes - 3 does not divide the domain evenly
+nprocs = [1, 2, 3]
+
+#
+# Compile and run the MPI domain decomposition tests
+#
+
+# Compile
+subprocess.call([py_version + ' compilation.py'], shell=True)
+
+# General message
+ut.msg('MPI domain decomposition tests', CYAN)
+
+for nproc in nprocs:
+	ut.msg('Distributed runs on ' + str(nproc) + ' processes', RED)
+	subprocess.call(['mpirun -np ' + str(nproc) + ' ' + path_exe + 'mpi_tst'], shell=True)
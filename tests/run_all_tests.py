@@ -52,3 +52,10 @@ os.chdir('lbm/')
 subprocess.call([py_version + ' make_geoms.py'], shell=True)
 subprocess.call([py_version + ' run_lbm_tests.py'], shell=True)
 os.chdir('../')
+
+# MPI domain decomposition - needs mpicxx and mpirun
+print('\n'*2)
+ut.msg('- '*nSim + 'MPI DOMAIN DECOMPOSITION TESTS' + ' -'*nSim, REVERSE+RED)
+os.chdir('mpi/')
+subprocess.call([py_version + ' run_mpi_tests.py'], shell=True)
+os.chdir('../')